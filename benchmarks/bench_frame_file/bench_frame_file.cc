@@ -0,0 +1,266 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Inspects the .rsframes files recorded by the extensions, and measures the
+// recorder on synthetic frames.
+//
+// Usage: bench_frame_file <file>
+//          Prints the header, the frame rate, the dropped frames and the
+//          chunks of the file, and times random seeks into it.
+//        bench_frame_file --record=<file> [--frames=<count>]
+//                         [--width=<pixels>] [--height=<pixels>]
+//          Records color and depth frames at 60 FPS and prints the time the
+//          pipeline thread spent per frame and the frames dropped.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "realsense/common/frame_file_reader.h"
+#include "realsense/common/frame_recorder.h"
+
+namespace realsense {
+namespace benchmarks {
+
+namespace {
+
+using common::FrameFileReader;
+using common::FrameRecorder;
+
+const char kRecordSwitch[] = "record";
+const char kFramesSwitch[] = "frames";
+const char kWidthSwitch[] = "width";
+const char kHeightSwitch[] = "height";
+
+const int kDefaultFrames = 600;
+const int kDefaultWidth = 640;
+const int kDefaultHeight = 480;
+const int kFrameIntervalUs = 1000000 / 60;
+const int kSeeks = 10000;
+
+const char* GetChunkTypeName(uint32 type) {
+  switch (type) {
+    case common::FRAME_CHUNK_COLOR:
+      return "color";
+    case common::FRAME_CHUNK_DEPTH:
+      return "depth";
+    case common::FRAME_CHUNK_CAMERA_POSE:
+      return "camera_pose";
+    case common::FRAME_CHUNK_FACE_LANDMARKS:
+      return "face_landmarks";
+    case common::FRAME_CHUNK_HAND_JOINTS:
+      return "hand_joints";
+  }
+  return "unknown";
+}
+
+bool GetIntSwitch(const base::CommandLine& command_line, const char* name,
+                  int default_value, int* value) {
+  *value = default_value;
+  if (command_line.HasSwitch(name) &&
+      (!base::StringToInt(command_line.GetSwitchValueASCII(name), value) ||
+       *value <= 0)) {
+    fprintf(stderr, "Invalid --%s\n", name);
+    return false;
+  }
+  return true;
+}
+
+int PrintFile(const base::FilePath& path) {
+  FrameFileReader reader;
+  base::TimeTicks open_start = base::TimeTicks::Now();
+  if (!reader.Open(path)) {
+    fprintf(stderr, "Not a frame file: %s\n", path.MaybeAsASCII().c_str());
+    return 1;
+  }
+  base::TimeDelta open_time = base::TimeTicks::Now() - open_start;
+
+  const common::FrameFileHeader& header = reader.header();
+  const size_t frame_count = reader.frame_count();
+  char source[sizeof(header.source) + 1] = {};
+  memcpy(source, header.source, sizeof(header.source));
+  printf("source          %s\n", source);
+  printf("version         %u\n", header.version);
+  printf("index           %s\n",
+         reader.has_index() ? "yes" : "no, rebuilt from the records");
+  printf("open            %.2f ms\n", open_time.InMillisecondsF());
+  printf("frames          %llu\n",
+         static_cast<unsigned long long>(frame_count));  // NOLINT
+  printf("dropped frames  %llu\n",
+         static_cast<unsigned long long>(  // NOLINT
+             header.dropped_frame_count));
+  if (!frame_count)
+    return 0;
+
+  const double duration_s =
+      (reader.GetFrameTimestamp(frame_count - 1) -
+       reader.GetFrameTimestamp(0)) / 1000000.0;
+  printf("duration        %.2f s\n", duration_s);
+  if (duration_s > 0)
+    printf("frame rate      %.2f FPS\n", (frame_count - 1) / duration_s);
+
+  // The chunks of each type, and the frames missing from the numbering.
+  std::map<uint32, std::pair<uint64, uint64> > chunk_stats;
+  uint64 missing_frames = 0;
+  size_t invalid_frames = 0;
+  const common::FrameRecordHeader* previous = NULL;
+  std::vector<FrameFileReader::Chunk> chunks;
+  for (size_t i = 0; i < frame_count; ++i) {
+    const common::FrameRecordHeader* record = reader.GetFrame(i);
+    if (!record || !reader.GetChunks(i, &chunks)) {
+      ++invalid_frames;
+      continue;
+    }
+    if (previous && record->frame_number > previous->frame_number + 1)
+      missing_frames += record->frame_number - previous->frame_number - 1;
+    previous = record;
+    for (size_t j = 0; j < chunks.size(); ++j) {
+      std::pair<uint64, uint64>& stats = chunk_stats[chunks[j].header->type];
+      ++stats.first;
+      stats.second += chunks[j].header->size;
+    }
+  }
+  printf("missing frames  %llu\n",
+         static_cast<unsigned long long>(missing_frames));  // NOLINT
+  printf("invalid frames  %llu\n",
+         static_cast<unsigned long long>(invalid_frames));  // NOLINT
+
+  printf("\n%-16s %10s %14s\n", "chunk", "count", "bytes/chunk");
+  for (std::map<uint32, std::pair<uint64, uint64> >::const_iterator it =
+           chunk_stats.begin(); it != chunk_stats.end(); ++it) {
+    printf("%-16s %10llu %14.1f\n", GetChunkTypeName(it->first),
+           static_cast<unsigned long long>(it->second.first),  // NOLINT
+           static_cast<double>(it->second.second) / it->second.first);
+  }
+
+  // Seeks to random times and reads the first chunk of the frame found, the
+  // way a player scrubs through the recording.
+  const int64 first = reader.GetFrameTimestamp(0);
+  const int64 last = reader.GetFrameTimestamp(frame_count - 1);
+  uint32 checksum = 0;
+  base::TimeTicks seek_start = base::TimeTicks::Now();
+  for (int i = 0; i < kSeeks; ++i) {
+    int64 timestamp = first + static_cast<int64>(
+        base::RandGenerator(static_cast<uint64>(last - first) + 1));
+    size_t index = reader.FindFrame(timestamp);
+    FrameFileReader::Chunk chunk;
+    if (reader.GetChunk(index, common::FRAME_CHUNK_DEPTH, &chunk) ||
+        reader.GetChunk(index, common::FRAME_CHUNK_COLOR, &chunk)) {
+      for (uint64 j = 0; j < chunk.header->size; j += 4096)
+        checksum += chunk.data[j];
+    }
+  }
+  base::TimeDelta seek_time = base::TimeTicks::Now() - seek_start;
+  printf("\nseek            %.2f us (checksum %u)\n",
+         seek_time.InMicrosecondsF() / kSeeks, checksum);
+  return 0;
+}
+
+int Record(const base::FilePath& path, int frames, int width, int height) {
+  std::vector<uint8> color(width * height * 4);
+  std::vector<uint16> depth(width * height);
+  for (size_t i = 0; i < color.size(); ++i)
+    color[i] = static_cast<uint8>(i * 7);
+  for (size_t i = 0; i < depth.size(); ++i)
+    depth[i] = static_cast<uint16>(500 + i % 2000);
+  float pose[12] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+
+  FrameRecorder recorder;
+  if (!recorder.Start(path, "bench_frame_file"))
+    return 1;
+
+  base::TimeDelta total;
+  base::TimeDelta longest;
+  base::TimeTicks next_frame = base::TimeTicks::Now();
+  for (int i = 0; i < frames; ++i) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    FrameRecorder::Frame* frame = recorder.BeginFrame();
+    if (frame) {
+      frame->AddImage(common::FRAME_CHUNK_COLOR,
+                      common::FRAME_CHUNK_FORMAT_BGRA32, &color[0],
+                      width * 4, width, height, 4, i);
+      frame->AddImage(common::FRAME_CHUNK_DEPTH,
+                      common::FRAME_CHUNK_FORMAT_DEPTH16,
+                      reinterpret_cast<const uint8*>(&depth[0]), width * 2,
+                      width, height, 2, i);
+      frame->AddData(common::FRAME_CHUNK_CAMERA_POSE, pose, sizeof(pose));
+      recorder.EndFrame(frame);
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    total += elapsed;
+    longest = std::max(longest, elapsed);
+
+    next_frame += base::TimeDelta::FromMicroseconds(kFrameIntervalUs);
+    base::TimeDelta wait = next_frame - base::TimeTicks::Now();
+    if (wait > base::TimeDelta())
+      base::PlatformThread::Sleep(wait);
+  }
+  base::TimeTicks stop_start = base::TimeTicks::Now();
+  recorder.Stop();
+  base::TimeDelta stop_time = base::TimeTicks::Now() - stop_start;
+
+  printf("frames          %d of %dx%d\n", frames, width, height);
+  printf("pipeline        %.1f us/frame, %.1f us at most\n",
+         total.InMicrosecondsF() / frames, longest.InMicrosecondsF());
+  printf("stop            %.2f ms\n", stop_time.InMillisecondsF());
+
+  FrameFileReader reader;
+  if (!reader.Open(path)) {
+    fprintf(stderr, "Failed to read back %s\n", path.MaybeAsASCII().c_str());
+    return 1;
+  }
+  printf("written         %llu\n",
+         static_cast<unsigned long long>(reader.frame_count()));  // NOLINT
+  printf("dropped         %llu\n",
+         static_cast<unsigned long long>(  // NOLINT
+             reader.header().dropped_frame_count));
+  return 0;
+}
+
+}  // namespace
+
+int Main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine* command_line =
+      base::CommandLine::ForCurrentProcess();
+
+  if (command_line->HasSwitch(kRecordSwitch)) {
+    int frames, width, height;
+    if (!GetIntSwitch(*command_line, kFramesSwitch, kDefaultFrames,
+                      &frames) ||
+        !GetIntSwitch(*command_line, kWidthSwitch, kDefaultWidth, &width) ||
+        !GetIntSwitch(*command_line, kHeightSwitch, kDefaultHeight,
+                      &height)) {
+      return 1;
+    }
+    return Record(command_line->GetSwitchValuePath(kRecordSwitch), frames,
+                  width, height);
+  }
+
+  const base::CommandLine::StringVector& args = command_line->GetArgs();
+  if (args.size() != 1) {
+    fprintf(stderr, "Usage: bench_frame_file <file> | --record=<file>\n");
+    return 1;
+  }
+  return PrintFile(base::FilePath(args[0]));
+}
+
+}  // namespace benchmarks
+}  // namespace realsense
+
+int main(int argc, char** argv) {
+  return realsense::benchmarks::Main(argc, argv);
+}
@@ -0,0 +1,28 @@
+# Copyright (c) 2016 Intel Corporation. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'targets': [
+    {
+      'target_name': 'bench_frame_file',
+      'type': 'executable',
+      'include_dirs': [
+        '../..',
+      ],
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+      ],
+      'sources': [
+        '../../realsense/common/frame_file.h',
+        '../../realsense/common/frame_file_reader.cc',
+        '../../realsense/common/frame_file_reader.h',
+        '../../realsense/common/frame_recorder.cc',
+        '../../realsense/common/frame_recorder.h',
+        '../../realsense/common/memory_accounting.cc',
+        '../../realsense/common/memory_accounting.h',
+        'bench_frame_file.cc',
+      ],
+    },
+  ],
+}
@@ -4,12 +4,45 @@
 
 var BenchImage = function(object_id) {
   common.BindingObject.call(this, common.getUniqueId());
+  common.EventTarget.call(this);
 
   if (object_id == undefined)
     internal.postMessage('benchImageConstructor', [this._id]);
 
+  var sampleFormats = ['', 'rgba32', 'depth16', 'depth_f32'];
+
+  function wrapImageBinaryReturns(data) {
+    // ImageBinary layout: call_id (int32), format (int32), width (int32),
+    // height (int32), then the pixels (4 bytes for rgba32 and depth_f32,
+    // 2 bytes for depth16).
+    var int32Array = new Int32Array(data, 0, 4);
+    var format = sampleFormats[int32Array[1]];
+    var width = int32Array[2];
+    var height = int32Array[3];
+    var offset = 4 * 4;
+    var pixels;
+    if (format == 'depth16')
+      pixels = new Uint16Array(data, offset, width * height);
+    else if (format == 'depth_f32')
+      pixels = new Float32Array(data, offset, width * height);
+    else
+      pixels = new Uint8Array(data, offset, width * height * 4);
+    return {
+      format: format,
+      width: width,
+      height: height,
+      data: pixels
+    };
+  }
+
   this._addMethodWithPromise('getSampleLong');
   this._addMethodWithPromise('getSampleString');
+  this._addMethodWithPromise('getSampleBinary', null, wrapImageBinaryReturns);
+  this._addMethodWithPromise('getSampleBinaryPooled', null, wrapImageBinaryReturns);
+  this._addMethodWithPromise('requestSampleEvent');
+  this._addMethodWithPromise('getPendingSample', null, wrapImageBinaryReturns);
+
+  this._addEvent('sampleready');
 };
 
 BenchImage.prototype = new common.EventTargetPrototype();
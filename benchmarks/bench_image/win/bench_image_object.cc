@@ -2,34 +2,90 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 
 #include "benchmarks/bench_image/win/bench_image_object.h"
 #include "third_party/modp_b64/modp_b64.h"
 
-// This file is auto-generated by bench_image.idl
-#include "bench_image.h" // NOLINT
-
 namespace realsense {
 namespace bench_image {
 
 using namespace realsense::jsapi::bench_image; // NOLINT
 using namespace xwalk::common; // NOLINT
 
-BenchImageObject::BenchImageObject() {
+namespace {
+
+// call_id, format, width and height (int32).
+const size_t kBinaryHeaderSize = 4 * sizeof(int);
+// Up to 4K.
+const int kMaxSampleWidth = 4096;
+const int kMaxSampleHeight = 2160;
+
+SampleFormat GetSampleFormat(const SampleOptions& options) {
+  if (options.format == SampleFormat::SAMPLE_FORMAT_NONE)
+    return SampleFormat::SAMPLE_FORMAT_RGBA32;
+  return options.format;
+}
+
+int GetBytesPerPixel(SampleFormat format) {
+  return format == SampleFormat::SAMPLE_FORMAT_DEPTH16 ? 2 : 4;
+}
+
+// The codes of the binary message.
+int GetFormatCode(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::SAMPLE_FORMAT_DEPTH16:
+      return 2;
+    case SampleFormat::SAMPLE_FORMAT_DEPTH_F32:
+      return 3;
+    default:
+      return 1;
+  }
+}
+
+}  // namespace
+
+BenchImageObject::BenchImageObject()
+    : pool_size_(0),
+      pending_pool_size_(0),
+      pending_size_(0),
+      on_sampleready_(false) {
   handler_.Register("getSampleLong",
     base::Bind(&BenchImageObject::OnGetSampleLong,
                                base::Unretained(this)));
   handler_.Register("getSampleString",
     base::Bind(&BenchImageObject::OnGetSampleString,
                              base::Unretained(this)));
+  handler_.Register("getSampleBinary",
+    base::Bind(&BenchImageObject::OnGetSampleBinary,
+               base::Unretained(this)));
+  handler_.Register("getSampleBinaryPooled",
+    base::Bind(&BenchImageObject::OnGetSampleBinaryPooled,
+               base::Unretained(this)));
+  handler_.Register("requestSampleEvent",
+    base::Bind(&BenchImageObject::OnRequestSampleEvent,
+               base::Unretained(this)));
+  handler_.Register("getPendingSample",
+    base::Bind(&BenchImageObject::OnGetPendingSample,
+               base::Unretained(this)));
   frame_count = 0;
 }
 
 BenchImageObject::~BenchImageObject() {
 }
 
+void BenchImageObject::StartEvent(const std::string& type) {
+  if (type == std::string("sampleready"))
+    on_sampleready_ = true;
+}
+
+void BenchImageObject::StopEvent(const std::string& type) {
+  if (type == std::string("sampleready"))
+    on_sampleready_ = false;
+}
+
 void BenchImageObject::OnGetSampleLong(
   scoped_ptr<XWalkExtensionFunctionInfo> info) {
   scoped_ptr<SampleLong> sample(new SampleLong());
@@ -77,6 +133,120 @@ void BenchImageObject::OnGetSampleString(
   }
 }
 
+void BenchImageObject::OnGetSampleBinary(
+  scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<GetSampleBinary::Params>
+    params(GetSampleBinary::Params::Create(*info->arguments()));
+  size_t size = params ? GetBinarySampleSize(params->options) : 0;
+  if (size == 0) {
+    info->PostResult(GetSampleBinary::Results::Create(
+      ImageBinary(), std::string("invalid image size")));
+    return;
+  }
+
+  scoped_ptr<char[]> message(new char[size]);
+  FillBinarySample(params->options, message.get());
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(new base::BinaryValue(message.Pass(), size));
+  info->PostResult(result.Pass());
+}
+
+void BenchImageObject::OnGetSampleBinaryPooled(
+  scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<GetSampleBinaryPooled::Params>
+    params(GetSampleBinaryPooled::Params::Create(*info->arguments()));
+  size_t size =
+    params ? FillPooledSample(params->options, &pool_, &pool_size_) : 0;
+  if (size == 0) {
+    info->PostResult(GetSampleBinaryPooled::Results::Create(
+      ImageBinary(), std::string("invalid image size")));
+    return;
+  }
+
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(base::BinaryValue::CreateWithCopiedBuffer(pool_.get(), size));
+  info->PostResult(result.Pass());
+}
+
+void BenchImageObject::OnRequestSampleEvent(
+  scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<RequestSampleEvent::Params>
+    params(RequestSampleEvent::Params::Create(*info->arguments()));
+  pending_size_ = params ? FillPooledSample(params->options, &pending_pool_,
+                                            &pending_pool_size_) : 0;
+  if (pending_size_ == 0) {
+    info->PostResult(RequestSampleEvent::Results::Create(
+      std::string("invalid image size")));
+    return;
+  }
+
+  info->PostResult(RequestSampleEvent::Results::Create(std::string()));
+  if (on_sampleready_)
+    DispatchEvent("sampleready");
+}
+
+void BenchImageObject::OnGetPendingSample(
+  scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  if (pending_size_ == 0) {
+    info->PostResult(GetPendingSample::Results::Create(
+      ImageBinary(), std::string("no pending sample")));
+    return;
+  }
+
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(
+    base::BinaryValue::CreateWithCopiedBuffer(pending_pool_.get(),
+                                              pending_size_));
+  pending_size_ = 0;
+  info->PostResult(result.Pass());
+}
+
+size_t BenchImageObject::GetBinarySampleSize(const SampleOptions& options) {
+  if (options.width <= 0 || options.width > kMaxSampleWidth ||
+      options.height <= 0 || options.height > kMaxSampleHeight)
+    return 0;
+  return kBinaryHeaderSize + static_cast<size_t>(options.width) *
+    options.height * GetBytesPerPixel(GetSampleFormat(options));
+}
+
+void BenchImageObject::FillBinarySample(const SampleOptions& options,
+                                        char* message) {
+  SampleFormat format = GetSampleFormat(options);
+  int* int_array = reinterpret_cast<int*>(message);
+  int_array[1] = GetFormatCode(format);
+  int_array[2] = options.width;
+  int_array[3] = options.height;
+
+  const size_t count = static_cast<size_t>(options.width) * options.height;
+  char* pixels = message + kBinaryHeaderSize;
+  uint32 pixel = GeneratePixel();
+  if (format == SampleFormat::SAMPLE_FORMAT_DEPTH16) {
+    // A depth in millimeters which changes with each frame.
+    uint16* depth = reinterpret_cast<uint16*>(pixels);
+    std::fill(depth, depth + count, static_cast<uint16>(pixel & 0xFFF));
+  } else if (format == SampleFormat::SAMPLE_FORMAT_DEPTH_F32) {
+    float* depth = reinterpret_cast<float*>(pixels);
+    std::fill(depth, depth + count, (pixel & 0xFFF) / 1000.0f);
+  } else {
+    uint32* rgba = reinterpret_cast<uint32*>(pixels);
+    std::fill(rgba, rgba + count, pixel);
+  }
+}
+
+size_t BenchImageObject::FillPooledSample(const SampleOptions& options,
+                                          scoped_ptr<char[]>* pool,
+                                          size_t* pool_size) {
+  size_t size = GetBinarySampleSize(options);
+  if (size == 0)
+    return 0;
+  if (*pool_size < size) {
+    pool->reset(new char[size]);
+    *pool_size = size;
+  }
+  FillBinarySample(options, pool->get());
+  return size;
+}
+
 uint32 BenchImageObject::GeneratePixel() {
   return (0xff << ((frame_count++ % 3) * 8)) + 0x80000000;
 }
@@ -6,23 +6,63 @@
 #define REALSENSE_BENCHMARKS_BENCH_IMAGE_BENCH_IMAGE_OBJECT_H_
 
 #include <string>
-#include "xwalk/common/binding_object.h"
+#include "xwalk/common/event_target.h"
+
+// This file is auto-generated by bench_image.idl
+#include "bench_image.h" // NOLINT
 
 namespace realsense {
 namespace bench_image {
 
-class BenchImageObject : public xwalk::common::BindingObject {
+class BenchImageObject : public xwalk::common::EventTarget {
  public:
   BenchImageObject();
   ~BenchImageObject() override;
 
+  // EventTarget implementation.
+  void StartEvent(const std::string& type) override;
+  void StopEvent(const std::string& type) override;
+
  private:
   void OnGetSampleLong(
     scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
   void OnGetSampleString(
     scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  // The binary samples take a new buffer each time, which the result takes
+  // over.
+  void OnGetSampleBinary(
+    scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  // The pooled samples are filled in a buffer kept across calls and copied
+  // into the result.
+  void OnGetSampleBinaryPooled(
+    scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  void OnRequestSampleEvent(
+    scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  void OnGetPendingSample(
+    scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+
+  // Returns the size of the binary message of |options|, or 0 if they are
+  // invalid.
+  size_t GetBinarySampleSize(const jsapi::bench_image::SampleOptions& options);
+  // Fills the binary message of |options|, except the call_id.
+  void FillBinarySample(const jsapi::bench_image::SampleOptions& options,
+                        char* message);
+  // Fills |pool|, growing it to fit, and returns the size of the message, or
+  // 0 if |options| are invalid.
+  size_t FillPooledSample(const jsapi::bench_image::SampleOptions& options,
+                          scoped_ptr<char[]>* pool, size_t* pool_size);
   uint32 GeneratePixel();
   uint32 frame_count;
+
+  scoped_ptr<char[]> pool_;
+  size_t pool_size_;
+  // The sample prepared by requestSampleEvent() has a pool of its own, so
+  // the pooled calls made before getPendingSample() don't overwrite it.
+  scoped_ptr<char[]> pending_pool_;
+  size_t pending_pool_size_;
+  // Size of the sample in |pending_pool_|, 0 if there is none.
+  size_t pending_size_;
+  bool on_sampleready_;
 };
 
 }  // namespace bench_image
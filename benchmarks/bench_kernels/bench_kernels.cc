@@ -0,0 +1,490 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Microbenchmarks of the kernels filling the binary messages and results of
+// the extensions, on synthetic frames of several resolutions. Each case
+// reports the time per iteration, the throughput of the bytes it produces and
+// the heap allocations it makes.
+//
+// Usage: bench_kernels [--filter=<substring of the case name>]
+//                      [--min-time-ms=<time spent on each case>]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/memory/linked_ptr.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "realsense/common/binary_packing.h"
+#include "realsense/common/depth_codec.h"
+#include "realsense/hand/win/joint_population.h"
+
+namespace {
+
+// Heap allocations of the process, counted by the operators below. The
+// benchmark is single threaded.
+int64 g_allocation_count = 0;
+int64 g_allocated_bytes = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++g_allocation_count;
+  g_allocated_bytes += size;
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    abort();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) throw() {
+  free(p);
+}
+
+void operator delete[](void* p) throw() {
+  free(p);
+}
+
+namespace realsense {
+namespace benchmarks {
+
+namespace {
+
+using common::ImageMessageFormat;
+
+const char kFilterSwitch[] = "filter";
+const char kMinTimeSwitch[] = "min-time-ms";
+const int kDefaultMinTimeMs = 200;
+
+struct Resolution {
+  int width;
+  int height;
+};
+
+// Color and depth resolutions of the cameras.
+const Resolution kResolutions[] = {
+  { 320, 240 },
+  { 640, 480 },
+  { 1280, 720 },
+  { 1920, 1080 },
+};
+
+// Faces and landmarks of a face sample, the maximum of the face module.
+const int kFaces = 4;
+const int kLandmarks = 78;
+const int kHands = 2;
+
+// The SDK types the kernels are instantiated with, reduced to the fields they
+// read.
+struct BlockMesh {
+  int meshId;
+  int vertexStartIndex;
+  int numVertices;
+  int faceStartIndex;
+  int numFaces;
+};
+
+struct Point2DF32 {
+  float x;
+  float y;
+};
+
+struct Point3DF32 {
+  float x;
+  float y;
+  float z;
+};
+
+struct Point4DF32 {
+  float x;
+  float y;
+  float z;
+  float w;
+};
+
+struct LandmarkPoint {
+  struct {
+    int index;
+    int alias;
+  } source;
+  int confidenceImage;
+  int confidenceWorld;
+  Point3DF32 world;
+  Point2DF32 image;
+};
+
+struct JointData {
+  int confidence;
+  Point3DF32 positionWorld;
+  Point3DF32 positionImage;
+  Point4DF32 localRotation;
+  Point4DF32 globalOrientation;
+  Point3DF32 speed;
+};
+
+// Synthetic inputs of one resolution, with padded rows like the planes of the
+// SDK.
+struct Frame {
+  explicit Frame(const Resolution& resolution);
+
+  int width;
+  int height;
+  int color_pitch;
+  int depth_pitch;
+  int depth_f32_pitch;
+  int mask_pitch;
+  std::vector<uint8> color;
+  std::vector<uint8> depth;
+  std::vector<uint8> depth_f32;
+  std::vector<uint8> mask;
+  // The RVL coding of |depth|.
+  std::vector<uint8> depth_rvl;
+
+  // A mesh of one vertex per 4x4 pixels, in block meshes of 64 vertices.
+  std::vector<BlockMesh> block_meshes;
+  std::vector<float> vertices;
+  std::vector<int> faces;
+  std::vector<uint8> colors;
+
+  std::vector<LandmarkPoint> landmarks;
+  std::vector<JointData> joints;
+
+  // Output buffers reused by the cases which write in place.
+  std::vector<uint8> output;
+};
+
+int PaddedPitch(int row_size) {
+  return (row_size + 63) & ~63;
+}
+
+Frame::Frame(const Resolution& resolution)
+    : width(resolution.width),
+      height(resolution.height),
+      color_pitch(PaddedPitch(width * 4)),
+      depth_pitch(PaddedPitch(width * 2)),
+      depth_f32_pitch(PaddedPitch(width * 4)),
+      mask_pitch(PaddedPitch(width)),
+      color(color_pitch * height),
+      depth(depth_pitch * height),
+      depth_f32(depth_f32_pitch * height),
+      mask(mask_pitch * height) {
+  for (size_t i = 0; i < color.size(); ++i)
+    color[i] = static_cast<uint8>(i * 7);
+  for (int y = 0; y < height; ++y) {
+    uint16* depth_row = reinterpret_cast<uint16*>(&depth[depth_pitch * y]);
+    float* f32_row = reinterpret_cast<float*>(&depth_f32[depth_f32_pitch * y]);
+    for (int x = 0; x < width; ++x) {
+      // Holes of 8x8 pixels, like the shadows and the out of range areas of
+      // a depth camera.
+      if ((x / 8 + y / 8) % 5 == 0)
+        depth_row[x] = 0;
+      else
+        depth_row[x] = static_cast<uint16>(500 + (x * 3 + y * 5) % 2000);
+      f32_row[x] = depth_row[x] / 1000.0f;
+      mask[mask_pitch * y + x] = ((x ^ y) & 1) ? 255 : 0;
+    }
+  }
+  depth_rvl.resize(common::GetMaxRVLSize(width, height));
+  depth_rvl.resize(common::EncodeRVL(&depth[0], depth_pitch, width, height,
+                                     &depth_rvl[0]));
+
+  const int kVerticesPerBlock = 64;
+  const int num_vertices = width * height / 16;
+  vertices.resize(num_vertices * 4);
+  for (size_t i = 0; i < vertices.size(); ++i)
+    vertices[i] = static_cast<float>(i % 1000) / 100.0f;
+  colors.resize(num_vertices * 3);
+  for (size_t i = 0; i < colors.size(); ++i)
+    colors[i] = static_cast<uint8>(i);
+  for (int start = 0; start < num_vertices; start += kVerticesPerBlock) {
+    BlockMesh mesh;
+    mesh.meshId = static_cast<int>(block_meshes.size());
+    mesh.vertexStartIndex = start * 4;
+    mesh.numVertices = std::min(kVerticesPerBlock, num_vertices - start);
+    mesh.faceStartIndex = static_cast<int>(faces.size());
+    mesh.numFaces = 2 * mesh.numVertices;
+    for (int j = 0; j < mesh.numFaces * 3; ++j)
+      faces.push_back(start + (j * 13) % mesh.numVertices);
+    block_meshes.push_back(mesh);
+  }
+
+  landmarks.resize(kFaces * kLandmarks);
+  for (size_t i = 0; i < landmarks.size(); ++i) {
+    LandmarkPoint& point = landmarks[i];
+    point.source.index = static_cast<int>(i) % kLandmarks;
+    point.source.alias = point.source.index;
+    point.confidenceImage = 100;
+    point.confidenceWorld = 90;
+    point.world.x = point.world.y = point.world.z = i * 0.5f;
+    point.image.x = point.image.y = i * 2.0f;
+  }
+
+  joints.resize(kHands * hand::kNumberOfJoints);
+  for (size_t i = 0; i < joints.size(); ++i) {
+    JointData& joint = joints[i];
+    memset(&joint, 0, sizeof(joint));
+    joint.confidence = 100;
+    joint.positionWorld.x = joint.positionImage.x = i * 0.25f;
+    joint.localRotation.w = joint.globalOrientation.w = 1.0f;
+  }
+}
+
+// Runs one iteration and returns the size of what it produced.
+typedef size_t (*CaseFunction)(Frame* frame);
+
+size_t RunImageMessage(Frame* frame, ImageMessageFormat format,
+                       const std::vector<uint8>& plane, int pitch) {
+  size_t length;
+  scoped_ptr<uint8[]> message = common::CreateImageMessage(
+      format, &plane[0], pitch, frame->width, frame->height, &length);
+  return length;
+}
+
+size_t RunSwizzle(Frame* frame) {
+  frame->output.resize(frame->width * frame->height * 4);
+  common::SwizzleBGRAToRGBA(&frame->color[0], frame->color_pitch,
+                            frame->width, frame->height, &frame->output[0]);
+  return frame->output.size();
+}
+
+size_t RunHalve(Frame* frame) {
+  frame->output.resize((frame->width / 2) * (frame->height / 2) * 4);
+  common::HalveBGRAToRGBA(&frame->color[0], frame->color_pitch, frame->width,
+                          frame->height, &frame->output[0]);
+  return frame->output.size();
+}
+
+size_t RunImageMessageY8(Frame* frame) {
+  return RunImageMessage(frame, common::IMAGE_MESSAGE_Y8, frame->mask,
+                         frame->mask_pitch);
+}
+
+size_t RunImageMessageDepth16(Frame* frame) {
+  return RunImageMessage(frame, common::IMAGE_MESSAGE_DEPTH16, frame->depth,
+                         frame->depth_pitch);
+}
+
+size_t RunImageMessageDepthF32(Frame* frame) {
+  return RunImageMessage(frame, common::IMAGE_MESSAGE_DEPTH_F32,
+                         frame->depth_f32, frame->depth_f32_pitch);
+}
+
+size_t RunImageMessageRGBA(Frame* frame) {
+  return RunImageMessage(frame, common::IMAGE_MESSAGE_RGBA, frame->color,
+                         frame->color_pitch);
+}
+
+// The depth section of the messages asking for the RVL coding.
+size_t RunRVLEncode(Frame* frame) {
+  frame->output.resize(common::GetMaxDepthSectionSize(
+      common::DEPTH_MESSAGE_RVL, frame->width, frame->height));
+  return common::PackDepthSection(common::DEPTH_MESSAGE_RVL, &frame->depth[0],
+                                  frame->depth_pitch, frame->width,
+                                  frame->height, &frame->output[0]);
+}
+
+// The native decoder, the pages running depth_codec_api.js instead. Returns
+// the size of the decoded pixels.
+size_t RunRVLDecode(Frame* frame) {
+  const size_t size = frame->width * frame->height * sizeof(uint16);
+  frame->output.resize(size);
+  bool decoded = common::DecodeRVL(
+      &frame->depth_rvl[0], frame->depth_rvl.size(), frame->width,
+      frame->height, reinterpret_cast<uint16*>(&frame->output[0]));
+  CHECK(decoded);
+  return size;
+}
+
+// As ScenePerceptionObject::DoMeshingUpdateOnMeshingThread().
+size_t RunMeshMessage(Frame* frame) {
+  const int num_block_meshes = static_cast<int>(frame->block_meshes.size());
+  const int num_vertices = static_cast<int>(frame->vertices.size() / 4);
+  const int num_faces = static_cast<int>(frame->faces.size() / 3);
+  size_t size = common::GetMeshMessageSize(num_block_meshes, num_vertices,
+                                           num_faces);
+  scoped_ptr<char[]> message(new char[size]);
+  common::PackMeshMessage(&frame->block_meshes[0], num_block_meshes,
+                          &frame->vertices[0], num_vertices,
+                          &frame->faces[0], num_faces, &frame->colors[0],
+                          reinterpret_cast<uint8*>(message.get()));
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(new base::BinaryValue(message.Pass(), size));
+  return size;
+}
+
+// As FaceModuleObject::OnGetProcessedSample(), with the color and depth
+// images, then the detection and landmarks of each face, into a buffer kept
+// across calls and copied into the result.
+size_t RunFaceSample(Frame* frame) {
+  const size_t color_size = frame->width * frame->height * 4;
+  const size_t depth_size = common::GetMaxDepthSectionSize(
+      common::DEPTH_MESSAGE_RAW, frame->width, frame->height);
+  const size_t face_size =
+      sizeof(int) + 4 * sizeof(int) + sizeof(float) +
+      sizeof(int) + kLandmarks * common::kLandmarkPointSize;
+  const size_t size = sizeof(int) + 3 * sizeof(int) + color_size +
+                      3 * sizeof(int) + depth_size + 4 * sizeof(int) +
+                      kFaces * face_size;
+  if (frame->output.size() < size)
+    frame->output.resize(size);
+
+  uint8* message = &frame->output[0];
+  size_t offset = sizeof(int) + 3 * sizeof(int);
+  common::SwizzleBGRAToRGBA(&frame->color[0], frame->color_pitch,
+                            frame->width, frame->height, message + offset);
+  offset += color_size + 3 * sizeof(int);
+  offset += common::PackDepthSection(common::DEPTH_MESSAGE_RAW,
+                                     &frame->depth[0], frame->depth_pitch,
+                                     frame->width, frame->height,
+                                     message + offset);
+  offset += 4 * sizeof(int);
+  for (int i = 0; i < kFaces; ++i) {
+    memset(message + offset, 0, 5 * sizeof(int) + sizeof(float));
+    offset += 5 * sizeof(int) + sizeof(float);
+    *reinterpret_cast<int*>(message + offset) = kLandmarks;
+    offset += sizeof(int);
+    const LandmarkPoint* points = &frame->landmarks[i * kLandmarks];
+    for (int j = 0; j < kLandmarks; ++j)
+      common::PackLandmarkPoint(points[j], message + offset);
+    offset += kLandmarks * common::kLandmarkPointSize;
+  }
+
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(base::BinaryValue::CreateWithCopiedBuffer(
+      reinterpret_cast<const char*>(message), offset));
+  return offset;
+}
+
+// As HandModuleObject::OnTrack(), with the tracked and normalized joints of
+// each hand, converted to the result.
+size_t RunHandJoints(Frame* frame) {
+  using jsapi::hand_module::Hand;
+  std::vector<linked_ptr<Hand>> hands;
+  for (int i = 0; i < kHands; ++i) {
+    linked_ptr<Hand> hand(new Hand);
+    hand->body_side = jsapi::hand_module::BODY_SIDE_LEFT;
+    hand->tracking_status = jsapi::hand_module::TRACKING_STATUS_GOOD;
+    const JointData* joints = &frame->joints[i * hand::kNumberOfJoints];
+    hand::PopulateJoints(&hand->tracked_joints, joints);
+    hand::PopulateJoints(&hand->normalized_joints, joints);
+    hands.push_back(hand);
+  }
+  scoped_ptr<base::ListValue> result(
+      jsapi::hand_module::Track::Results::Create(hands));
+  return 2 * kHands * hand::kNumberOfJoints * sizeof(JointData);
+}
+
+struct Case {
+  const char* name;
+  CaseFunction function;
+  // Whether the case depends on the resolution.
+  bool sweep;
+};
+
+const Case kCases[] = {
+  { "swizzle_bgra_to_rgba", &RunSwizzle, true },
+  { "halve_bgra_to_rgba", &RunHalve, true },
+  { "image_message_y8", &RunImageMessageY8, true },
+  { "image_message_depth16", &RunImageMessageDepth16, true },
+  { "image_message_depth_f32", &RunImageMessageDepthF32, true },
+  { "image_message_rgba", &RunImageMessageRGBA, true },
+  { "mesh_message", &RunMeshMessage, true },
+  { "face_sample", &RunFaceSample, true },
+  { "rvl_encode", &RunRVLEncode, true },
+  { "rvl_decode", &RunRVLDecode, true },
+  { "hand_joints", &RunHandJoints, false },
+};
+
+void RunCase(const Case& bench_case, const Resolution& resolution,
+             base::TimeDelta min_time) {
+  Frame frame(resolution);
+  // Warms up the caches and the reused buffers.
+  size_t bytes = bench_case.function(&frame);
+
+  const int64 allocation_count = g_allocation_count;
+  const int64 allocated_bytes = g_allocated_bytes;
+  int64 iterations = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  base::TimeDelta elapsed;
+  do {
+    bench_case.function(&frame);
+    ++iterations;
+    elapsed = base::TimeTicks::Now() - start;
+  } while (elapsed < min_time);
+
+  const double us_per_iteration =
+      elapsed.InMicrosecondsF() / iterations;
+  const double mb_per_second =
+      bytes / us_per_iteration * 1000000.0 / (1024.0 * 1024.0);
+  char resolution_name[32];
+  if (bench_case.sweep) {
+    snprintf(resolution_name, sizeof(resolution_name), "%dx%d",
+             resolution.width, resolution.height);
+  } else {
+    snprintf(resolution_name, sizeof(resolution_name), "-");
+  }
+  printf("%-24s %-10s %10lld %12.2f %10.1f %12.2f %14.1f\n",
+         bench_case.name, resolution_name,
+         static_cast<long long>(iterations), us_per_iteration,  // NOLINT
+         mb_per_second,
+         static_cast<double>(g_allocation_count - allocation_count) /
+             iterations,
+         static_cast<double>(g_allocated_bytes - allocated_bytes) /
+             iterations);
+}
+
+}  // namespace
+
+int Main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine* command_line =
+      base::CommandLine::ForCurrentProcess();
+  std::string filter = command_line->GetSwitchValueASCII(kFilterSwitch);
+  int min_time_ms = kDefaultMinTimeMs;
+  if (command_line->HasSwitch(kMinTimeSwitch) &&
+      (!base::StringToInt(command_line->GetSwitchValueASCII(kMinTimeSwitch),
+                          &min_time_ms) || min_time_ms <= 0)) {
+    fprintf(stderr, "Invalid --%s\n", kMinTimeSwitch);
+    return 1;
+  }
+  base::TimeDelta min_time = base::TimeDelta::FromMilliseconds(min_time_ms);
+
+  printf("%-24s %-10s %10s %12s %10s %12s %14s\n", "case", "resolution",
+         "iterations", "us/iter", "MB/s", "allocs/iter", "bytes/iter");
+  for (size_t i = 0; i < arraysize(kCases); ++i) {
+    const Case& bench_case = kCases[i];
+    if (!filter.empty() &&
+        std::string(bench_case.name).find(filter) == std::string::npos)
+      continue;
+    if (!bench_case.sweep) {
+      RunCase(bench_case, kResolutions[0], min_time);
+      continue;
+    }
+    for (size_t j = 0; j < arraysize(kResolutions); ++j)
+      RunCase(bench_case, kResolutions[j], min_time);
+  }
+  return 0;
+}
+
+}  // namespace benchmarks
+}  // namespace realsense
+
+int main(int argc, char** argv) {
+  return realsense::benchmarks::Main(argc, argv);
+}
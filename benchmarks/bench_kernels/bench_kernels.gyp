@@ -0,0 +1,34 @@
+# Copyright (c) 2016 Intel Corporation. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'targets': [
+    {
+      'target_name': 'bench_kernels',
+      'type': 'executable',
+      'includes': [
+        '../../../xwalk/common/xwalk_idlgen.gypi',
+      ],
+      'include_dirs': [
+        '../..',
+      ],
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+      ],
+      'variables': {
+        'jsapi_namespace': 'realsense::jsapi',
+        'jsapi_component': 'bench_kernels',
+      },
+      'sources': [
+        '../../realsense/common/binary_packing.cc',
+        '../../realsense/common/binary_packing.h',
+        '../../realsense/common/depth_codec.cc',
+        '../../realsense/common/depth_codec.h',
+        '../../realsense/hand/win/hand_module.idl',
+        '../../realsense/hand/win/joint_population.h',
+        'bench_kernels.cc',
+      ],
+    },
+  ],
+}
@@ -7,6 +7,10 @@
     {
       'target_name': 'benchmarks',
       'type': 'none',
+      'dependencies': [
+        'bench_frame_file/bench_frame_file.gyp:*',
+        'bench_kernels/bench_kernels.gyp:*',
+      ],
       'conditions': [
         ['OS=="win"', {
           'dependencies': [
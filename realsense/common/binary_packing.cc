@@ -0,0 +1,108 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/binary_packing.h"
+
+#include "base/logging.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+const size_t kImageHeaderSize = 3 * sizeof(int);
+
+}  // namespace
+
+int GetImageMessageBytesPerPixel(ImageMessageFormat format) {
+  switch (format) {
+    case IMAGE_MESSAGE_Y8:
+      return 1;
+    case IMAGE_MESSAGE_DEPTH16:
+      return 2;
+    case IMAGE_MESSAGE_DEPTH_F32:
+    case IMAGE_MESSAGE_RGBA:
+      return 4;
+  }
+  NOTREACHED();
+  return 0;
+}
+
+void SwizzleBGRAToRGBA(const uint8* bgra, int pitch, int width, int height,
+                       uint8* rgba) {
+  // A pixel is handled as one little endian word, swapping its B and R bytes.
+  for (int y = 0; y < height; ++y) {
+    const uint8* row = bgra + pitch * y;
+    for (int x = 0; x < width; ++x) {
+      uint32 pixel;
+      memcpy(&pixel, row + x * 4, sizeof(pixel));
+      pixel = (pixel & 0xFF00FF00) | ((pixel & 0xFF) << 16) |
+              ((pixel >> 16) & 0xFF);
+      memcpy(rgba, &pixel, sizeof(pixel));
+      rgba += 4;
+    }
+  }
+}
+
+void HalveBGRAToRGBA(const uint8* bgra, int pitch, int width, int height,
+                     uint8* rgba) {
+  for (int y = 0; y < height / 2; ++y) {
+    const uint8* top = bgra + pitch * 2 * y;
+    const uint8* bottom = top + pitch;
+    for (int x = 0; x < width / 2; ++x) {
+      const uint8* a = top + x * 8;
+      const uint8* b = bottom + x * 8;
+      // The channels are averaged with rounding, B and R swapped.
+      rgba[0] = static_cast<uint8>((a[2] + a[6] + b[2] + b[6] + 2) >> 2);
+      rgba[1] = static_cast<uint8>((a[1] + a[5] + b[1] + b[5] + 2) >> 2);
+      rgba[2] = static_cast<uint8>((a[0] + a[4] + b[0] + b[4] + 2) >> 2);
+      rgba[3] = static_cast<uint8>((a[3] + a[7] + b[3] + b[7] + 2) >> 2);
+      rgba += 4;
+    }
+  }
+}
+
+void CopyPlaneRows(const uint8* plane, int pitch, int row_size, int height,
+                   uint8* output) {
+  if (pitch == row_size) {
+    memcpy(output, plane, static_cast<size_t>(row_size) * height);
+    return;
+  }
+  for (int y = 0; y < height; ++y)
+    memcpy(output + row_size * y, plane + pitch * y, row_size);
+}
+
+scoped_ptr<uint8[]> CreateImageMessage(ImageMessageFormat format,
+                                       const uint8* plane,
+                                       int pitch,
+                                       int width,
+                                       int height,
+                                       size_t* length) {
+  const int bytes_per_pixel = GetImageMessageBytesPerPixel(format);
+  *length = kImageHeaderSize +
+            static_cast<size_t>(width) * height * bytes_per_pixel;
+  scoped_ptr<uint8[]> message(new uint8[*length]);
+  int* int_array = reinterpret_cast<int*>(message.get());
+  int_array[1] = width;
+  int_array[2] = height;
+
+  uint8* pixels = message.get() + kImageHeaderSize;
+  if (format == IMAGE_MESSAGE_RGBA)
+    SwizzleBGRAToRGBA(plane, pitch, width, height, pixels);
+  else
+    CopyPlaneRows(plane, pitch, width * bytes_per_pixel, height, pixels);
+  return message.Pass();
+}
+
+size_t GetMeshMessageSize(int num_block_meshes, int num_vertices,
+                          int num_faces) {
+  return 4 * sizeof(int) +
+         num_block_meshes * 5 * sizeof(int) +
+         num_vertices * 4 * sizeof(float) +
+         num_faces * 3 * sizeof(int) +
+         num_vertices * 3 * sizeof(uint8);
+}
+
+}  // namespace common
+}  // namespace realsense
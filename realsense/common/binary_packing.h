@@ -0,0 +1,128 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_BINARY_PACKING_H_
+#define REALSENSE_COMMON_BINARY_PACKING_H_
+
+#include <string.h>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+
+// Kernels filling the binary messages of the extensions. They only take plain
+// buffers, the SDK types stay in the callers, so that they build on every
+// platform and are measured by benchmarks/bench_kernels.
+namespace realsense {
+namespace common {
+
+// Pixel layouts of the binary image messages.
+enum ImageMessageFormat {
+  IMAGE_MESSAGE_Y8,
+  IMAGE_MESSAGE_DEPTH16,
+  IMAGE_MESSAGE_DEPTH_F32,
+  // Converted from the BGRA of PIXEL_FORMAT_RGB32.
+  IMAGE_MESSAGE_RGBA,
+};
+
+int GetImageMessageBytesPerPixel(ImageMessageFormat format);
+
+// Converts the BGRA rows of |bgra|, |pitch| bytes apart, to packed RGBA.
+void SwizzleBGRAToRGBA(const uint8* bgra, int pitch, int width, int height,
+                       uint8* rgba);
+// Like SwizzleBGRAToRGBA(), at half the width and height: each pixel of
+// |rgba| averages a block of 2x2 pixels. An odd last column or row is left
+// out.
+void HalveBGRAToRGBA(const uint8* bgra, int pitch, int width, int height,
+                     uint8* rgba);
+// Copies the rows of a plane, |pitch| bytes apart, without the padding.
+void CopyPlaneRows(const uint8* plane, int pitch, int row_size, int height,
+                   uint8* output);
+
+// Returns the binary image message of a plane: call_id (i32), width (i32),
+// height (i32), then the pixels without padding. The call_id is left for the
+// caller.
+scoped_ptr<uint8[]> CreateImageMessage(ImageMessageFormat format,
+                                       const uint8* plane,
+                                       int pitch,
+                                       int width,
+                                       int height,
+                                       size_t* length);
+
+// Size of the meshing message: call_id, number of block meshes, vertices and
+// faces (i32), the block meshes (5 x i32), the vertices (4 x f32), the faces
+// (3 x i32) and the vertex colors (3 x u8).
+size_t GetMeshMessageSize(int num_block_meshes, int num_vertices,
+                          int num_faces);
+
+// Fills |message|, of GetMeshMessageSize() bytes, except the call_id.
+// |BlockMesh| has the fields of PXCBlockMeshingData::PXCBlockMesh. The face
+// indices of each block mesh are rebased on its first vertex in the message,
+// |faces| is not modified.
+template <typename BlockMesh>
+void PackMeshMessage(const BlockMesh* block_meshes, int num_block_meshes,
+                     const float* vertices, int num_vertices,
+                     const int* faces, int num_faces,
+                     const uint8* colors, uint8* message) {
+  int* header = reinterpret_cast<int*>(message);
+  header[1] = num_block_meshes;
+  header[2] = num_vertices;
+  header[3] = num_faces;
+
+  int* packed_meshes = header + 4;
+  float* packed_vertices = reinterpret_cast<float*>(
+      packed_meshes + 5 * num_block_meshes);
+  int* packed_faces = reinterpret_cast<int*>(
+      packed_vertices + 4 * num_vertices);
+  uint8* packed_colors = reinterpret_cast<uint8*>(
+      packed_faces + 3 * num_faces);
+  memcpy(packed_vertices, vertices, num_vertices * 4 * sizeof(float));
+  memcpy(packed_faces, faces, num_faces * 3 * sizeof(int));
+  if (colors)
+    memcpy(packed_colors, colors, num_vertices * 3);
+  else
+    memset(packed_colors, 0, num_vertices * 3);
+
+  for (int i = 0; i < num_block_meshes; ++i) {
+    const BlockMesh& mesh = block_meshes[i];
+    int* packed_mesh = packed_meshes + 5 * i;
+    packed_mesh[0] = mesh.meshId;
+    packed_mesh[1] = mesh.vertexStartIndex;
+    packed_mesh[2] = mesh.numVertices;
+    packed_mesh[3] = mesh.faceStartIndex;
+    packed_mesh[4] = mesh.numFaces;
+    if (mesh.numVertices <= 0 || mesh.numFaces <= 0)
+      continue;
+    // vertexStartIndex counts floats, 4 per vertex.
+    const int base = mesh.vertexStartIndex / 4;
+    int* mesh_faces = packed_faces + mesh.faceStartIndex;
+    for (int j = 0; j < mesh.numFaces * 3; ++j)
+      mesh_faces[j] -= base;
+  }
+}
+
+// Size of a landmark point in the face sample message.
+const size_t kLandmarkPointSize = 3 * sizeof(int) + 5 * sizeof(float);
+
+// Writes a landmark point of the face sample message: alias, image and world
+// confidences (i32), then the world x, y, z and image x, y (f32). |Point| has
+// the fields of PXCFaceData::LandmarkPoint. Returns the end of the point.
+template <typename Point>
+uint8* PackLandmarkPoint(const Point& point, uint8* output) {
+  int* int_array = reinterpret_cast<int*>(output);
+  int_array[0] = point.source.alias;
+  int_array[1] = point.confidenceImage;
+  int_array[2] = point.confidenceWorld;
+  float* float_array = reinterpret_cast<float*>(int_array + 3);
+  float_array[0] = point.world.x;
+  float_array[1] = point.world.y;
+  float_array[2] = point.world.z;
+  float_array[3] = point.image.x;
+  float_array[4] = point.image.y;
+  return output + kLandmarkPointSize;
+}
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_BINARY_PACKING_H_
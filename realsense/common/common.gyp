@@ -0,0 +1,36 @@
+# Copyright (c) 2016 Intel Corporation. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'targets': [
+    {
+      # The parts of common which build on every platform.
+      'target_name': 'common_unittests',
+      'type': 'executable',
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/base/base.gyp:run_all_unittests',
+        '<(DEPTH)/testing/gtest.gyp:gtest',
+      ],
+      'include_dirs': [
+        '../..',
+      ],
+      'sources': [
+        'binary_packing.cc',
+        'binary_packing.h',
+        'depth_codec.cc',
+        'depth_codec.h',
+        'depth_codec_unittest.cc',
+        'frame_file.h',
+        'frame_file_reader.cc',
+        'frame_file_reader.h',
+        'frame_file_unittest.cc',
+        'frame_recorder.cc',
+        'frame_recorder.h',
+        'memory_accounting.cc',
+        'memory_accounting.h',
+      ],
+    },
+  ],
+}
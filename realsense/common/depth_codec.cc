@@ -0,0 +1,224 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/depth_codec.h"
+
+#include <string.h>
+
+#include "base/logging.h"
+#include "realsense/common/binary_packing.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+const size_t kDepthSectionHeaderSize = 2 * sizeof(int);
+
+// Lanes of 4 pixels in a 64 bit word.
+const uint64 kLowBits = 0x0001000100010001ULL;
+const uint64 kHighBits = 0x8000800080008000ULL;
+
+class NibbleWriter {
+ public:
+  explicit NibbleWriter(uint8* output)
+      : output_(output), size_(0), word_(0), nibbles_(0) {}
+
+  void Write(uint32 value) {
+    do {
+      uint32 nibble = value & 0x7;
+      value >>= 3;
+      if (value)
+        nibble |= 0x8;
+      word_ = (word_ << 4) | nibble;
+      if (++nibbles_ == 8)
+        Flush();
+    } while (value);
+  }
+
+  // Flushes the last word, filled with zero nibbles. Returns the size.
+  size_t Finish() {
+    if (nibbles_) {
+      word_ <<= 4 * (8 - nibbles_);
+      Flush();
+    }
+    return size_;
+  }
+
+ private:
+  void Flush() {
+    memcpy(output_ + size_, &word_, sizeof(word_));
+    size_ += sizeof(word_);
+    word_ = 0;
+    nibbles_ = 0;
+  }
+
+  uint8* output_;
+  size_t size_;
+  uint32 word_;
+  int nibbles_;
+
+  DISALLOW_COPY_AND_ASSIGN(NibbleWriter);
+};
+
+class NibbleReader {
+ public:
+  NibbleReader(const uint8* input, size_t size)
+      : input_(input), size_(size), position_(0), word_(0), nibbles_(0) {}
+
+  bool Read(uint32* value) {
+    uint32 result = 0;
+    for (int shift = 0; shift < 32; shift += 3) {
+      if (!nibbles_) {
+        if (position_ + sizeof(word_) > size_)
+          return false;
+        memcpy(&word_, input_ + position_, sizeof(word_));
+        position_ += sizeof(word_);
+        nibbles_ = 8;
+      }
+      uint32 nibble = word_ >> 28;
+      word_ <<= 4;
+      --nibbles_;
+      result |= (nibble & 0x7) << shift;
+      if (!(nibble & 0x8)) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  const uint8* input_;
+  size_t size_;
+  size_t position_;
+  uint32 word_;
+  int nibbles_;
+
+  DISALLOW_COPY_AND_ASSIGN(NibbleReader);
+};
+
+// Returns the end of the run of zeros starting at |x|. The pixels are tested
+// 4 at a time, most of the runs being long.
+int ScanZeros(const uint16* row, int x, int width) {
+  for (; x + 4 <= width; x += 4) {
+    uint64 pixels;
+    memcpy(&pixels, row + x, sizeof(pixels));
+    if (pixels)
+      break;
+  }
+  while (x < width && !row[x])
+    ++x;
+  return x;
+}
+
+// Returns the end of the run of valid pixels starting at |x|.
+int ScanValid(const uint16* row, int x, int width) {
+  for (; x + 4 <= width; x += 4) {
+    uint64 pixels;
+    memcpy(&pixels, row + x, sizeof(pixels));
+    // Non zero if any of the 4 pixels is zero.
+    if ((pixels - kLowBits) & ~pixels & kHighBits)
+      break;
+  }
+  while (x < width && row[x])
+    ++x;
+  return x;
+}
+
+}  // namespace
+
+size_t GetMaxRVLSize(int width, int height) {
+  // Per row, at most a pair of counts per run of valid pixels, plus one, and
+  // a count takes no more nibbles than the pixels it covers, or one. A
+  // pixel takes at most 6 nibbles for the 17 bits of its zigzag difference.
+  const size_t nibbles = static_cast<size_t>(9 * width + 2) * height;
+  return (nibbles + 7) / 8 * sizeof(uint32);
+}
+
+size_t EncodeRVL(const uint8* plane, int pitch, int width, int height,
+                 uint8* output) {
+  NibbleWriter writer(output);
+  int previous = 0;
+  for (int y = 0; y < height; ++y) {
+    const uint16* row = reinterpret_cast<const uint16*>(plane + pitch * y);
+    int x = 0;
+    while (x < width) {
+      int start = x;
+      x = ScanZeros(row, x, width);
+      writer.Write(x - start);
+      start = x;
+      x = ScanValid(row, x, width);
+      writer.Write(x - start);
+      for (int i = start; i < x; ++i) {
+        // Zigzag, shifted unsigned since the difference may be negative.
+        int delta = row[i] - previous;
+        writer.Write((static_cast<uint32>(delta) << 1) ^
+                     static_cast<uint32>(delta >> 31));
+        previous = row[i];
+      }
+    }
+  }
+  return writer.Finish();
+}
+
+bool DecodeRVL(const uint8* input, size_t size, int width, int height,
+               uint16* output) {
+  NibbleReader reader(input, size);
+  int previous = 0;
+  for (int y = 0; y < height; ++y) {
+    uint16* row = output + static_cast<size_t>(width) * y;
+    int x = 0;
+    while (x < width) {
+      uint32 zeros, valid;
+      if (!reader.Read(&zeros) || zeros > static_cast<uint32>(width - x))
+        return false;
+      memset(row + x, 0, zeros * sizeof(uint16));
+      x += zeros;
+      if (!reader.Read(&valid) || valid > static_cast<uint32>(width - x))
+        return false;
+      for (uint32 i = 0; i < valid; ++i) {
+        uint32 value;
+        if (!reader.Read(&value))
+          return false;
+        previous += static_cast<int>(value >> 1) ^
+                    -static_cast<int>(value & 1);
+        if (previous <= 0 || previous > 0xFFFF)
+          return false;
+        row[x++] = static_cast<uint16>(previous);
+      }
+    }
+  }
+  return true;
+}
+
+size_t GetMaxDepthSectionSize(DepthMessageEncoding encoding, int width,
+                              int height) {
+  size_t size = encoding == DEPTH_MESSAGE_RVL ?
+      GetMaxRVLSize(width, height) :
+      static_cast<size_t>(width) * height * sizeof(uint16);
+  return kDepthSectionHeaderSize + ((size + 3) & ~3);
+}
+
+size_t PackDepthSection(DepthMessageEncoding encoding, const uint8* plane,
+                        int pitch, int width, int height, uint8* output) {
+  DCHECK_EQ(0u, reinterpret_cast<uintptr_t>(output) % 4);
+  uint8* data = output + kDepthSectionHeaderSize;
+  size_t size;
+  if (encoding == DEPTH_MESSAGE_RVL) {
+    size = EncodeRVL(plane, pitch, width, height, data);
+  } else {
+    size = static_cast<size_t>(width) * height * sizeof(uint16);
+    CopyPlaneRows(plane, pitch, width * 2, height, data);
+  }
+  int* header = reinterpret_cast<int*>(output);
+  header[0] = encoding;
+  header[1] = static_cast<int>(size);
+  const size_t padded_size = (size + 3) & ~3;
+  memset(data + size, 0, padded_size - size);
+  return kDepthSectionHeaderSize + padded_size;
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -0,0 +1,56 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_DEPTH_CODEC_H_
+#define REALSENSE_COMMON_DEPTH_CODEC_H_
+
+#include "base/basictypes.h"
+
+// Lossless coding of the 16 bit depth planes, after the RVL scheme of
+// "Fast Lossless Depth Image Compression" (Wilson, 2017). The pixels are
+// coded as runs of zeros, the holes of the depth, and runs of valid pixels
+// coded by their difference to the previous valid pixel. Each number is
+// written in variable length nibbles of 3 bits and a continuation bit,
+// packed 8 per little endian 32 bit word, most significant first.
+//
+// Unlike the original scheme the runs stop at the end of each row, so that
+// the rows are coded straight from a plane with padding. depth_codec_api.js
+// decodes the depth sections of the messages.
+namespace realsense {
+namespace common {
+
+// Maximum size of the RVL coding of a |width| x |height| plane, in bytes.
+size_t GetMaxRVLSize(int width, int height);
+
+// Codes the rows of |plane|, |pitch| bytes apart, into |output| of
+// GetMaxRVLSize() bytes. Returns the size of the coding, a multiple of 4.
+size_t EncodeRVL(const uint8* plane, int pitch, int width, int height,
+                 uint8* output);
+
+// Decodes the RVL coding of a |width| x |height| plane into packed rows.
+// Returns false if |input| is not a complete coding of such a plane.
+bool DecodeRVL(const uint8* input, size_t size, int width, int height,
+               uint16* output);
+
+// How the depth section of a binary message holds the pixels.
+enum DepthMessageEncoding {
+  DEPTH_MESSAGE_RAW = 0,
+  DEPTH_MESSAGE_RVL = 1,
+};
+
+// Maximum size of a depth section of a |width| x |height| plane.
+size_t GetMaxDepthSectionSize(DepthMessageEncoding encoding, int width,
+                              int height);
+
+// Writes the depth section of a message: the encoding (i32), the size of the
+// pixel data in bytes (i32), then the pixels without padding or their RVL
+// coding, padded to 4 bytes. |output| must be 4 byte aligned in the message.
+// Returns the size of the section.
+size_t PackDepthSection(DepthMessageEncoding encoding, const uint8* plane,
+                        int pitch, int width, int height, uint8* output);
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_DEPTH_CODEC_H_
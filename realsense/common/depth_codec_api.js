@@ -0,0 +1,75 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Reads the depth sections of the binary messages, written by
+// PackDepthSection() of realsense/common/depth_codec.cc, which also describes
+// the RVL coding.
+var depthCodec = (function() {
+  const DEPTH_MESSAGE_RAW = 0;
+  const DEPTH_MESSAGE_RVL = 1;
+  const sectionHeaderByteLength = 2 * 4;
+
+  function decodeRVL(words, width, height, output) {
+    var wordIndex = 0;
+    var word = 0;
+    var nibbles = 0;
+
+    function readValue() {
+      var value = 0;
+      var shift = 0;
+      var nibble;
+      do {
+        if (nibbles == 0) {
+          word = words[wordIndex++];
+          nibbles = 8;
+        }
+        nibble = word >>> 28;
+        word = (word << 4) >>> 0;
+        nibbles--;
+        value |= (nibble & 0x7) << shift;
+        shift += 3;
+      } while (nibble & 0x8);
+      return value;
+    }
+
+    // The runs stop at the end of the rows, and |output| is zero filled.
+    var previous = 0;
+    var i = 0;
+    for (var y = 0; y < height; y++) {
+      var rowEnd = i + width;
+      while (i < rowEnd) {
+        i += readValue();
+        var end = i + readValue();
+        for (; i < end; i++) {
+          var value = readValue();
+          previous += (value >>> 1) ^ -(value & 1);
+          output[i] = previous;
+        }
+      }
+    }
+  }
+
+  // Returns the pixels of the |width| x |height| depth section at
+  // |byteOffset| of |data| as an Uint16Array, and the byte length of the
+  // section. The raw pixels are returned without a copy.
+  function readDepthSection(data, byteOffset, width, height) {
+    var header = new Int32Array(data, byteOffset, 2);
+    var byteLength = header[1];
+    var pixelOffset = byteOffset + sectionHeaderByteLength;
+    var pixels;
+    if (header[0] == DEPTH_MESSAGE_RVL) {
+      pixels = new Uint16Array(width * height);
+      decodeRVL(new Uint32Array(data, pixelOffset, byteLength / 4),
+                width, height, pixels);
+    } else {
+      pixels = new Uint16Array(data, pixelOffset, width * height);
+    }
+    return {
+      data: pixels,
+      byteLength: sectionHeaderByteLength + ((byteLength + 3) & ~3)
+    };
+  }
+
+  return { readDepthSection: readDepthSection };
+})();
@@ -0,0 +1,249 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/depth_codec.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+// A depth plane of |width| x |height| pixels whose rows are |pitch| bytes
+// apart, with the padding filled with garbage.
+class DepthPlane {
+ public:
+  DepthPlane(int width, int height, int pitch)
+      : width_(width),
+        height_(height),
+        pitch_(pitch),
+        bytes_(static_cast<size_t>(pitch) * height, 0xCD) {}
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int pitch() const { return pitch_; }
+  const uint8* data() const { return bytes_.empty() ? nullptr : &bytes_[0]; }
+
+  uint16 Get(int x, int y) const {
+    uint16 value;
+    memcpy(&value, &bytes_[pitch_ * y + x * sizeof(uint16)], sizeof(value));
+    return value;
+  }
+
+  void Set(int x, int y, uint16 value) {
+    memcpy(&bytes_[pitch_ * y + x * sizeof(uint16)], &value, sizeof(value));
+  }
+
+  // Holes, surfaces and edges, from a fixed seed.
+  void Fill(uint32 seed) {
+    uint32 state = seed;
+    int depth = 1000;
+    for (int y = 0; y < height_; ++y) {
+      for (int x = 0; x < width_; ++x) {
+        state = state * 1664525 + 1013904223;
+        uint32 random = state >> 8;
+        if (random % 16 < 3) {
+          Set(x, y, 0);
+          continue;
+        }
+        if (random % 16 == 3)
+          depth = 1 + (random >> 4) % 0xFFFF;
+        else
+          depth += static_cast<int>(random % 9) - 4;
+        depth = std::max(1, std::min(0xFFFF, depth));
+        Set(x, y, static_cast<uint16>(depth));
+      }
+    }
+  }
+
+  // The pixels as packed rows.
+  std::vector<uint16> Pack() const {
+    std::vector<uint16> pixels;
+    for (int y = 0; y < height_; ++y) {
+      for (int x = 0; x < width_; ++x)
+        pixels.push_back(Get(x, y));
+    }
+    return pixels;
+  }
+
+ private:
+  int width_;
+  int height_;
+  int pitch_;
+  std::vector<uint8> bytes_;
+};
+
+// Codes |plane| and checks the coding against the bounds of the header.
+std::vector<uint8> Encode(const DepthPlane& plane) {
+  const size_t max_size = GetMaxRVLSize(plane.width(), plane.height());
+  // A guard past the maximum size catches overruns.
+  std::vector<uint8> coding(max_size + 16, 0xAB);
+  size_t size = EncodeRVL(plane.data(), plane.pitch(), plane.width(),
+                          plane.height(), &coding[0]);
+  EXPECT_LE(size, max_size);
+  EXPECT_EQ(0u, size % 4);
+  for (size_t i = max_size; i < coding.size(); ++i)
+    EXPECT_EQ(0xAB, coding[i]);
+  coding.resize(size);
+  return coding;
+}
+
+void ExpectRoundTrip(const DepthPlane& plane) {
+  std::vector<uint8> coding = Encode(plane);
+  std::vector<uint16> decoded(
+      static_cast<size_t>(plane.width()) * plane.height() + 1, 0xEEEE);
+  ASSERT_TRUE(DecodeRVL(coding.empty() ? nullptr : &coding[0], coding.size(),
+                        plane.width(), plane.height(), &decoded[0]));
+  std::vector<uint16> expected = plane.Pack();
+  // The pixel past the plane is left alone.
+  EXPECT_EQ(0xEEEE, decoded.back());
+  decoded.pop_back();
+  EXPECT_EQ(expected, decoded);
+}
+
+}  // namespace
+
+TEST(DepthCodecTest, RoundTrip) {
+  DepthPlane plane(64, 48, 64 * 2);
+  plane.Fill(1);
+  ExpectRoundTrip(plane);
+}
+
+TEST(DepthCodecTest, RoundTripWithPitch) {
+  // An odd width, with rows padded as in the SDK images.
+  DepthPlane plane(37, 21, 96);
+  plane.Fill(2);
+  ExpectRoundTrip(plane);
+}
+
+TEST(DepthCodecTest, RoundTripSmallPlanes) {
+  for (int width = 1; width <= 9; ++width) {
+    for (int height = 1; height <= 3; ++height) {
+      DepthPlane plane(width, height, width * 2);
+      plane.Fill(width * 16 + height);
+      SCOPED_TRACE(testing::Message() << width << "x" << height);
+      ExpectRoundTrip(plane);
+    }
+  }
+}
+
+TEST(DepthCodecTest, EmptyPlane) {
+  DepthPlane plane(32, 8, 64);
+  for (int y = 0; y < plane.height(); ++y) {
+    for (int x = 0; x < plane.width(); ++x)
+      plane.Set(x, y, 0);
+  }
+  // Two counts per row.
+  std::vector<uint8> coding = Encode(plane);
+  EXPECT_LE(coding.size(), 8u * sizeof(uint32));
+  ExpectRoundTrip(plane);
+}
+
+TEST(DepthCodecTest, WorstCaseFitsMaxSize) {
+  // The largest differences, without holes.
+  DepthPlane extremes(33, 5, 66);
+  for (int y = 0; y < extremes.height(); ++y) {
+    for (int x = 0; x < extremes.width(); ++x)
+      extremes.Set(x, y, (x + y) % 2 ? 0xFFFF : 1);
+  }
+  ExpectRoundTrip(extremes);
+
+  // A run of each kind per pixel.
+  DepthPlane holes(33, 5, 66);
+  for (int y = 0; y < holes.height(); ++y) {
+    for (int x = 0; x < holes.width(); ++x)
+      holes.Set(x, y, x % 2 ? 0 : (y % 2 ? 0xFFFF : 1));
+  }
+  ExpectRoundTrip(holes);
+}
+
+TEST(DepthCodecTest, DecodeRejectsTruncatedCoding) {
+  DepthPlane plane(64, 48, 128);
+  plane.Fill(3);
+  std::vector<uint8> coding = Encode(plane);
+  ASSERT_GT(coding.size(), 4u);
+  std::vector<uint16> decoded(64 * 48);
+  EXPECT_FALSE(DecodeRVL(&coding[0], coding.size() - 4, 64, 48,
+                         &decoded[0]));
+}
+
+TEST(DepthCodecTest, DecodeRejectsOtherSizes) {
+  DepthPlane plane(16, 4, 32);
+  plane.Fill(4);
+  std::vector<uint8> coding = Encode(plane);
+  // More rows than coded.
+  std::vector<uint16> decoded(16 * 8);
+  EXPECT_FALSE(DecodeRVL(&coding[0], coding.size(), 16, 8, &decoded[0]));
+  // Runs longer than the rows.
+  EXPECT_FALSE(DecodeRVL(&coding[0], coding.size(), 8, 8, &decoded[0]));
+}
+
+TEST(DepthCodecTest, DecodeRejectsOutOfRangeDepth) {
+  // A single pixel, whose difference is then changed to go below 0.
+  DepthPlane plane(1, 1, 2);
+  plane.Set(0, 0, 1);
+  std::vector<uint8> coding = Encode(plane);
+  ASSERT_EQ(4u, coding.size());
+  uint32 word;
+  memcpy(&word, &coding[0], sizeof(word));
+  // Counts 0 and 1, then the difference +1 (zigzag 2).
+  EXPECT_EQ(0x01200000u, word);
+  // The difference -1 (zigzag 1).
+  word = 0x01100000u;
+  memcpy(&coding[0], &word, sizeof(word));
+  uint16 decoded;
+  EXPECT_FALSE(DecodeRVL(&coding[0], coding.size(), 1, 1, &decoded));
+}
+
+TEST(DepthCodecTest, PackRawDepthSection) {
+  DepthPlane plane(5, 3, 16);
+  plane.Fill(5);
+  std::vector<uint8> section(
+      GetMaxDepthSectionSize(DEPTH_MESSAGE_RAW, 5, 3) + 4, 0xAB);
+  size_t size = PackDepthSection(DEPTH_MESSAGE_RAW, plane.data(),
+                                 plane.pitch(), 5, 3, &section[0]);
+  EXPECT_EQ(GetMaxDepthSectionSize(DEPTH_MESSAGE_RAW, 5, 3), size);
+  EXPECT_EQ(0u, size % 4);
+
+  int header[2];
+  memcpy(header, &section[0], sizeof(header));
+  EXPECT_EQ(DEPTH_MESSAGE_RAW, header[0]);
+  EXPECT_EQ(5 * 3 * 2, header[1]);
+  std::vector<uint16> pixels(5 * 3);
+  memcpy(&pixels[0], &section[sizeof(header)], header[1]);
+  EXPECT_EQ(plane.Pack(), pixels);
+  // Padded with zeros to 4 bytes.
+  EXPECT_EQ(0, section[sizeof(header) + header[1]]);
+  EXPECT_EQ(0, section[sizeof(header) + header[1] + 1]);
+  EXPECT_EQ(0xAB, section[size]);
+}
+
+TEST(DepthCodecTest, PackRVLDepthSection) {
+  DepthPlane plane(40, 30, 96);
+  plane.Fill(6);
+  const size_t max_size = GetMaxDepthSectionSize(DEPTH_MESSAGE_RVL, 40, 30);
+  std::vector<uint8> section(max_size);
+  size_t size = PackDepthSection(DEPTH_MESSAGE_RVL, plane.data(),
+                                 plane.pitch(), 40, 30, &section[0]);
+  EXPECT_LE(size, max_size);
+  EXPECT_EQ(0u, size % 4);
+
+  int header[2];
+  memcpy(header, &section[0], sizeof(header));
+  EXPECT_EQ(DEPTH_MESSAGE_RVL, header[0]);
+  EXPECT_EQ(size - sizeof(header), static_cast<size_t>(header[1]));
+  std::vector<uint16> decoded(40 * 30);
+  ASSERT_TRUE(DecodeRVL(&section[sizeof(header)], header[1], 40, 30,
+                        &decoded[0]));
+  EXPECT_EQ(plane.Pack(), decoded);
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -34,6 +34,8 @@ def main():
                       help='The extension dll file.')
   parser.add_argument('--target-dir',
                       help='Target directory of with .dll and hook file.')
+  parser.add_argument('--runtime-dll', action='append', default=[],
+                      help='A dll the extension loads, copied next to it.')
 
   args = parser.parse_args()
 
@@ -48,6 +50,10 @@ def main():
 
   shutil.copyfile(args.extension_dll,
                   os.path.join(args.target_dir, dll_file))
+  for runtime_dll in args.runtime_dll:
+    shutil.copyfile(runtime_dll,
+                    os.path.join(args.target_dir,
+                                 os.path.basename(runtime_dll)))
 
   hooks_file = os.path.join(args.target_dir, "XWalkExtensionHooks.js")
   # Add extra line in the template js hooks to make the module hooks.
@@ -0,0 +1,157 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_FRAME_FILE_H_
+#define REALSENSE_COMMON_FRAME_FILE_H_
+
+#include "base/basictypes.h"
+
+// Layout of the .rsframes capture files, written by FrameRecorder and read
+// by FrameFileReader. The file is the header, the frame records one after
+// the other, then the frame index once the recording is closed:
+//
+//   FrameFileHeader
+//   FrameRecordHeader, FrameChunkHeader, chunk data, FrameChunkHeader, ...
+//   ...
+//   FrameIndexHeader, FrameIndexEntry * frame count
+//
+// All the fields are little endian, and every structure and chunk data starts
+// 8 byte aligned, so that a mapped file is read in place on any platform. A
+// file whose index_offset is 0 was not closed, and its frames are found by
+// walking the records.
+namespace realsense {
+namespace common {
+
+const char kFrameFileMagic[8] = {'R', 'S', 'F', 'R', 'A', 'M', 'E', 'S'};
+const uint32 kFrameFileVersion = 1;
+const uint32 kFrameRecordMagic = 0x4D415246;  // "FRAM"
+const uint32 kFrameIndexMagic = 0x58444E49;  // "INDX"
+const size_t kFrameFileAlignment = 8;
+
+// What a chunk of a frame holds.
+enum FrameChunkType {
+  FRAME_CHUNK_COLOR = 1,
+  FRAME_CHUNK_DEPTH = 2,
+  // The 12 floats of the camera pose of scene perception, a 3x4 matrix in row
+  // order.
+  FRAME_CHUNK_CAMERA_POSE = 3,
+  // The face count (i32), then for each face its user id (i32), its point
+  // count (i32) and the points as packed by PackLandmarkPoint().
+  FRAME_CHUNK_FACE_LANDMARKS = 4,
+  // The hand count (i32), then for each hand its unique id (i32), its body
+  // side (i32) and the kFrameJointCount joints as packed by PackFrameJoint().
+  FRAME_CHUNK_HAND_JOINTS = 5,
+};
+
+// How the data of a chunk is laid out.
+enum FrameChunkFormat {
+  // Described by the type of the chunk.
+  FRAME_CHUNK_FORMAT_DATA = 0,
+  // Rows of |stride| bytes of BGRA pixels.
+  FRAME_CHUNK_FORMAT_BGRA32 = 1,
+  // Rows of |stride| bytes of 16 bit depth values in millimeters.
+  FRAME_CHUNK_FORMAT_DEPTH16 = 2,
+};
+
+struct FrameFileHeader {
+  char magic[8];
+  uint32 version;
+  uint32 header_size;
+  // Offset of the FrameIndexHeader, 0 until the recording is closed.
+  uint64 index_offset;
+  uint64 frame_count;
+  // The frames the writer could not keep up with, or that the extension
+  // skipped.
+  uint64 dropped_frame_count;
+  // Wall clock time of the start, in microseconds since the Unix epoch.
+  int64 start_time_us;
+  // Name of the recorded extension, zero terminated.
+  char source[24];
+};
+
+struct FrameRecordHeader {
+  uint32 magic;
+  uint32 chunk_count;
+  // Size of the record, this header included.
+  uint64 size;
+  // Counts the frames from the start, so that the dropped frames leave gaps.
+  uint64 frame_number;
+  // Time since the start of the recording, in microseconds.
+  int64 timestamp_us;
+};
+
+struct FrameChunkHeader {
+  uint32 type;
+  uint32 format;
+  uint32 width;
+  uint32 height;
+  uint32 stride;
+  uint32 reserved;
+  // Time stamp of the device, in 100 nanosecond units, or 0.
+  int64 device_timestamp;
+  // Size of the data, without the padding to kFrameFileAlignment.
+  uint64 size;
+};
+
+struct FrameIndexHeader {
+  uint32 magic;
+  uint32 reserved;
+  uint64 count;
+};
+
+struct FrameIndexEntry {
+  // Offset of the FrameRecordHeader.
+  uint64 offset;
+  int64 timestamp_us;
+};
+
+static_assert(sizeof(FrameFileHeader) == 72, "FrameFileHeader layout");
+static_assert(sizeof(FrameRecordHeader) == 32, "FrameRecordHeader layout");
+static_assert(sizeof(FrameChunkHeader) == 40, "FrameChunkHeader layout");
+static_assert(sizeof(FrameIndexHeader) == 16, "FrameIndexHeader layout");
+static_assert(sizeof(FrameIndexEntry) == 16, "FrameIndexEntry layout");
+
+inline size_t AlignFrameFileSize(size_t size) {
+  return (size + kFrameFileAlignment - 1) & ~(kFrameFileAlignment - 1);
+}
+
+// Joints of a hand in FRAME_CHUNK_HAND_JOINTS, in the order of
+// PXCHandData::JointType.
+const int kFrameJointCount = 22;
+// Size of a joint in FRAME_CHUNK_HAND_JOINTS.
+const size_t kFrameJointSize = sizeof(int) + 17 * sizeof(float);
+
+// Writes a joint of FRAME_CHUNK_HAND_JOINTS: the confidence (i32), then the
+// world and image positions (3 f32 each), the local rotation and the global
+// orientation (4 f32 each) and the speed (3 f32). |JointData| has the fields
+// of PXCHandData::JointData. Returns the end of the joint.
+template <typename JointData>
+uint8* PackFrameJoint(const JointData& joint, uint8* output) {
+  int* int_array = reinterpret_cast<int*>(output);
+  int_array[0] = joint.confidence;
+  float* float_array = reinterpret_cast<float*>(int_array + 1);
+  float_array[0] = joint.positionWorld.x;
+  float_array[1] = joint.positionWorld.y;
+  float_array[2] = joint.positionWorld.z;
+  float_array[3] = joint.positionImage.x;
+  float_array[4] = joint.positionImage.y;
+  float_array[5] = joint.positionImage.z;
+  float_array[6] = joint.localRotation.x;
+  float_array[7] = joint.localRotation.y;
+  float_array[8] = joint.localRotation.z;
+  float_array[9] = joint.localRotation.w;
+  float_array[10] = joint.globalOrientation.x;
+  float_array[11] = joint.globalOrientation.y;
+  float_array[12] = joint.globalOrientation.z;
+  float_array[13] = joint.globalOrientation.w;
+  float_array[14] = joint.speed.x;
+  float_array[15] = joint.speed.y;
+  float_array[16] = joint.speed.z;
+  return output + kFrameJointSize;
+}
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_FRAME_FILE_H_
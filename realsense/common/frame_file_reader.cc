@@ -0,0 +1,169 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/frame_file_reader.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+bool CompareTimestamp(int64 timestamp_us, const FrameIndexEntry& entry) {
+  return timestamp_us < entry.timestamp_us;
+}
+
+}  // namespace
+
+FrameFileReader::FrameFileReader()
+    : header_(NULL),
+      index_(NULL),
+      frame_count_(0),
+      has_index_(false) {
+}
+
+FrameFileReader::~FrameFileReader() {
+}
+
+bool FrameFileReader::Open(const base::FilePath& path) {
+  DCHECK(!file_.IsValid());
+  if (!file_.Initialize(path) || file_.length() < sizeof(FrameFileHeader))
+    return false;
+
+  header_ = reinterpret_cast<const FrameFileHeader*>(file_.data());
+  if (memcmp(header_->magic, kFrameFileMagic, sizeof(kFrameFileMagic)) ||
+      header_->version != kFrameFileVersion ||
+      header_->header_size < sizeof(FrameFileHeader) ||
+      header_->header_size % kFrameFileAlignment ||
+      header_->header_size > file_.length()) {
+    return false;
+  }
+
+  has_index_ = ReadIndex();
+  if (!has_index_)
+    RebuildIndex();
+  return true;
+}
+
+size_t FrameFileReader::FindFrame(int64 timestamp_us) const {
+  const FrameIndexEntry* end = index_ + frame_count_;
+  const FrameIndexEntry* next =
+      std::upper_bound(index_, end, timestamp_us, CompareTimestamp);
+  return next == index_ ? 0 : next - index_ - 1;
+}
+
+const FrameRecordHeader* FrameFileReader::GetFrame(size_t index) const {
+  DCHECK_LT(index, frame_count_);
+  return GetRecord(index_[index].offset);
+}
+
+bool FrameFileReader::GetChunk(size_t index, FrameChunkType type,
+                               Chunk* chunk) const {
+  const FrameRecordHeader* record = GetFrame(index);
+  if (!record)
+    return false;
+
+  uint64 offset = sizeof(FrameRecordHeader);
+  for (uint32 i = 0; i < record->chunk_count; ++i) {
+    if (!ReadChunk(record, &offset, chunk))
+      return false;
+    if (chunk->header->type == static_cast<uint32>(type))
+      return true;
+  }
+  return false;
+}
+
+bool FrameFileReader::GetChunks(size_t index,
+                                std::vector<Chunk>* chunks) const {
+  chunks->clear();
+  const FrameRecordHeader* record = GetFrame(index);
+  if (!record)
+    return false;
+
+  uint64 offset = sizeof(FrameRecordHeader);
+  for (uint32 i = 0; i < record->chunk_count; ++i) {
+    Chunk chunk;
+    if (!ReadChunk(record, &offset, &chunk))
+      return false;
+    chunks->push_back(chunk);
+  }
+  return true;
+}
+
+bool FrameFileReader::ReadIndex() {
+  const uint64 offset = header_->index_offset;
+  const uint64 length = file_.length();
+  if (!offset || offset % kFrameFileAlignment ||
+      offset < header_->header_size ||
+      length - std::min(offset, length) < sizeof(FrameIndexHeader)) {
+    return false;
+  }
+
+  const FrameIndexHeader* index_header =
+      reinterpret_cast<const FrameIndexHeader*>(file_.data() + offset);
+  const uint64 entries_size = length - offset - sizeof(FrameIndexHeader);
+  if (index_header->magic != kFrameIndexMagic ||
+      index_header->count > entries_size / sizeof(FrameIndexEntry)) {
+    return false;
+  }
+
+  index_ = reinterpret_cast<const FrameIndexEntry*>(index_header + 1);
+  frame_count_ = static_cast<size_t>(index_header->count);
+  return true;
+}
+
+void FrameFileReader::RebuildIndex() {
+  rebuilt_index_.clear();
+  uint64 offset = header_->header_size;
+  while (const FrameRecordHeader* record = GetRecord(offset)) {
+    FrameIndexEntry entry = {offset, record->timestamp_us};
+    rebuilt_index_.push_back(entry);
+    offset += record->size;
+  }
+  index_ = rebuilt_index_.empty() ? NULL : &rebuilt_index_[0];
+  frame_count_ = rebuilt_index_.size();
+}
+
+const FrameRecordHeader* FrameFileReader::GetRecord(uint64 offset) const {
+  const uint64 length = file_.length();
+  if (offset % kFrameFileAlignment || offset > length ||
+      length - offset < sizeof(FrameRecordHeader)) {
+    return NULL;
+  }
+  const FrameRecordHeader* record =
+      reinterpret_cast<const FrameRecordHeader*>(file_.data() + offset);
+  if (record->magic != kFrameRecordMagic ||
+      record->size < sizeof(FrameRecordHeader) ||
+      record->size % kFrameFileAlignment ||
+      record->size > length - offset) {
+    return NULL;
+  }
+  return record;
+}
+
+bool FrameFileReader::ReadChunk(const FrameRecordHeader* record,
+                                uint64* offset, Chunk* chunk) const {
+  if (record->size - *offset < sizeof(FrameChunkHeader))
+    return false;
+  const uint8* begin = reinterpret_cast<const uint8*>(record);
+  chunk->header = reinterpret_cast<const FrameChunkHeader*>(begin + *offset);
+  *offset += sizeof(FrameChunkHeader);
+  // Checked before aligning, which could wrap around.
+  const uint64 remaining = record->size - *offset;
+  if (chunk->header->size > remaining ||
+      AlignFrameFileSize(chunk->header->size) > remaining) {
+    return false;
+  }
+  chunk->data = begin + *offset;
+  *offset += AlignFrameFileSize(chunk->header->size);
+  return true;
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -0,0 +1,76 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_FRAME_FILE_READER_H_
+#define REALSENSE_COMMON_FRAME_FILE_READER_H_
+
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/macros.h"
+#include "realsense/common/frame_file.h"
+
+namespace realsense {
+namespace common {
+
+// Reads a .rsframes file in place from a mapping of it. Opening a closed file
+// only checks its header and index, the frames being checked as they are
+// read, so that seeking to any frame costs the same in any file.
+class FrameFileReader {
+ public:
+  struct Chunk {
+    const FrameChunkHeader* header;
+    const uint8* data;
+  };
+
+  FrameFileReader();
+  ~FrameFileReader();
+
+  // Returns false if |path| is not a frame file.
+  bool Open(const base::FilePath& path);
+
+  const FrameFileHeader& header() const { return *header_; }
+  // Whether the index was read from the file, rather than rebuilt from the
+  // records of a file which was not closed.
+  bool has_index() const { return has_index_; }
+  size_t frame_count() const { return frame_count_; }
+  int64 GetFrameTimestamp(size_t index) const {
+    return index_[index].timestamp_us;
+  }
+
+  // Returns the index of the last frame at or before |timestamp_us|, or 0.
+  size_t FindFrame(int64 timestamp_us) const;
+
+  // Returns the header of the frame at |index|, or NULL if the record is
+  // invalid.
+  const FrameRecordHeader* GetFrame(size_t index) const;
+  // Finds the first chunk of |type| of the frame at |index|. Returns false if
+  // there is none or the record is invalid.
+  bool GetChunk(size_t index, FrameChunkType type, Chunk* chunk) const;
+  // Returns the chunks of the frame at |index|, in their order.
+  bool GetChunks(size_t index, std::vector<Chunk>* chunks) const;
+
+ private:
+  bool ReadIndex();
+  void RebuildIndex();
+  const FrameRecordHeader* GetRecord(uint64 offset) const;
+  // Reads the chunk at |offset| of |record| and moves |offset| past it.
+  bool ReadChunk(const FrameRecordHeader* record, uint64* offset,
+                 Chunk* chunk) const;
+
+  base::MemoryMappedFile file_;
+  const FrameFileHeader* header_;
+  const FrameIndexEntry* index_;
+  size_t frame_count_;
+  bool has_index_;
+  std::vector<FrameIndexEntry> rebuilt_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrameFileReader);
+};
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_FRAME_FILE_READER_H_
@@ -0,0 +1,243 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "realsense/common/frame_file_reader.h"
+#include "realsense/common/frame_recorder.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+const char kSource[] = "test";
+const int kWidth = 5;
+const int kHeight = 3;
+// Rows padded as in the SDK images.
+const int kPitch = 32;
+const int kFrameCount = 3;
+
+class FrameFileTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("test.rsframes");
+    for (int y = 0; y < kHeight; ++y) {
+      for (int x = 0; x < kPitch; ++x) {
+        plane_[y * kPitch + x] =
+            static_cast<uint8>(x < kWidth * 4 ? y * 16 + x : 0xCD);
+      }
+    }
+  }
+
+  // Records kFrameCount frames of a color image and a data chunk, skipping
+  // 2 frames of the pipeline after the second one.
+  void Record() {
+    FrameRecorder recorder;
+    ASSERT_TRUE(recorder.Start(path_, kSource));
+    for (int i = 0; i < kFrameCount; ++i) {
+      if (i == 2)
+        recorder.SkipFrames(2);
+      FrameRecorder::Frame* frame = recorder.BeginFrame();
+      ASSERT_TRUE(frame);
+      frame->AddImage(FRAME_CHUNK_COLOR, FRAME_CHUNK_FORMAT_BGRA32, plane_,
+                      kPitch, kWidth, kHeight, 4, 1000 + i);
+      // 3 bytes, padded in the file.
+      const uint8 data[] = {1, 2, static_cast<uint8>(i)};
+      frame->AddData(FRAME_CHUNK_FACE_LANDMARKS, data, sizeof(data));
+      recorder.EndFrame(frame);
+    }
+    recorder.Stop();
+    EXPECT_FALSE(recorder.is_recording());
+  }
+
+  // Replaces |size| bytes of the file at |offset|.
+  void PatchFile(size_t offset, const void* data, size_t size) {
+    std::string contents;
+    ASSERT_TRUE(base::ReadFileToString(path_, &contents));
+    ASSERT_LE(offset + size, contents.size());
+    contents.replace(offset, size, static_cast<const char*>(data), size);
+    WriteContents(contents);
+  }
+
+  void WriteContents(const std::string& contents) {
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              base::WriteFile(path_, contents.data(), contents.size()));
+  }
+
+  // Returns the offset of the record of the frame at |index| in the file.
+  size_t GetRecordOffset(size_t index) {
+    FrameFileReader reader;
+    EXPECT_TRUE(reader.Open(path_));
+    EXPECT_LT(index, reader.frame_count());
+    if (index >= reader.frame_count())
+      return 0;
+    return reinterpret_cast<const uint8*>(reader.GetFrame(index)) -
+           reinterpret_cast<const uint8*>(&reader.header());
+  }
+
+  void ExpectFrame(const FrameFileReader& reader, size_t index) {
+    FrameFileReader::Chunk chunk;
+    ASSERT_TRUE(reader.GetChunk(index, FRAME_CHUNK_COLOR, &chunk));
+    EXPECT_EQ(static_cast<uint32>(FRAME_CHUNK_FORMAT_BGRA32),
+              chunk.header->format);
+    EXPECT_EQ(static_cast<uint32>(kWidth), chunk.header->width);
+    EXPECT_EQ(static_cast<uint32>(kHeight), chunk.header->height);
+    // The rows are written without their padding.
+    EXPECT_EQ(static_cast<uint32>(kWidth * 4), chunk.header->stride);
+    EXPECT_EQ(static_cast<int64>(1000 + index),
+              chunk.header->device_timestamp);
+    ASSERT_EQ(static_cast<uint64>(kWidth * 4 * kHeight), chunk.header->size);
+    for (int y = 0; y < kHeight; ++y) {
+      EXPECT_EQ(0, memcmp(plane_ + kPitch * y, chunk.data + kWidth * 4 * y,
+                          kWidth * 4));
+    }
+
+    ASSERT_TRUE(reader.GetChunk(index, FRAME_CHUNK_FACE_LANDMARKS, &chunk));
+    ASSERT_EQ(3u, chunk.header->size);
+    EXPECT_EQ(static_cast<uint8>(index), chunk.data[2]);
+    // The data starts aligned in the mapping.
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(chunk.data) %
+                  kFrameFileAlignment);
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  uint8 plane_[kPitch * kHeight];
+};
+
+}  // namespace
+
+TEST_F(FrameFileTest, RecordAndRead) {
+  Record();
+  FrameFileReader reader;
+  ASSERT_TRUE(reader.Open(path_));
+  EXPECT_TRUE(reader.has_index());
+  EXPECT_STREQ(kSource, reader.header().source);
+  EXPECT_EQ(static_cast<uint64>(kFrameCount), reader.header().frame_count);
+  EXPECT_EQ(2u, reader.header().dropped_frame_count);
+  ASSERT_EQ(static_cast<size_t>(kFrameCount), reader.frame_count());
+
+  // The skipped frames leave a gap in the numbers.
+  const uint64 frame_numbers[] = {0, 1, 4};
+  for (size_t i = 0; i < reader.frame_count(); ++i) {
+    SCOPED_TRACE(testing::Message() << "frame " << i);
+    const FrameRecordHeader* record = reader.GetFrame(i);
+    ASSERT_TRUE(record);
+    EXPECT_EQ(frame_numbers[i], record->frame_number);
+    EXPECT_EQ(2u, record->chunk_count);
+    EXPECT_EQ(record->timestamp_us, reader.GetFrameTimestamp(i));
+    ExpectFrame(reader, i);
+
+    std::vector<FrameFileReader::Chunk> chunks;
+    ASSERT_TRUE(reader.GetChunks(i, &chunks));
+    ASSERT_EQ(2u, chunks.size());
+    EXPECT_EQ(static_cast<uint32>(FRAME_CHUNK_COLOR), chunks[0].header->type);
+    EXPECT_EQ(static_cast<uint32>(FRAME_CHUNK_FACE_LANDMARKS),
+              chunks[1].header->type);
+
+    FrameFileReader::Chunk chunk;
+    EXPECT_FALSE(reader.GetChunk(i, FRAME_CHUNK_DEPTH, &chunk));
+  }
+}
+
+TEST_F(FrameFileTest, FindFrame) {
+  Record();
+  FrameFileReader reader;
+  ASSERT_TRUE(reader.Open(path_));
+  ASSERT_EQ(static_cast<size_t>(kFrameCount), reader.frame_count());
+
+  EXPECT_EQ(0u, reader.FindFrame(-1));
+  EXPECT_EQ(reader.frame_count() - 1,
+            reader.FindFrame(std::numeric_limits<int64>::max()));
+  for (size_t i = 0; i < reader.frame_count(); ++i) {
+    // The last frame at or before the time stamp, which may be shared.
+    int64 timestamp = reader.GetFrameTimestamp(i);
+    size_t found = reader.FindFrame(timestamp);
+    EXPECT_GE(found, i);
+    EXPECT_EQ(timestamp, reader.GetFrameTimestamp(found));
+  }
+}
+
+TEST_F(FrameFileTest, RebuildsIndexOfUnclosedFile) {
+  Record();
+  const uint64 index_offset = 0;
+  PatchFile(offsetof(FrameFileHeader, index_offset), &index_offset,
+            sizeof(index_offset));
+
+  FrameFileReader reader;
+  ASSERT_TRUE(reader.Open(path_));
+  EXPECT_FALSE(reader.has_index());
+  // The walk stops at the index, which is not a record.
+  ASSERT_EQ(static_cast<size_t>(kFrameCount), reader.frame_count());
+  for (size_t i = 0; i < reader.frame_count(); ++i)
+    ExpectFrame(reader, i);
+}
+
+TEST_F(FrameFileTest, RebuildsIndexOfTruncatedFile) {
+  Record();
+  const size_t last_offset = GetRecordOffset(kFrameCount - 1);
+
+  // Cut in the middle of the last record, the index is gone with it.
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(path_, &contents));
+  contents.resize(last_offset + sizeof(FrameRecordHeader) + 8);
+  base::FilePath truncated = temp_dir_.path().AppendASCII("cut.rsframes");
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(truncated, contents.data(), contents.size()));
+
+  FrameFileReader reader;
+  ASSERT_TRUE(reader.Open(truncated));
+  EXPECT_FALSE(reader.has_index());
+  ASSERT_EQ(static_cast<size_t>(kFrameCount - 1), reader.frame_count());
+  for (size_t i = 0; i < reader.frame_count(); ++i)
+    ExpectFrame(reader, i);
+}
+
+TEST_F(FrameFileTest, RejectsInvalidChunk) {
+  Record();
+  // A first chunk of the first frame larger than its record.
+  const uint64 size = std::numeric_limits<uint64>::max() - 3;
+  PatchFile(GetRecordOffset(0) + sizeof(FrameRecordHeader) +
+                offsetof(FrameChunkHeader, size),
+            &size, sizeof(size));
+
+  FrameFileReader reader;
+  ASSERT_TRUE(reader.Open(path_));
+  ASSERT_EQ(static_cast<size_t>(kFrameCount), reader.frame_count());
+  FrameFileReader::Chunk chunk;
+  EXPECT_FALSE(reader.GetChunk(0, FRAME_CHUNK_FACE_LANDMARKS, &chunk));
+  std::vector<FrameFileReader::Chunk> chunks;
+  EXPECT_FALSE(reader.GetChunks(0, &chunks));
+  // The other frames are still read.
+  ExpectFrame(reader, 1);
+}
+
+TEST_F(FrameFileTest, RejectsOtherFiles) {
+  FrameFileReader missing;
+  EXPECT_FALSE(missing.Open(path_));
+
+  WriteContents(std::string("RSFRAMES"));
+  FrameFileReader too_short;
+  EXPECT_FALSE(too_short.Open(path_));
+
+  Record();
+  const char magic[] = "RSFRAMEZ";
+  PatchFile(0, magic, 8);
+  FrameFileReader wrong_magic;
+  EXPECT_FALSE(wrong_magic.Open(path_));
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -0,0 +1,286 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/frame_recorder.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/atomic_sequence_num.h"
+#include "base/bind.h"
+#include "base/environment.h"
+#include "base/logging.h"
+#include "base/process/process_handle.h"
+#include "base/strings/stringprintf.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+const char kRecordDirVariable[] = "REALSENSE_RECORD_DIR";
+
+// About 130 ms of frames at 60 FPS for the writer to absorb the stalls of
+// the disk.
+const size_t kFrameBufferCount = 8;
+
+base::StaticAtomicSequenceNumber g_recording_number;
+
+}  // namespace
+
+FrameRecorder::Frame::Frame()
+    : capacity_(0),
+      size_(0),
+      memory_("FrameRecorder", "frame") {
+}
+
+FrameRecorder::Frame::~Frame() {
+}
+
+uint8* FrameRecorder::Frame::AddChunk(FrameChunkType type,
+                                      FrameChunkFormat format,
+                                      int width, int height, int stride,
+                                      int64 device_timestamp, size_t size) {
+  const size_t chunk_size =
+      sizeof(FrameChunkHeader) + AlignFrameFileSize(size);
+  Reserve(size_ + chunk_size);
+
+  FrameChunkHeader* chunk =
+      reinterpret_cast<FrameChunkHeader*>(data_.get() + size_);
+  chunk->type = type;
+  chunk->format = format;
+  chunk->width = width;
+  chunk->height = height;
+  chunk->stride = stride;
+  chunk->reserved = 0;
+  chunk->device_timestamp = device_timestamp;
+  chunk->size = size;
+
+  uint8* data = data_.get() + size_ + sizeof(FrameChunkHeader);
+  memset(data + size, 0, AlignFrameFileSize(size) - size);
+  size_ += chunk_size;
+  ++header()->chunk_count;
+  return data;
+}
+
+void FrameRecorder::Frame::AddData(FrameChunkType type, const void* data,
+                                   size_t size) {
+  memcpy(AddChunk(type, FRAME_CHUNK_FORMAT_DATA, 0, 0, 0, 0, size), data,
+         size);
+}
+
+void FrameRecorder::Frame::AddImage(FrameChunkType type,
+                                    FrameChunkFormat format,
+                                    const uint8* plane, int pitch,
+                                    int width, int height,
+                                    int bytes_per_pixel,
+                                    int64 device_timestamp) {
+  const int row_size = width * bytes_per_pixel;
+  uint8* output = AddChunk(type, format, width, height, row_size,
+                           device_timestamp,
+                           static_cast<size_t>(row_size) * height);
+  if (pitch == row_size) {
+    memcpy(output, plane, static_cast<size_t>(row_size) * height);
+    return;
+  }
+  for (int y = 0; y < height; ++y)
+    memcpy(output + row_size * y, plane + pitch * y, row_size);
+}
+
+void FrameRecorder::Frame::Reset() {
+  Reserve(sizeof(FrameRecordHeader));
+  size_ = sizeof(FrameRecordHeader);
+  memset(data_.get(), 0, sizeof(FrameRecordHeader));
+  header()->magic = kFrameRecordMagic;
+}
+
+void FrameRecorder::Frame::Reserve(size_t size) {
+  if (size <= capacity_)
+    return;
+  // Leaves room for the frames to vary in size without growing again.
+  size_t capacity = std::max(size + size / 4, 2 * capacity_);
+  scoped_ptr<uint8[]> data(new uint8[capacity]);
+  if (size_)
+    memcpy(data.get(), data_.get(), size_);
+  data_ = data.Pass();
+  capacity_ = capacity;
+  memory_.Set(capacity);
+}
+
+FrameRecorder::FrameRecorder()
+    : writer_thread_("FrameRecorderThread"),
+      next_frame_number_(0),
+      file_size_(0),
+      write_failed_(false),
+      dropped_frame_count_(0) {
+  memset(&file_header_, 0, sizeof(file_header_));
+}
+
+FrameRecorder::~FrameRecorder() {
+  Stop();
+}
+
+// static
+scoped_ptr<FrameRecorder> FrameRecorder::CreateFromEnvironment(
+    const std::string& name) {
+  std::string dir;
+  scoped_ptr<base::Environment> env(base::Environment::Create());
+  if (!env->GetVar(kRecordDirVariable, &dir) || dir.empty())
+    return scoped_ptr<FrameRecorder>();
+
+  base::FilePath path = base::FilePath::FromUTF8Unsafe(dir).AppendASCII(
+      base::StringPrintf("%s-%d-%d.rsframes", name.c_str(),
+                         static_cast<int>(base::GetCurrentProcId()),
+                         g_recording_number.GetNext()));
+  scoped_ptr<FrameRecorder> recorder(new FrameRecorder);
+  if (!recorder->Start(path, name))
+    return scoped_ptr<FrameRecorder>();
+  return recorder.Pass();
+}
+
+bool FrameRecorder::Start(const base::FilePath& path,
+                          const std::string& source) {
+  DCHECK(!is_recording());
+  file_.Initialize(path, base::File::FLAG_CREATE_ALWAYS |
+                         base::File::FLAG_WRITE);
+  if (!file_.IsValid()) {
+    LOG(ERROR) << "Failed to create the frame file " << path.value();
+    return false;
+  }
+
+  memset(&file_header_, 0, sizeof(file_header_));
+  memcpy(file_header_.magic, kFrameFileMagic, sizeof(kFrameFileMagic));
+  file_header_.version = kFrameFileVersion;
+  file_header_.header_size = sizeof(FrameFileHeader);
+  file_header_.start_time_us =
+      (base::Time::Now() - base::Time::UnixEpoch()).InMicroseconds();
+  strncpy(file_header_.source, source.c_str(),
+          sizeof(file_header_.source) - 1);
+  const char* header = reinterpret_cast<const char*>(&file_header_);
+  if (file_.WriteAtCurrentPos(header, sizeof(file_header_)) !=
+      static_cast<int>(sizeof(file_header_))) {
+    LOG(ERROR) << "Failed to write the frame file " << path.value();
+    file_.Close();
+    return false;
+  }
+
+  path_ = path;
+  start_time_ = base::TimeTicks::Now();
+  next_frame_number_ = 0;
+  file_size_ = sizeof(file_header_);
+  index_.clear();
+  write_failed_ = false;
+  dropped_frame_count_ = 0;
+  if (frames_.empty()) {
+    for (size_t i = 0; i < kFrameBufferCount; ++i) {
+      Frame* frame = new Frame;
+      frame->Reset();
+      frames_.push_back(frame);
+    }
+  }
+  free_frames_.assign(frames_.begin(), frames_.end());
+  writer_thread_.Start();
+  return true;
+}
+
+void FrameRecorder::Stop() {
+  if (!is_recording())
+    return;
+
+  writer_thread_.message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&FrameRecorder::FinishFile, base::Unretained(this)));
+  // Runs the writes still queued and the task above.
+  writer_thread_.Stop();
+  DCHECK_EQ(frames_.size(), free_frames_.size());
+}
+
+FrameRecorder::Frame* FrameRecorder::BeginFrame() {
+  DCHECK(is_recording());
+  const uint64 frame_number = next_frame_number_++;
+  Frame* frame = NULL;
+  {
+    base::AutoLock lock(lock_);
+    if (free_frames_.empty()) {
+      ++dropped_frame_count_;
+      return NULL;
+    }
+    frame = free_frames_.back();
+    free_frames_.pop_back();
+  }
+
+  frame->Reset();
+  frame->header()->frame_number = frame_number;
+  frame->header()->timestamp_us =
+      (base::TimeTicks::Now() - start_time_).InMicroseconds();
+  return frame;
+}
+
+void FrameRecorder::EndFrame(Frame* frame) {
+  frame->header()->size = frame->size_;
+  writer_thread_.message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&FrameRecorder::WriteFrame, base::Unretained(this),
+                 base::Unretained(frame)));
+}
+
+void FrameRecorder::SkipFrames(uint64 count) {
+  DCHECK(is_recording());
+  next_frame_number_ += count;
+  base::AutoLock lock(lock_);
+  dropped_frame_count_ += count;
+}
+
+void FrameRecorder::WriteFrame(Frame* frame) {
+  const int size = static_cast<int>(frame->size_);
+  if (!write_failed_) {
+    if (file_.WriteAtCurrentPos(reinterpret_cast<const char*>(
+            frame->data_.get()), size) == size) {
+      FrameIndexEntry entry = {file_size_, frame->header()->timestamp_us};
+      index_.push_back(entry);
+      file_size_ += size;
+    } else {
+      LOG(ERROR) << "Failed to write the frame file " << path_.value();
+      write_failed_ = true;
+    }
+  }
+
+  base::AutoLock lock(lock_);
+  if (write_failed_)
+    ++dropped_frame_count_;
+  free_frames_.push_back(frame);
+}
+
+void FrameRecorder::FinishFile() {
+  if (!write_failed_) {
+    FrameIndexHeader index_header = {kFrameIndexMagic, 0, index_.size()};
+    const int index_size =
+        static_cast<int>(index_.size() * sizeof(FrameIndexEntry));
+    if (file_.WriteAtCurrentPos(reinterpret_cast<const char*>(&index_header),
+                                sizeof(index_header)) ==
+            static_cast<int>(sizeof(index_header)) &&
+        (index_.empty() ||
+         file_.WriteAtCurrentPos(reinterpret_cast<const char*>(&index_[0]),
+                                 index_size) == index_size)) {
+      file_header_.index_offset = file_size_;
+    }
+  }
+
+  file_header_.frame_count = index_.size();
+  {
+    base::AutoLock lock(lock_);
+    file_header_.dropped_frame_count = dropped_frame_count_;
+  }
+  if (file_.Write(0, reinterpret_cast<const char*>(&file_header_),
+                  sizeof(file_header_)) !=
+      static_cast<int>(sizeof(file_header_))) {
+    LOG(ERROR) << "Failed to close the frame file " << path_.value();
+  }
+  file_.Close();
+  index_.clear();
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -0,0 +1,127 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_FRAME_RECORDER_H_
+#define REALSENSE_COMMON_FRAME_RECORDER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "realsense/common/frame_file.h"
+#include "realsense/common/memory_accounting.h"
+
+namespace realsense {
+namespace common {
+
+// Records the frames of a pipeline loop to a .rsframes file, laid out in
+// frame_file.h. The pipeline thread fills a frame from a pool of buffers and
+// hands it to a writer thread, which appends it to the file and gives the
+// buffer back. The pipeline thread never waits for the disk: a frame which
+// finds no free buffer is dropped and counted in the file header.
+//
+// The buffers grow to the size of the frames the first time they are used,
+// and are reused afterwards. Start(), Stop(), BeginFrame() and EndFrame() are
+// called on the pipeline thread.
+class FrameRecorder {
+ public:
+  // A frame being filled. The data pointer returned by AddChunk() is valid
+  // until the next chunk is added.
+  class Frame {
+   public:
+    Frame();
+    ~Frame();
+
+    // Appends a chunk of |size| bytes and returns where its data goes.
+    uint8* AddChunk(FrameChunkType type, FrameChunkFormat format,
+                    int width, int height, int stride,
+                    int64 device_timestamp, size_t size);
+    void AddData(FrameChunkType type, const void* data, size_t size);
+    // Appends the rows of |plane|, |pitch| bytes apart, without their
+    // padding.
+    void AddImage(FrameChunkType type, FrameChunkFormat format,
+                  const uint8* plane, int pitch, int width, int height,
+                  int bytes_per_pixel, int64 device_timestamp);
+
+   private:
+    friend class FrameRecorder;
+
+    void Reset();
+    void Reserve(size_t size);
+    FrameRecordHeader* header() {
+      return reinterpret_cast<FrameRecordHeader*>(data_.get());
+    }
+
+    scoped_ptr<uint8[]> data_;
+    size_t capacity_;
+    size_t size_;
+    MemoryTracker memory_;
+
+    DISALLOW_COPY_AND_ASSIGN(Frame);
+  };
+
+  FrameRecorder();
+  // Stops the recording.
+  ~FrameRecorder();
+
+  // Returns a started recorder while the REALSENSE_RECORD_DIR environment
+  // variable names a directory, writing <name>-<pid>-<n>.rsframes there, and
+  // NULL otherwise.
+  static scoped_ptr<FrameRecorder> CreateFromEnvironment(
+      const std::string& name);
+
+  // Creates the file at |path|, recording the frames of |source|.
+  bool Start(const base::FilePath& path, const std::string& source);
+  // Writes the pending frames and the index, and closes the file.
+  void Stop();
+
+  // Returns the frame to fill, or NULL if the writer is behind, in which case
+  // the frame is dropped. A returned frame is passed to EndFrame().
+  Frame* BeginFrame();
+  // Queues |frame| to be written.
+  void EndFrame(Frame* frame);
+  // Counts |count| frames of the pipeline which the extension did not see,
+  // e.g. as it only acquires frames on request, as dropped. They leave a gap
+  // in the frame numbers.
+  void SkipFrames(uint64 count);
+
+  bool is_recording() const { return writer_thread_.IsRunning(); }
+
+ private:
+  // Run on |writer_thread_|.
+  void WriteFrame(Frame* frame);
+  void FinishFile();
+
+  base::Thread writer_thread_;
+  base::FilePath path_;
+  base::TimeTicks start_time_;
+  uint64 next_frame_number_;
+
+  // Only used on |writer_thread_| once started.
+  base::File file_;
+  FrameFileHeader file_header_;
+  uint64 file_size_;
+  std::vector<FrameIndexEntry> index_;
+  bool write_failed_;
+
+  ScopedVector<Frame> frames_;
+  // Guards the members below, shared by the two threads.
+  base::Lock lock_;
+  std::vector<Frame*> free_frames_;
+  uint64 dropped_frame_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrameRecorder);
+};
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_FRAME_RECORDER_H_
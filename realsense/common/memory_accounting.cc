@@ -0,0 +1,198 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/memory_accounting.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/trace_event/trace_event.h"
+
+namespace realsense {
+namespace common {
+
+struct MemoryCategory {
+  // The name of the trace counter, which must outlive the trace.
+  std::string counter_name;
+  MemoryUsage usage;
+};
+
+namespace {
+
+const char kTraceCategories[] = "realsense";
+
+// The accounting shared by the trackers of the extension. Its categories
+// are never removed, so that the trackers can hold them.
+class MemoryAccounting {
+ public:
+  MemoryAccounting() : reports_(0) {}
+
+  MemoryCategory* GetCategory(const char* object, const char* buffer) {
+    base::AutoLock lock(lock_);
+    MemoryCategory& category =
+        categories_[std::make_pair(std::string(object), std::string(buffer))];
+    if (category.counter_name.empty()) {
+      category.counter_name = base::StringPrintf("%s.%s", object, buffer);
+      category.usage.object = object;
+      category.usage.buffer = buffer;
+    }
+    return &category;
+  }
+
+  // Moves |category| from |old_buffers| buffers of |old_bytes| to
+  // |new_buffers| of |new_bytes|.
+  void Update(MemoryCategory* category, int old_buffers, size_t old_bytes,
+              int new_buffers, size_t new_bytes) {
+    size_t current_bytes;
+    {
+      base::AutoLock lock(lock_);
+      MemoryUsage& usage = category->usage;
+      usage.current_bytes = usage.current_bytes - old_bytes + new_bytes;
+      usage.peak_bytes = std::max(usage.peak_bytes, usage.current_bytes);
+      usage.buffers += new_buffers - old_buffers;
+      total_.current_bytes = total_.current_bytes - old_bytes + new_bytes;
+      total_.peak_bytes = std::max(total_.peak_bytes, total_.current_bytes);
+      total_.buffers += new_buffers - old_buffers;
+      current_bytes = usage.current_bytes;
+    }
+    TRACE_COUNTER1(kTraceCategories, category->counter_name.c_str(),
+                   current_bytes / 1024);
+  }
+
+  void GetUsage(std::vector<MemoryUsage>* categories, MemoryUsage* total) {
+    base::AutoLock lock(lock_);
+    categories->clear();
+    for (CategoryMap::const_iterator it = categories_.begin();
+         it != categories_.end(); ++it) {
+      categories->push_back(it->second.usage);
+    }
+    *total = total_;
+  }
+
+  void AddReport(const std::string& name) {
+    base::AutoLock lock(lock_);
+    if (reports_++ == 0)
+      name_ = name;
+  }
+
+  // Returns true if the last report is removed.
+  bool RemoveReport() {
+    base::AutoLock lock(lock_);
+    DCHECK_GT(reports_, 0);
+    return --reports_ == 0;
+  }
+
+  std::string name() {
+    base::AutoLock lock(lock_);
+    return name_;
+  }
+
+ private:
+  typedef std::map<std::pair<std::string, std::string>, MemoryCategory>
+      CategoryMap;
+
+  base::Lock lock_;
+  CategoryMap categories_;
+  MemoryUsage total_;
+  int reports_;
+  std::string name_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryAccounting);
+};
+
+base::LazyInstance<MemoryAccounting>::Leaky g_memory_accounting =
+    LAZY_INSTANCE_INITIALIZER;
+
+std::string FormatUsage(const std::string& name, const MemoryUsage& usage) {
+  return base::StringPrintf(
+      "%-40s %12llu %12llu %8d\n", name.c_str(),
+      static_cast<unsigned long long>(usage.current_bytes),  // NOLINT
+      static_cast<unsigned long long>(usage.peak_bytes),  // NOLINT
+      usage.buffers);
+}
+
+}  // namespace
+
+MemoryUsage::MemoryUsage()
+    : current_bytes(0),
+      peak_bytes(0),
+      buffers(0) {
+}
+
+void GetMemoryUsage(std::vector<MemoryUsage>* categories,
+                    MemoryUsage* total) {
+  g_memory_accounting.Get().GetUsage(categories, total);
+}
+
+std::string DumpMemoryUsage() {
+  std::vector<MemoryUsage> categories;
+  MemoryUsage total;
+  GetMemoryUsage(&categories, &total);
+
+  std::string dump = base::StringPrintf(
+      "Memory of %s\n%-40s %12s %12s %8s\n",
+      g_memory_accounting.Get().name().c_str(), "category", "current",
+      "peak", "buffers");
+  for (size_t i = 0; i < categories.size(); ++i) {
+    dump += FormatUsage(categories[i].object + "." + categories[i].buffer,
+                        categories[i]);
+  }
+  dump += FormatUsage("total", total);
+  return dump;
+}
+
+MemoryTracker::MemoryTracker(const char* object, const char* buffer)
+    : category_(g_memory_accounting.Get().GetCategory(object, buffer)),
+      buffers_(0),
+      bytes_(0) {
+}
+
+MemoryTracker::~MemoryTracker() {
+  Reset();
+}
+
+void MemoryTracker::SetBuffers(int buffers, size_t bytes) {
+  if (buffers == buffers_ && bytes == bytes_)
+    return;
+  g_memory_accounting.Get().Update(category_, buffers_, bytes_, buffers,
+                                   bytes);
+  buffers_ = buffers;
+  bytes_ = bytes;
+}
+
+ScopedMemoryReport::ScopedMemoryReport(const std::string& name) {
+  g_memory_accounting.Get().AddReport(name);
+}
+
+ScopedMemoryReport::~ScopedMemoryReport() {
+  if (!g_memory_accounting.Get().RemoveReport()) {
+    DVLOG(1) << DumpMemoryUsage();
+    return;
+  }
+
+  std::vector<MemoryUsage> categories;
+  MemoryUsage total;
+  GetMemoryUsage(&categories, &total);
+  if (!total.current_bytes) {
+    DVLOG(1) << DumpMemoryUsage();
+    return;
+  }
+  for (size_t i = 0; i < categories.size(); ++i) {
+    if (categories[i].current_bytes) {
+      LOG(WARNING) << categories[i].object << "." << categories[i].buffer
+                   << " still holds " << categories[i].current_bytes
+                   << " bytes in " << categories[i].buffers
+                   << " buffers after the last instance";
+    }
+  }
+  LOG(WARNING) << DumpMemoryUsage();
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -0,0 +1,108 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_MEMORY_ACCOUNTING_H_
+#define REALSENSE_COMMON_MEMORY_ACCOUNTING_H_
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/memory/linked_ptr.h"
+
+namespace realsense {
+namespace common {
+
+struct MemoryCategory;
+
+// The bytes held by the native buffers of an extension, by category. A
+// category is a buffer of a class of objects, e.g. the "sample_message" of
+// the "ScenePerception" objects, and adds up the buffers of all its
+// instances. Each extension DLL accounts for its own buffers.
+struct MemoryUsage {
+  MemoryUsage();
+
+  std::string object;
+  std::string buffer;
+  size_t current_bytes;
+  // The most bytes held at once.
+  size_t peak_bytes;
+  // The buffers holding memory.
+  int buffers;
+};
+
+// Returns the usage of each category, ordered by object and buffer, and the
+// total, whose peak is the most bytes the extension held at once.
+void GetMemoryUsage(std::vector<MemoryUsage>* categories, MemoryUsage* total);
+// Formats the usage as a table for the log.
+std::string DumpMemoryUsage();
+
+// Fills the MemoryStats dictionary of the IDL of an extension.
+template <typename CategoryStats, typename Stats>
+void PopulateMemoryStats(Stats* stats) {
+  std::vector<MemoryUsage> categories;
+  MemoryUsage total;
+  GetMemoryUsage(&categories, &total);
+  stats->current_bytes = static_cast<double>(total.current_bytes);
+  stats->peak_bytes = static_cast<double>(total.peak_bytes);
+  stats->categories.clear();
+  for (size_t i = 0; i < categories.size(); ++i) {
+    linked_ptr<CategoryStats> category(new CategoryStats);
+    category->object = categories[i].object;
+    category->buffer = categories[i].buffer;
+    category->current_bytes =
+        static_cast<double>(categories[i].current_bytes);
+    category->peak_bytes = static_cast<double>(categories[i].peak_bytes);
+    category->buffers = categories[i].buffers;
+    stats->categories.push_back(category);
+  }
+}
+
+// Accounts for the bytes of a buffer of |object| under the |buffer|
+// category. The owner of the buffer updates it as the buffer is allocated,
+// grown or freed, and the bytes still counted are released when the tracker
+// is destroyed. The names must outlive the process, string literals in
+// practice. A tracker is not thread safe and is used like the buffer it
+// tracks. The usage of each category is also a counter of the "realsense"
+// trace events, in kilobytes.
+class MemoryTracker {
+ public:
+  MemoryTracker(const char* object, const char* buffer);
+  ~MemoryTracker();
+
+  // Counts |bytes| in one buffer, or none if |bytes| is 0.
+  void Set(size_t bytes) { SetBuffers(bytes ? 1 : 0, bytes); }
+  // Counts |bytes| in |buffers| buffers, for a set of buffers.
+  void SetBuffers(int buffers, size_t bytes);
+  void Reset() { SetBuffers(0, 0); }
+
+  size_t bytes() const { return bytes_; }
+
+ private:
+  MemoryCategory* category_;
+  int buffers_;
+  size_t bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryTracker);
+};
+
+// Reports the memory of an extension when its instances go away. Each
+// instance of the extension holds one, declared before the objects and the
+// threads holding the buffers so that it outlives them. The usage is logged
+// when an instance is destroyed, and once the last one is, the categories
+// still holding memory are logged as warnings: their buffers belong to
+// objects which outlived all the instances.
+class ScopedMemoryReport {
+ public:
+  explicit ScopedMemoryReport(const std::string& name);
+  ~ScopedMemoryReport();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedMemoryReport);
+};
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_MEMORY_ACCOUNTING_H_
@@ -0,0 +1,172 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/stream_quality.h"
+
+#include <algorithm>
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+// The bounds of setStreamQuality() when its options leave them unset.
+const StreamQualityController::Quality kDefaultLowestQuality =
+    StreamQualityController::QUALITY_THROTTLED;
+const int kDefaultMaxLatencyMs = 100;
+
+// The unacknowledged events over which the page lags, whatever the latency.
+const size_t kMaxPendingEvents = 3;
+// The events tracked for a page which stopped acknowledging.
+const size_t kMaxTrackedEvents = 32;
+
+// A step down waits for the previous one to show, a step up waits for the
+// page to keep up long enough not to flap between two qualities.
+const int kDegradeIntervalMs = 250;
+const int kRecoverIntervalMs = 2000;
+
+int GetEventInterval(StreamQualityController::Quality quality) {
+  switch (quality) {
+    case StreamQualityController::QUALITY_FULL:
+      return 1;
+    case StreamQualityController::QUALITY_THROTTLED:
+    case StreamQualityController::QUALITY_DOWNSCALED:
+      return 2;
+    case StreamQualityController::QUALITY_MINIMAL:
+      return 4;
+  }
+  return 1;
+}
+
+}  // namespace
+
+StreamQualityController::StreamQualityController()
+    : enabled_(false),
+      lowest_quality_(QUALITY_FULL),
+      max_latency_(base::TimeDelta::FromMilliseconds(kDefaultMaxLatencyMs)),
+      quality_(QUALITY_FULL),
+      frame_count_(0),
+      last_event_id_(0) {
+}
+
+StreamQualityController::~StreamQualityController() {
+}
+
+void StreamQualityController::SetBounds(Quality lowest_quality,
+                                        base::TimeDelta max_latency) {
+  base::AutoLock lock(lock_);
+  enabled_ = true;
+  lowest_quality_ = lowest_quality;
+  max_latency_ = max_latency;
+  quality_ = std::min(quality_, lowest_quality_);
+}
+
+bool StreamQualityController::SetBoundsFromOptions(
+    int lowest_quality, const double* max_latency_ms) {
+  Quality quality = kDefaultLowestQuality;
+  if (lowest_quality > 0 && lowest_quality - 1 <= QUALITY_MINIMAL)
+    quality = static_cast<Quality>(lowest_quality - 1);
+  double latency_ms = max_latency_ms ? *max_latency_ms : kDefaultMaxLatencyMs;
+  // Also rejects NaN.
+  if (!(latency_ms > 0))
+    return false;
+
+  SetBounds(quality,
+            base::TimeDelta::FromMicroseconds(static_cast<int64>(
+                latency_ms * base::Time::kMicrosecondsPerMillisecond)));
+  return true;
+}
+
+bool StreamQualityController::OnFrame(base::TimeTicks now, int* event_id) {
+  base::AutoLock lock(lock_);
+  *event_id = 0;
+  if (!enabled_)
+    return true;
+
+  UpdateQuality(now);
+  if (frame_count_++ % GetEventInterval(quality_))
+    return false;
+
+  if (events_.size() == kMaxTrackedEvents)
+    events_.pop_front();
+  if (++last_event_id_ <= 0)
+    last_event_id_ = 1;
+  Event event = {last_event_id_, now};
+  events_.push_back(event);
+  *event_id = last_event_id_;
+  return true;
+}
+
+void StreamQualityController::OnFrameEventAcknowledged(int event_id,
+                                                       base::TimeTicks now) {
+  base::AutoLock lock(lock_);
+  std::deque<Event>::iterator it = events_.begin();
+  while (it != events_.end() && it->id != event_id)
+    ++it;
+  // Dispatched before Reset(), or dropped from the backlog.
+  if (it == events_.end())
+    return;
+
+  base::TimeDelta latency = now - it->dispatch_time;
+  events_.erase(events_.begin(), it + 1);
+  if (latency_.is_zero())
+    latency_ = latency;
+  else
+    latency_ = (latency_ * 3 + latency) / 4;
+}
+
+void StreamQualityController::Reset() {
+  base::AutoLock lock(lock_);
+  quality_ = QUALITY_FULL;
+  last_change_ = base::TimeTicks();
+  last_lag_ = base::TimeTicks();
+  frame_count_ = 0;
+  events_.clear();
+  latency_ = base::TimeDelta();
+}
+
+StreamQualityController::Quality StreamQualityController::quality() const {
+  base::AutoLock lock(lock_);
+  return quality_;
+}
+
+bool StreamQualityController::ShouldDownscalePreview() const {
+  base::AutoLock lock(lock_);
+  return quality_ >= QUALITY_DOWNSCALED;
+}
+
+bool StreamQualityController::ShouldSkipOptionalOutputs() const {
+  base::AutoLock lock(lock_);
+  return quality_ >= QUALITY_MINIMAL;
+}
+
+void StreamQualityController::UpdateQuality(base::TimeTicks now) {
+  lock_.AssertAcquired();
+  // The oldest event in flight tells a stalled page before its
+  // acknowledgement comes.
+  base::TimeDelta latency = latency_;
+  if (!events_.empty())
+    latency = std::max(latency, now - events_.front().dispatch_time);
+
+  if (latency > max_latency_ || events_.size() > kMaxPendingEvents) {
+    last_lag_ = now;
+    if (quality_ < lowest_quality_ &&
+        now - last_change_ >=
+            base::TimeDelta::FromMilliseconds(kDegradeIntervalMs)) {
+      quality_ = static_cast<Quality>(quality_ + 1);
+      last_change_ = now;
+    }
+    return;
+  }
+
+  if (quality_ > QUALITY_FULL && latency < max_latency_ / 2 &&
+      now - std::max(last_change_, last_lag_) >=
+          base::TimeDelta::FromMilliseconds(kRecoverIntervalMs)) {
+    quality_ = static_cast<Quality>(quality_ - 1);
+    last_change_ = now;
+  }
+}
+
+}  // namespace common
+}  // namespace realsense
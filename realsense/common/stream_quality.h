@@ -0,0 +1,108 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_STREAM_QUALITY_H_
+#define REALSENSE_COMMON_STREAM_QUALITY_H_
+
+#include <deque>
+
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace realsense {
+namespace common {
+
+// Adapts the frame events of an extension to how fast the page consumes
+// them, once the page opted in with setStreamQuality(); until then every
+// frame has its event. The events then carry an ID which the JS API
+// acknowledges as it receives them, and the time from the dispatch to the
+// acknowledgement, the delivery latency, grows with the messages queued
+// behind a busy page. The quality goes down
+// a step while the latency or the number of unacknowledged events is too
+// high, and up a step once the page has kept up for a while, within the
+// bounds of the page.
+//
+// The pipeline thread calls OnFrame() and the extension thread the others.
+class StreamQualityController {
+ public:
+  // How much of the stream of frame events goes to the page, from the whole
+  // stream down.
+  enum Quality {
+    // An event per frame, with the full size images.
+    QUALITY_FULL,
+    // An event every other frame.
+    QUALITY_THROTTLED,
+    // Also the preview images at half their width and height.
+    QUALITY_DOWNSCALED,
+    // An event every 4 frames, and no optional outputs like the color
+    // images.
+    QUALITY_MINIMAL,
+  };
+
+  StreamQualityController();
+  ~StreamQualityController();
+
+  // Lets the quality go down to |lowest_quality| when the delivery latency
+  // exceeds |max_latency|, and turns the controller on.
+  void SetBounds(Quality lowest_quality, base::TimeDelta max_latency);
+  // Sets the bounds from the StreamQualityOptions of setStreamQuality(),
+  // which the IDLs of the extensions declare alike. |lowest_quality| is the
+  // value of their StreamQuality enum, which lists the qualities in the
+  // order of Quality after the NONE of an unset member, and
+  // |max_latency_ms| is NULL if unset. An unset lowest quality is
+  // throttled, as the IDLs document. Returns false, leaving the bounds
+  // alone, if the latency is not positive.
+  bool SetBoundsFromOptions(int lowest_quality, const double* max_latency_ms);
+
+  // Called for each frame which has an event. Returns whether the event of
+  // the frame is dispatched, with |*event_id| set to the ID the page
+  // acknowledges it with, or to 0 while the controller is off.
+  bool OnFrame(base::TimeTicks now, int* event_id);
+
+  // The page received the event |event_id|. The events arrive in order, so
+  // the earlier ones still in flight will not be acknowledged any more. An
+  // event no longer tracked, e.g. dropped from a long backlog, is ignored.
+  void OnFrameEventAcknowledged(int event_id, base::TimeTicks now);
+
+  // Forgets the events in flight and goes back to the full quality, when the
+  // page stops listening to the frame events. The controller stays on.
+  void Reset();
+
+  Quality quality() const;
+  // Whether the preview images are sent at half their width and height.
+  bool ShouldDownscalePreview() const;
+  // Whether the optional outputs, like the color images, are skipped.
+  bool ShouldSkipOptionalOutputs() const;
+
+ private:
+  struct Event {
+    int id;
+    base::TimeTicks dispatch_time;
+  };
+
+  void UpdateQuality(base::TimeTicks now);
+
+  mutable base::Lock lock_;
+  bool enabled_;
+  Quality lowest_quality_;
+  base::TimeDelta max_latency_;
+
+  Quality quality_;
+  base::TimeTicks last_change_;
+  base::TimeTicks last_lag_;
+  int64 frame_count_;
+  int last_event_id_;
+  // The events not acknowledged yet, oldest first.
+  std::deque<Event> events_;
+  // The delivery latency, averaged over the last acknowledgements.
+  base::TimeDelta latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(StreamQualityController);
+};
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_STREAM_QUALITY_H_
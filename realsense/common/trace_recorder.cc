@@ -0,0 +1,145 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/trace_recorder.h"
+
+#include "base/bind.h"
+#include "base/environment.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/process/process_handle.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_config.h"
+#include "base/trace_event/trace_log.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+const char kTraceDirVariable[] = "REALSENSE_TRACE_DIR";
+const char kTraceCategories[] = "realsense";
+
+using base::trace_event::TraceConfig;
+using base::trace_event::TraceLog;
+using base::trace_event::TraceResultBuffer;
+
+// The recording shared by the instances of the extension.
+class TraceRecorder {
+ public:
+  TraceRecorder() : recordings_(0) {}
+
+  void AddRecording(const std::string& name) {
+    base::AutoLock lock(lock_);
+    if (recordings_++ > 0)
+      return;
+
+    std::string dir;
+    scoped_ptr<base::Environment> env(base::Environment::Create());
+    if (!env->GetVar(kTraceDirVariable, &dir) || dir.empty())
+      return;
+    path_ = base::FilePath::FromUTF8Unsafe(dir).AppendASCII(
+        base::StringPrintf("%s-%d.json", name.c_str(),
+                           static_cast<int>(base::GetCurrentProcId())));
+    // TraceLog::Flush() needs a message loop, and the threads of the
+    // instances are gone by the time the trace is written.
+    flush_thread_.reset(new base::Thread("TraceRecorderThread"));
+    flush_thread_->Start();
+    TraceLog::GetInstance()->SetEnabled(
+        TraceConfig(kTraceCategories, base::trace_event::RECORD_CONTINUOUSLY),
+        TraceLog::RECORDING_MODE);
+  }
+
+  void RemoveRecording() {
+    base::AutoLock lock(lock_);
+    DCHECK_GT(recordings_, 0);
+    if (--recordings_ > 0 || !flush_thread_)
+      return;
+
+    TraceLog::GetInstance()->SetDisabled();
+    output_.json_output.clear();
+    buffer_.SetOutputCallback(output_.GetCallback());
+    buffer_.Start();
+    base::WaitableEvent flushed(false, false);
+    flush_thread_->message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&TraceLog::Flush,
+                   base::Unretained(TraceLog::GetInstance()),
+                   base::Bind(&TraceRecorder::OnTraceData,
+                              base::Unretained(this),
+                              base::Unretained(&flushed)),
+                   false));
+    flushed.Wait();
+    buffer_.Finish();
+    flush_thread_.reset();
+
+    const std::string& json = output_.json_output;
+    if (base::WriteFile(path_, json.data(), json.size()) !=
+        static_cast<int>(json.size()))
+      LOG(ERROR) << "Failed to write the trace to " << path_.value();
+    output_.json_output.clear();
+  }
+
+ private:
+  void OnTraceData(base::WaitableEvent* flushed,
+                   const scoped_refptr<base::RefCountedString>& events,
+                   bool has_more_events) {
+    buffer_.AddFragment(events->data());
+    if (!has_more_events)
+      flushed->Signal();
+  }
+
+  base::Lock lock_;
+  int recordings_;
+  base::FilePath path_;
+  scoped_ptr<base::Thread> flush_thread_;
+  TraceResultBuffer buffer_;
+  TraceResultBuffer::SimpleOutput output_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceRecorder);
+};
+
+base::LazyInstance<TraceRecorder>::Leaky g_trace_recorder =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+ScopedTraceRecording::ScopedTraceRecording(const std::string& name) {
+  g_trace_recorder.Get().AddRecording(name);
+}
+
+ScopedTraceRecording::~ScopedTraceRecording() {
+  g_trace_recorder.Get().RemoveRecording();
+}
+
+FrameFlow::FrameFlow(const char* name) : name_(name), frame_id_(0) {
+}
+
+FrameFlow::~FrameFlow() {
+  End();
+}
+
+void FrameFlow::Begin(int64 frame_id) {
+  End();
+  frame_id_ = frame_id;
+  TRACE_EVENT_FLOW_BEGIN0("realsense", name_, frame_id_);
+}
+
+void FrameFlow::End() {
+  if (!frame_id_)
+    return;
+  TRACE_EVENT_FLOW_END0("realsense", name_, frame_id_);
+  frame_id_ = 0;
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -0,0 +1,59 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_TRACE_RECORDER_H_
+#define REALSENSE_COMMON_TRACE_RECORDER_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/macros.h"
+#include "base/trace_event/trace_event.h"
+
+namespace realsense {
+namespace common {
+
+// Records the "realsense" trace events of an extension while the
+// REALSENSE_TRACE_DIR environment variable names a directory. Each instance
+// of the extension holds one, declared before its threads so that it
+// outlives them. Recording starts with the first instance, and when the last
+// one is destroyed the events of all the threads are written to
+// <name>-<pid>.json in that directory, which chrome://tracing loads.
+class ScopedTraceRecording {
+ public:
+  explicit ScopedTraceRecording(const std::string& name);
+  ~ScopedTraceRecording();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedTraceRecording);
+};
+
+// The flow from the frame event of a module to the request of the page
+// pulling that frame. The page may skip frames, so the flow of a frame that
+// is never pulled ends when the next one begins, and no flow is left open.
+// |name| must be a string literal. Used on the thread of the pipeline.
+class FrameFlow {
+ public:
+  explicit FrameFlow(const char* name);
+  ~FrameFlow();
+
+  // Begins the flow of |frame_id|, ending the open one.
+  void Begin(int64 frame_id);
+  // Ends the open flow, if any.
+  void End();
+
+  // The frame of the open flow, or 0.
+  int64 frame_id() const { return frame_id_; }
+
+ private:
+  const char* name_;
+  int64 frame_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrameFlow);
+};
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_TRACE_RECORDER_H_
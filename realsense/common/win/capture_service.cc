@@ -0,0 +1,716 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/win/capture_service.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/sys_string_conversions.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/simple_thread.h"
+#include "third_party/libpxc/include/pxcsession.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+class Pipeline;
+
+class Connection : public CaptureConnection {
+ public:
+  // JOINING        --- pipeline set up ---> ACTIVE or REJECTED
+  // ACTIVE         --- restart ---> RESTART_PENDING
+  // ACTIVE         --- camera error ---> FAILED
+  // RESTART_PENDING --- WaitForRestart() ---> WAITING_RESTART
+  // WAITING_RESTART --- pipeline set up ---> ACTIVE or FAILED
+  enum State {
+    JOINING,
+    ACTIVE,
+    RESTART_PENDING,
+    WAITING_RESTART,
+    FAILED,
+    REJECTED,
+  };
+
+  Connection(Pipeline* pipeline, CaptureConsumer* consumer)
+      : state(JOINING),
+        status(PXC_STATUS_NO_ERROR),
+        restart_notified(false),
+        waiting(false),
+        expects_frame(false),
+        last_frame(0),
+        pipeline_(pipeline),
+        consumer_(consumer) {}
+  ~Connection() override {}
+
+  // CaptureConnection implementation.
+  PXCSenseManager* QuerySenseManager() override;
+  pxcStatus AcquireFrame(CaptureFrame** frame) override;
+  bool IsRestartPending() override;
+  pxcStatus WaitForRestart() override;
+  void Release() override;
+
+  Pipeline* pipeline() const { return pipeline_; }
+  CaptureConsumer* consumer() const { return consumer_; }
+
+  // Guarded by the lock of the pipeline.
+  State state;
+  pxcStatus status;
+  bool restart_notified;
+  // Whether the consumer is in AcquireFrame().
+  bool waiting;
+  // Whether the consumer was waiting when the held frame was acquired, and
+  // has not taken it yet.
+  bool expects_frame;
+  int last_frame;
+
+ private:
+  Pipeline* pipeline_;
+  CaptureConsumer* consumer_;
+
+  DISALLOW_COPY_AND_ASSIGN(Connection);
+};
+
+// The sense manager of one camera and its capture thread. The pipeline is the
+// held frame as well, as the sense manager holds one frame at a time.
+class Pipeline : public base::DelegateSimpleThread::Delegate,
+                 public CaptureFrame {
+ public:
+  explicit Pipeline(const std::string& device_name);
+  ~Pipeline() override;
+
+  void Start();
+  void Stop();
+
+  // Whether a consumer of |device_name| can use this pipeline. An empty
+  // name matches any camera.
+  bool MatchesDevice(const std::string& device_name);
+
+  Connection* AddConnection(CaptureConsumer* consumer);
+  // Waits until the capture thread no longer calls the consumer of
+  // |connection|, then removes it.
+  void RemoveConnection(Connection* connection);
+
+  // The connections added and not yet disconnected, including the one being
+  // removed. Used with the lock of the service held, so that a pipeline is
+  // only stopped once no Connect() can find it any more.
+  void AddUser() { ++users_; }
+  // Returns whether no user is left.
+  bool RemoveUser() { return --users_ == 0; }
+
+  pxcStatus WaitForJoin(Connection* connection);
+
+  // Called through the connections.
+  PXCSenseManager* QuerySenseManager(Connection* connection);
+  pxcStatus AcquireFrame(Connection* connection, CaptureFrame** frame);
+  bool IsRestartPending(Connection* connection);
+  pxcStatus WaitForRestart(Connection* connection);
+
+  // CaptureFrame implementation.
+  PXCSenseManager* QuerySenseManager() override;
+  int QueryFrameNumber() override;
+  void Release() override;
+
+  // base::DelegateSimpleThread::Delegate implementation.
+  void Run() override;
+
+ private:
+  // These run on the capture thread with |lock_| held.
+  void SetUp();
+  Connection* FindRestartToNotify() const;
+  bool AnyWaiting() const;
+  bool HasState(Connection::State state) const;
+  void AcquireNextFrame();
+  void Fail(pxcStatus status);
+  // Replaces the sense manager by one configured for the connections in
+  // |state|.
+  pxcStatus CreateSenseManager(Connection::State state);
+  void DestroySenseManager();
+  // Calls a consumer with |lock_| released. The connection is not removed
+  // during the call.
+  bool CallCanJoinPipeline(Connection* connection);
+  pxcStatus CallOnConfigurePipeline(Connection* connection,
+                                    PXCSenseManager* sense_manager);
+  void CallOnPipelineRestart(Connection* connection);
+
+  // Runs without |lock_|.
+  bool FilterDevice(PXCSenseManager* sense_manager);
+
+  base::Lock lock_;
+  base::ConditionVariable changed_;
+  std::string device_name_;
+  std::vector<Connection*> connections_;
+  // Guarded by the lock of the service.
+  int users_;
+  // The connection being called on the capture thread.
+  Connection* calling_;
+  bool quit_;
+
+  PXCSession* session_;
+  PXCSenseManager* sense_manager_;
+  bool running_;
+
+  int frame_number_;
+  bool frame_held_;
+  // Consumers that expect the held frame, and consumers holding it.
+  int frame_takers_;
+  int frame_holders_;
+
+  scoped_ptr<base::DelegateSimpleThread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(Pipeline);
+};
+
+class CaptureServiceImpl : public CaptureService {
+ public:
+  CaptureServiceImpl() {}
+  ~CaptureServiceImpl() override {}
+
+  // CaptureService implementation.
+  CaptureConnection* Connect(const char* device_name,
+                             CaptureConsumer* consumer,
+                             pxcStatus* status) override;
+
+  void Disconnect(Connection* connection);
+
+ private:
+  base::Lock lock_;
+  std::vector<Pipeline*> pipelines_;
+
+  DISALLOW_COPY_AND_ASSIGN(CaptureServiceImpl);
+};
+
+base::LazyInstance<CaptureServiceImpl>::Leaky g_capture_service =
+    LAZY_INSTANCE_INITIALIZER;
+
+PXCSenseManager* Connection::QuerySenseManager() {
+  return pipeline_->QuerySenseManager(this);
+}
+
+pxcStatus Connection::AcquireFrame(CaptureFrame** frame) {
+  return pipeline_->AcquireFrame(this, frame);
+}
+
+bool Connection::IsRestartPending() {
+  return pipeline_->IsRestartPending(this);
+}
+
+pxcStatus Connection::WaitForRestart() {
+  return pipeline_->WaitForRestart(this);
+}
+
+void Connection::Release() {
+  g_capture_service.Get().Disconnect(this);
+}
+
+Pipeline::Pipeline(const std::string& device_name)
+    : changed_(&lock_),
+      device_name_(device_name),
+      users_(0),
+      calling_(NULL),
+      quit_(false),
+      session_(NULL),
+      sense_manager_(NULL),
+      running_(false),
+      frame_number_(0),
+      frame_held_(false),
+      frame_takers_(0),
+      frame_holders_(0) {
+}
+
+Pipeline::~Pipeline() {
+  DCHECK(connections_.empty());
+  DCHECK(!sense_manager_);
+}
+
+void Pipeline::Start() {
+  thread_.reset(new base::DelegateSimpleThread(this, "CaptureThread"));
+  thread_->Start();
+}
+
+void Pipeline::Stop() {
+  {
+    base::AutoLock lock(lock_);
+    quit_ = true;
+    changed_.Broadcast();
+  }
+  thread_->Join();
+}
+
+bool Pipeline::MatchesDevice(const std::string& device_name) {
+  base::AutoLock lock(lock_);
+  return device_name.empty() || device_name == device_name_;
+}
+
+Connection* Pipeline::AddConnection(CaptureConsumer* consumer) {
+  base::AutoLock lock(lock_);
+  Connection* connection = new Connection(this, consumer);
+  connections_.push_back(connection);
+  changed_.Broadcast();
+  return connection;
+}
+
+void Pipeline::RemoveConnection(Connection* connection) {
+  base::AutoLock lock(lock_);
+  while (calling_ == connection)
+    changed_.Wait();
+  connections_.erase(std::find(connections_.begin(), connections_.end(),
+                               connection));
+  // Neither a pending restart nor the held frame wait for it any more.
+  if (connection->expects_frame)
+    --frame_takers_;
+  changed_.Broadcast();
+}
+
+pxcStatus Pipeline::WaitForJoin(Connection* connection) {
+  base::AutoLock lock(lock_);
+  while (connection->state == Connection::JOINING)
+    changed_.Wait();
+  return connection->state == Connection::ACTIVE ?
+      PXC_STATUS_NO_ERROR : connection->status;
+}
+
+PXCSenseManager* Pipeline::QuerySenseManager(Connection* connection) {
+  base::AutoLock lock(lock_);
+  // A pending restart waits for the consumer before it destroys the sense
+  // manager.
+  if (connection->state == Connection::ACTIVE ||
+      connection->state == Connection::RESTART_PENDING)
+    return sense_manager_;
+  return NULL;
+}
+
+pxcStatus Pipeline::AcquireFrame(Connection* connection,
+                                 CaptureFrame** frame) {
+  base::AutoLock lock(lock_);
+  connection->waiting = true;
+  changed_.Broadcast();
+
+  pxcStatus status = PXC_STATUS_NO_ERROR;
+  while (true) {
+    if (connection->state == Connection::RESTART_PENDING) {
+      status = PXC_STATUS_EXEC_ABORTED;
+      break;
+    }
+    if (connection->state != Connection::ACTIVE) {
+      status = connection->status;
+      break;
+    }
+    // A frame nobody expects nor holds any more is about to be released.
+    if (frame_held_ && connection->last_frame < frame_number_ &&
+        (connection->expects_frame || frame_takers_ > 0 ||
+         frame_holders_ > 0)) {
+      if (connection->expects_frame) {
+        connection->expects_frame = false;
+        --frame_takers_;
+      }
+      ++frame_holders_;
+      connection->last_frame = frame_number_;
+      *frame = this;
+      break;
+    }
+    changed_.Wait();
+  }
+  connection->waiting = false;
+  return status;
+}
+
+bool Pipeline::IsRestartPending(Connection* connection) {
+  base::AutoLock lock(lock_);
+  return connection->state == Connection::RESTART_PENDING;
+}
+
+pxcStatus Pipeline::WaitForRestart(Connection* connection) {
+  base::AutoLock lock(lock_);
+  if (connection->state == Connection::RESTART_PENDING) {
+    connection->state = Connection::WAITING_RESTART;
+    changed_.Broadcast();
+    while (connection->state == Connection::WAITING_RESTART)
+      changed_.Wait();
+  }
+  return connection->state == Connection::ACTIVE ?
+      PXC_STATUS_NO_ERROR : connection->status;
+}
+
+PXCSenseManager* Pipeline::QuerySenseManager() {
+  // Only used while the frame is held, when the sense manager cannot change.
+  return sense_manager_;
+}
+
+int Pipeline::QueryFrameNumber() {
+  base::AutoLock lock(lock_);
+  return frame_number_;
+}
+
+void Pipeline::Release() {
+  base::AutoLock lock(lock_);
+  DCHECK_GT(frame_holders_, 0);
+  if (--frame_holders_ == 0)
+    changed_.Broadcast();
+}
+
+void Pipeline::Run() {
+  base::AutoLock lock(lock_);
+  while (!quit_) {
+    if (HasState(Connection::JOINING)) {
+      SetUp();
+    } else if (running_ && AnyWaiting()) {
+      AcquireNextFrame();
+    } else {
+      changed_.Wait();
+    }
+  }
+  DestroySenseManager();
+}
+
+void Pipeline::SetUp() {
+  // The joining consumers wait in Connect(), so they stay connected.
+  std::vector<Connection*> joining;
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    if (connections_[i]->state == Connection::JOINING)
+      joining.push_back(connections_[i]);
+  }
+
+  // If the running pipeline serves all of them, they join it right away.
+  bool can_join = running_;
+  for (size_t i = 0; i < joining.size() && can_join; ++i)
+    can_join = CallCanJoinPipeline(joining[i]);
+  if (can_join) {
+    for (size_t i = 0; i < joining.size(); ++i) {
+      joining[i]->state = Connection::ACTIVE;
+      joining[i]->last_frame = frame_number_;
+    }
+    changed_.Broadcast();
+    return;
+  }
+
+  // Let the active consumers drop what they created from the sense manager.
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    if (connections_[i]->state == Connection::ACTIVE) {
+      connections_[i]->state = Connection::RESTART_PENDING;
+      connections_[i]->restart_notified = false;
+    }
+  }
+  changed_.Broadcast();
+  // The connections may go away while a consumer is called, so the next one
+  // to notify is looked up again each time.
+  while (Connection* connection = FindRestartToNotify()) {
+    connection->restart_notified = true;
+    CallOnPipelineRestart(connection);
+  }
+  while (HasState(Connection::RESTART_PENDING) && !quit_)
+    changed_.Wait();
+  if (quit_)
+    return;
+
+  // Recreate the pipeline for everyone. If the joining consumers cannot be
+  // served, they are turned down and the others get their pipeline back.
+  pxcStatus status = CreateSenseManager(Connection::JOINING);
+  if (status < PXC_STATUS_NO_ERROR) {
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      if (connections_[i]->state == Connection::JOINING) {
+        connections_[i]->state = Connection::REJECTED;
+        connections_[i]->status = status;
+      }
+    }
+    if (HasState(Connection::WAITING_RESTART))
+      status = CreateSenseManager(Connection::WAITING_RESTART);
+  }
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    Connection* connection = connections_[i];
+    if (connection->state != Connection::JOINING &&
+        connection->state != Connection::WAITING_RESTART)
+      continue;
+    if (status < PXC_STATUS_NO_ERROR) {
+      connection->state = Connection::FAILED;
+      connection->status = status;
+    } else {
+      connection->state = Connection::ACTIVE;
+      connection->last_frame = frame_number_;
+    }
+  }
+  changed_.Broadcast();
+}
+
+Connection* Pipeline::FindRestartToNotify() const {
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    if (connections_[i]->state == Connection::RESTART_PENDING &&
+        !connections_[i]->restart_notified)
+      return connections_[i];
+  }
+  return NULL;
+}
+
+bool Pipeline::AnyWaiting() const {
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    if (connections_[i]->state == Connection::ACTIVE &&
+        connections_[i]->waiting)
+      return true;
+  }
+  return false;
+}
+
+bool Pipeline::HasState(Connection::State state) const {
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    if (connections_[i]->state == state)
+      return true;
+  }
+  return false;
+}
+
+void Pipeline::AcquireNextFrame() {
+  PXCSenseManager* sense_manager = sense_manager_;
+  pxcStatus status;
+  {
+    base::AutoUnlock unlock(lock_);
+    status = sense_manager->AcquireFrame(true);
+  }
+  if (status < PXC_STATUS_NO_ERROR) {
+    DLOG(ERROR) << "Failed to acquire frame: " << status;
+    Fail(status);
+    return;
+  }
+
+  ++frame_number_;
+  frame_held_ = true;
+  frame_takers_ = 0;
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    Connection* connection = connections_[i];
+    if (connection->state == Connection::ACTIVE && connection->waiting) {
+      connection->expects_frame = true;
+      ++frame_takers_;
+    }
+  }
+  changed_.Broadcast();
+  while (frame_takers_ > 0 || frame_holders_ > 0)
+    changed_.Wait();
+  frame_held_ = false;
+
+  base::AutoUnlock unlock(lock_);
+  sense_manager->ReleaseFrame();
+}
+
+void Pipeline::Fail(pxcStatus status) {
+  running_ = false;
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    if (connections_[i]->state == Connection::ACTIVE) {
+      connections_[i]->state = Connection::FAILED;
+      connections_[i]->status = status;
+    }
+  }
+  changed_.Broadcast();
+}
+
+pxcStatus Pipeline::CreateSenseManager(Connection::State state) {
+  DestroySenseManager();
+
+  // Not the shared session of AcquireSharedSession(): scene perception sets
+  // its coordinate system, e.g. the OpenCV one, on the session of the sense
+  // manager, which would change the coordinates returned to every other
+  // user of the shared session.
+  if (!session_) {
+    base::AutoUnlock unlock(lock_);
+    session_ = PXCSession::CreateInstance();
+  }
+  if (!session_)
+    return PXC_STATUS_ITEM_UNAVAILABLE;
+
+  PXCSenseManager* sense_manager;
+  {
+    base::AutoUnlock unlock(lock_);
+    sense_manager = session_->CreateSenseManager();
+  }
+  if (!sense_manager)
+    return PXC_STATUS_ALLOC_FAILED;
+
+  pxcStatus status = PXC_STATUS_NO_ERROR;
+  if (!device_name_.empty()) {
+    base::AutoUnlock unlock(lock_);
+    if (!FilterDevice(sense_manager))
+      status = PXC_STATUS_ITEM_UNAVAILABLE;
+  }
+  // The consumers in |state| wait in Connect() or WaitForRestart(), so they
+  // stay connected.
+  std::vector<Connection*> consumers;
+  for (size_t i = 0; i < connections_.size(); ++i) {
+    if (connections_[i]->state == state ||
+        connections_[i]->state == Connection::WAITING_RESTART)
+      consumers.push_back(connections_[i]);
+  }
+  for (size_t i = 0; i < consumers.size() && status >= PXC_STATUS_NO_ERROR;
+       ++i) {
+    status = CallOnConfigurePipeline(consumers[i], sense_manager);
+  }
+  if (status >= PXC_STATUS_NO_ERROR) {
+    base::AutoUnlock unlock(lock_);
+    status = sense_manager->Init();
+  }
+  if (status < PXC_STATUS_NO_ERROR) {
+    DLOG(ERROR) << "Failed to set up the pipeline: " << status;
+    base::AutoUnlock unlock(lock_);
+    sense_manager->Close();
+    sense_manager->Release();
+    return status;
+  }
+
+  if (device_name_.empty()) {
+    PXCCapture::DeviceInfo device_info = {};
+    sense_manager->QueryCaptureManager()->QueryDevice()
+        ->QueryDeviceInfo(&device_info);
+    device_name_ = base::SysWideToUTF8(device_info.name);
+  }
+  sense_manager_ = sense_manager;
+  running_ = true;
+  return PXC_STATUS_NO_ERROR;
+}
+
+void Pipeline::DestroySenseManager() {
+  running_ = false;
+  PXCSenseManager* sense_manager = sense_manager_;
+  sense_manager_ = NULL;
+  // The session is kept for the next sense manager until the pipeline stops.
+  PXCSession* session = quit_ ? session_ : NULL;
+  if (quit_)
+    session_ = NULL;
+
+  base::AutoUnlock unlock(lock_);
+  if (sense_manager) {
+    sense_manager->Close();
+    sense_manager->Release();
+  }
+  if (session)
+    session->Release();
+}
+
+bool Pipeline::CallCanJoinPipeline(Connection* connection) {
+  calling_ = connection;
+  bool can_join;
+  {
+    base::AutoUnlock unlock(lock_);
+    can_join = connection->consumer()->CanJoinPipeline(sense_manager_);
+  }
+  calling_ = NULL;
+  changed_.Broadcast();
+  return can_join;
+}
+
+pxcStatus Pipeline::CallOnConfigurePipeline(Connection* connection,
+                                            PXCSenseManager* sense_manager) {
+  calling_ = connection;
+  pxcStatus status;
+  {
+    base::AutoUnlock unlock(lock_);
+    status = connection->consumer()->OnConfigurePipeline(sense_manager);
+  }
+  calling_ = NULL;
+  changed_.Broadcast();
+  return status;
+}
+
+void Pipeline::CallOnPipelineRestart(Connection* connection) {
+  calling_ = connection;
+  {
+    base::AutoUnlock unlock(lock_);
+    connection->consumer()->OnPipelineRestart();
+  }
+  calling_ = NULL;
+  changed_.Broadcast();
+}
+
+bool Pipeline::FilterDevice(PXCSenseManager* sense_manager) {
+  PXCSession::ImplDesc templat = {};
+  templat.group = PXCSession::IMPL_GROUP_SENSOR;
+  templat.subgroup = PXCSession::IMPL_SUBGROUP_VIDEO_CAPTURE;
+  PXCSession::ImplDesc desc;
+  for (int module_index = 0;
+       session_->QueryImpl(&templat, module_index, &desc) >=
+           PXC_STATUS_NO_ERROR;
+       ++module_index) {
+    PXCCapture* capture;
+    if (session_->CreateImpl<PXCCapture>(&desc, &capture) <
+        PXC_STATUS_NO_ERROR)
+      continue;
+
+    bool found = false;
+    for (int i = 0; i < capture->QueryDeviceNum() && !found; ++i) {
+      PXCCapture::DeviceInfo device_info;
+      if (capture->QueryDeviceInfo(i, &device_info) < PXC_STATUS_NO_ERROR)
+        break;
+      if (device_name_ == base::SysWideToUTF8(device_info.name)) {
+        sense_manager->QueryCaptureManager()->FilterByDeviceInfo(
+            &device_info);
+        found = true;
+      }
+    }
+    capture->Release();
+    if (found)
+      return true;
+  }
+  return false;
+}
+
+CaptureConnection* CaptureServiceImpl::Connect(const char* device_name,
+                                               CaptureConsumer* consumer,
+                                               pxcStatus* status) {
+  std::string name(device_name ? device_name : "");
+  Connection* connection;
+  {
+    base::AutoLock lock(lock_);
+    Pipeline* pipeline = NULL;
+    for (size_t i = 0; i < pipelines_.size() && !pipeline; ++i) {
+      if (pipelines_[i]->MatchesDevice(name))
+        pipeline = pipelines_[i];
+    }
+    if (!pipeline) {
+      pipeline = new Pipeline(name);
+      pipeline->Start();
+      pipelines_.push_back(pipeline);
+    }
+    pipeline->AddUser();
+    connection = pipeline->AddConnection(consumer);
+  }
+
+  *status = connection->pipeline()->WaitForJoin(connection);
+  if (*status < PXC_STATUS_NO_ERROR) {
+    Disconnect(connection);
+    return NULL;
+  }
+  return connection;
+}
+
+void CaptureServiceImpl::Disconnect(Connection* connection) {
+  Pipeline* pipeline = connection->pipeline();
+  // This waits for the capture thread, which may itself wait for a consumer
+  // blocked in Connect(), e.g. during a restart, so |lock_| is not held. The
+  // pipeline stays alive as long as the connection counts as a user.
+  pipeline->RemoveConnection(connection);
+  delete connection;
+  {
+    base::AutoLock lock(lock_);
+    if (!pipeline->RemoveUser())
+      return;
+    pipelines_.erase(std::find(pipelines_.begin(), pipelines_.end(),
+                               pipeline));
+  }
+  // Nobody can find the pipeline any more.
+  pipeline->Stop();
+  delete pipeline;
+}
+
+}  // namespace
+
+// static
+CaptureService* CaptureService::GetInstance() {
+  return g_capture_service.Pointer();
+}
+
+}  // namespace common
+}  // namespace realsense
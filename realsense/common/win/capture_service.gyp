@@ -0,0 +1,29 @@
+# Copyright (c) 2016 Intel Corporation. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'targets': [
+    {
+      'target_name': 'capture_service',
+      'type': 'shared_library',
+      'dependencies':[
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/extensions/third_party/libpxc/libpxc.gyp:libpxc',
+      ],
+      'defines': [
+        'CAPTURE_SERVICE_IMPLEMENTATION',
+      ],
+      'include_dirs': [
+        '../../..',
+      ],
+      'sources': [
+        'capture_service.cc',
+        'capture_service.h',
+        'capture_service_export.h',
+        'shared_session.cc',
+        'shared_session.h',
+      ],
+    },
+  ],
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_WIN_CAPTURE_SERVICE_H_
+#define REALSENSE_COMMON_WIN_CAPTURE_SERVICE_H_
+
+#include "realsense/common/win/capture_service_export.h"
+#include "third_party/libpxc/include/pxcsensemanager.h"
+
+namespace realsense {
+namespace common {
+
+// The capture service runs one PXCSenseManager per camera for the whole
+// process, and lets the objects of several extensions read its frames at the
+// same time. It lives in capture_service.dll, which all the extension DLLs
+// share, so its interface only uses the SDK types and plain virtual classes:
+// each extension DLL has its own copy of base.
+//
+// The modules of all the consumers of a camera are enabled on its sense
+// manager, which the SDK only allows before PXCSenseManager::Init(). When a
+// consumer needs a module or a stream that the running pipeline does not
+// have, the pipeline is restarted with the modules of all its consumers, and
+// the state of the modules, such as the scene perception volume, is lost.
+
+// A frame of a shared pipeline. The consumers waiting for a frame when it is
+// acquired, and the ones asking for a frame while it is held, all get the
+// same frame, which goes back to the camera once all of them released it.
+// The samples and the module outputs are read through the sense manager of
+// the pipeline while the frame is held.
+class CaptureFrame {
+ public:
+  virtual PXCSenseManager* QuerySenseManager() = 0;
+  // Number of the frame in the pipeline, counted from 1.
+  virtual int QueryFrameNumber() = 0;
+  virtual void Release() = 0;
+
+ protected:
+  virtual ~CaptureFrame() {}
+};
+
+// Implemented by the objects reading the frames of a shared pipeline. These
+// are called on the capture thread of the camera, and must return without
+// waiting for the thread of the consumer.
+class CaptureConsumer {
+ public:
+  // Whether the running pipeline of |sense_manager| already has the streams
+  // and the modules of the consumer, which then joins it without a restart.
+  virtual bool CanJoinPipeline(PXCSenseManager* sense_manager) = 0;
+  // Enables the streams and the modules of the consumer on a new sense
+  // manager, before it is initialized. This is called each time the pipeline
+  // is created, so it may only use the settings fixed before Connect().
+  virtual pxcStatus OnConfigurePipeline(PXCSenseManager* sense_manager) = 0;
+  // The pipeline is going to be restarted. The consumer must release, on its
+  // own thread, what it created from the sense manager and then call
+  // CaptureConnection::WaitForRestart(). Until then AcquireFrame() returns
+  // PXC_STATUS_EXEC_ABORTED.
+  virtual void OnPipelineRestart() = 0;
+
+ protected:
+  virtual ~CaptureConsumer() {}
+};
+
+// The subscription of a consumer to the pipeline of a camera, used on the
+// thread of the consumer.
+class CaptureConnection {
+ public:
+  // The sense manager to create the module outputs and configurations from.
+  // It stays valid until WaitForRestart(), and changes when the pipeline
+  // restarts.
+  virtual PXCSenseManager* QuerySenseManager() = 0;
+  // Waits for a frame that the consumer has not seen yet. Returns
+  // PXC_STATUS_EXEC_ABORTED while a restart is pending, and the error of the
+  // camera once the pipeline failed.
+  virtual pxcStatus AcquireFrame(CaptureFrame** frame) = 0;
+  virtual bool IsRestartPending() = 0;
+  // Lets a pending restart go on and waits for it to complete. Returns the
+  // status of the new pipeline; on failure the connection gets no more
+  // frames and should be released.
+  virtual pxcStatus WaitForRestart() = 0;
+  // Unsubscribes the consumer, which is not called any more once this
+  // returns. The frames it acquired must be released before.
+  virtual void Release() = 0;
+
+ protected:
+  virtual ~CaptureConnection() {}
+};
+
+class CAPTURE_SERVICE_EXPORT CaptureService {
+ public:
+  static CaptureService* GetInstance();
+
+  // Subscribes |consumer| to the pipeline of the camera named |device_name|
+  // in UTF-8, or of any camera if it is empty, and starts or restarts the
+  // pipeline as needed. Blocks until the pipeline runs for the consumer.
+  // Returns NULL and the failure in |status| if it could not be set up for
+  // the consumer, in which case the other consumers keep the pipeline.
+  virtual CaptureConnection* Connect(const char* device_name,
+                                     CaptureConsumer* consumer,
+                                     pxcStatus* status) = 0;
+
+ protected:
+  virtual ~CaptureService() {}
+};
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_WIN_CAPTURE_SERVICE_H_
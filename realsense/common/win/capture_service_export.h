@@ -0,0 +1,14 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_WIN_CAPTURE_SERVICE_EXPORT_H_
+#define REALSENSE_COMMON_WIN_CAPTURE_SERVICE_EXPORT_H_
+
+#if defined(CAPTURE_SERVICE_IMPLEMENTATION)
+#define CAPTURE_SERVICE_EXPORT __declspec(dllexport)
+#else
+#define CAPTURE_SERVICE_EXPORT __declspec(dllimport)
+#endif
+
+#endif  // REALSENSE_COMMON_WIN_CAPTURE_SERVICE_EXPORT_H_
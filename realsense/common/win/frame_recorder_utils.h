@@ -0,0 +1,40 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_WIN_FRAME_RECORDER_UTILS_H_
+#define REALSENSE_COMMON_WIN_FRAME_RECORDER_UTILS_H_
+
+#include "realsense/common/frame_recorder.h"
+#include "third_party/libpxc/include/pxcimage.h"
+
+namespace realsense {
+namespace common {
+
+// Appends |image| to |frame| as a FRAME_CHUNK_COLOR chunk of BGRA pixels or a
+// FRAME_CHUNK_DEPTH chunk of 16 bit depth values. Returns false if the image
+// is not readable in that format.
+inline bool AddImageChunk(FrameRecorder::Frame* frame, FrameChunkType type,
+                          PXCImage* image) {
+  const bool depth = type == FRAME_CHUNK_DEPTH;
+  PXCImage::ImageInfo info = image->QueryInfo();
+  PXCImage::ImageData data;
+  if (image->AcquireAccess(PXCImage::ACCESS_READ,
+                           depth ? PXCImage::PIXEL_FORMAT_DEPTH :
+                                   PXCImage::PIXEL_FORMAT_RGB32,
+                           &data) < PXC_STATUS_NO_ERROR) {
+    return false;
+  }
+  frame->AddImage(type,
+                  depth ? FRAME_CHUNK_FORMAT_DEPTH16 :
+                          FRAME_CHUNK_FORMAT_BGRA32,
+                  data.planes[0], data.pitches[0], info.width, info.height,
+                  depth ? 2 : 4, image->QueryTimeStamp());
+  image->ReleaseAccess(&data);
+  return true;
+}
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_WIN_FRAME_RECORDER_UTILS_H_
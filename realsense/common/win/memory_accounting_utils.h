@@ -0,0 +1,43 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_WIN_MEMORY_ACCOUNTING_UTILS_H_
+#define REALSENSE_COMMON_WIN_MEMORY_ACCOUNTING_UTILS_H_
+
+#include "realsense/common/memory_accounting.h"
+#include "third_party/libpxc/include/pxcimage.h"
+
+namespace realsense {
+namespace common {
+
+// Estimated size of the pixels of |image|, which the SDK allocates, or 0 if
+// there is no image.
+inline size_t GetImageFootprint(PXCImage* image) {
+  if (!image)
+    return 0;
+  PXCImage::ImageInfo info = image->QueryInfo();
+  size_t bytes_per_pixel = 0;
+  switch (info.format) {
+    case PXCImage::PIXEL_FORMAT_Y8:
+      bytes_per_pixel = 1;
+      break;
+    case PXCImage::PIXEL_FORMAT_Y16:
+    case PXCImage::PIXEL_FORMAT_DEPTH:
+    case PXCImage::PIXEL_FORMAT_DEPTH_RAW:
+      bytes_per_pixel = 2;
+      break;
+    case PXCImage::PIXEL_FORMAT_RGB24:
+      bytes_per_pixel = 3;
+      break;
+    default:
+      bytes_per_pixel = 4;
+      break;
+  }
+  return static_cast<size_t>(info.width) * info.height * bytes_per_pixel;
+}
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_WIN_MEMORY_ACCOUNTING_UTILS_H_
@@ -0,0 +1,128 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/common/win/shared_session.h"
+
+#include <map>
+#include <string>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/synchronization/lock.h"
+
+namespace realsense {
+namespace common {
+
+namespace {
+
+class SharedSession {
+ public:
+  SharedSession() : session_(NULL), references_(0) {}
+
+  PXCSession* Acquire() {
+    base::AutoLock lock(lock_);
+    if (!session_) {
+      session_ = PXCSession::CreateInstance();
+      if (!session_)
+        return NULL;
+    }
+    references_++;
+    return session_;
+  }
+
+  void Release(PXCSession* session) {
+    if (!session)
+      return;
+    base::AutoLock lock(lock_);
+    DCHECK_EQ(session, session_);
+    DCHECK_GT(references_, 0);
+    if (--references_ > 0)
+      return;
+
+    // The modules go before the session which loaded them.
+    for (ImplMap::iterator it = impls_.begin(); it != impls_.end(); ++it)
+      it->second.base->Release();
+    impls_.clear();
+    session_->Release();
+    session_ = NULL;
+  }
+
+  void* QueryImpl(const PXCSession::ImplDesc& desc, pxcUID cuid) {
+    base::AutoLock lock(lock_);
+    ImplMap::const_iterator it = impls_.find(ImplKey(desc, cuid));
+    return it == impls_.end() ? NULL : it->second.instance;
+  }
+
+  void* AddImpl(const PXCSession::ImplDesc& desc,
+                pxcUID cuid,
+                void* instance,
+                PXCBase* base) {
+    base::AutoLock lock(lock_);
+    DCHECK_GT(references_, 0);
+    std::string key = ImplKey(desc, cuid);
+    ImplMap::const_iterator it = impls_.find(key);
+    if (it != impls_.end()) {
+      base->Release();
+      return it->second.instance;
+    }
+    Impl& impl = impls_[key];
+    impl.instance = instance;
+    impl.base = base;
+    return instance;
+  }
+
+ private:
+  struct Impl {
+    void* instance;
+    PXCBase* base;
+  };
+  typedef std::map<std::string, Impl> ImplMap;
+
+  // The fields which PXCSession::CreateImpl() matches the modules on.
+  static std::string ImplKey(const PXCSession::ImplDesc& desc, pxcUID cuid) {
+    return base::StringPrintf("%d:%d:%d:%d:%d:",
+                              static_cast<int>(desc.group),
+                              static_cast<int>(desc.subgroup),
+                              static_cast<int>(desc.algorithm),
+                              static_cast<int>(desc.iuid),
+                              static_cast<int>(cuid)) +
+        base::WideToUTF8(desc.friendlyName);
+  }
+
+  base::Lock lock_;
+  PXCSession* session_;
+  int references_;
+  ImplMap impls_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedSession);
+};
+
+base::LazyInstance<SharedSession>::Leaky g_shared_session =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+PXCSession* AcquireSharedSession() {
+  return g_shared_session.Get().Acquire();
+}
+
+void ReleaseSharedSession(PXCSession* session) {
+  g_shared_session.Get().Release(session);
+}
+
+void* QuerySharedImpl(const PXCSession::ImplDesc& desc, pxcUID cuid) {
+  return g_shared_session.Get().QueryImpl(desc, cuid);
+}
+
+void* AddSharedImpl(const PXCSession::ImplDesc& desc,
+                    pxcUID cuid,
+                    void* instance,
+                    PXCBase* base) {
+  return g_shared_session.Get().AddImpl(desc, cuid, instance, base);
+}
+
+}  // namespace common
+}  // namespace realsense
@@ -0,0 +1,64 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_COMMON_WIN_SHARED_SESSION_H_
+#define REALSENSE_COMMON_WIN_SHARED_SESSION_H_
+
+#include "realsense/common/win/capture_service_export.h"
+#include "third_party/libpxc/include/pxcsession.h"
+
+namespace realsense {
+namespace common {
+
+// Creating a PXCSession loads the module DLLs of the SDK and enumerates
+// them, which takes tens to hundreds of milliseconds. The extensions of a
+// process share one session instead, created by the first
+// AcquireSharedSession() and released when the last reference is.
+//
+// Like the capture service, this lives in capture_service.dll so that all
+// the extension DLLs see the same session.
+
+// Returns the shared session with a new reference, or NULL if the SDK could
+// not create it. Never call PXCSession::Release() on it.
+CAPTURE_SERVICE_EXPORT PXCSession* AcquireSharedSession();
+
+// Drops a reference returned by AcquireSharedSession(). Accepts NULL.
+CAPTURE_SERVICE_EXPORT void ReleaseSharedSession(PXCSession* session);
+
+// The cached module instance created for |desc| and |cuid|, or NULL.
+CAPTURE_SERVICE_EXPORT void* QuerySharedImpl(const PXCSession::ImplDesc& desc,
+                                             pxcUID cuid);
+
+// Caches |instance|, the |cuid| interface of |base|, for |desc|. Returns the
+// cached instance, which is another one if a thread cached it meanwhile, in
+// which case |base| is released.
+CAPTURE_SERVICE_EXPORT void* AddSharedImpl(const PXCSession::ImplDesc& desc,
+                                           pxcUID cuid,
+                                           void* instance,
+                                           PXCBase* base);
+
+// Like PXCSession::CreateImpl(), but creates the module once per descriptor
+// for the whole process. |session| must be the shared session. The instance
+// is owned by the shared session, and released with it: never call
+// Release() on it.
+template <class T>
+pxcStatus CreateSharedImpl(PXCSession* session,
+                           PXCSession::ImplDesc* desc,
+                           T** instance) {
+  *instance = static_cast<T*>(QuerySharedImpl(*desc, T::CUID));
+  if (*instance)
+    return PXC_STATUS_NO_ERROR;
+
+  T* created = NULL;
+  pxcStatus status = session->CreateImpl<T>(desc, &created);
+  if (status < PXC_STATUS_NO_ERROR)
+    return status;
+  *instance = static_cast<T*>(AddSharedImpl(*desc, T::CUID, created, created));
+  return status;
+}
+
+}  // namespace common
+}  // namespace realsense
+
+#endif  // REALSENSE_COMMON_WIN_SHARED_SESSION_H_
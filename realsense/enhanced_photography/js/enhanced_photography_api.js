@@ -34,6 +34,12 @@ function wrapPhotoReturns(data) {
   return new DepthPhoto(data.objectId);
 }
 
+function wrapPhotosReturns(data) {
+  return data.map(function(photo) {
+    return new DepthPhoto(photo.objectId);
+  });
+}
+
 function wrapRGB32ImageReturns(data) {
   var int32Array = new Int32Array(data, 0, 3);
   // int32Array[0] is the callback id.
@@ -45,6 +51,23 @@ function wrapRGB32ImageReturns(data) {
   return { format: 'rgb32', width: width, height: height, data: buffer };
 }
 
+function wrapRGB32SequenceReturns(data) {
+  var int32Array = new Int32Array(data, 0, 4);
+  // int32Array[0] is the callback id.
+  var frameCount = int32Array[1];
+  var width = int32Array[2];
+  var height = int32Array[3];
+  // 4 int32 (4 bytes) values.
+  var byteOffset = 4 * bytesPerInt32;
+  var frameSize = width * height * bytesPerRGB32Pixel;
+  var frames = [];
+  for (var i = 0; i < frameCount; ++i) {
+    var buffer = new Uint8Array(data, byteOffset + i * frameSize, frameSize);
+    frames.push({ format: 'rgb32', width: width, height: height, data: buffer });
+  }
+  return frames;
+}
+
 function wrapY8ImageReturns(data) {
   // 3 int32 (4 bytes) values.
   var header_byte_offset = 3 * 4;
@@ -67,10 +90,90 @@ function wrapDepthImageReturns(data) {
   return { format: 'depth', width: width, height: height, data: buffer };
 }
 
+function wrapCapturedDepthImageReturns(data) {
+  var int32Array = new Int32Array(data, 0, 3);
+  // int32Array[0] is the callback id.
+  var width = int32Array[1];
+  var height = int32Array[2];
+  // 3 int32 (4 bytes) values, then the depth section.
+  var headerByteOffset = 3 * bytesPerInt32;
+  var depth = depthCodec.readDepthSection(data, headerByteOffset, width, height);
+  return { format: 'depth', width: width, height: height, data: depth.data };
+}
+
+function wrapDepthPreviewReturns(data) {
+  var int32Array = new Int32Array(data, 0, 4);
+  // int32Array[0] is the callback id.
+  var width = int32Array[1];
+  var height = int32Array[2];
+  // 4 int32 (4 bytes) values.
+  var headerByteOffset = 4 * bytesPerInt32;
+  if (int32Array[3] == 1) {
+    var buffer = new Uint8Array(data, headerByteOffset, width * height * bytesPerRGB32Pixel);
+    return { format: 'rgba32', width: width, height: height, data: buffer };
+  }
+  var buffer = new Uint16Array(data, headerByteOffset, width * height);
+  return { format: 'depth', width: width, height: height, data: buffer };
+}
+
+function wrapDepthQualityMapReturns(data) {
+  var int32Array = new Int32Array(data, 0, 6);
+  // int32Array[0] is the callback id.
+  var columns = int32Array[1];
+  var rows = int32Array[2];
+  var binCount = int32Array[4];
+  var float32Array = new Float32Array(data, 6 * bytesPerFloat, 3);
+  // 6 int32 and 3 float (4 bytes) values.
+  var histogramByteOffset = 9 * bytesPerInt32;
+  var tileCount = columns * rows;
+  var mapByteOffset = histogramByteOffset + binCount * bytesPerInt32;
+  return {
+    columns: columns,
+    rows: rows,
+    tileSize: int32Array[3],
+    holeRatio: float32Array[0],
+    edgeDensity: float32Array[1],
+    noise: float32Array[2],
+    histogramBinWidth: int32Array[5],
+    histogram: new Uint32Array(data, histogramByteOffset, binCount),
+    validityMap: new Uint8Array(data, mapByteOffset, tileCount),
+    noiseMap: new Uint8Array(data, mapByteOffset + tileCount, tileCount),
+    edgeMap: new Uint8Array(data, mapByteOffset + 2 * tileCount, tileCount),
+  };
+}
+
 function wrapErrorReturns(error) {
   return new DOMException(error.message, error.name);
 }
 
+// Indexed by the format code of the encoded image results.
+const imageMimeTypes = ['', 'image/jpeg', 'image/png', 'image/webp'];
+
+function wrapEncodedImageReturns(data) {
+  var int32Array = new Int32Array(data, 0, 4);
+  // int32Array[0] is the callback id.
+  // 4 int32 (4 bytes) values.
+  var headerByteOffset = 4 * bytesPerInt32;
+  return new Blob([new Uint8Array(data, headerByteOffset)],
+                  { type: imageMimeTypes[int32Array[3]] });
+}
+
+// Adds a method returning an image, whose argument at |optionsIndex| is an
+// optional ImageEncodingOptions. The encoded images are returned as a Blob,
+// the raw ones are wrapped by |wrapReturns|.
+function addImageMethodWithPromise(target, name, optionsIndex, wrapArgs, wrapReturns) {
+  target._addMethodWithPromise(name, wrapArgs, wrapEncodedImageReturns, wrapErrorReturns);
+  var encoded = target[name];
+  target._addMethodWithPromise(name, wrapArgs, wrapReturns, wrapErrorReturns);
+  var raw = target[name];
+  target[name] = function() {
+    var options = arguments[optionsIndex];
+    if (options && options.format && options.format != 'raw')
+      return encoded.apply(this, arguments);
+    return raw.apply(this, arguments);
+  };
+}
+
 var DepthMask = function(objectId) {
   common.BindingObject.call(this, objectId ? objectId : common.getUniqueId());
   if (objectId == undefined) {
@@ -80,8 +183,9 @@ var DepthMask = function(objectId) {
   }
 
   this._addMethodWithPromise('init', wrapPhotoArgs, null, wrapErrorReturns);
-  this._addMethodWithPromise('computeFromCoordinate', null, wrapF32ImageReturns, wrapErrorReturns);
-  this._addMethodWithPromise('computeFromThreshold', null, wrapF32ImageReturns, wrapErrorReturns);
+  addImageMethodWithPromise(this, 'computeFromCoordinate', 2, null, wrapF32ImageReturns);
+  addImageMethodWithPromise(this, 'computeFromThreshold', 2, null, wrapF32ImageReturns);
+  this._addMethodWithPromise('cancel', null, null, wrapErrorReturns);
 };
 
 DepthMask.prototype = new common.EventTargetPrototype();
@@ -106,9 +210,7 @@ var DepthPhoto = function(objectId) {
     view[0] = args[0].width;
     view[1] = args[0].height;
     var view = new Uint8Array(arrayBuffer, 2 * bytesPerInt32);
-    for (var i = 0; i < args[0].data.length; i++) {
-      view[i] = args[0].data[i];
-    }
+    view.set(args[0].data);
     return arrayBuffer;
   };
 
@@ -121,9 +223,7 @@ var DepthPhoto = function(objectId) {
     view[0] = args[0].width;
     view[1] = args[0].height;
     var view = new Uint16Array(arrayBuffer, 2 * bytesPerInt32);
-    for (var i = 0; i < args[0].data.length; i++) {
-      view[i] = args[0].data[i];
-    }
+    view.set(args[0].data);
     return arrayBuffer;
   };
 
@@ -131,8 +231,8 @@ var DepthPhoto = function(objectId) {
   this._addMethodWithPromise('queryCameraPerspectiveModel', null, null, wrapErrorReturns);
   this._addMethodWithPromise('queryCameraPose', null, null, wrapErrorReturns);
   this._addMethodWithPromise('queryCameraVendorInfo', null, null, wrapErrorReturns);
-  this._addMethodWithPromise('queryContainerImage', null, wrapRGB32ImageReturns, wrapErrorReturns);
-  this._addMethodWithPromise('queryImage', null, wrapRGB32ImageReturns, wrapErrorReturns);
+  addImageMethodWithPromise(this, 'queryContainerImage', 0, null, wrapRGB32ImageReturns);
+  addImageMethodWithPromise(this, 'queryImage', 1, null, wrapRGB32ImageReturns);
   this._addMethodWithPromise('queryDepth', null, wrapDepthImageReturns, wrapErrorReturns);
   this._addMethodWithPromise('queryDeviceVendorInfo', null, null, wrapErrorReturns);
   this._addMethodWithPromise('queryNumberOfCameras', null, null, wrapErrorReturns);
@@ -167,6 +267,8 @@ var DepthRefocus = function(objectId) {
 
   this._addMethodWithPromise('init', wrapPhotoArgs);
   this._addMethodWithPromise('apply', null, wrapPhotoReturns);
+  addImageMethodWithPromise(this, 'applyPreview', 3, null, wrapRGB32ImageReturns);
+  this._addMethodWithPromise('cancel', null, null, wrapErrorReturns);
 };
 
 DepthRefocus.prototype = new common.EventTargetPrototype();
@@ -183,7 +285,44 @@ var Measurement = function(objectId) {
       throw new InitFailureException('Failed to construct Measurement object. Missing dependency');
   }
 
+  function wrapMeasureDistancesArgsToArrayBuffer(args) {
+    var photoId = args[0].photoId;
+    var alignedPhotoIdLen = photoId.length + 4 - photoId.length % 4;
+    var pairs = args[1];
+    if (pairs.length == 0 || pairs.length % 4 != 0)
+      return null;
+    // photoIdLen(int), photoId(string), pairCount(int),
+    // pairs[startX(int) startY(int) endX(int) endY(int)]
+    var length = bytesPerInt32 + alignedPhotoIdLen + bytesPerInt32 + pairs.length * bytesPerInt32;
+    var arrayBuffer = new ArrayBuffer(length);
+    var offset = 0;
+    var view = new Int32Array(arrayBuffer, offset, 1);
+    view[0] = photoId.length;
+    offset += bytesPerInt32;
+
+    view = new Uint8Array(arrayBuffer, offset, photoId.length);
+    for (var i = 0; i < photoId.length; i++) {
+      view[i] = photoId.charCodeAt(i);
+    }
+    offset += alignedPhotoIdLen;
+
+    view = new Int32Array(arrayBuffer, offset);
+    view[0] = pairs.length / 4;
+    view.set(pairs, 1);
+    return arrayBuffer;
+  };
+
+  function wrapMeasureDistancesReturns(data) {
+    var int32Array = new Int32Array(data, 0, 2);
+    // int32Array[0] is the callback id.
+    var count = int32Array[1];
+    // 2 int32 (4 bytes) values, then 8 floats per pair.
+    return new Float32Array(data, 2 * bytesPerInt32, count * 8);
+  };
+
   this._addMethodWithPromise('measureDistance', wrapPhotoArgs, null, wrapErrorReturns);
+  this._addBinaryMethodWithPromise('measureDistances', wrapMeasureDistancesArgsToArrayBuffer,
+                                   wrapMeasureDistancesReturns, wrapErrorReturns);
   // Mark following APIs as experimental according to RSSDK WM6.
   this._addMethodWithPromise('measureUADistance', wrapPhotoArgs, null, wrapErrorReturns, true);
   this._addMethodWithPromise('queryUADataSize', null, null, wrapErrorReturns, true);
@@ -203,7 +342,9 @@ var MotionEffect = function(objectId) {
   }
 
   this._addMethodWithPromise('init', wrapPhotoArgs, null, wrapErrorReturns);
-  this._addMethodWithPromise('apply', null, wrapRGB32ImageReturns, wrapErrorReturns);
+  addImageMethodWithPromise(this, 'apply', 3, null, wrapRGB32ImageReturns);
+  this._addMethodWithPromise('renderSequence', null, wrapRGB32SequenceReturns, wrapErrorReturns);
+  this._addMethodWithPromise('cancel', null, null, wrapErrorReturns);
 };
 
 MotionEffect.prototype = new common.EventTargetPrototype();
@@ -293,6 +434,7 @@ var Paster = function(objectId) {
                                    wrapErrorReturns);
   this._addMethodWithPromise('paste', null, wrapPhotoReturns, wrapErrorReturns);
   this._addMethodWithPromise('previewSticker', null, wrapY8ImageReturns, wrapErrorReturns);
+  this._addMethodWithPromise('cancel', null, null, wrapErrorReturns);
 };
 
 Paster.prototype = new common.EventTargetPrototype();
@@ -335,8 +477,45 @@ var PhotoCapture = function(previewStream, objectId) {
     }
   });
 
-  this._addMethodWithPromise('getDepthImage', null, wrapDepthImageReturns, wrapErrorReturns);
+  this._addMethodWithPromise('getDepthImage', null, wrapCapturedDepthImageReturns, wrapErrorReturns);
   this._addMethodWithPromise('takePhoto', null, wrapPhotoReturns, wrapErrorReturns);
+  this._addMethodWithPromise('takeBurst', null, wrapPhotosReturns, wrapErrorReturns);
+  this._addMethodWithPromise('startDepthPreview', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('stopDepthPreview', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('readDepthPreview', null, wrapDepthPreviewReturns, wrapErrorReturns);
+  this._addMethodWithPromise('startDepthQualityMap', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('stopDepthQualityMap', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('getDepthQualityMap', null, wrapDepthQualityMapReturns, wrapErrorReturns);
+
+  // The next depth frame is read as soon as the previous one arrives, so that
+  // the extension sends each frame once, as soon as it is captured.
+  var startDepthPreview = this.startDepthPreview;
+  var stopDepthPreview = this.stopDepthPreview;
+  var readDepthPreview = this.readDepthPreview;
+  var previewGeneration = 0;
+  this.startDepthPreview = function(options) {
+    var generation = ++previewGeneration;
+    return startDepthPreview.call(that, options).then(function() {
+      function readNext() {
+        if (generation != previewGeneration)
+          return;
+        readDepthPreview.call(that).then(function(image) {
+          if (generation != previewGeneration)
+            return;
+          that.dispatchEvent({ type: 'depthframe', image: image });
+          readNext();
+        }, function(e) {
+          if (e.name != 'AbortError')
+            that.dispatchEvent({ type: 'error', error: e.name, message: e.message });
+        });
+      }
+      readNext();
+    });
+  };
+  this.stopDepthPreview = function() {
+    ++previewGeneration;
+    return stopDepthPreview.call(that);
+  };
 
   var CaptureErrorEvent = function(type, data) {
     // Follow https://developer.mozilla.org/en-US/docs/Web/API/ErrorEvent
@@ -357,6 +536,7 @@ var PhotoCapture = function(previewStream, objectId) {
     }
   };
   this._addEvent('depthquality', DepthQualityEvent);
+  this._addEvent('depthframe');
 
   var result = internal.sendSyncMessage('photoCaptureConstructor', [this._id]);
   if (!result)
@@ -378,9 +558,12 @@ var PhotoUtils = function(objectId) {
   this._addMethodWithPromise('commonFOV', wrapPhotoArgs, wrapPhotoReturns, wrapErrorReturns);
   this._addMethodWithPromise('depthResize', wrapPhotoArgs, wrapPhotoReturns, wrapErrorReturns);
   this._addMethodWithPromise('enhanceDepth', wrapPhotoArgs, wrapPhotoReturns, wrapErrorReturns);
+  this._addMethodWithPromise('executeGraph', wrapPhotoArgs, wrapPhotosReturns, wrapErrorReturns);
   this._addMethodWithPromise('getDepthQuality', wrapPhotoArgs, null, wrapErrorReturns);
   this._addMethodWithPromise('photoCrop', wrapPhotoArgs, wrapPhotoReturns, wrapErrorReturns);
   this._addMethodWithPromise('photoRotate', wrapPhotoArgs, wrapPhotoReturns, wrapErrorReturns);
+  this._addMethodWithPromise('setPhotoMemoryBudget', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('getMemoryStats', null, null, wrapErrorReturns);
 };
 
 PhotoUtils.prototype = new common.EventTargetPrototype();
@@ -489,9 +672,150 @@ var XDMUtils = function(objectId) {
     return blob;
   };
 
+  function readBlob(blob) {
+    return new Promise(function(resolve, reject) {
+      var reader = new FileReader();
+      reader.onload = function(e) {
+        resolve(e.target.result);
+      };
+      reader.onerror = function(e) {
+        reject(new DOMException('Failed to read blob', 'NotReadableError'));
+      };
+      reader.readAsArrayBuffer(blob);
+    });
+  };
+
+  // Returns the size of the JPEG header in |bytes|, up to and including the
+  // SOS segment, which is all the native side parses. If |bytes| ends before,
+  // returns minus the size needed to read the next segment.
+  function getJPEGHeaderSize(bytes) {
+    var offset = 2;
+    while (offset + 4 <= bytes.length) {
+      // Not a JPEG, let the native side reject it.
+      if (bytes[offset] != 0xFF)
+        return offset + 2;
+      var marker = bytes[offset + 1];
+      if (marker == 0xFF) {
+        ++offset;
+        continue;
+      }
+      if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+        offset += 2;
+        continue;
+      }
+      if (marker == 0xD9)
+        return offset + 2;
+      var end = offset + 2 + (bytes[offset + 2] << 8 | bytes[offset + 3]);
+      if (end > bytes.length)
+        return -end;
+      if (marker == 0xDA)
+        return end;
+      offset = end;
+    }
+    return -(offset + 4);
+  };
+
+  // Reads the header of a JPEG blob, rather than the whole file: a prefix of
+  // xdmProbePrefixSize bytes is read first, and is only grown when a segment,
+  // e.g. a large extended XMP, runs past its end.
+  function readBlobHeader(blob) {
+    function read(size) {
+      return readBlob(blob.slice(0, size)).then(function(buffer) {
+        var headerSize = getJPEGHeaderSize(new Uint8Array(buffer));
+        if (headerSize >= 0)
+          return buffer.slice(0, headerSize);
+        if (buffer.byteLength >= blob.size)
+          return buffer;
+        return read(Math.max(-headerSize, size * 2));
+      });
+    };
+    return read(xdmProbePrefixSize);
+  };
+
+  function wrapBlobHeaderArgs(data) {
+    return readBlobHeader(data[0]);
+  };
+
+  // Packs the count, the sizes and the headers of the blobs.
+  function wrapBlobsArgs(data) {
+    return Promise.all(data[0].map(readBlobHeader)).then(function(buffers) {
+      var length = (buffers.length + 1) * bytesPerInt32;
+      buffers.forEach(function(buffer) { length += buffer.byteLength; });
+      var arrayBuffer = new ArrayBuffer(length);
+      var sizes = new Int32Array(arrayBuffer, 0, buffers.length + 1);
+      var bytes = new Uint8Array(arrayBuffer);
+      var offset = sizes.byteLength;
+      sizes[0] = buffers.length;
+      buffers.forEach(function(buffer, i) {
+        sizes[i + 1] = buffer.byteLength;
+        bytes.set(new Uint8Array(buffer), offset);
+        offset += buffer.byteLength;
+      });
+      return arrayBuffer;
+    });
+  };
+
   this._addBinaryMethodWithPromise2('isXDM', wrapBlobArgs, null, wrapErrorReturns);
   this._addBinaryMethodWithPromise2('loadXDM', wrapBlobArgs, wrapPhotoReturns, wrapErrorReturns);
   this._addMethodWithPromise('saveXDM', wrapPhotoArgs, wrapBlobReturns, wrapErrorReturns);
+  this._addBinaryMethodWithPromise2('probeXDM', wrapBlobHeaderArgs, null, wrapErrorReturns);
+  this._addBinaryMethodWithPromise2('probeXDMBatch', wrapBlobsArgs, null, wrapErrorReturns);
+
+  // Index of the probed files, so that a gallery only probes new or
+  // modified files when it is opened again. Blobs which are not files have
+  // no stable identity and are always probed.
+  var xdmIndex = new Map();
+  var xdmProbeChunkSize = 32;
+  // Enough for the header of most XDM files; larger ones are read again.
+  var xdmProbePrefixSize = 256 * 1024;
+  var probeXDMBatch = this.probeXDMBatch;
+
+  function indexKey(blob) {
+    if (!(blob instanceof File))
+      return null;
+    return blob.name + '|' + blob.size + '|' + blob.lastModified;
+  };
+
+  this.probeXDMBatch = function(blobs) {
+    var infos = new Array(blobs.length);
+    var missing = [];
+    blobs.forEach(function(blob, i) {
+      var key = indexKey(blob);
+      if (key && xdmIndex.has(key))
+        infos[i] = xdmIndex.get(key);
+      else
+        missing.push(i);
+    });
+
+    // The files are sent in chunks to bound the size of the messages.
+    var self = this;
+    var done = Promise.resolve();
+    for (var start = 0; start < missing.length; start += xdmProbeChunkSize) {
+      done = done.then(probeChunk.bind(
+          null, missing.slice(start, start + xdmProbeChunkSize)));
+    }
+
+    function probeChunk(indexes) {
+      return probeXDMBatch.call(self, indexes.map(function(i) {
+        return blobs[i];
+      })).then(function(probed) {
+        indexes.forEach(function(index, i) {
+          infos[index] = probed[i];
+          var key = indexKey(blobs[index]);
+          if (key)
+            xdmIndex.set(key, probed[i]);
+        });
+      });
+    };
+
+    return done.then(function() {
+      return infos;
+    });
+  };
+
+  this.clearXDMIndex = function() {
+    xdmIndex.clear();
+  };
 };
 
 XDMUtils.prototype = new common.EventTargetPrototype();
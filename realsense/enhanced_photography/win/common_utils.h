@@ -6,8 +6,10 @@
 #define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_COMMON_UTILS_H_
 
 #include "base/memory/scoped_ptr.h"
+#include "base/values.h"
 // This file is auto-generated by depth_photo.idl
 #include "depth_photo.h" // NOLINT
+#include "realsense/common/memory_accounting.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
 #include "third_party/libpxc/include/pxcphoto.h"
 
@@ -30,9 +32,24 @@ namespace enhanced_photography {
   "The operation failed to execute.", \
   ERROR_NAME_ABORTERROR
 
+// Replaces |binary_message| with the image message of |image|, of |length|
+// bytes, which |memory| accounts for.
 bool CopyImageToBinaryMessage(PXCImage* image,
                               scoped_ptr<uint8[]>& binary_message,  // NOLINT
-                              size_t* length);
+                              size_t* length,
+                              common::MemoryTracker* memory);
+// Copies the pixels of a color image to |rgba|, which must hold
+// width * height * 4 bytes.
+bool CopyColorImageToRGBA(PXCImage* image, uint8* rgba);
+// Parses the image argument of a binary message in place, without copying
+// the pixels. The buffer holds width (int32), height (int32), then
+// width * height pixels of |bytes_per_pixel| bytes. |pixels| points into the
+// arguments of the message and is valid as long as they are.
+bool GetImageFromArgs(base::ListValue* args,
+                      int bytes_per_pixel,
+                      int* width,
+                      int* height,
+                      const uint8** pixels);
 void CreateDepthPhotoObject(EnhancedPhotographyInstance* instance,
                             PXCPhoto* pxcphoto,
                             jsapi::depth_photo::Photo* photo);
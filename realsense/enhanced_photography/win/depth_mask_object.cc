@@ -7,8 +7,10 @@
 #include <string>
 
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
+#include "realsense/enhanced_photography/win/image_encoder.h"
 
 namespace realsense {
 using namespace realsense::common;  // NOLINT
@@ -17,28 +19,35 @@ namespace enhanced_photography {
 DepthMaskObject::DepthMaskObject(EnhancedPhotographyInstance* instance)
     : session_(nullptr),
       instance_(instance),
-      binary_message_size_(0) {
+      sequence_(instance),
+      photo_(nullptr),
+      binary_message_size_(0),
+      binary_message_memory_("DepthMask", "binary_message") {
   handler_.Register("init",
-                    base::Bind(&DepthMaskObject::OnInit,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthMaskObject::OnInit,
+                        base::Unretained(this))));
+  handler_.Register("cancel", sequence_.CancelHandler());
   handler_.Register("computeFromCoordinate",
-      base::Bind(&DepthMaskObject::OnComputeFromCoordinate,
-                 base::Unretained(this)));
+      sequence_.WrapLatest("computeFromCoordinate",
+                           base::Bind(&DepthMaskObject::OnComputeFromCoordinate,
+                                      base::Unretained(this))));
   handler_.Register("computeFromThreshold",
-      base::Bind(&DepthMaskObject::OnComputeFromThreshold,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&DepthMaskObject::OnComputeFromThreshold,
+                                base::Unretained(this))));
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   depth_mask_ = PXCEnhancedPhoto::DepthMask::CreateInstance(session_);
 }
 
 DepthMaskObject::~DepthMaskObject() {
+  sequence_.Flush();
   if (depth_mask_) {
     depth_mask_->Release();
     depth_mask_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -53,17 +62,22 @@ void DepthMaskObject::OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
+
+  depthPhotoObject->PinPhoto();
+  photo_id_.clear();
+  photo_ = nullptr;
   if ((depth_mask_->Init(depthPhotoObject->GetPhoto())) < PXC_STATUS_NO_ERROR) {
     info->PostResult(CreateDOMException("DepthMask Init failed.",
                                         ERROR_NAME_ABORTERROR));
     return;
   }
+  photo_id_ = object_id;
+  photo_ = depthPhotoObject->GetPhoto();
 
   info->PostResult(CreateSuccessResult());
 }
@@ -83,21 +97,35 @@ void DepthMaskObject::OnComputeFromCoordinate(
   point.y = params->point.y;
 
   PXCImage* pxcimage;
-  if (params->params) {
-    PXCEnhancedPhoto::DepthMask::MaskParams mask_params;
-
-    mask_params.frontObjectDepth = params->params->front_object_depth;
-    mask_params.backOjectDepth = params->params->back_object_depth;
-    mask_params.nearFallOffDepth = params->params->near_fall_off_depth;
-    mask_params.farFallOffDepth = params->params->far_fall_off_depth;
-    pxcimage = depth_mask_->ComputeFromCoordinate(point, &mask_params);
-  } else {
-    pxcimage = depth_mask_->ComputeFromCoordinate(point);
+  {
+    ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+    if (!module_photo.valid()) {
+      info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+      return;
+    }
+    if (params->params) {
+      PXCEnhancedPhoto::DepthMask::MaskParams mask_params;
+
+      mask_params.frontObjectDepth = params->params->front_object_depth;
+      mask_params.backOjectDepth = params->params->back_object_depth;
+      mask_params.nearFallOffDepth = params->params->near_fall_off_depth;
+      mask_params.farFallOffDepth = params->params->far_fall_off_depth;
+      pxcimage = depth_mask_->ComputeFromCoordinate(point, &mask_params);
+    } else {
+      pxcimage = depth_mask_->ComputeFromCoordinate(point);
+    }
   }
 
+  if (IsImageEncodingRequested(params->encoding)) {
+    PostEncodedImage(pxcimage, *params->encoding, info.Pass());
+    if (pxcimage)
+      pxcimage->Release();
+    return;
+  }
   if (!CopyImageToBinaryMessage(pxcimage,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -122,21 +150,35 @@ void DepthMaskObject::OnComputeFromThreshold(
 
   DCHECK(depth_mask_);
   PXCImage* pxcimage;
-  if (params->params) {
-    PXCEnhancedPhoto::DepthMask::MaskParams mask_params;
-    mask_params.frontObjectDepth = params->params->front_object_depth;
-    mask_params.backOjectDepth = params->params->back_object_depth;
-    mask_params.nearFallOffDepth = params->params->near_fall_off_depth;
-    mask_params.farFallOffDepth = params->params->far_fall_off_depth;
-    pxcimage = depth_mask_->ComputeFromThreshold(params->threshold,
-                                                 &mask_params);
-  } else {
-    pxcimage = depth_mask_->ComputeFromThreshold(params->threshold);
+  {
+    ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+    if (!module_photo.valid()) {
+      info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+      return;
+    }
+    if (params->params) {
+      PXCEnhancedPhoto::DepthMask::MaskParams mask_params;
+      mask_params.frontObjectDepth = params->params->front_object_depth;
+      mask_params.backOjectDepth = params->params->back_object_depth;
+      mask_params.nearFallOffDepth = params->params->near_fall_off_depth;
+      mask_params.farFallOffDepth = params->params->far_fall_off_depth;
+      pxcimage = depth_mask_->ComputeFromThreshold(params->threshold,
+                                                   &mask_params);
+    } else {
+      pxcimage = depth_mask_->ComputeFromThreshold(params->threshold);
+    }
   }
 
+  if (IsImageEncodingRequested(params->encoding)) {
+    PostEncodedImage(pxcimage, *params->encoding, info.Pass());
+    if (pxcimage)
+      pxcimage->Release();
+    return;
+  }
   if (!CopyImageToBinaryMessage(pxcimage,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -8,8 +8,13 @@
 // This file is auto-generated by depth_mask.idl
 #include "depth_mask.h" // NOLINT
 
+#include <string>
+
+#include "realsense/common/memory_accounting.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
+#include "third_party/libpxc/include/pxcphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 
 namespace realsense {
@@ -29,10 +34,16 @@ class DepthMaskObject : public xwalk::common::BindingObject {
   void OnComputeFromThreshold(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
   PXCSession* session_;
   PXCEnhancedPhoto::DepthMask* depth_mask_;
+  // The photo passed to init(), which |depth_mask_| reads under a
+  // ScopedModulePhoto.
+  std::string photo_id_;
+  PXCPhoto* photo_;
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
 };
 
 }  // namespace enhanced_photography
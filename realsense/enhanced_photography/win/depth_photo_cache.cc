@@ -0,0 +1,306 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/depth_photo_cache.h"
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "realsense/enhanced_photography/win/depth_photo_object.h"
+#include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+namespace {
+
+const size_t kDefaultBudget = 1024 * 1024 * 1024;
+
+const base::FilePath::CharType kXDMExtension[] = FILE_PATH_LITERAL("jpg");
+const base::FilePath::CharType kPlanesExtension[] = FILE_PATH_LITERAL("raw");
+
+int GetBytesPerPixel(PXCImage::PixelFormat format) {
+  switch (format) {
+    case PXCImage::PIXEL_FORMAT_Y8:
+      return 1;
+    case PXCImage::PIXEL_FORMAT_Y16:
+    case PXCImage::PIXEL_FORMAT_DEPTH:
+    case PXCImage::PIXEL_FORMAT_DEPTH_RAW:
+      return 2;
+    case PXCImage::PIXEL_FORMAT_RGB24:
+      return 3;
+    case PXCImage::PIXEL_FORMAT_RGB32:
+    case PXCImage::PIXEL_FORMAT_DEPTH_F32:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+// The planes XDM stores lossy or not at all, in the order they are written
+// to the spill file.
+void GetPhotoImages(PXCPhoto* photo, PXCImage* images[4]) {
+  images[0] = photo->QueryContainerImage();
+  images[1] = photo->QueryImage();
+  images[2] = photo->QueryDepth();
+  images[3] = photo->QueryRawDepth();
+}
+
+// Spill file layout, for each image: width, height and format (int32), then
+// the rows without padding.
+bool WriteImage(PXCImage* image, base::File* file) {
+  int header[3] = { 0, 0, 0 };
+  PXCImage::ImageInfo info = {};
+  if (image) {
+    info = image->QueryInfo();
+    header[0] = info.width;
+    header[1] = info.height;
+    header[2] = info.format;
+  }
+  const int row_size = info.width * GetBytesPerPixel(info.format);
+  if (row_size == 0)
+    header[0] = header[1] = 0;
+  if (file->WriteAtCurrentPos(reinterpret_cast<const char*>(header),
+                              sizeof(header)) != sizeof(header))
+    return false;
+  if (row_size == 0)
+    return true;
+
+  PXCImage::ImageData data;
+  if (image->AcquireAccess(PXCImage::ACCESS_READ, info.format, &data) <
+      PXC_STATUS_NO_ERROR)
+    return false;
+  bool success = true;
+  for (int y = 0; y < info.height && success; ++y) {
+    success = file->WriteAtCurrentPos(
+        reinterpret_cast<const char*>(data.planes[0] + data.pitches[0] * y),
+        row_size) == row_size;
+  }
+  image->ReleaseAccess(&data);
+  return success;
+}
+
+bool ReadImage(base::File* file, PXCImage* image) {
+  int header[3];
+  if (file->ReadAtCurrentPos(reinterpret_cast<char*>(header),
+                             sizeof(header)) != sizeof(header))
+    return false;
+  const int row_size =
+      header[0] * GetBytesPerPixel(static_cast<PXCImage::PixelFormat>(
+          header[2]));
+  if (row_size == 0)
+    return true;
+
+  // The image loaded from the XDM file has the same geometry, only its
+  // pixels may differ.
+  if (!image)
+    return false;
+  PXCImage::ImageInfo info = image->QueryInfo();
+  if (info.width != header[0] || info.height != header[1] ||
+      info.format != header[2])
+    return false;
+
+  PXCImage::ImageData data;
+  if (image->AcquireAccess(PXCImage::ACCESS_WRITE, info.format, &data) <
+      PXC_STATUS_NO_ERROR)
+    return false;
+  bool success = true;
+  for (int y = 0; y < info.height && success; ++y) {
+    success = file->ReadAtCurrentPos(
+        reinterpret_cast<char*>(data.planes[0] + data.pitches[0] * y),
+        row_size) == row_size;
+  }
+  image->ReleaseAccess(&data);
+  return success;
+}
+
+}  // namespace
+
+DepthPhotoCache::DepthPhotoCache(EnhancedPhotographyInstance* instance)
+    : task_runner_(instance->CreateSequencedTaskRunner()),
+      resident_size_(0),
+      resident_memory_("DepthPhoto", "resident_photos"),
+      budget_(kDefaultBudget),
+      eviction_pending_(false) {
+}
+
+DepthPhotoCache::~DepthPhotoCache() {
+  DCHECK(entries_.empty());
+}
+
+void DepthPhotoCache::SetBudget(size_t bytes) {
+  base::AutoLock lock(lock_);
+  budget_ = bytes;
+  EvictIfNeededLocked();
+}
+
+void DepthPhotoCache::Touch(DepthPhotoObject* obj, size_t footprint) {
+  base::AutoLock lock(lock_);
+  std::map<DepthPhotoObject*, Entry>::iterator it = entries_.find(obj);
+  if (it == entries_.end()) {
+    lru_.push_front(obj);
+    Entry entry = { lru_.begin(), footprint };
+    entries_[obj] = entry;
+  } else {
+    lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+    resident_size_ -= it->second.footprint;
+    it->second.footprint = footprint;
+  }
+  resident_size_ += footprint;
+  resident_memory_.SetBuffers(static_cast<int>(entries_.size()),
+                              resident_size_);
+  EvictIfNeededLocked();
+}
+
+void DepthPhotoCache::Remove(DepthPhotoObject* obj) {
+  base::AutoLock lock(lock_);
+  RemoveLocked(obj);
+}
+
+void DepthPhotoCache::RemoveLocked(DepthPhotoObject* obj) {
+  lock_.AssertAcquired();
+  std::map<DepthPhotoObject*, Entry>::iterator it = entries_.find(obj);
+  if (it == entries_.end())
+    return;
+  resident_size_ -= it->second.footprint;
+  lru_.erase(it->second.lru_position);
+  entries_.erase(it);
+  resident_memory_.SetBuffers(static_cast<int>(entries_.size()),
+                              resident_size_);
+}
+
+void DepthPhotoCache::EvictIfNeededLocked() {
+  lock_.AssertAcquired();
+  if (eviction_pending_ || budget_ == 0 || resident_size_ <= budget_)
+    return;
+  // The photos are spilled from another sequence, which holds no photo lock,
+  // so that the photo being touched is never spilled under its user.
+  eviction_pending_ = task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&DepthPhotoCache::Evict, base::Unretained(this)));
+}
+
+void DepthPhotoCache::Evict() {
+  if (!spill_dir_.IsValid() && !spill_dir_.CreateUniqueTempDir()) {
+    base::AutoLock lock(lock_);
+    eviction_pending_ = false;
+    return;
+  }
+
+  // The photos which failed to spill in this round.
+  size_t failures = 0;
+  for (;;) {
+    DepthPhotoObject* victim = nullptr;
+    {
+      base::AutoLock lock(lock_);
+      if (budget_ == 0 || resident_size_ <= budget_ ||
+          failures >= entries_.size()) {
+        eviction_pending_ = false;
+        return;
+      }
+      // Photos which are in use are not worth spilling, and pinned or
+      // shared ones would stay in memory.
+      for (LRUList::reverse_iterator it = lru_.rbegin(); it != lru_.rend();
+           ++it) {
+        if (!(*it)->photo_lock().Try())
+          continue;
+        if ((*it)->CanSpill()) {
+          victim = *it;
+          break;
+        }
+        (*it)->photo_lock().Release();
+      }
+      if (!victim) {
+        eviction_pending_ = false;
+        return;
+      }
+    }
+
+    // The destructor of |victim| takes its photo lock before destroying the
+    // photo, so it stays alive until the lock is released. The photo stays
+    // accounted for until it is actually released.
+    bool spilled = victim->Spill(spill_dir_.path());
+    {
+      base::AutoLock lock(lock_);
+      if (spilled) {
+        RemoveLocked(victim);
+      } else {
+        // Tries the other photos before this one again.
+        ++failures;
+        std::map<DepthPhotoObject*, Entry>::iterator it =
+            entries_.find(victim);
+        if (it != entries_.end())
+          lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+      }
+    }
+    victim->photo_lock().Release();
+  }
+}
+
+size_t GetPhotoFootprint(PXCPhoto* photo) {
+  PXCImage* images[4];
+  GetPhotoImages(photo, images);
+  size_t footprint = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (!images[i])
+      continue;
+    PXCImage::ImageInfo info = images[i]->QueryInfo();
+    footprint += static_cast<size_t>(info.width) * info.height *
+                 GetBytesPerPixel(info.format);
+  }
+  return footprint;
+}
+
+bool SpillPhoto(PXCPhoto* photo, const base::FilePath& path) {
+  base::FilePath xdm_path = path.AddExtension(kXDMExtension);
+  if (photo->SaveXDM(const_cast<wchar_t*>(xdm_path.value().c_str())) <
+      PXC_STATUS_NO_ERROR)
+    return false;
+
+  base::File file(path.AddExtension(kPlanesExtension),
+                  base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
+  PXCImage* images[4];
+  GetPhotoImages(photo, images);
+  bool success = file.IsValid();
+  for (int i = 0; i < 4 && success; ++i)
+    success = WriteImage(images[i], &file);
+  file.Close();
+
+  if (!success)
+    DeleteSpilledPhoto(path);
+  return success;
+}
+
+PXCPhoto* FaultInPhoto(PXCSession* session, const base::FilePath& path) {
+  base::FilePath xdm_path = path.AddExtension(kXDMExtension);
+  PXCPhoto* photo = session->CreatePhoto();
+  if (!photo)
+    return nullptr;
+  if (photo->LoadXDM(const_cast<wchar_t*>(xdm_path.value().c_str())) <
+      PXC_STATUS_NO_ERROR) {
+    photo->Release();
+    return nullptr;
+  }
+
+  base::File file(path.AddExtension(kPlanesExtension),
+                  base::File::FLAG_OPEN | base::File::FLAG_READ);
+  PXCImage* images[4];
+  GetPhotoImages(photo, images);
+  bool success = file.IsValid();
+  for (int i = 0; i < 4 && success; ++i)
+    success = ReadImage(&file, images[i]);
+  if (!success) {
+    photo->Release();
+    return nullptr;
+  }
+  return photo;
+}
+
+void DeleteSpilledPhoto(const base::FilePath& path) {
+  base::DeleteFile(path.AddExtension(kXDMExtension), false);
+  base::DeleteFile(path.AddExtension(kPlanesExtension), false);
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
@@ -0,0 +1,86 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_PHOTO_CACHE_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_PHOTO_CACHE_H_
+
+#include <list>
+#include <map>
+
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequenced_task_runner.h"
+#include "base/synchronization/lock.h"
+#include "realsense/common/memory_accounting.h"
+#include "third_party/libpxc/include/pxcphoto.h"
+#include "third_party/libpxc/include/pxcsession.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+class DepthPhotoObject;
+class EnhancedPhotographyInstance;
+
+// Keeps the resident photos of the DepthPhotoObjects within a memory budget.
+// When the budget is exceeded, the least recently used photos are spilled to
+// disk on a sequence of the worker pool, and DepthPhotoObject::GetPhoto()
+// faults them back in on their next access.
+class DepthPhotoCache {
+ public:
+  explicit DepthPhotoCache(EnhancedPhotographyInstance* instance);
+  ~DepthPhotoCache();
+
+  // A budget of 0 disables spilling.
+  void SetBudget(size_t bytes);
+
+  // Marks the photo of |obj| as the most recently used one, using |footprint|
+  // bytes. Must be called with the photo lock of |obj| held.
+  void Touch(DepthPhotoObject* obj, size_t footprint);
+  // Forgets |obj|, which must not be used by the cache once this returns.
+  void Remove(DepthPhotoObject* obj);
+
+ private:
+  typedef std::list<DepthPhotoObject*> LRUList;
+  struct Entry {
+    LRUList::iterator lru_position;
+    size_t footprint;
+  };
+
+  void RemoveLocked(DepthPhotoObject* obj);
+  void EvictIfNeededLocked();
+  void Evict();
+
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  base::Lock lock_;
+  // Most recently used first.
+  LRUList lru_;
+  std::map<DepthPhotoObject*, Entry> entries_;
+  size_t resident_size_;
+  // Accounts for the resident photos, updated with |resident_size_|.
+  realsense::common::MemoryTracker resident_memory_;
+  size_t budget_;
+  bool eviction_pending_;
+
+  // Only used on |task_runner_|.
+  base::ScopedTempDir spill_dir_;
+
+  DISALLOW_COPY_AND_ASSIGN(DepthPhotoCache);
+};
+
+// Estimated size of the image planes of |photo|.
+size_t GetPhotoFootprint(PXCPhoto* photo);
+
+// Writes |photo| to |path| as XDM, and its image planes alongside, as the XDM
+// encoding of the color images is lossy.
+bool SpillPhoto(PXCPhoto* photo, const base::FilePath& path);
+// Reads back a photo written by SpillPhoto(), returns nullptr on failure.
+PXCPhoto* FaultInPhoto(PXCSession* session, const base::FilePath& path);
+void DeleteSpilledPhoto(const base::FilePath& path);
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_PHOTO_CACHE_H_
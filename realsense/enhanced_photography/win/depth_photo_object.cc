@@ -4,95 +4,235 @@
 
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
 
+#include <cstring>
 #include <string>
-#include <vector>
 
 #include "base/bind.h"
 #include "base/guid.h"
 #include "base/strings/sys_string_conversions.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
+#include "realsense/enhanced_photography/win/depth_photo_cache.h"
+#include "realsense/enhanced_photography/win/image_encoder.h"
 
 namespace realsense {
 using namespace realsense::common;  // NOLINT
 namespace enhanced_photography {
 
+SharedPhoto::SharedPhoto(PXCPhoto* photo)
+    : photo_(photo),
+      sharers_(0) {
+}
+
+SharedPhoto::~SharedPhoto() {
+  if (photo_)
+    photo_->Release();
+}
+
 DepthPhotoObject::DepthPhotoObject(EnhancedPhotographyInstance* instance)
-    : instance_(instance),
-      binary_message_size_(0) {
+    : photo_(nullptr),
+      instance_(instance),
+      sequence_(instance),
+      pinned_(false),
+      binary_message_size_(0),
+      binary_message_memory_("DepthPhoto", "binary_message") {
   handler_.Register("checkSignature",
-                    base::Bind(&DepthPhotoObject::OnCheckSignature,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnCheckSignature,
+                        base::Unretained(this))));
   handler_.Register("queryCameraPerspectiveModel",
-                    base::Bind(&DepthPhotoObject::OnQueryCameraPerspectiveModel,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryCameraPerspectiveModel,
+                        base::Unretained(this))));
   handler_.Register("queryCameraPose",
-                    base::Bind(&DepthPhotoObject::OnQueryCameraPose,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryCameraPose,
+                        base::Unretained(this))));
   handler_.Register("queryCameraVendorInfo",
-                    base::Bind(&DepthPhotoObject::OnQueryCameraVendorInfo,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryCameraVendorInfo,
+                        base::Unretained(this))));
   handler_.Register("queryContainerImage",
-                    base::Bind(&DepthPhotoObject::OnQueryContainerImage,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryContainerImage,
+                        base::Unretained(this))));
   handler_.Register("queryImage",
-                    base::Bind(&DepthPhotoObject::OnQueryImage,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryImage,
+                        base::Unretained(this))));
   handler_.Register("queryDepth",
-                    base::Bind(&DepthPhotoObject::OnQueryDepth,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryDepth,
+                        base::Unretained(this))));
   handler_.Register("queryDeviceVendorInfo",
-                    base::Bind(&DepthPhotoObject::OnQueryDeviceVendorInfo,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryDeviceVendorInfo,
+                        base::Unretained(this))));
   handler_.Register("queryNumberOfCameras",
-                    base::Bind(&DepthPhotoObject::OnQueryNumberOfCameras,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryNumberOfCameras,
+                        base::Unretained(this))));
   handler_.Register("queryRawDepth",
-                    base::Bind(&DepthPhotoObject::OnQueryRawDepth,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryRawDepth,
+                        base::Unretained(this))));
   handler_.Register("queryXDMRevision",
-                    base::Bind(&DepthPhotoObject::OnQueryXDMRevision,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnQueryXDMRevision,
+                        base::Unretained(this))));
   handler_.Register("resetContainerImage",
-                    base::Bind(&DepthPhotoObject::OnResetContainerImage,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnResetContainerImage,
+                        base::Unretained(this))));
   handler_.Register("setContainerImage",
-                    base::Bind(&DepthPhotoObject::OnSetContainerImage,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnSetContainerImage,
+                        base::Unretained(this))));
   handler_.Register("setColorImage",
-                    base::Bind(&DepthPhotoObject::OnSetColorImage,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnSetColorImage,
+                        base::Unretained(this))));
   handler_.Register("setDepthImage",
-                    base::Bind(&DepthPhotoObject::OnSetDepthImage,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnSetDepthImage,
+                        base::Unretained(this))));
   handler_.Register("setRawDepthImage",
-                    base::Bind(&DepthPhotoObject::OnSetRawDepthImage,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnSetRawDepthImage,
+                        base::Unretained(this))));
   handler_.Register("clone",
-                    base::Bind(&DepthPhotoObject::OnClone,
-                               base::Unretained(this)));
-  session_ = PXCSession::CreateInstance();
-  photo_ = session_->CreatePhoto();
+                    sequence_.Wrap(base::Bind(
+                        &DepthPhotoObject::OnClone,
+                        base::Unretained(this))));
+  session_ = AcquireSharedSession();
+  PXCPhoto* photo = session_->CreatePhoto();
+  ResetPhoto(make_scoped_refptr(photo ? new SharedPhoto(photo) : nullptr));
 }
 
 DepthPhotoObject::~DepthPhotoObject() {
+  sequence_.Flush();
+  instance_->RemoveDepthPhoto(this);
+  instance_->photo_cache()->Remove(this);
+  // Waits for a spill in progress.
+  base::AutoLock lock(photo_lock_);
   DestroyPhoto();
 }
 
-void DepthPhotoObject::DestroyPhoto() {
+PXCPhoto* DepthPhotoObject::GetPhoto() {
+  photo_lock_.AssertAcquired();
+  if (!photo_ && !spill_path_.empty() && session_) {
+    PXCPhoto* photo = FaultInPhoto(session_, spill_path_);
+    if (photo) {
+      ResetPhoto(make_scoped_refptr(new SharedPhoto(photo)));
+      DeleteSpilledPhoto(spill_path_);
+      spill_path_.clear();
+    }
+  }
+  // The footprint of a shared photo is split between its sharers.
   if (photo_) {
-    photo_->Release();
-    photo_ = nullptr;
+    instance_->photo_cache()->Touch(
+        this, GetPhotoFootprint(photo_) / shared_photo_->sharers());
+  }
+  return photo_;
+}
+
+PXCPhoto* DepthPhotoObject::GetWritablePhoto() {
+  if (!GetPhoto())
+    return nullptr;
+  if (shared_photo_->sharers() > 1) {
+    PXCPhoto* copy = session_->CreatePhoto();
+    if (!copy)
+      return nullptr;
+    copy->CopyPhoto(photo_);
+    ResetPhoto(make_scoped_refptr(new SharedPhoto(copy)));
+    instance_->photo_cache()->Touch(this, GetPhotoFootprint(photo_));
+  }
+  return photo_;
+}
+
+void DepthPhotoObject::SetPhoto(PXCPhoto* photo) {
+  base::AutoLock lock(photo_lock_);
+  ResetPhoto(make_scoped_refptr(photo ? new SharedPhoto(photo) : nullptr));
+  if (photo_)
+    instance_->photo_cache()->Touch(this, GetPhotoFootprint(photo_));
+}
+
+void DepthPhotoObject::SharePhoto(const scoped_refptr<SharedPhoto>& photo) {
+  base::AutoLock lock(photo_lock_);
+  ResetPhoto(photo);
+  if (photo_) {
+    instance_->photo_cache()->Touch(
+        this, GetPhotoFootprint(photo_) / shared_photo_->sharers());
+  }
+}
+
+scoped_refptr<SharedPhoto> DepthPhotoObject::SnapshotPhoto() {
+  if (!GetPhoto())
+    return nullptr;
+  scoped_refptr<SharedPhoto> snapshot = shared_photo_;
+  // A pinned photo is written in place, so the task gets a copy.
+  if (pinned_) {
+    PXCPhoto* copy = session_->CreatePhoto();
+    if (!copy)
+      return nullptr;
+    copy->CopyPhoto(photo_);
+    snapshot = new SharedPhoto(copy);
+  }
+  snapshot->AddSharer();
+  return snapshot;
+}
+
+void DepthPhotoObject::ResetPhoto(const scoped_refptr<SharedPhoto>& photo) {
+  if (shared_photo_)
+    shared_photo_->RemoveSharer();
+  shared_photo_ = photo;
+  photo_ = nullptr;
+  if (shared_photo_) {
+    shared_photo_->AddSharer();
+    photo_ = shared_photo_->get();
+  }
+}
+
+void DepthPhotoObject::PinPhoto() {
+  GetWritablePhoto();
+  pinned_ = true;
+}
+
+void DepthPhotoObject::DestroyPhoto() {
+  ResetPhoto(nullptr);
+  if (!spill_path_.empty()) {
+    DeleteSpilledPhoto(spill_path_);
+    spill_path_.clear();
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
 
+bool DepthPhotoObject::CanSpill() const {
+  photo_lock_.AssertAcquired();
+  // Spilling a shared photo would not free it.
+  return photo_ && !pinned_ && shared_photo_->sharers() == 1;
+}
+
+bool DepthPhotoObject::Spill(const base::FilePath& dir) {
+  if (!CanSpill())
+    return false;
+
+  base::FilePath path = dir.AppendASCII(base::GenerateGUID());
+  if (!SpillPhoto(photo_, path))
+    return false;
+  ResetPhoto(nullptr);
+  spill_path_ = path;
+  return true;
+}
+
 void DepthPhotoObject::OnCheckSignature(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -103,7 +243,8 @@ void DepthPhotoObject::OnCheckSignature(
 
 void DepthPhotoObject::OnQueryCameraPerspectiveModel(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -135,7 +276,8 @@ void DepthPhotoObject::OnQueryCameraPerspectiveModel(
 
 void DepthPhotoObject::OnQueryCameraPose(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -164,7 +306,8 @@ void DepthPhotoObject::OnQueryCameraPose(
 
 void DepthPhotoObject::OnQueryCameraVendorInfo(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -188,16 +331,29 @@ void DepthPhotoObject::OnQueryCameraVendorInfo(
 
 void DepthPhotoObject::OnQueryContainerImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  base::AutoLock lock(photo_lock_);
   jsapi::depth_photo::Image img;
-  if (!photo_) {
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
+  scoped_ptr<QueryContainerImage::Params> params(
+      QueryContainerImage::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
   PXCImage* imColor = photo_->QueryContainerImage();
+  if (IsImageEncodingRequested(params->encoding)) {
+    PostEncodedImage(imColor, *params->encoding, info.Pass());
+    return;
+  }
   if (!CopyImageToBinaryMessage(imColor,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -211,8 +367,9 @@ void DepthPhotoObject::OnQueryContainerImage(
 
 void DepthPhotoObject::OnQueryImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  base::AutoLock lock(photo_lock_);
   jsapi::depth_photo::Image img;
-  if (!photo_) {
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -229,9 +386,14 @@ void DepthPhotoObject::OnQueryImage(
     imColor = photo_->QueryImage(*(params->camera_index.get()));
   else
     imColor = photo_->QueryImage();
+  if (IsImageEncodingRequested(params->encoding)) {
+    PostEncodedImage(imColor, *params->encoding, info.Pass());
+    return;
+  }
   if (!CopyImageToBinaryMessage(imColor,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -245,8 +407,9 @@ void DepthPhotoObject::OnQueryImage(
 
 void DepthPhotoObject::OnQueryDepth(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  base::AutoLock lock(photo_lock_);
   jsapi::depth_photo::Image img;
-  if (!photo_) {
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -265,7 +428,8 @@ void DepthPhotoObject::OnQueryDepth(
     imDepth = photo_->QueryDepth();
   if (!CopyImageToBinaryMessage(imDepth,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -279,7 +443,8 @@ void DepthPhotoObject::OnQueryDepth(
 
 void DepthPhotoObject::OnQueryDeviceVendorInfo(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -296,7 +461,8 @@ void DepthPhotoObject::OnQueryDeviceVendorInfo(
 
 void DepthPhotoObject::OnQueryNumberOfCameras(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -308,8 +474,9 @@ void DepthPhotoObject::OnQueryNumberOfCameras(
 
 void DepthPhotoObject::OnQueryRawDepth(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  base::AutoLock lock(photo_lock_);
   jsapi::depth_photo::Image img;
-  if (!photo_) {
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -317,7 +484,8 @@ void DepthPhotoObject::OnQueryRawDepth(
   PXCImage* imDepth = photo_->QueryRawDepth();
   if (!CopyImageToBinaryMessage(imDepth,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -331,7 +499,8 @@ void DepthPhotoObject::OnQueryRawDepth(
 
 void DepthPhotoObject::OnQueryXDMRevision(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -343,36 +512,38 @@ void DepthPhotoObject::OnQueryXDMRevision(
 
 void DepthPhotoObject::OnResetContainerImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
+  // Shared photos are copied here, so this can only fail to copy it.
+  if (!GetWritablePhoto()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
   photo_->ResetContainerImage();
   info->PostResult(CreateSuccessResult());
 }
 
 void DepthPhotoObject::OnSetContainerImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
-  scoped_ptr<SetContainerImage::Params> params(
-      SetContainerImage::Params::Create(*info->arguments()));
-  if (!params) {
+  int width = 0;
+  int height = 0;
+  const uint8* image_data = nullptr;
+  if (!GetImageFromArgs(info->arguments(), 4, &width, &height,
+                        &image_data)) {
     info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
     return;
   }
 
-  std::vector<char> buffer = params->image;
-  char* data = &buffer[0];
-  int* int_array = reinterpret_cast<int*>(data);
-  int width = int_array[0];
-  int height = int_array[1];
-  char* image_data = data + 2 * sizeof(int);
-
   PXCImage* out = photo_->QueryContainerImage();
   if (!out) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
@@ -384,6 +555,18 @@ void DepthPhotoObject::OnSetContainerImage(
     return;
   }
 
+  // A shared photo is copied only once the call is known to write to it,
+  // so this can only fail to copy it.
+  if (!GetWritablePhoto()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  out = photo_->QueryContainerImage();
+  if (!out) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
   PXCImage::ImageData outData;
   pxcStatus photoSts = out->AcquireAccess(PXCImage::ACCESS_READ_WRITE,
                                           PXCImage::PIXEL_FORMAT_RGB24,
@@ -393,13 +576,14 @@ void DepthPhotoObject::OnSetContainerImage(
     return;
   }
 
+  // RGBA to BGR, straight into the image plane.
   for (int y = 0; y < outInfo.height; y++) {
-    for (int x = 0; x < outInfo.width; x++) {
-      int i = x * 3 + outData.pitches[0] * y;
-      int k = x * 4 + outInfo.width * 4 * y;
-      outData.planes[0][i] = image_data[k + 2];
-      outData.planes[0][i + 1] = image_data[k + 1];
-      outData.planes[0][i + 2] = image_data[k];
+    const uint8* src = image_data + outInfo.width * 4 * y;
+    uint8* dst = outData.planes[0] + outData.pitches[0] * y;
+    for (int x = 0; x < outInfo.width; x++, src += 4, dst += 3) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
     }
   }
   out->ReleaseAccess(&outData);
@@ -409,25 +593,21 @@ void DepthPhotoObject::OnSetContainerImage(
 
 void DepthPhotoObject::OnSetColorImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
-  scoped_ptr<SetColorImage::Params> params(
-      SetColorImage::Params::Create(*info->arguments()));
-  if (!params) {
+  int width = 0;
+  int height = 0;
+  const uint8* image_data = nullptr;
+  if (!GetImageFromArgs(info->arguments(), 4, &width, &height,
+                        &image_data)) {
     info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
     return;
   }
 
-  std::vector<char> buffer = params->image;
-  char* data = &buffer[0];
-  int* int_array = reinterpret_cast<int*>(data);
-  int width = int_array[0];
-  int height = int_array[1];
-  char* image_data = data + 2 * sizeof(int);
-
   PXCImage* out = photo_->QueryImage();
   if (!out) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
@@ -439,6 +619,18 @@ void DepthPhotoObject::OnSetColorImage(
     return;
   }
 
+  // A shared photo is copied only once the call is known to write to it,
+  // so this can only fail to copy it.
+  if (!GetWritablePhoto()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  out = photo_->QueryImage();
+  if (!out) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
   PXCImage::ImageData outData;
   pxcStatus photoSts = out->AcquireAccess(PXCImage::ACCESS_READ_WRITE,
                                           PXCImage::PIXEL_FORMAT_RGB32,
@@ -448,13 +640,15 @@ void DepthPhotoObject::OnSetColorImage(
     return;
   }
 
+  // RGBA to BGRA, straight into the image plane.
   for (int y = 0; y < outInfo.height; y++) {
-    for (int x = 0; x < outInfo.width; x++) {
-      int i = x * 4 + outData.pitches[0] * y;
-      outData.planes[0][i] = image_data[i + 2];
-      outData.planes[0][i + 1] = image_data[i + 1];
-      outData.planes[0][i + 2] = image_data[i];
-      outData.planes[0][i + 3] = image_data[i + 3];
+    const uint8* src = image_data + outInfo.width * 4 * y;
+    uint8* dst = outData.planes[0] + outData.pitches[0] * y;
+    for (int x = 0; x < outInfo.width; x++, src += 4, dst += 4) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+      dst[3] = src[3];
     }
   }
   out->ReleaseAccess(&outData);
@@ -464,32 +658,44 @@ void DepthPhotoObject::OnSetColorImage(
 
 void DepthPhotoObject::OnSetDepthImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
-  scoped_ptr<SetDepthImage::Params> params(
-      SetDepthImage::Params::Create(*info->arguments()));
-  if (!params) {
+  int width = 0;
+  int height = 0;
+  const uint8* image_data = nullptr;
+  if (!GetImageFromArgs(info->arguments(), 2, &width, &height,
+                        &image_data)) {
     info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
     return;
   }
 
-  std::vector<char> buffer = params->image;
-  char* data = &buffer[0];
-  int* int_array = reinterpret_cast<int*>(data);
-  int width = int_array[0];
-  int height = int_array[1];
-  char* image_data = data + 2 * sizeof(int);
-
   PXCImage* out = photo_->QueryDepth();
+  if (!out) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
   PXCImage::ImageInfo outInfo = out->QueryInfo();
   if (width != outInfo.width || height != outInfo.height) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
 
+  // A shared photo is copied only once the call is known to write to it,
+  // so this can only fail to copy it.
+  if (!GetWritablePhoto()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  out = photo_->QueryDepth();
+  if (!out) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
   PXCImage::ImageData outData;
   pxcStatus photoSts = out->AcquireAccess(PXCImage::ACCESS_READ_WRITE,
                                           PXCImage::PIXEL_FORMAT_DEPTH,
@@ -499,14 +705,12 @@ void DepthPhotoObject::OnSetDepthImage(
     return;
   }
 
-  int i = 0;
+  // The depth values are 16 bits, copy them row by row.
+  const size_t row_size = outInfo.width * sizeof(uint16_t);
   for (int y = 0; y < outInfo.height; ++y) {
-    for (int x = 0; x < outInfo.width; ++x) {
-      uint16_t* depth16 = reinterpret_cast<uint16_t*>(
-        outData.planes[0] + outData.pitches[0] * y);
-      depth16[x] = image_data[i];
-      i++;
-    }
+    memcpy(outData.planes[0] + outData.pitches[0] * y,
+           image_data + row_size * y,
+           row_size);
   }
   out->ReleaseAccess(&outData);
 
@@ -515,32 +719,44 @@ void DepthPhotoObject::OnSetDepthImage(
 
 void DepthPhotoObject::OnSetRawDepthImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!photo_) {
+  base::AutoLock lock(photo_lock_);
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
-  scoped_ptr<SetRawDepthImage::Params> params(
-      SetRawDepthImage::Params::Create(*info->arguments()));
-  if (!params) {
+  int width = 0;
+  int height = 0;
+  const uint8* image_data = nullptr;
+  if (!GetImageFromArgs(info->arguments(), 2, &width, &height,
+                        &image_data)) {
     info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
     return;
   }
 
-  std::vector<char> buffer = params->image;
-  char* data = &buffer[0];
-  int* int_array = reinterpret_cast<int*>(data);
-  int width = int_array[0];
-  int height = int_array[1];
-  char* image_data = data + 2 * sizeof(int);
-
   PXCImage* out = photo_->QueryRawDepth();
+  if (!out) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
   PXCImage::ImageInfo outInfo = out->QueryInfo();
   if (width != outInfo.width || height != outInfo.height) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
 
+  // A shared photo is copied only once the call is known to write to it,
+  // so this can only fail to copy it.
+  if (!GetWritablePhoto()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  out = photo_->QueryRawDepth();
+  if (!out) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
   PXCImage::ImageData outData;
   pxcStatus photoSts = out->AcquireAccess(PXCImage::ACCESS_READ_WRITE,
                                           PXCImage::PIXEL_FORMAT_DEPTH,
@@ -550,14 +766,12 @@ void DepthPhotoObject::OnSetRawDepthImage(
     return;
   }
 
-  int i = 0;
+  // The depth values are 16 bits, copy them row by row.
+  const size_t row_size = outInfo.width * sizeof(uint16_t);
   for (int y = 0; y < outInfo.height; ++y) {
-    for (int x = 0; x < outInfo.width; ++x) {
-      uint16_t* depth16 = reinterpret_cast<uint16_t*>(
-          outData.planes[0] + outData.pitches[0] * y);
-      depth16[x] = image_data[i];
-      i++;
-    }
+    memcpy(outData.planes[0] + outData.pitches[0] * y,
+           image_data + row_size * y,
+           row_size);
   }
   out->ReleaseAccess(&outData);
 
@@ -566,20 +780,55 @@ void DepthPhotoObject::OnSetRawDepthImage(
 
 void DepthPhotoObject::OnClone(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  base::AutoLock lock(photo_lock_);
   jsapi::depth_photo::Photo photo;
-  if (!photo_) {
+  if (!GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
-  DepthPhotoObject* depthPhotoObject = new DepthPhotoObject(instance_);
-  depthPhotoObject->GetPhoto()->CopyPhoto(photo_);
-  scoped_ptr<BindingObject> obj(depthPhotoObject);
+  // The clone shares the photo until either of them writes to it. A pinned
+  // photo is copied, as it must stay the one its SDK module points to.
+  scoped_ptr<DepthPhotoObject> obj(new DepthPhotoObject(instance_));
+  if (pinned_) {
+    PXCPhoto* copy = session_->CreatePhoto();
+    if (!copy) {
+      info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+      return;
+    }
+    copy->CopyPhoto(photo_);
+    obj->SetPhoto(copy);
+  } else {
+    obj->SharePhoto(shared_photo_);
+  }
   std::string object_id = base::GenerateGUID();
-  instance_->AddBindingObject(object_id, obj.Pass());
+  instance_->AddDepthPhotoObject(object_id, obj.Pass());
   photo.object_id = object_id;
   info->PostResult(Clone::Results::Create(photo, std::string()));
 }
 
+ScopedDepthPhoto::ScopedDepthPhoto(EnhancedPhotographyInstance* instance,
+                                   const std::string& object_id)
+    : instance_(instance),
+      depth_photo_(instance->AcquireDepthPhoto(object_id)) {
+  if (depth_photo_)
+    depth_photo_->photo_lock().Acquire();
+}
+
+ScopedDepthPhoto::~ScopedDepthPhoto() {
+  if (depth_photo_) {
+    depth_photo_->photo_lock().Release();
+    instance_->ReleaseDepthPhoto(depth_photo_);
+  }
+}
+
+ScopedModulePhoto::ScopedModulePhoto(EnhancedPhotographyInstance* instance,
+                                     const std::string& object_id,
+                                     PXCPhoto* photo)
+    : depth_photo_(instance, object_id),
+      valid_(photo && depth_photo_.get() &&
+             depth_photo_->GetPhoto() == photo) {
+}
+
 }  // namespace enhanced_photography
 }  // namespace realsense
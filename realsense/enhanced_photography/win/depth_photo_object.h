@@ -10,7 +10,13 @@
 // This file is auto-generated by enhanced_photography.idl
 #include "depth_photo.h" // NOLINT
 
+#include "base/atomicops.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "realsense/common/memory_accounting.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 #include "xwalk/common/event_target.h"
@@ -21,14 +27,61 @@ namespace enhanced_photography {
 using xwalk::common::XWalkExtensionFunctionInfo;
 using namespace jsapi::depth_photo; // NOLINT
 
+// A PXCPhoto shared by a DepthPhotoObject and its clones. A shared photo is
+// never written to, the object about to write copies it first.
+class SharedPhoto : public base::RefCountedThreadSafe<SharedPhoto> {
+ public:
+  explicit SharedPhoto(PXCPhoto* photo);
+
+  PXCPhoto* get() const { return photo_; }
+
+  // Number of DepthPhotoObjects using the photo.
+  int sharers() const { return base::subtle::Acquire_Load(&sharers_); }
+  void AddSharer() { base::subtle::Barrier_AtomicIncrement(&sharers_, 1); }
+  void RemoveSharer() { base::subtle::Barrier_AtomicIncrement(&sharers_, -1); }
+
+ private:
+  friend class base::RefCountedThreadSafe<SharedPhoto>;
+  ~SharedPhoto();
+
+  PXCPhoto* photo_;
+  base::subtle::Atomic32 sharers_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedPhoto);
+};
+
 class DepthPhotoObject : public xwalk::common::BindingObject {
  public:
   explicit DepthPhotoObject(EnhancedPhotographyInstance* instance);
   ~DepthPhotoObject() override;
 
-  PXCPhoto* GetPhoto() { return photo_; }
-  void SetPhoto(PXCPhoto* photo) { photo_ = photo; }
+  // Other objects must hold photo_lock() while using the photo, see
+  // ScopedDepthPhoto. Faults the photo back in if it was spilled by the
+  // DepthPhotoCache.
+  PXCPhoto* GetPhoto();
+  // Takes ownership of |photo|. Must be called before the object is shared.
+  void SetPhoto(PXCPhoto* photo);
+  // Makes this object a copy-on-write clone of |photo|.
+  void SharePhoto(const scoped_refptr<SharedPhoto>& photo);
+  // Shares the photo with a task which reads it without holding
+  // photo_lock(). The task must call RemoveSharer() on the returned photo
+  // when done. Must be called with photo_lock() held.
+  scoped_refptr<SharedPhoto> SnapshotPhoto();
   void DestroyPhoto();
+  base::Lock& photo_lock() { return photo_lock_; }
+
+  // The SDK modules keep a pointer to the photo they are initialized with,
+  // so such a photo stays resident and unshared for the rest of the object
+  // life. Must be called with photo_lock() held.
+  void PinPhoto();
+  bool pinned() const { return pinned_; }
+
+  // Whether Spill() would free the photo: it is resident, and neither pinned
+  // nor shared. Must be called with photo_lock() held.
+  bool CanSpill() const;
+  // Called by the DepthPhotoCache with photo_lock() held. Writes the photo to
+  // |dir| and releases it.
+  bool Spill(const base::FilePath& dir);
 
  private:
   void OnCheckSignature(scoped_ptr<XWalkExtensionFunctionInfo> info);
@@ -50,11 +103,62 @@ class DepthPhotoObject : public xwalk::common::BindingObject {
   void OnSetRawDepthImage(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnClone(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
+  // Like GetPhoto(), but first copies the photo if it is shared.
+  PXCPhoto* GetWritablePhoto();
+  void ResetPhoto(const scoped_refptr<SharedPhoto>& photo);
+
   PXCSession* session_;
+  scoped_refptr<SharedPhoto> shared_photo_;
+  // The photo of |shared_photo_|.
   PXCPhoto* photo_;
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
+  base::Lock photo_lock_;
+  bool pinned_;
+  // Where the photo is spilled, empty while it is resident.
+  base::FilePath spill_path_;
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
+};
+
+// Looks up a DepthPhotoObject from the sequence of another object. While in
+// scope the object is not destroyed and its photo is locked.
+class ScopedDepthPhoto {
+ public:
+  ScopedDepthPhoto(EnhancedPhotographyInstance* instance,
+                   const std::string& object_id);
+  ~ScopedDepthPhoto();
+
+  DepthPhotoObject* get() const { return depth_photo_; }
+  DepthPhotoObject* operator->() const { return depth_photo_; }
+
+ private:
+  EnhancedPhotographyInstance* instance_;
+  DepthPhotoObject* depth_photo_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedDepthPhoto);
+};
+
+// Locks |photo|, which an SDK module was initialized with, for a call of the
+// module. The modules keep a pointer to the photo they are given, which is
+// only valid while the DepthPhotoObject |object_id| is alive and its photo
+// is not used by anyone else.
+class ScopedModulePhoto {
+ public:
+  ScopedModulePhoto(EnhancedPhotographyInstance* instance,
+                    const std::string& object_id,
+                    PXCPhoto* photo);
+
+  // False if the module has no photo, or if the object was destroyed or its
+  // photo replaced. The module must not be called then.
+  bool valid() const { return valid_; }
+
+ private:
+  ScopedDepthPhoto depth_photo_;
+  bool valid_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedModulePhoto);
 };
 
 }  // namespace enhanced_photography
@@ -0,0 +1,151 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/depth_preview.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/trace_event/trace_event.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+using jsapi::photo_capture::DepthPreviewOptions;
+
+namespace {
+
+const int kDefaultMinDepth = 200;
+const int kDefaultMaxDepth = 3000;
+const size_t kHeaderSize = 4 * sizeof(int);
+const int kFormatDepth = 0;
+const int kFormatRGBA32 = 1;
+
+uint8 ToColorComponent(double value) {
+  return static_cast<uint8>(std::min(std::max(value, 0.0), 1.0) * 255);
+}
+
+// A jet color map, from dark red for |min_depth| to dark blue for
+// |max_depth|. 0, which is no depth, is transparent.
+void BuildPalette(int min_depth, int max_depth, std::vector<uint32>* palette) {
+  palette->resize(65536);
+  (*palette)[0] = 0;
+  for (int depth = 1; depth < 65536; ++depth) {
+    double t = static_cast<double>(
+        std::min(std::max(depth, min_depth), max_depth) - min_depth) /
+        (max_depth - min_depth);
+    double v = 1.0 - t;
+    uint32 r = ToColorComponent(1.5 - fabs(4 * v - 3));
+    uint32 g = ToColorComponent(1.5 - fabs(4 * v - 2));
+    uint32 b = ToColorComponent(1.5 - fabs(4 * v - 1));
+    // RGBA bytes in memory.
+    (*palette)[depth] = r | (g << 8) | (b << 16) | 0xFF000000;
+  }
+}
+
+}  // namespace
+
+DepthPreview::DepthPreview()
+    : colorize_(false),
+      requested_width_(0),
+      source_width_(0),
+      source_height_(0),
+      width_(0),
+      height_(0) {
+}
+
+DepthPreview::~DepthPreview() {
+}
+
+void DepthPreview::Configure(const DepthPreviewOptions* options) {
+  colorize_ = options && options->colorize && *options->colorize;
+  requested_width_ = options && options->width ? *options->width : 0;
+  // The sampling is rebuilt for the new width on the next frame.
+  source_width_ = source_height_ = 0;
+
+  palette_.clear();
+  if (colorize_) {
+    int min_depth = options->min_depth ?
+        std::max(*options->min_depth, 0) : kDefaultMinDepth;
+    int max_depth = options->max_depth ?
+        std::min(*options->max_depth, 65535) : kDefaultMaxDepth;
+    if (max_depth <= min_depth)
+      max_depth = min_depth + 1;
+    BuildPalette(min_depth, max_depth, &palette_);
+  }
+}
+
+void DepthPreview::BuildSampling(int source_width, int source_height) {
+  source_width_ = source_width;
+  source_height_ = source_height;
+  // The depth is never upscaled, and sampled rather than filtered so that
+  // no depth is made up across edges.
+  width_ = requested_width_ > 0 ?
+      std::min(requested_width_, source_width) : source_width;
+  height_ = std::max(1, static_cast<int>(
+      static_cast<int64>(source_height) * width_ / source_width));
+
+  columns_.resize(width_);
+  for (int x = 0; x < width_; ++x)
+    columns_[x] = static_cast<int>(static_cast<int64>(x) * source_width /
+                                   width_);
+  rows_.resize(height_);
+  for (int y = 0; y < height_; ++y)
+    rows_[y] = static_cast<int>(static_cast<int64>(y) * source_height /
+                                height_);
+}
+
+scoped_ptr<base::ListValue> DepthPreview::Convert(PXCImage* depth) {
+  TRACE_EVENT0("realsense", "DepthPreview::Convert");
+  PXCImage::ImageInfo info = depth->QueryInfo();
+  if (info.width <= 0 || info.height <= 0)
+    return nullptr;
+  if (info.width != source_width_ || info.height != source_height_)
+    BuildSampling(info.width, info.height);
+
+  PXCImage::ImageData data;
+  if (depth->AcquireAccess(PXCImage::ACCESS_READ,
+      PXCImage::PIXEL_FORMAT_DEPTH, &data) < PXC_STATUS_NO_ERROR)
+    return nullptr;
+
+  const size_t bytes_per_pixel = colorize_ ? sizeof(uint32) : sizeof(uint16);
+  const size_t size =
+      kHeaderSize + static_cast<size_t>(width_) * height_ * bytes_per_pixel;
+  // The buffer is handed over to the message, so it can't be reused for the
+  // next frame.
+  scoped_ptr<char[]> buffer(new char[size]);
+  int* int_array = reinterpret_cast<int*>(buffer.get());
+  int_array[1] = width_;
+  int_array[2] = height_;
+  int_array[3] = colorize_ ? kFormatRGBA32 : kFormatDepth;
+
+  char* pixels = buffer.get() + kHeaderSize;
+  const bool full_width = width_ == info.width;
+  for (int y = 0; y < height_; ++y) {
+    const uint16* source = reinterpret_cast<const uint16*>(
+        data.planes[0] + data.pitches[0] * rows_[y]);
+    if (colorize_) {
+      uint32* row = reinterpret_cast<uint32*>(pixels) + y * width_;
+      for (int x = 0; x < width_; ++x)
+        row[x] = palette_[source[columns_[x]]];
+    } else if (full_width) {
+      memcpy(pixels + y * width_ * sizeof(uint16), source,
+             width_ * sizeof(uint16));
+    } else {
+      uint16* row = reinterpret_cast<uint16*>(pixels) + y * width_;
+      for (int x = 0; x < width_; ++x)
+        row[x] = source[columns_[x]];
+    }
+  }
+  depth->ReleaseAccess(&data);
+
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(new base::BinaryValue(buffer.Pass(), size));
+  return result.Pass();
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
@@ -0,0 +1,60 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_PREVIEW_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_PREVIEW_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/values.h"
+// This file is auto-generated by photo_capture.idl
+#include "photo_capture.h" // NOLINT
+#include "third_party/libpxc/include/pxcimage.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+// Converts the frames of the depth stream to the preview images pushed to
+// PhotoCapture.ondepthframe. The sampling and color tables are built once
+// for a configuration and a stream size, so that converting a frame is one
+// pass over the output pixels, written straight into the message.
+class DepthPreview {
+ public:
+  DepthPreview();
+  ~DepthPreview();
+
+  void Configure(const jsapi::photo_capture::DepthPreviewOptions* options);
+
+  // Returns nullptr if |depth| can't be read.
+  //
+  // binary image message: call_id (i32), width (i32), height (i32),
+  // format (i32, 0 for depth, 1 for rgba32), then the pixels (uint16 depth
+  // or RGBA32 colors).
+  scoped_ptr<base::ListValue> Convert(PXCImage* depth);
+
+ private:
+  void BuildSampling(int source_width, int source_height);
+
+  bool colorize_;
+  int requested_width_;
+  // Depth values from min to max are mapped to the colors of |palette_|.
+  std::vector<uint32> palette_;
+
+  int source_width_;
+  int source_height_;
+  int width_;
+  int height_;
+  // The source column and row of each output pixel.
+  std::vector<int> columns_;
+  std::vector<int> rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(DepthPreview);
+};
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_PREVIEW_H_
@@ -0,0 +1,126 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/depth_quality_kernels.h"
+
+#include "base/logging.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY)
+#include <emmintrin.h>
+#endif
+
+namespace realsense {
+namespace enhanced_photography {
+
+namespace {
+
+#if defined(ARCH_CPU_X86_FAMILY)
+int SumEpi16(__m128i v) {
+  int16 lanes[8];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+  int sum = 0;
+  for (int i = 0; i < 8; ++i)
+    sum += lanes[i];
+  return sum;
+}
+
+int SumEpi32(__m128i v) {
+  int32 lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+}  // namespace
+
+DepthQualityStats::DepthQualityStats()
+    : pixels(0),
+      valid(0),
+      smooth(0),
+      edges(0),
+      roughness(0) {
+}
+
+int CountValidDepth(const uint16* row, int count) {
+  DCHECK_LE(count, kMaxDepthSpan);
+  int i = 0;
+  int holes = 0;
+#if defined(ARCH_CPU_X86_FAMILY)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i hole_count = zero;
+  for (; i + 8 <= count; i += 8) {
+    __m128i depth =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+    // The comparison yields -1 per hole.
+    hole_count = _mm_sub_epi16(hole_count, _mm_cmpeq_epi16(depth, zero));
+  }
+  holes = SumEpi16(hole_count);
+#endif
+  return i - holes + CountValidDepthScalar(row + i, count - i);
+}
+
+void AnalyzeDepthPairs(const uint16* a, const uint16* b, int count,
+                       DepthQualityStats* stats) {
+  DCHECK_LE(count, kMaxDepthSpan);
+  int i = 0;
+#if defined(ARCH_CPU_X86_FAMILY)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i threshold = _mm_set1_epi16(kDepthEdgeThreshold);
+  __m128i edges = zero;
+  __m128i smooth = zero;
+  __m128i roughness = zero;
+  for (; i + 8 <= count; i += 8) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    __m128i holes = _mm_or_si128(_mm_cmpeq_epi16(va, zero),
+                                 _mm_cmpeq_epi16(vb, zero));
+    __m128i diff = _mm_or_si128(_mm_subs_epu16(va, vb),
+                                _mm_subs_epu16(vb, va));
+    __m128i flat =
+        _mm_cmpeq_epi16(_mm_subs_epu16(diff, threshold), zero);
+    __m128i edge_mask = _mm_andnot_si128(_mm_or_si128(holes, flat),
+                                         _mm_cmpeq_epi16(zero, zero));
+    __m128i smooth_mask = _mm_andnot_si128(holes, flat);
+    edges = _mm_sub_epi16(edges, edge_mask);
+    smooth = _mm_sub_epi16(smooth, smooth_mask);
+    // The differences on surfaces are at most kDepthEdgeThreshold, they are
+    // summed in 32 bit lanes.
+    roughness = _mm_add_epi32(
+        roughness, _mm_madd_epi16(_mm_and_si128(diff, smooth_mask), ones));
+  }
+  stats->edges += SumEpi16(edges);
+  stats->smooth += SumEpi16(smooth);
+  stats->roughness += SumEpi32(roughness);
+#endif
+  AnalyzeDepthPairsScalar(a + i, b + i, count - i, stats);
+}
+
+int CountValidDepthScalar(const uint16* row, int count) {
+  int valid = 0;
+  for (int i = 0; i < count; ++i) {
+    if (row[i])
+      ++valid;
+  }
+  return valid;
+}
+
+void AnalyzeDepthPairsScalar(const uint16* a, const uint16* b, int count,
+                             DepthQualityStats* stats) {
+  for (int i = 0; i < count; ++i) {
+    if (!a[i] || !b[i])
+      continue;
+    int diff = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    if (diff > kDepthEdgeThreshold) {
+      ++stats->edges;
+    } else {
+      ++stats->smooth;
+      stats->roughness += diff;
+    }
+  }
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
@@ -0,0 +1,47 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_QUALITY_KERNELS_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_QUALITY_KERNELS_H_
+
+#include "base/basictypes.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+// Neighbors farther apart, in millimeters, are on both sides of an edge.
+const int kDepthEdgeThreshold = 50;
+
+// Longest span of pixels the kernels take at once, the SIMD versions count
+// in 16 bit lanes.
+const int kMaxDepthSpan = 32767;
+
+// The statistics of a span of depth pixels or of neighbor pairs.
+struct DepthQualityStats {
+  DepthQualityStats();
+
+  int pixels;
+  int valid;
+  // Pairs of neighbors with depth, on a surface or across an edge.
+  int smooth;
+  int edges;
+  int64 roughness;
+};
+
+// Counts the pixels of |row| with depth.
+int CountValidDepth(const uint16* row, int count);
+
+// Accumulates the pairs (a[i], b[i]) to |stats|, where both have depth.
+void AnalyzeDepthPairs(const uint16* a, const uint16* b, int count,
+                       DepthQualityStats* stats);
+
+// Portable versions of the kernels above, which use SSE2 where available.
+int CountValidDepthScalar(const uint16* row, int count);
+void AnalyzeDepthPairsScalar(const uint16* a, const uint16* b, int count,
+                             DepthQualityStats* stats);
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_QUALITY_KERNELS_H_
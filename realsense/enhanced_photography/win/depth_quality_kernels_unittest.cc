@@ -0,0 +1,149 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/depth_quality_kernels.h"
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+namespace {
+
+uint32 NextRandom(uint32* state) {
+  *state = *state * 1664525 + 1013904223;
+  return *state >> 8;
+}
+
+// A step on a surface, up to a pixel over the edge threshold either way.
+int RandomStep(uint32* state) {
+  return static_cast<int>(NextRandom(state) % (2 * kDepthEdgeThreshold + 5)) -
+         kDepthEdgeThreshold - 2;
+}
+
+uint16 ClampDepth(int depth) {
+  return static_cast<uint16>(depth < 1 ? 1 : depth > 0xFFFF ? 0xFFFF : depth);
+}
+
+// Depth rows with holes, surfaces and edges, from a fixed seed so that the
+// failures can be reproduced.
+std::vector<uint16> CreateDepthRow(size_t size, uint32 seed) {
+  std::vector<uint16> row(size);
+  uint32 state = seed;
+  uint16 depth = 1000;
+  for (size_t i = 0; i < size; ++i) {
+    uint32 kind = NextRandom(&state) % 8;
+    if (kind == 0) {
+      row[i] = 0;
+      continue;
+    }
+    if (kind == 1) {
+      // Across an edge, up to the largest depth.
+      depth = ClampDepth(NextRandom(&state) & 0xFFFF);
+    } else {
+      depth = ClampDepth(depth + RandomStep(&state));
+    }
+    row[i] = depth;
+  }
+  return row;
+}
+
+// The row below |row|, with its pixels mostly on the same surfaces.
+std::vector<uint16> CreateNeighborRow(const std::vector<uint16>& row,
+                                      uint32 seed) {
+  std::vector<uint16> neighbor(row.size());
+  uint32 state = seed;
+  for (size_t i = 0; i < row.size(); ++i) {
+    if (NextRandom(&state) % 8 == 0)
+      neighbor[i] = 0;
+    else
+      neighbor[i] = ClampDepth(row[i] + RandomStep(&state));
+  }
+  return neighbor;
+}
+
+void ExpectSameStats(const DepthQualityStats& expected,
+                     const DepthQualityStats& actual) {
+  EXPECT_EQ(expected.smooth, actual.smooth);
+  EXPECT_EQ(expected.edges, actual.edges);
+  EXPECT_EQ(expected.roughness, actual.roughness);
+}
+
+}  // namespace
+
+TEST(DepthQualityKernelsTest, CountValidDepthScalar) {
+  const uint16 row[] = {0, 1, 0, 0, 500, 0xFFFF, 0, 7};
+  EXPECT_EQ(0, CountValidDepthScalar(row, 0));
+  EXPECT_EQ(1, CountValidDepthScalar(row, 2));
+  EXPECT_EQ(4, CountValidDepthScalar(row, 8));
+}
+
+TEST(DepthQualityKernelsTest, AnalyzeDepthPairsScalar) {
+  // A hole on either side, a surface, the threshold and an edge.
+  const uint16 a[] = {0, 100, 100, 200, 1000, 0xFFFF};
+  const uint16 b[] = {100, 0, 110, 150, 1051, 1};
+  DepthQualityStats stats;
+  AnalyzeDepthPairsScalar(a, b, 6, &stats);
+  EXPECT_EQ(2, stats.smooth);
+  EXPECT_EQ(2, stats.edges);
+  EXPECT_EQ(10 + kDepthEdgeThreshold, stats.roughness);
+}
+
+// The SIMD versions take 8 pixels at a time and finish with the scalar
+// ones, every length and alignment of the tail is checked.
+TEST(DepthQualityKernelsTest, CountValidDepthMatchesScalar) {
+  std::vector<uint16> row = CreateDepthRow(300, 1);
+  for (int offset = 0; offset < 8; ++offset) {
+    for (int count = 0; count + offset <= 300; ++count) {
+      EXPECT_EQ(CountValidDepthScalar(&row[offset], count),
+                CountValidDepth(&row[offset], count))
+          << "offset " << offset << ", count " << count;
+    }
+  }
+}
+
+TEST(DepthQualityKernelsTest, AnalyzeDepthPairsMatchesScalar) {
+  std::vector<uint16> a = CreateDepthRow(300, 2);
+  std::vector<uint16> b = CreateNeighborRow(a, 3);
+  for (int offset = 0; offset < 8; ++offset) {
+    for (int count = 0; count + offset <= 300; ++count) {
+      DepthQualityStats expected;
+      AnalyzeDepthPairsScalar(&a[offset], &b[offset], count, &expected);
+      DepthQualityStats actual;
+      AnalyzeDepthPairs(&a[offset], &b[offset], count, &actual);
+      SCOPED_TRACE(testing::Message() << "offset " << offset << ", count "
+                                      << count);
+      ExpectSameStats(expected, actual);
+    }
+  }
+}
+
+TEST(DepthQualityKernelsTest, AnalyzeDepthPairsOfNeighbors) {
+  // As DepthQualityMap uses them, on a row and the row shifted by a pixel.
+  std::vector<uint16> row = CreateDepthRow(641, 4);
+  DepthQualityStats expected;
+  AnalyzeDepthPairsScalar(&row[0], &row[1], 640, &expected);
+  DepthQualityStats actual;
+  AnalyzeDepthPairs(&row[0], &row[1], 640, &actual);
+  ExpectSameStats(expected, actual);
+  EXPECT_GT(actual.smooth, 0);
+  EXPECT_GT(actual.edges, 0);
+}
+
+TEST(DepthQualityKernelsTest, AnalyzeDepthPairsAccumulates) {
+  std::vector<uint16> a = CreateDepthRow(64, 5);
+  std::vector<uint16> b = CreateNeighborRow(a, 6);
+  DepthQualityStats expected;
+  AnalyzeDepthPairsScalar(&a[0], &b[0], 64, &expected);
+  AnalyzeDepthPairsScalar(&b[0], &a[0], 64, &expected);
+  DepthQualityStats actual;
+  AnalyzeDepthPairs(&a[0], &b[0], 64, &actual);
+  AnalyzeDepthPairs(&b[0], &a[0], 64, &actual);
+  ExpectSameStats(expected, actual);
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
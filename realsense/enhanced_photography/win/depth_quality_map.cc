@@ -0,0 +1,182 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/depth_quality_map.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/trace_event/trace_event.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+namespace {
+
+const int kMinTileSize = 4;
+const int kMaxTileSize = 128;
+const int kUpdatesPerMap = 4;
+const int kHistogramShift = 7;
+const size_t kHeaderSize = 9 * sizeof(int);
+
+uint8 ToByte(int64 value, int64 total) {
+  if (total <= 0)
+    return 0;
+  return static_cast<uint8>(std::min<int64>(value * 255 / total, 255));
+}
+
+}  // namespace
+
+// Defined as well, since the constants may be odr-used, e.g. in a ternary.
+const int DepthQualityMap::kDefaultTileSize;
+const int DepthQualityMap::kHistogramBins;
+const int DepthQualityMap::kHistogramBinWidth;
+
+DepthQualityMap::DepthQualityMap()
+    : tile_size_(kDefaultTileSize),
+      width_(0),
+      height_(0),
+      columns_(0),
+      rows_(0),
+      bands_per_update_(1),
+      next_band_(0),
+      complete_(false) {
+}
+
+DepthQualityMap::~DepthQualityMap() {
+}
+
+void DepthQualityMap::Configure(int tile_size) {
+  tile_size_ = std::min(std::max(tile_size, kMinTileSize), kMaxTileSize);
+  // The tiles are laid out again on the next frame.
+  width_ = height_ = 0;
+  complete_ = false;
+}
+
+void DepthQualityMap::Resize(int width, int height) {
+  width_ = width;
+  height_ = height;
+  columns_ = (width + tile_size_ - 1) / tile_size_;
+  rows_ = (height + tile_size_ - 1) / tile_size_;
+  bands_per_update_ = std::max(1, (rows_ + kUpdatesPerMap - 1) /
+                                  kUpdatesPerMap);
+  next_band_ = 0;
+  complete_ = false;
+  tiles_.assign(columns_ * rows_, DepthQualityStats());
+  histograms_.assign(rows_ * kHistogramBins, 0);
+}
+
+bool DepthQualityMap::Update(PXCImage* depth) {
+  TRACE_EVENT0("realsense", "DepthQualityMap::Update");
+  PXCImage::ImageInfo info = depth->QueryInfo();
+  if (info.width <= 0 || info.height <= 0)
+    return false;
+  if (info.width != width_ || info.height != height_)
+    Resize(info.width, info.height);
+
+  PXCImage::ImageData data;
+  if (depth->AcquireAccess(PXCImage::ACCESS_READ,
+      PXCImage::PIXEL_FORMAT_DEPTH, &data) < PXC_STATUS_NO_ERROR)
+    return false;
+  bool completed = false;
+  for (int i = 0; i < bands_per_update_; ++i) {
+    AnalyzeBand(data, next_band_);
+    if (++next_band_ == rows_) {
+      next_band_ = 0;
+      complete_ = completed = true;
+      break;
+    }
+  }
+  depth->ReleaseAccess(&data);
+  return completed;
+}
+
+void DepthQualityMap::AnalyzeBand(const PXCImage::ImageData& data,
+                                  int band) {
+  DepthQualityStats* tiles = &tiles_[band * columns_];
+  std::fill(tiles, tiles + columns_, DepthQualityStats());
+  uint32* histogram = &histograms_[band * kHistogramBins];
+  std::fill(histogram, histogram + kHistogramBins, 0);
+
+  const int top = band * tile_size_;
+  const int bottom = std::min(top + tile_size_, height_);
+  for (int y = top; y < bottom; ++y) {
+    const uint16* row =
+        reinterpret_cast<const uint16*>(data.planes[0] + data.pitches[0] * y);
+    const uint16* above = y > 0 ? reinterpret_cast<const uint16*>(
+        data.planes[0] + data.pitches[0] * (y - 1)) : nullptr;
+    for (int column = 0; column < columns_; ++column) {
+      const int left = column * tile_size_;
+      const int right = std::min(left + tile_size_, width_);
+      const int count = right - left;
+      DepthQualityStats& tile = tiles[column];
+      tile.pixels += count;
+      tile.valid += CountValidDepth(row + left, count);
+      // The pair across the right border of the tile belongs to it.
+      AnalyzeDepthPairs(row + left, row + left + 1,
+                        right < width_ ? count : count - 1, &tile);
+      if (above)
+        AnalyzeDepthPairs(above + left, row + left, count, &tile);
+    }
+    for (int x = 0; x < width_; ++x) {
+      if (row[x]) {
+        ++histogram[std::min(row[x] >> kHistogramShift,
+                             kHistogramBins - 1)];
+      }
+    }
+  }
+}
+
+scoped_ptr<base::ListValue> DepthQualityMap::CreateResult() const {
+  const size_t tile_count = tiles_.size();
+  const size_t size = kHeaderSize + kHistogramBins * sizeof(uint32) +
+                      3 * tile_count;
+  scoped_ptr<char[]> buffer(new char[size]);
+  int* int_array = reinterpret_cast<int*>(buffer.get());
+  int_array[1] = columns_;
+  int_array[2] = rows_;
+  int_array[3] = tile_size_;
+  int_array[4] = kHistogramBins;
+  int_array[5] = kHistogramBinWidth;
+
+  uint32* histogram = reinterpret_cast<uint32*>(buffer.get() + kHeaderSize);
+  memset(histogram, 0, kHistogramBins * sizeof(uint32));
+  for (int band = 0; band < rows_; ++band) {
+    for (int i = 0; i < kHistogramBins; ++i)
+      histogram[i] += histograms_[band * kHistogramBins + i];
+  }
+
+  uint8* validity = reinterpret_cast<uint8*>(histogram + kHistogramBins);
+  uint8* noise = validity + tile_count;
+  uint8* edges = noise + tile_count;
+  DepthQualityStats total;
+  for (size_t i = 0; i < tile_count; ++i) {
+    const DepthQualityStats& tile = tiles_[i];
+    validity[i] = ToByte(tile.valid, tile.pixels);
+    noise[i] = static_cast<uint8>(std::min<int64>(
+        tile.smooth ? tile.roughness / tile.smooth : 0, 255));
+    edges[i] = ToByte(tile.edges, tile.smooth + tile.edges);
+    total.pixels += tile.pixels;
+    total.valid += tile.valid;
+    total.smooth += tile.smooth;
+    total.edges += tile.edges;
+    total.roughness += tile.roughness;
+  }
+
+  float* float_array = reinterpret_cast<float*>(buffer.get());
+  float_array[6] = total.pixels ?
+      1.0f - static_cast<float>(total.valid) / total.pixels : 1.0f;
+  float_array[7] = total.smooth + total.edges ?
+      static_cast<float>(total.edges) / (total.smooth + total.edges) : 0.0f;
+  float_array[8] = total.smooth ?
+      static_cast<float>(total.roughness) / total.smooth : 0.0f;
+
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(new base::BinaryValue(buffer.Pass(), size));
+  return result.Pass();
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
@@ -0,0 +1,74 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_QUALITY_MAP_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_QUALITY_MAP_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/values.h"
+#include "realsense/enhanced_photography/win/depth_quality_kernels.h"
+#include "third_party/libpxc/include/pxcimage.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+// Computes a per-tile quality map of the depth stream: the ratio of pixels
+// with depth, the noise (mean difference between neighbors on surfaces) and
+// the edge density (ratio of neighbors more than kDepthEdgeThreshold apart),
+// and a depth histogram. The work is spread over the frames: each update
+// analyzes the next few rows of tiles, so that the whole map is refreshed
+// every kUpdatesPerMap frames at a small cost per frame.
+class DepthQualityMap {
+ public:
+  static const int kDefaultTileSize = 16;
+  static const int kHistogramBins = 32;
+  // In millimeters, the last bin also holds the farther depth.
+  static const int kHistogramBinWidth = 128;
+
+  DepthQualityMap();
+  ~DepthQualityMap();
+
+  // Restarts the map with tiles of |tile_size| pixels.
+  void Configure(int tile_size);
+
+  // Analyzes the next rows of tiles of |depth|. Returns true if the map of
+  // the whole frame was completed by this update.
+  bool Update(PXCImage* depth);
+
+  // Whether every tile has been analyzed since the map was configured.
+  bool is_complete() const { return complete_; }
+
+  // binary quality map message: call_id (i32), columns (i32), rows (i32),
+  // tile size (i32), histogram bins (i32), bin width (i32), hole ratio
+  // (f32), edge density (f32), noise (f32), histogram (u32 per bin), then
+  // the validity, noise and edge density planes (u8 per tile, row by row).
+  scoped_ptr<base::ListValue> CreateResult() const;
+
+ private:
+  void Resize(int width, int height);
+  void AnalyzeBand(const PXCImage::ImageData& data, int band);
+
+  int tile_size_;
+  int width_;
+  int height_;
+  int columns_;
+  int rows_;
+  int bands_per_update_;
+  int next_band_;
+  bool complete_;
+
+  std::vector<DepthQualityStats> tiles_;
+  // kHistogramBins per row of tiles.
+  std::vector<uint32> histograms_;
+
+  DISALLOW_COPY_AND_ASSIGN(DepthQualityMap);
+};
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_DEPTH_QUALITY_MAP_H_
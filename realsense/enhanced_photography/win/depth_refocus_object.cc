@@ -4,37 +4,68 @@
 
 #include "realsense/enhanced_photography/win/depth_refocus_object.h"
 
+#include <algorithm>
 #include <string>
 
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
+#include "realsense/enhanced_photography/win/depth_photo_cache.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
+#include "realsense/enhanced_photography/win/image_encoder.h"
 
 namespace realsense {
 using namespace realsense::common;  // NOLINT
 namespace enhanced_photography {
 
+namespace {
+
+// Width of the preview color image, unless applyPreview() asks otherwise.
+const int kDefaultPreviewWidth = 640;
+
+}  // namespace
+
 DepthRefocusObject::DepthRefocusObject(EnhancedPhotographyInstance* instance)
     : session_(nullptr),
-      instance_(instance) {
+      instance_(instance),
+      sequence_(instance),
+      photo_(nullptr),
+      preview_refocus_(nullptr),
+      preview_photo_(nullptr),
+      preview_photo_memory_("DepthRefocus", "preview_photo"),
+      preview_width_(0),
+      preview_scale_(1.0),
+      binary_message_size_(0),
+      binary_message_memory_("DepthRefocus", "binary_message") {
   handler_.Register("init",
-                    base::Bind(&DepthRefocusObject::OnInit,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &DepthRefocusObject::OnInit,
+                        base::Unretained(this))));
+  // A full resolution pass only supersedes the full resolution passes still
+  // waiting, and a preview the previews.
   handler_.Register("apply",
-                    base::Bind(&DepthRefocusObject::OnApply,
-                               base::Unretained(this)));
+                    sequence_.WrapLatest("apply", base::Bind(
+                        &DepthRefocusObject::OnApply,
+                        base::Unretained(this))));
+  handler_.Register("applyPreview",
+                    sequence_.WrapLatest("applyPreview", base::Bind(
+                        &DepthRefocusObject::OnApplyPreview,
+                        base::Unretained(this))));
+  handler_.Register("cancel", sequence_.CancelHandler());
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   depth_refocus_ = PXCEnhancedPhoto::DepthRefocus::CreateInstance(session_);
 }
 
 DepthRefocusObject::~DepthRefocusObject() {
+  sequence_.Flush();
+  ResetPreview();
   if (depth_refocus_) {
     depth_refocus_->Release();
     depth_refocus_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -49,19 +80,24 @@ void DepthRefocusObject::OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
+  depthPhotoObject->PinPhoto();
+  ResetPreview();
+  photo_id_.clear();
+  photo_ = nullptr;
   if ((depth_refocus_->Init(depthPhotoObject->GetPhoto())) <
       PXC_STATUS_NO_ERROR) {
     info->PostResult(CreateDOMException("DepthRefocus Init failed",
                                         ERROR_NAME_ABORTERROR));
     return;
   }
+  photo_id_ = object_id;
+  photo_ = depthPhotoObject->GetPhoto();
   info->PostResult(CreateSuccessResult());
 }
 
@@ -79,10 +115,17 @@ void DepthRefocusObject::OnApply(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   focus.y = params->focus.y;
 
   PXCPhoto* pxcphoto;
-  if (params->aperture)
-    pxcphoto = depth_refocus_->Apply(focus, *(params->aperture.get()));
-  else
-    pxcphoto = depth_refocus_->Apply(focus);
+  {
+    ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+    if (!module_photo.valid()) {
+      info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+      return;
+    }
+    if (params->aperture)
+      pxcphoto = depth_refocus_->Apply(focus, *(params->aperture.get()));
+    else
+      pxcphoto = depth_refocus_->Apply(focus);
+  }
   if (!pxcphoto) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
@@ -93,5 +136,135 @@ void DepthRefocusObject::OnApply(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   info->PostResult(Apply::Results::Create(photo, std::string()));
 }
 
+void DepthRefocusObject::OnApplyPreview(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<ApplyPreview::Params> params(
+      ApplyPreview::Params::Create(*info->arguments()));
+  if (!params || (params->width && *params->width <= 0)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  int width = params->width ? *params->width : kDefaultPreviewWidth;
+  if (!InitPreview(width)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_INIT_FAILED));
+    return;
+  }
+
+  // The focus point is given in the coordinates of the full resolution
+  // photo.
+  PXCPointI32 focus;
+  focus.x = static_cast<pxcI32>(params->focus.x * preview_scale_);
+  focus.y = static_cast<pxcI32>(params->focus.y * preview_scale_);
+
+  PXCPhoto* pxcphoto;
+  if (params->aperture)
+    pxcphoto = preview_refocus_->Apply(focus, *(params->aperture.get()));
+  else
+    pxcphoto = preview_refocus_->Apply(focus);
+  if (!pxcphoto) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
+  // The refocus itself can't be interrupted, but there is no point in
+  // sending back pixels which are already stale.
+  if (sequence_.IsSuperseded()) {
+    pxcphoto->Release();
+    info->PostResult(CreateDOMException("The request was superseded.",
+                                        ERROR_NAME_ABORTERROR));
+    return;
+  }
+
+  if (IsImageEncodingRequested(params->encoding)) {
+    PostEncodedImage(pxcphoto->QueryContainerImage(), *params->encoding,
+                     info.Pass());
+    pxcphoto->Release();
+    return;
+  }
+
+  bool copied = CopyImageToBinaryMessage(pxcphoto->QueryContainerImage(),
+                                         binary_message_,
+                                         &binary_message_size_,
+                                         &binary_message_memory_);
+  pxcphoto->Release();
+  if (!copied) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(base::BinaryValue::CreateWithCopiedBuffer(
+      reinterpret_cast<const char*>(binary_message_.get()),
+      binary_message_size_));
+  info->PostResult(result.Pass());
+}
+
+bool DepthRefocusObject::InitPreview(int width) {
+  if (preview_refocus_ && preview_width_ == width)
+    return true;
+  ResetPreview();
+  if (photo_id_.empty())
+    return false;
+
+  ScopedDepthPhoto depthPhotoObject(instance_, photo_id_);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto())
+    return false;
+  PXCPhoto* photo = depthPhotoObject->GetPhoto();
+  PXCImage* color = photo->QueryContainerImage();
+  PXCImage* depth = photo->QueryDepth();
+  if (!color || !depth)
+    return false;
+  PXCImage::ImageInfo color_info = color->QueryInfo();
+  PXCImage::ImageInfo depth_info = depth->QueryInfo();
+  if (color_info.width <= 0)
+    return false;
+
+  // Never upscale, the preview is meant to be cheaper than the photo.
+  int color_width = std::min(width, color_info.width);
+  double scale = static_cast<double>(color_width) / color_info.width;
+  int depth_width = std::max(1, static_cast<int>(depth_info.width * scale));
+
+  PXCEnhancedPhoto::PhotoUtils* photo_utils =
+      PXCEnhancedPhoto::PhotoUtils::CreateInstance(session_);
+  if (!photo_utils)
+    return false;
+  PXCPhoto* resized = photo_utils->ColorResize(photo, color_width);
+  if (resized) {
+    preview_photo_ = photo_utils->DepthResize(
+        resized, depth_width,
+        PXCEnhancedPhoto::PhotoUtils::DepthFillQuality::LOW);
+    resized->Release();
+  }
+  photo_utils->Release();
+  if (!preview_photo_)
+    return false;
+  preview_photo_memory_.Set(GetPhotoFootprint(preview_photo_));
+
+  preview_refocus_ = PXCEnhancedPhoto::DepthRefocus::CreateInstance(session_);
+  if (!preview_refocus_ ||
+      preview_refocus_->Init(preview_photo_) < PXC_STATUS_NO_ERROR) {
+    ResetPreview();
+    return false;
+  }
+  preview_width_ = width;
+  preview_scale_ = scale;
+  return true;
+}
+
+void DepthRefocusObject::ResetPreview() {
+  if (preview_refocus_) {
+    preview_refocus_->Release();
+    preview_refocus_ = nullptr;
+  }
+  if (preview_photo_) {
+    preview_photo_->Release();
+    preview_photo_ = nullptr;
+  }
+  preview_photo_memory_.Reset();
+  preview_width_ = 0;
+  preview_scale_ = 1.0;
+}
+
 }  // namespace enhanced_photography
 }  // namespace realsense
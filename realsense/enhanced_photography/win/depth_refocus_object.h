@@ -8,8 +8,13 @@
 // This file is auto-generated by depth_refocus.idl
 #include "depth_refocus.h" // NOLINT
 
+#include <string>
+
+#include "realsense/common/memory_accounting.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
+#include "third_party/libpxc/include/pxcphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 
 namespace realsense {
@@ -26,10 +31,31 @@ class DepthRefocusObject : public xwalk::common::BindingObject {
  private:
   void OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnApply(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnApplyPreview(scoped_ptr<XWalkExtensionFunctionInfo> info);
+
+  // Refocuses a downscaled copy of the photo passed to init(), built on the
+  // first preview of each |width|.
+  bool InitPreview(int width);
+  void ResetPreview();
 
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
   PXCSession* session_;
   PXCEnhancedPhoto::DepthRefocus* depth_refocus_;
+
+  // Only used on |sequence_|. The photo passed to init(), which
+  // |depth_refocus_| reads under a ScopedModulePhoto.
+  std::string photo_id_;
+  PXCPhoto* photo_;
+  PXCEnhancedPhoto::DepthRefocus* preview_refocus_;
+  PXCPhoto* preview_photo_;
+  realsense::common::MemoryTracker preview_photo_memory_;
+  int preview_width_;
+  // Ratio of the preview to the full resolution.
+  double preview_scale_;
+  scoped_ptr<uint8[]> binary_message_;
+  size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
 };
 
 }  // namespace enhanced_photography
@@ -9,7 +9,10 @@
       'type': 'loadable_module',
       'dependencies':[
         '<(DEPTH)/base/base.gyp:base',
+        '../../common/win/capture_service.gyp:capture_service',
         '<(DEPTH)/extensions/third_party/libpxc/libpxc.gyp:libpxc',
+        '<(DEPTH)/third_party/libwebp/libwebp.gyp:libwebp',
+        '<(DEPTH)/ui/gfx/gfx.gyp:gfx',
         '<(DEPTH)/xwalk/common/common.gyp:common',
       ],
       'includes': [
@@ -24,6 +27,15 @@
         'jsapi_component': 'enhanced_photography',
       },
       'sources': [
+        '../../common/binary_packing.cc',
+        '../../common/binary_packing.h',
+        '../../common/depth_codec.cc',
+        '../../common/depth_codec.h',
+        '../../common/depth_codec_api.js',
+        '../../common/memory_accounting.cc',
+        '../../common/memory_accounting.h',
+        '../../common/trace_recorder.cc',
+        '../../common/trace_recorder.h',
         '../js/enhanced_photography_api.js',
         'common.idl',
         'common_utils.cc',
@@ -32,8 +44,16 @@
         "depth_mask_object.cc",
         "depth_mask_object.h",
         'depth_photo.idl',
+        'depth_photo_cache.cc',
+        'depth_photo_cache.h',
         'depth_photo_object.cc',
         'depth_photo_object.h',
+        'depth_preview.cc',
+        'depth_preview.h',
+        'depth_quality_kernels.cc',
+        'depth_quality_kernels.h',
+        'depth_quality_map.cc',
+        'depth_quality_map.h',
         'depth_refocus.idl',
         'depth_refocus_object.cc',
         'depth_refocus_object.h',
@@ -41,28 +61,59 @@
         'enhanced_photography_extension.h',
         'enhanced_photography_instance.cc',
         'enhanced_photography_instance.h',
+        'image_encoder.cc',
+        'image_encoder.h',
         'measurement.idl',
         'measurement_object.cc',
         'measurement_object.h',
         'motion_effect.idl',
         'motion_effect_object.cc',
         'motion_effect_object.h',
+        'motion_poses.cc',
+        'motion_poses.h',
+        'object_sequence.cc',
+        'object_sequence.h',
         'paster.idl',
         'paster_object.cc',
         'paster_object.h',
         'photo_capture.idl',
         'photo_capture_object.cc',
         'photo_capture_object.h',
+        'photo_graph.cc',
+        'photo_graph.h',
         'photo_utils.idl',
         'photo_utils_object.cc',
         'photo_utils_object.h',
         'segmentation.idl',
         'segmentation_object.cc',
         'segmentation_object.h',
+        'xdm_container_reader.cc',
+        'xdm_container_reader.h',
         'xdm_utils.idl',
         'xdm_utils_object.cc',
         'xdm_utils_object.h',
       ],
     },
+    {
+      # The parts of the extension which don't need the SDK.
+      'target_name': 'enhanced_photography_unittests',
+      'type': 'executable',
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/base/base.gyp:run_all_unittests',
+        '<(DEPTH)/testing/gtest.gyp:gtest',
+      ],
+      'include_dirs': [
+        '../../..',
+      ],
+      'sources': [
+        'depth_quality_kernels.cc',
+        'depth_quality_kernels.h',
+        'depth_quality_kernels_unittest.cc',
+        'motion_poses.cc',
+        'motion_poses.h',
+        'motion_poses_unittest.cc',
+      ],
+    },
   ],
 }
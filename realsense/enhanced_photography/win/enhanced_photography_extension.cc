@@ -17,6 +17,8 @@ xwalk::common::Extension* CreateExtension() {
 
 // This will be generated from common_api.js
 extern const char kSource_common_api[];
+// This will be generated from depth_codec_api.js.
+extern const char kSource_depth_codec_api[];
 // This will be generated from enhanced_photography_api.js.
 extern const char kSource_enhanced_photography_api[];
 
@@ -26,6 +28,7 @@ namespace enhanced_photography {
 EnhancedPhotographyExtension::EnhancedPhotographyExtension() {
   SetExtensionName("realsense.DepthEnabledPhotography");
   std::string jsapi(kSource_common_api);
+  jsapi += kSource_depth_codec_api;
   jsapi += kSource_enhanced_photography_api;
   SetJavaScriptAPI(jsapi.c_str());
 }
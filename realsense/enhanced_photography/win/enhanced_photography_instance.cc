@@ -24,7 +24,10 @@
 #include "xdm_utils.h" // NOLINT
 
 #include "base/json/json_string_value_serializer.h"
+#include "base/sys_info.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/depth_mask_object.h"
+#include "realsense/enhanced_photography/win/depth_photo_cache.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
 #include "realsense/enhanced_photography/win/depth_refocus_object.h"
 #include "realsense/enhanced_photography/win/measurement_object.h"
@@ -40,11 +43,17 @@ using namespace xwalk::common; // NOLINT
 namespace enhanced_photography {
 
 EnhancedPhotographyInstance::EnhancedPhotographyInstance()
-    : handler_(this),
+    : trace_recording_("enhanced_photography"),
+      memory_report_("enhanced_photography"),
+      depth_photo_released_(&depth_photos_lock_),
+      handler_(this),
       session_(nullptr),
       store_(&handler_),
-      ep_ext_thread_("EPExtensionThread") {
+      ep_ext_thread_("EPExtensionThread"),
+      worker_pool_(new base::SequencedWorkerPool(
+          base::SysInfo::NumberOfProcessors(), "EPWorker")) {
   ep_ext_thread_.Start();
+  photo_cache_.reset(new DepthPhotoCache(this));
   handler_.Register("measurementConstructor",
       base::Bind(&EnhancedPhotographyInstance::OnMeasurementConstructor,
                  base::Unretained(this)));
@@ -78,9 +87,12 @@ EnhancedPhotographyInstance::EnhancedPhotographyInstance()
 }
 
 EnhancedPhotographyInstance::~EnhancedPhotographyInstance() {
-  if (session_)
-    session_->Release();
+  // Run the pending operations first, they may still post new objects to
+  // ep_ext_thread_.
+  worker_pool_->Shutdown();
   ep_ext_thread_.Stop();
+  if (session_)
+    realsense::common::ReleaseSharedSession(session_);
 }
 
 void EnhancedPhotographyInstance::HandleMessage(const char* msg) {
@@ -103,6 +115,9 @@ void EnhancedPhotographyInstance::HandleMessage(const char* msg) {
 
 void EnhancedPhotographyInstance::HandleBinaryMessage(
     const char* msg, const size_t size) {
+  // |msg| is only valid during this call, so this is the one copy of the
+  // payload. From here on its ownership is passed along with the message and
+  // the handlers read it in place.
   scoped_ptr<base::Value> value = scoped_ptr<base::Value>(
       base::BinaryValue::CreateWithCopiedBuffer(msg, size));
 
@@ -135,7 +150,7 @@ bool EnhancedPhotographyInstance::IsRSSDKInstalled() {
   if (session_)
     return true;
 
-  session_ = PXCSession::CreateInstance();
+  session_ = realsense::common::AcquireSharedSession();
   if (!session_) {
     return false;
   }
@@ -144,18 +159,24 @@ bool EnhancedPhotographyInstance::IsRSSDKInstalled() {
 
 void EnhancedPhotographyInstance::OnHandleMessage(scoped_ptr<base::Value> msg) {
   DCHECK_EQ(ep_ext_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense",
+               "EnhancedPhotographyInstance::OnHandleMessage");
   handler_.HandleMessage(msg.Pass());
 }
 
 void EnhancedPhotographyInstance::OnHandleBinaryMessage(
     scoped_ptr<base::Value> msg) {
   DCHECK_EQ(ep_ext_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense",
+               "EnhancedPhotographyInstance::OnHandleBinaryMessage");
   handler_.HandleBinaryMessage(msg.Pass());
 }
 
 void EnhancedPhotographyInstance::OnHandleSyncMessage(
     scoped_ptr<base::Value> msg) {
   DCHECK_EQ(ep_ext_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense",
+               "EnhancedPhotographyInstance::OnHandleSyncMessage");
   handler_.HandleSyncMessage(msg.Pass());
 }
 
@@ -215,8 +236,8 @@ void EnhancedPhotographyInstance::OnDepthPhotoConstructor(
       Params> params(jsapi::depth_photo::DepthPhotoConstructor::
           Params::Create(*info->arguments()));
 
-  scoped_ptr<BindingObject> obj(new DepthPhotoObject(this));
-  store_.AddBindingObject(params->object_id, obj.Pass());
+  scoped_ptr<DepthPhotoObject> obj(new DepthPhotoObject(this));
+  AddDepthPhotoObject(params->object_id, obj.Pass());
 
   result.reset(new base::FundamentalValue(true));
   info->PostResult(result.Pass());
@@ -351,12 +372,67 @@ void EnhancedPhotographyInstance::OnXDMUtilsConstructor(
 
 void EnhancedPhotographyInstance::AddBindingObject(const std::string& object_id,
     scoped_ptr<BindingObject> obj) {
+  if (base::MessageLoop::current() != ep_ext_thread_.message_loop()) {
+    ep_ext_thread_.message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&EnhancedPhotographyInstance::AddBindingObject,
+                   base::Unretained(this),
+                   object_id,
+                   base::Passed(&obj)));
+    return;
+  }
   store_.AddBindingObject(object_id, obj.Pass());
 }
 
-BindingObject* EnhancedPhotographyInstance::GetBindingObjectById(
+void EnhancedPhotographyInstance::AddDepthPhotoObject(
+    const std::string& object_id, scoped_ptr<DepthPhotoObject> obj) {
+  {
+    // Registered right away, so that the photo can be used as soon as its id
+    // is posted to JavaScript.
+    base::AutoLock lock(depth_photos_lock_);
+    depth_photos_[object_id] = obj.get();
+  }
+  AddBindingObject(object_id, obj.Pass());
+}
+
+DepthPhotoObject* EnhancedPhotographyInstance::AcquireDepthPhoto(
     const std::string& object_id) {
-  return store_.GetBindingObjectById(object_id);
+  base::AutoLock lock(depth_photos_lock_);
+  std::map<std::string, DepthPhotoObject*>::iterator it =
+      depth_photos_.find(object_id);
+  if (it == depth_photos_.end())
+    return nullptr;
+  ++depth_photo_users_[it->second];
+  return it->second;
+}
+
+void EnhancedPhotographyInstance::ReleaseDepthPhoto(DepthPhotoObject* obj) {
+  base::AutoLock lock(depth_photos_lock_);
+  std::map<DepthPhotoObject*, int>::iterator it = depth_photo_users_.find(obj);
+  DCHECK(it != depth_photo_users_.end());
+  if (--it->second == 0) {
+    depth_photo_users_.erase(it);
+    depth_photo_released_.Broadcast();
+  }
+}
+
+void EnhancedPhotographyInstance::RemoveDepthPhoto(DepthPhotoObject* obj) {
+  base::AutoLock lock(depth_photos_lock_);
+  for (std::map<std::string, DepthPhotoObject*>::iterator it =
+       depth_photos_.begin(); it != depth_photos_.end(); ++it) {
+    if (it->second == obj) {
+      depth_photos_.erase(it);
+      break;
+    }
+  }
+  while (depth_photo_users_.find(obj) != depth_photo_users_.end())
+    depth_photo_released_.Wait();
+}
+
+scoped_refptr<base::SequencedTaskRunner>
+EnhancedPhotographyInstance::CreateSequencedTaskRunner() {
+  return worker_pool_->GetSequencedTaskRunner(
+      worker_pool_->GetSequenceToken());
 }
 
 }  // namespace enhanced_photography
@@ -5,11 +5,20 @@
 #ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_ENHANCED_PHOTOGRAPHY_INSTANCE_H_
 #define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_ENHANCED_PHOTOGRAPHY_INSTANCE_H_
 
+#include <map>
 #include <string>
 
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/sequenced_task_runner.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/sequenced_worker_pool.h"
 #include "base/threading/thread.h"
 #include "base/values.h"
 #include "third_party/libpxc/include/pxcsession.h"
+#include "realsense/common/memory_accounting.h"
+#include "realsense/common/trace_recorder.h"
 #include "xwalk/common/extension.h"
 #include "xwalk/common/binding_object_store.h"
 #include "xwalk/common/xwalk_extension_function_handler.h"
@@ -20,6 +29,9 @@ namespace enhanced_photography {
 using xwalk::common::Instance;
 using xwalk::common::XWalkExtensionFunctionInfo;
 
+class DepthPhotoCache;
+class DepthPhotoObject;
+
 class EnhancedPhotographyInstance : public Instance {
  public:
   EnhancedPhotographyInstance();
@@ -30,11 +42,26 @@ class EnhancedPhotographyInstance : public Instance {
   void HandleBinaryMessage(const char* msg, const size_t size) override;
   void HandleSyncMessage(const char* msg) override;
 
+  // Can be called from any thread, the object is added on ep_ext_thread_.
   void AddBindingObject(const std::string& object_id,
       scoped_ptr<xwalk::common::BindingObject> obj);
+  void AddDepthPhotoObject(const std::string& object_id,
+      scoped_ptr<DepthPhotoObject> obj);
+
+  // The DepthPhotoObjects are used by the sequences of other objects, so they
+  // are looked up here rather than in |store_|. An acquired object is not
+  // destroyed before it is released, use ScopedDepthPhoto instead of calling
+  // these directly.
+  DepthPhotoObject* AcquireDepthPhoto(const std::string& object_id);
+  void ReleaseDepthPhoto(DepthPhotoObject* obj);
+  // Blocks until |obj| is released by all the sequences using it.
+  void RemoveDepthPhoto(DepthPhotoObject* obj);
+
+  // Each binding object runs its messages on its own sequence of the shared
+  // worker pool.
+  scoped_refptr<base::SequencedTaskRunner> CreateSequencedTaskRunner();
 
-  xwalk::common::BindingObject* GetBindingObjectById(
-      const std::string& object_id);
+  DepthPhotoCache* photo_cache() { return photo_cache_.get(); }
 
  private:
   void OnHandleMessage(scoped_ptr<base::Value> msg);
@@ -53,9 +80,23 @@ class EnhancedPhotographyInstance : public Instance {
 
   bool IsRSSDKInstalled();
 
+  // Declared first so that the trace is written once the threads below are
+  // stopped.
+  realsense::common::ScopedTraceRecording trace_recording_;
+  // Declared before the objects so that it reports the buffers they leave.
+  realsense::common::ScopedMemoryReport memory_report_;
+
+  // Declared before |store_| as the objects use them while being destroyed.
+  base::Lock depth_photos_lock_;
+  base::ConditionVariable depth_photo_released_;
+  std::map<std::string, DepthPhotoObject*> depth_photos_;
+  std::map<DepthPhotoObject*, int> depth_photo_users_;
+  scoped_ptr<DepthPhotoCache> photo_cache_;
+
   xwalk::common::XWalkExtensionFunctionHandler handler_;
   xwalk::common::BindingObjectStore store_;
   base::Thread ep_ext_thread_;
+  scoped_refptr<base::SequencedWorkerPool> worker_pool_;
   PXCSession* session_;
 };
 
@@ -0,0 +1,215 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/image_encoder.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/trace_event/trace_event.h"
+#include "realsense/common/win/common_utils.h"
+#include "realsense/enhanced_photography/win/common_utils.h"
+#include "third_party/libwebp/webp/encode.h"
+#include "ui/gfx/codec/jpeg_codec.h"
+#include "ui/gfx/codec/png_codec.h"
+#include "ui/gfx/geometry/size.h"
+
+namespace realsense {
+using namespace realsense::common;  // NOLINT
+namespace enhanced_photography {
+
+using jsapi::depth_photo::ImageEncoding;
+using jsapi::depth_photo::ImageEncodingOptions;
+
+namespace {
+
+const int kDefaultQuality = 90;
+const size_t kHeaderSize = 4 * sizeof(int);
+
+int GetFormatCode(ImageEncoding encoding) {
+  switch (encoding) {
+    case ImageEncoding::IMAGE_ENCODING_JPEG:
+      return 1;
+    case ImageEncoding::IMAGE_ENCODING_PNG:
+      return 2;
+    case ImageEncoding::IMAGE_ENCODING_WEBP:
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+// Frees the WebP picture and writer on every exit of EncodeWebP().
+class ScopedWebPPicture {
+ public:
+  ScopedWebPPicture() {
+    // A zeroed picture can be freed even if WebPPictureInit() fails.
+    memset(&picture_, 0, sizeof(picture_));
+    WebPMemoryWriterInit(&writer_);
+  }
+  ~ScopedWebPPicture() {
+    WebPPictureFree(&picture_);
+    WebPMemoryWriterClear(&writer_);
+  }
+
+  WebPPicture* picture() { return &picture_; }
+  WebPMemoryWriter* writer() { return &writer_; }
+
+ private:
+  WebPPicture picture_;
+  WebPMemoryWriter writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedWebPPicture);
+};
+
+bool EncodeWebP(const uint8* bgra, int width, int height, int stride,
+                int quality, std::vector<unsigned char>* output) {
+  WebPConfig config;
+  if (!WebPConfigInit(&config))
+    return false;
+  config.quality = static_cast<float>(quality);
+  // Lets the encoder use a second thread.
+  config.thread_level = 1;
+
+  ScopedWebPPicture scoped_picture;
+  WebPPicture* picture = scoped_picture.picture();
+  if (!WebPPictureInit(picture))
+    return false;
+  picture->width = width;
+  picture->height = height;
+  if (!WebPPictureImportBGRA(picture, bgra, stride))
+    return false;
+
+  WebPMemoryWriter* writer = scoped_picture.writer();
+  picture->writer = WebPMemoryWrite;
+  picture->custom_ptr = writer;
+  if (!WebPEncode(&config, picture))
+    return false;
+  output->assign(writer->mem, writer->mem + writer->size);
+  return true;
+}
+
+bool EncodeBGRA(const uint8* bgra, int width, int height, int stride,
+                ImageEncoding encoding, int quality,
+                std::vector<unsigned char>* output) {
+  switch (encoding) {
+    case ImageEncoding::IMAGE_ENCODING_JPEG:
+      return gfx::JPEGCodec::Encode(bgra, gfx::JPEGCodec::FORMAT_BGRA,
+                                    width, height, stride, quality, output);
+    case ImageEncoding::IMAGE_ENCODING_PNG:
+      return gfx::PNGCodec::Encode(bgra, gfx::PNGCodec::FORMAT_BGRA,
+                                   gfx::Size(width, height), stride, false,
+                                   std::vector<gfx::PNGCodec::Comment>(),
+                                   output);
+    case ImageEncoding::IMAGE_ENCODING_WEBP:
+      return EncodeWebP(bgra, width, height, stride, quality, output);
+    default:
+      return false;
+  }
+}
+
+// The codecs take color pixels only, so the masks are expanded to opaque
+// gray BGRA.
+bool ExpandMask(PXCImage* image, std::vector<uint8>* bgra) {
+  PXCImage::ImageInfo info = image->QueryInfo();
+  if (info.width <= 0 || info.height <= 0)
+    return false;
+  PXCImage::ImageData data;
+  if (image->AcquireAccess(PXCImage::ACCESS_READ, info.format, &data) <
+      PXC_STATUS_NO_ERROR)
+    return false;
+
+  bgra->resize(static_cast<size_t>(info.width) * info.height * 4);
+  uint8* out = &(*bgra)[0];
+  for (int y = 0; y < info.height; ++y) {
+    const uint8* row = data.planes[0] + data.pitches[0] * y;
+    for (int x = 0; x < info.width; ++x) {
+      uint8 value;
+      if (info.format == PXCImage::PIXEL_FORMAT_Y8) {
+        value = row[x];
+      } else {
+        float f = reinterpret_cast<const float*>(row)[x];
+        value = static_cast<uint8>(std::min(std::max(f, 0.0f), 1.0f) * 255);
+      }
+      *out++ = value;
+      *out++ = value;
+      *out++ = value;
+      *out++ = 0xFF;
+    }
+  }
+  image->ReleaseAccess(&data);
+  return true;
+}
+
+// Returns nullptr if |image| can't be encoded.
+scoped_ptr<base::ListValue> CreateEncodedImageResult(
+    PXCImage* image,
+    const ImageEncodingOptions& options) {
+  TRACE_EVENT0("realsense", "CreateEncodedImageResult");
+  int format_code = GetFormatCode(options.format);
+  if (!image || format_code == 0)
+    return nullptr;
+  int quality = options.quality ?
+      std::min(std::max(*options.quality, 0), 100) : kDefaultQuality;
+
+  PXCImage::ImageInfo info = image->QueryInfo();
+  std::vector<unsigned char> encoded;
+  bool success = false;
+  if (info.format == PXCImage::PIXEL_FORMAT_RGB24 ||
+      info.format == PXCImage::PIXEL_FORMAT_RGB32) {
+    // PIXEL_FORMAT_RGB32 is BGRA in memory, which the codecs read with the
+    // pitch of the plane, without an intermediate copy.
+    PXCImage::ImageData data;
+    if (image->AcquireAccess(PXCImage::ACCESS_READ,
+        PXCImage::PIXEL_FORMAT_RGB32, &data) < PXC_STATUS_NO_ERROR)
+      return nullptr;
+    success = EncodeBGRA(data.planes[0], info.width, info.height,
+                         data.pitches[0], options.format, quality, &encoded);
+    image->ReleaseAccess(&data);
+  } else if (info.format == PXCImage::PIXEL_FORMAT_Y8 ||
+             info.format == PXCImage::PIXEL_FORMAT_DEPTH_F32) {
+    std::vector<uint8> bgra;
+    success = ExpandMask(image, &bgra) &&
+        EncodeBGRA(&bgra[0], info.width, info.height, info.width * 4,
+                   options.format, quality, &encoded);
+  }
+  if (!success || encoded.empty())
+    return nullptr;
+
+  size_t size = kHeaderSize + encoded.size();
+  scoped_ptr<char[]> buffer(new char[size]);
+  int* int_array = reinterpret_cast<int*>(buffer.get());
+  int_array[1] = info.width;
+  int_array[2] = info.height;
+  int_array[3] = format_code;
+  memcpy(buffer.get() + kHeaderSize, &encoded[0], encoded.size());
+
+  scoped_ptr<base::ListValue> result(new base::ListValue());
+  result->Append(new base::BinaryValue(buffer.Pass(), size));
+  return result.Pass();
+}
+
+}  // namespace
+
+bool IsImageEncodingRequested(
+    const scoped_ptr<ImageEncodingOptions>& options) {
+  return options && GetFormatCode(options->format) != 0;
+}
+
+void PostEncodedImage(PXCImage* image,
+                      const ImageEncodingOptions& options,
+                      scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<base::ListValue> result(
+      CreateEncodedImageResult(image, options));
+  if (!result) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  info->PostResult(result.Pass());
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
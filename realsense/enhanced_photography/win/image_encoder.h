@@ -0,0 +1,37 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_IMAGE_ENCODER_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_IMAGE_ENCODER_H_
+
+#include "base/memory/scoped_ptr.h"
+#include "base/values.h"
+// This file is auto-generated by depth_photo.idl
+#include "depth_photo.h" // NOLINT
+#include "third_party/libpxc/include/pxcimage.h"
+#include "xwalk/common/xwalk_extension_function_handler.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+using xwalk::common::XWalkExtensionFunctionInfo;
+
+// Whether |options| asks for a compressed image rather than raw pixels.
+bool IsImageEncodingRequested(
+    const scoped_ptr<jsapi::depth_photo::ImageEncodingOptions>& options);
+
+// Posts |image| compressed as |options| asks, or an exception if it can't
+// be encoded. Color images are encoded straight from their plane, masks (Y8,
+// or F32 from 0 to 1) are encoded as gray.
+//
+// binary image message: call_id (i32), width (i32), height (i32),
+// format (i32, 1 for jpeg, 2 for png, 3 for webp), then the encoded image.
+void PostEncodedImage(PXCImage* image,
+                      const jsapi::depth_photo::ImageEncodingOptions& options,
+                      scoped_ptr<XWalkExtensionFunctionInfo> info);
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_IMAGE_ENCODER_H_
@@ -4,10 +4,17 @@
 
 #include "realsense/enhanced_photography/win/measurement_object.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
+#include <vector>
 
+#include "base/atomicops.h"
 #include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/sys_info.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
 
@@ -15,28 +22,158 @@ namespace realsense {
 using namespace realsense::common;  // NOLINT
 namespace enhanced_photography {
 
+namespace {
+
+// A task measures at least this many pairs, smaller batches are not worth
+// spreading over several cores.
+const size_t kMinPairsPerTask = 16;
+
+// The pairs of one measureDistances() call. The pairs are measured by tasks
+// running in parallel, each with its own Measurement instance, on a snapshot
+// of the photo. The result is posted when the last task drops its reference.
+class DistanceBatch : public base::RefCountedThreadSafe<DistanceBatch> {
+ public:
+  // Result layout: call_id (i32), pair count (i32), then for each pair the
+  // distance, confidence, start x, y, z and end x, y, z (f32). The distance
+  // is NaN if the pair can't be measured.
+  static const size_t kHeaderSize = 2 * sizeof(int);
+  static const size_t kValuesPerPair = 8;
+
+  DistanceBatch(scoped_ptr<XWalkExtensionFunctionInfo> info,
+                const scoped_refptr<SharedPhoto>& photo,
+                const int* pairs,
+                size_t count)
+      : info_(info.Pass()),
+        photo_(photo),
+        pairs_(pairs, pairs + 4 * count),
+        session_(AcquireSharedSession()),
+        failed_(0) {
+    size_ = kHeaderSize + count * kValuesPerPair * sizeof(float);
+    buffer_.reset(new char[size_]);
+    int* int_array = reinterpret_cast<int*>(buffer_.get());
+    int_array[1] = static_cast<int>(count);
+  }
+
+  size_t size() const { return pairs_.size() / 4; }
+
+  // Measures the pairs |first|, |first| + |stride|, ... in |photo| with
+  // |measurement|.
+  void Measure(PXCEnhancedPhoto::Measurement* measurement,
+               PXCPhoto* photo,
+               size_t first,
+               size_t stride) {
+    float* values = reinterpret_cast<float*>(buffer_.get() + kHeaderSize);
+    for (size_t i = first; i < size(); i += stride) {
+      const int* pair = &pairs_[4 * i];
+      PXCPointI32 start = { pair[0], pair[1] };
+      PXCPointI32 end = { pair[2], pair[3] };
+      PXCEnhancedPhoto::Measurement::MeasureData data;
+      float* out = values + kValuesPerPair * i;
+      if (measurement->MeasureDistance(photo, start, end, &data) !=
+          PXC_STATUS_NO_ERROR) {
+        std::fill(out, out + kValuesPerPair, 0.0f);
+        out[0] = std::numeric_limits<float>::quiet_NaN();
+        continue;
+      }
+      out[0] = data.distance;
+      out[1] = data.confidence;
+      out[2] = data.startPoint.coord.x;
+      out[3] = data.startPoint.coord.y;
+      out[4] = data.startPoint.coord.z;
+      out[5] = data.endPoint.coord.x;
+      out[6] = data.endPoint.coord.y;
+      out[7] = data.endPoint.coord.z;
+    }
+  }
+
+  // Measures in the snapshot of the batch, on the sequence of the object.
+  void Measure(PXCEnhancedPhoto::Measurement* measurement,
+               size_t first,
+               size_t stride) {
+    Measure(measurement, photo_->get(), first, stride);
+  }
+
+  // Measures with a Measurement instance of its own, in |photo|, a copy no
+  // other task reads, so that it can run concurrently with the others. As
+  // for MotionEffect, the SDK does not document concurrent readers of a
+  // photo as safe.
+  void MeasureWithNewInstance(const scoped_refptr<SharedPhoto>& photo,
+                              size_t first,
+                              size_t stride) {
+    PXCEnhancedPhoto::Measurement* measurement = session_ ?
+        PXCEnhancedPhoto::Measurement::CreateInstance(session_) : nullptr;
+    if (!measurement) {
+      Fail();
+      return;
+    }
+    Measure(measurement, photo->get(), first, stride);
+    measurement->Release();
+  }
+
+  void Fail() { base::subtle::Release_Store(&failed_, 1); }
+
+ private:
+  friend class base::RefCountedThreadSafe<DistanceBatch>;
+
+  ~DistanceBatch() {
+    if (base::subtle::Acquire_Load(&failed_)) {
+      info_->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    } else {
+      scoped_ptr<base::ListValue> result(new base::ListValue());
+      result->Append(new base::BinaryValue(buffer_.Pass(), size_));
+      info_->PostResult(result.Pass());
+    }
+    photo_->RemoveSharer();
+    if (session_)
+      ReleaseSharedSession(session_);
+  }
+
+  scoped_ptr<XWalkExtensionFunctionInfo> info_;
+  scoped_refptr<SharedPhoto> photo_;
+  // start x, y, end x, y per pair.
+  std::vector<int> pairs_;
+  PXCSession* session_;
+  scoped_ptr<char[]> buffer_;
+  size_t size_;
+  base::subtle::Atomic32 failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(DistanceBatch);
+};
+
+}  // namespace
+
 MeasurementObject::MeasurementObject(
     EnhancedPhotographyInstance* instance)
         : session_(nullptr),
-          instance_(instance) {
+          instance_(instance),
+          sequence_(instance) {
   handler_.Register("measureDistance",
-                    base::Bind(&MeasurementObject::OnMeasureDistance,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &MeasurementObject::OnMeasureDistance,
+                        base::Unretained(this))));
+  handler_.Register("measureDistances",
+                    sequence_.Wrap(base::Bind(
+                        &MeasurementObject::OnMeasureDistances,
+                        base::Unretained(this))));
   handler_.Register("measureUADistance",
-                    base::Bind(&MeasurementObject::OnMeasureUADistance,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &MeasurementObject::OnMeasureUADistance,
+                        base::Unretained(this))));
   handler_.Register("queryUADataSize",
-                    base::Bind(&MeasurementObject::OnQueryUADataSize,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &MeasurementObject::OnQueryUADataSize,
+                        base::Unretained(this))));
   handler_.Register("queryUAData",
-                    base::Bind(&MeasurementObject::OnQueryUAData,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &MeasurementObject::OnQueryUAData,
+                        base::Unretained(this))));
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   measurement_ = PXCEnhancedPhoto::Measurement::CreateInstance(session_);
 }
 
 MeasurementObject::~MeasurementObject() {
+  sequence_.Flush();
   ReleaseResources();
 }
 
@@ -50,9 +187,8 @@ void MeasurementObject::OnMeasureDistance(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -77,6 +213,77 @@ void MeasurementObject::OnMeasureDistance(
       measure_data, std::string()));
 }
 
+void MeasurementObject::OnMeasureDistances(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  const base::Value* value = NULL;
+  if (!info->arguments()->Get(0, &value) ||
+      !value->IsType(base::Value::TYPE_BINARY)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  // photoIdLen (i32), photoId (aligned to 4 bytes), pair count (i32), then
+  // start x, y and end x, y (i32) per pair.
+  const base::BinaryValue* binary_value =
+      static_cast<const base::BinaryValue*>(value);
+  const char* data = binary_value->GetBuffer();
+  const size_t size = binary_value->GetSize();
+  if (size < sizeof(int)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+  int object_id_len = reinterpret_cast<const int*>(data)[0];
+  size_t offset = sizeof(int) + object_id_len + 4 - object_id_len % 4;
+  if (object_id_len < 0 || offset + sizeof(int) > size) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+  std::string object_id(data + sizeof(int), object_id_len);
+  int count = reinterpret_cast<const int*>(data + offset)[0];
+  offset += sizeof(int);
+  if (count <= 0 ||
+      static_cast<size_t>(count) > (size - offset) / (4 * sizeof(int))) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  scoped_refptr<SharedPhoto> photo;
+  {
+    ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+    if (depthPhotoObject.get())
+      photo = depthPhotoObject->SnapshotPhoto();
+  }
+  if (!photo) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
+
+  DCHECK(measurement_);
+  scoped_refptr<DistanceBatch> batch(new DistanceBatch(
+      info.Pass(), photo, reinterpret_cast<const int*>(data + offset),
+      count));
+
+  // One task per processor, the first one runs on this sequence with the
+  // Measurement instance of the object and the snapshot, the others each
+  // get a copy of the snapshot.
+  size_t tasks = std::min(
+      (batch->size() + kMinPairsPerTask - 1) / kMinPairsPerTask,
+      static_cast<size_t>(base::SysInfo::NumberOfProcessors()));
+  for (size_t i = 1; i < tasks; ++i) {
+    PXCPhoto* copy = session_->CreatePhoto();
+    if (!copy) {
+      batch->Fail();
+      break;
+    }
+    copy->CopyPhoto(photo->get());
+    instance_->CreateSequencedTaskRunner()->PostTask(
+        FROM_HERE, base::Bind(&DistanceBatch::MeasureWithNewInstance, batch,
+                              make_scoped_refptr(new SharedPhoto(copy)),
+                              i, tasks));
+  }
+  batch->Measure(measurement_, 0, tasks);
+}
+
 void MeasurementObject::OnMeasureUADistance(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   scoped_ptr<MeasureUADistance::Params> params(
@@ -87,9 +294,8 @@ void MeasurementObject::OnMeasureUADistance(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -161,7 +367,7 @@ void MeasurementObject::ReleaseResources() {
     measurement_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -9,6 +9,7 @@
 #include "measurement.h"  // NOLINT
 
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 
@@ -25,6 +26,7 @@ class MeasurementObject : public xwalk::common::BindingObject {
 
  private:
   void OnMeasureDistance(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnMeasureDistances(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnMeasureUADistance(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnQueryUADataSize(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnQueryUAData(scoped_ptr<XWalkExtensionFunctionInfo> info);
@@ -37,6 +39,7 @@ class MeasurementObject : public xwalk::common::BindingObject {
   PXCEnhancedPhoto::Measurement* measurement_;
 
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
 };
 
 }  // namespace enhanced_photography
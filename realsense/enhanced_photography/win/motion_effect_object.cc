@@ -4,36 +4,199 @@
 
 #include "realsense/enhanced_photography/win/motion_effect_object.h"
 
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/memory/linked_ptr.h"
+#include "base/memory/ref_counted.h"
+#include "base/sys_info.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
+#include "realsense/enhanced_photography/win/image_encoder.h"
+#include "realsense/enhanced_photography/win/motion_poses.h"
 
 namespace realsense {
 using namespace realsense::common;  // NOLINT
 namespace enhanced_photography {
 
+namespace {
+
+// Upper bounds of one renderSequence() call, checked before anything is
+// allocated: the frames take a single buffer, which is then copied into the
+// result message.
+const int kMaxSequenceFrames = 300;
+const int64 kMaxSequenceSize = 512 * 1024 * 1024;
+
+void GetKeyframePoses(const std::vector<linked_ptr<Keyframe>>& keyframes,
+                      std::vector<MotionPose>* poses) {
+  poses->resize(keyframes.size());
+  for (size_t i = 0; i < keyframes.size(); ++i) {
+    const Keyframe& keyframe = *keyframes[i];
+    MotionPose& pose = (*poses)[i];
+    pose.motion[0] = keyframe.motion.horizontal;
+    pose.motion[1] = keyframe.motion.vertical;
+    pose.motion[2] = keyframe.motion.distance;
+    pose.rotation[0] = keyframe.rotation.pitch;
+    pose.rotation[1] = keyframe.rotation.yaw;
+    pose.rotation[2] = keyframe.rotation.roll;
+    pose.zoom = keyframe.zoom;
+  }
+}
+
+// The frames of one renderSequence() call, rendered by several tasks into a
+// single buffer. The result is posted when the last task drops its
+// reference.
+class FrameSequence : public base::RefCountedThreadSafe<FrameSequence> {
+ public:
+  // Result layout: call_id (i32), frame count (i32), width (i32),
+  // height (i32), then the RGBA pixels of each frame.
+  static const size_t kHeaderSize = 4 * sizeof(int);
+
+  // The size of the result for |frame_count| frames of |width| x |height|.
+  static int64 GetSize(int width, int height, int frame_count) {
+    return kHeaderSize +
+        static_cast<int64>(width) * height * 4 * frame_count;
+  }
+
+  // |buffer| holds GetSize() bytes.
+  FrameSequence(scoped_ptr<XWalkExtensionFunctionInfo> info,
+                std::vector<MotionPose>* poses,
+                int width,
+                int height,
+                scoped_ptr<char[]> buffer)
+      : info_(info.Pass()),
+        width_(width),
+        height_(height),
+        frame_size_(static_cast<size_t>(width) * height * 4),
+        buffer_(buffer.Pass()),
+        failed_(0) {
+    poses_.swap(*poses);
+    size_ = kHeaderSize + frame_size_ * poses_.size();
+    int* int_array = reinterpret_cast<int*>(buffer_.get());
+    int_array[1] = static_cast<int>(poses_.size());
+    int_array[2] = width_;
+    int_array[3] = height_;
+  }
+
+  size_t size() const { return poses_.size(); }
+
+  bool CopyFrame(size_t index, PXCImage* image) {
+    PXCImage::ImageInfo info = image->QueryInfo();
+    if (info.width != width_ || info.height != height_)
+      return false;
+    return CopyColorImageToRGBA(image, reinterpret_cast<uint8*>(
+        buffer_.get() + kHeaderSize + frame_size_ * index));
+  }
+
+  // Renders the frames |first|, |first| + |stride|, ... with |effect|. Each
+  // frame is written by a single task.
+  void Render(PXCEnhancedPhoto::MotionEffect* effect,
+              size_t first,
+              size_t stride) {
+    for (size_t i = first; i < poses_.size(); i += stride) {
+      if (base::subtle::Acquire_Load(&failed_))
+        return;
+      MotionPose& pose = poses_[i];
+      PXCImage* image = effect->Apply(pose.motion, pose.rotation, pose.zoom);
+      bool copied = image && CopyFrame(i, image);
+      if (image)
+        image->Release();
+      if (!copied) {
+        Fail();
+        return;
+      }
+    }
+  }
+
+  // Renders with a MotionEffect instance of its own, initialized with
+  // |photo|, a copy no other instance reads, so that it can run concurrently
+  // with the others.
+  void RenderWithNewEffect(const scoped_refptr<SharedPhoto>& photo,
+                           size_t first,
+                           size_t stride) {
+    PXCSession* session = AcquireSharedSession();
+    PXCEnhancedPhoto::MotionEffect* effect =
+        session ? PXCEnhancedPhoto::MotionEffect::CreateInstance(session)
+                : nullptr;
+    bool initialized =
+        effect && effect->Init(photo->get()) >= PXC_STATUS_NO_ERROR;
+    if (initialized)
+      Render(effect, first, stride);
+    else
+      Fail();
+    if (effect)
+      effect->Release();
+    if (session)
+      ReleaseSharedSession(session);
+  }
+
+  void Fail() { base::subtle::Release_Store(&failed_, 1); }
+
+ private:
+  friend class base::RefCountedThreadSafe<FrameSequence>;
+
+  ~FrameSequence() {
+    if (base::subtle::Acquire_Load(&failed_)) {
+      info_->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+      return;
+    }
+    scoped_ptr<base::ListValue> result(new base::ListValue());
+    result->Append(new base::BinaryValue(buffer_.Pass(), size_));
+    info_->PostResult(result.Pass());
+  }
+
+  scoped_ptr<XWalkExtensionFunctionInfo> info_;
+  std::vector<MotionPose> poses_;
+  int width_;
+  int height_;
+  size_t frame_size_;
+  scoped_ptr<char[]> buffer_;
+  size_t size_;
+  base::subtle::Atomic32 failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrameSequence);
+};
+
+}  // namespace
+
 MotionEffectObject::MotionEffectObject(EnhancedPhotographyInstance* instance)
     : session_(nullptr),
       instance_(instance),
-      binary_message_size_(0) {
+      sequence_(instance),
+      photo_(nullptr),
+      binary_message_size_(0),
+      binary_message_memory_("MotionEffect", "binary_message") {
   handler_.Register("init",
-                    base::Bind(&MotionEffectObject::OnInitMotionEffect,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &MotionEffectObject::OnInitMotionEffect,
+                        base::Unretained(this))));
   handler_.Register("apply",
-                    base::Bind(&MotionEffectObject::OnApplyMotionEffect,
-                               base::Unretained(this)));
+                    sequence_.WrapLatest("apply", base::Bind(
+                        &MotionEffectObject::OnApplyMotionEffect,
+                        base::Unretained(this))));
+  handler_.Register("renderSequence",
+                    sequence_.Wrap(base::Bind(
+                        &MotionEffectObject::OnRenderSequence,
+                        base::Unretained(this))));
+  handler_.Register("cancel", sequence_.CancelHandler());
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   motion_effect_ = PXCEnhancedPhoto::MotionEffect::CreateInstance(session_);
 }
 
 MotionEffectObject::~MotionEffectObject() {
+  sequence_.Flush();
   if (motion_effect_) {
     motion_effect_->Release();
     motion_effect_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -50,18 +213,22 @@ void MotionEffectObject::OnInitMotionEffect(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
+  depthPhotoObject->PinPhoto();
+  photo_id_.clear();
+  photo_ = nullptr;
   pxcStatus sts = motion_effect_->Init(depthPhotoObject->GetPhoto());
   if (sts < PXC_STATUS_NO_ERROR) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
+  photo_id_ = object_id;
+  photo_ = depthPhotoObject->GetPhoto();
 
   info->PostResult(CreateSuccessResult());
 }
@@ -87,16 +254,30 @@ void MotionEffectObject::OnApplyMotionEffect(
   rotation[1] = params->rotation.yaw;
   rotation[2] = params->rotation.roll;
 
-  PXCImage* pxcimage = motion_effect_->Apply(motion, rotation, params->zoom);
+  PXCImage* pxcimage;
+  {
+    ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+    if (!module_photo.valid()) {
+      info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+      return;
+    }
+    pxcimage = motion_effect_->Apply(motion, rotation, params->zoom);
+  }
 
   if (!pxcimage) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
 
+  if (IsImageEncodingRequested(params->encoding)) {
+    PostEncodedImage(pxcimage, *params->encoding, info.Pass());
+    pxcimage->Release();
+    return;
+  }
   if (!CopyImageToBinaryMessage(pxcimage,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -110,5 +291,85 @@ void MotionEffectObject::OnApplyMotionEffect(
   pxcimage->Release();
 }
 
+void MotionEffectObject::OnRenderSequence(
+    scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<RenderSequence::Params> params(
+      RenderSequence::Params::Create(*info->arguments()));
+  if (!params || params->keyframes.empty() || params->frame_count <= 0 ||
+      params->frame_count > kMaxSequenceFrames) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+  if (photo_id_.empty()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_INIT_FAILED));
+    return;
+  }
+
+  DCHECK(motion_effect_);
+  std::vector<MotionPose> keyframes;
+  GetKeyframePoses(params->keyframes, &keyframes);
+  std::vector<MotionPose> poses;
+  InterpolateMotionPoses(keyframes, params->frame_count, &poses);
+
+  // Held until the frames of this sequence are rendered.
+  ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+  if (!module_photo.valid()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
+
+  // The first frame gives the size of the buffer.
+  PXCImage* image = motion_effect_->Apply(poses[0].motion,
+                                          poses[0].rotation,
+                                          poses[0].zoom);
+  if (!image) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  PXCImage::ImageInfo image_info = image->QueryInfo();
+  int64 size = FrameSequence::GetSize(image_info.width, image_info.height,
+                                      params->frame_count);
+  if (size > kMaxSequenceSize) {
+    image->Release();
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+  scoped_ptr<char[]> buffer(
+      new (std::nothrow) char[static_cast<size_t>(size)]);
+  if (!buffer) {
+    image->Release();
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
+  scoped_refptr<FrameSequence> frames(new FrameSequence(
+      info.Pass(), &poses, image_info.width, image_info.height,
+      buffer.Pass()));
+  if (!frames->CopyFrame(0, image))
+    frames->Fail();
+  image->Release();
+
+  // One task per processor, the first one runs on this sequence with the
+  // MotionEffect instance already initialized. The SDK does not document
+  // MotionEffect as safe for concurrent readers of a photo, so the other
+  // instances are each given a copy, taken while the photo is locked.
+  size_t tasks = std::min(frames->size() - 1,
+      static_cast<size_t>(base::SysInfo::NumberOfProcessors()));
+  for (size_t i = 1; i < tasks; ++i) {
+    PXCPhoto* copy = session_->CreatePhoto();
+    if (!copy) {
+      frames->Fail();
+      break;
+    }
+    copy->CopyPhoto(photo_);
+    instance_->CreateSequencedTaskRunner()->PostTask(
+        FROM_HERE, base::Bind(&FrameSequence::RenderWithNewEffect, frames,
+                              make_scoped_refptr(new SharedPhoto(copy)),
+                              1 + i, tasks));
+  }
+  if (tasks > 0)
+    frames->Render(motion_effect_, 1, tasks);
+}
+
 }  // namespace enhanced_photography
 }  // namespace realsense
@@ -11,9 +11,12 @@
 // This file is auto-generated by motion_effect.idl
 #include "motion_effect.h" // NOLINT
 
+#include "realsense/common/memory_accounting.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
 #include "third_party/libpxc/include/pxcimage.h"
+#include "third_party/libpxc/include/pxcphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 
 namespace realsense {
@@ -30,13 +33,21 @@ class MotionEffectObject : public xwalk::common::BindingObject {
  private:
   void OnInitMotionEffect(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnApplyMotionEffect(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnRenderSequence(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
   PXCSession* session_;
   PXCEnhancedPhoto::MotionEffect* motion_effect_;
+  // The photo passed to init(), which |motion_effect_| reads under a
+  // ScopedModulePhoto, and of which the extra MotionEffect instances of
+  // renderSequence() are given copies.
+  std::string photo_id_;
+  PXCPhoto* photo_;
 
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
 };
 
 }  // namespace enhanced_photography
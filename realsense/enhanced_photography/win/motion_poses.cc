@@ -0,0 +1,42 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/motion_poses.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+void InterpolateMotionPoses(const std::vector<MotionPose>& keyframes,
+                            int frame_count,
+                            std::vector<MotionPose>* poses) {
+  DCHECK(!keyframes.empty());
+  DCHECK_GT(frame_count, 0);
+  const int last = static_cast<int>(keyframes.size()) - 1;
+  poses->resize(frame_count);
+  for (int i = 0; i < frame_count; ++i) {
+    double t = frame_count > 1 ?
+        static_cast<double>(i) * last / (frame_count - 1) : 0;
+    int k = std::min(static_cast<int>(t), last);
+    int next = std::min(k + 1, last);
+    float weight = static_cast<float>(t - k);
+
+    const MotionPose& from = keyframes[k];
+    const MotionPose& to = keyframes[next];
+    MotionPose& pose = (*poses)[i];
+    for (int j = 0; j < 3; ++j) {
+      pose.motion[j] =
+          from.motion[j] + (to.motion[j] - from.motion[j]) * weight;
+      pose.rotation[j] =
+          from.rotation[j] + (to.rotation[j] - from.rotation[j]) * weight;
+    }
+    pose.zoom = from.zoom + (to.zoom - from.zoom) * weight;
+  }
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
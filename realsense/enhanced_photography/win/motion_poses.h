@@ -0,0 +1,30 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_MOTION_POSES_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_MOTION_POSES_H_
+
+#include <vector>
+
+namespace realsense {
+namespace enhanced_photography {
+
+// Parameters of MotionEffect::Apply() for one frame.
+struct MotionPose {
+  float motion[3];
+  float rotation[3];
+  float zoom;
+};
+
+// Spreads |keyframes| evenly over |frame_count| frames and interpolates the
+// poses in between linearly. |keyframes| must not be empty and
+// |frame_count| must be positive.
+void InterpolateMotionPoses(const std::vector<MotionPose>& keyframes,
+                            int frame_count,
+                            std::vector<MotionPose>* poses);
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_MOTION_POSES_H_
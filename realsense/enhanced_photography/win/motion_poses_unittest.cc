@@ -0,0 +1,104 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/motion_poses.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+namespace {
+
+MotionPose CreatePose(float value) {
+  MotionPose pose;
+  for (int j = 0; j < 3; ++j) {
+    pose.motion[j] = value + j;
+    pose.rotation[j] = -value - j;
+  }
+  pose.zoom = value / 2;
+  return pose;
+}
+
+void ExpectPose(float value, const MotionPose& pose) {
+  MotionPose expected = CreatePose(value);
+  for (int j = 0; j < 3; ++j) {
+    EXPECT_FLOAT_EQ(expected.motion[j], pose.motion[j]);
+    EXPECT_FLOAT_EQ(expected.rotation[j], pose.rotation[j]);
+  }
+  EXPECT_FLOAT_EQ(expected.zoom, pose.zoom);
+}
+
+}  // namespace
+
+TEST(MotionPosesTest, SingleKeyframe) {
+  std::vector<MotionPose> keyframes(1, CreatePose(3));
+  std::vector<MotionPose> poses;
+  InterpolateMotionPoses(keyframes, 4, &poses);
+  ASSERT_EQ(4u, poses.size());
+  for (size_t i = 0; i < poses.size(); ++i)
+    ExpectPose(3, poses[i]);
+}
+
+TEST(MotionPosesTest, SingleFrame) {
+  std::vector<MotionPose> keyframes;
+  keyframes.push_back(CreatePose(1));
+  keyframes.push_back(CreatePose(5));
+  std::vector<MotionPose> poses;
+  InterpolateMotionPoses(keyframes, 1, &poses);
+  ASSERT_EQ(1u, poses.size());
+  ExpectPose(1, poses[0]);
+}
+
+TEST(MotionPosesTest, KeyframesOnFrames) {
+  // The keyframes land on the frames 0, 2 and 4, the others are halfway.
+  std::vector<MotionPose> keyframes;
+  keyframes.push_back(CreatePose(0));
+  keyframes.push_back(CreatePose(4));
+  keyframes.push_back(CreatePose(2));
+  std::vector<MotionPose> poses;
+  InterpolateMotionPoses(keyframes, 5, &poses);
+  ASSERT_EQ(5u, poses.size());
+  ExpectPose(0, poses[0]);
+  ExpectPose(2, poses[1]);
+  ExpectPose(4, poses[2]);
+  ExpectPose(3, poses[3]);
+  ExpectPose(2, poses[4]);
+}
+
+TEST(MotionPosesTest, KeyframesBetweenFrames) {
+  // Two keyframes over four frames, a third of the way apart.
+  std::vector<MotionPose> keyframes;
+  keyframes.push_back(CreatePose(0));
+  keyframes.push_back(CreatePose(3));
+  std::vector<MotionPose> poses;
+  InterpolateMotionPoses(keyframes, 4, &poses);
+  ASSERT_EQ(4u, poses.size());
+  for (size_t i = 0; i < poses.size(); ++i)
+    ExpectPose(static_cast<float>(i), poses[i]);
+}
+
+TEST(MotionPosesTest, MoreKeyframesThanFrames) {
+  // The first and the last keyframes are always rendered.
+  std::vector<MotionPose> keyframes;
+  for (int i = 0; i < 5; ++i)
+    keyframes.push_back(CreatePose(static_cast<float>(i)));
+  std::vector<MotionPose> poses;
+  InterpolateMotionPoses(keyframes, 2, &poses);
+  ASSERT_EQ(2u, poses.size());
+  ExpectPose(0, poses[0]);
+  ExpectPose(4, poses[1]);
+}
+
+TEST(MotionPosesTest, ReplacesPreviousPoses) {
+  std::vector<MotionPose> keyframes(1, CreatePose(1));
+  std::vector<MotionPose> poses(8, CreatePose(7));
+  InterpolateMotionPoses(keyframes, 2, &poses);
+  ASSERT_EQ(2u, poses.size());
+  ExpectPose(1, poses[0]);
+  ExpectPose(1, poses[1]);
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
@@ -0,0 +1,155 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/object_sequence.h"
+
+#include "base/atomic_sequence_num.h"
+#include "base/bind.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/trace_event/trace_event.h"
+#include "realsense/common/win/common_utils.h"
+#include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+
+namespace realsense {
+using namespace realsense::common;  // NOLINT
+namespace enhanced_photography {
+
+namespace {
+
+// Ties the posting of an operation to its run on the worker pool in traces.
+base::StaticAtomicSequenceNumber g_next_flow_id;
+
+}  // namespace
+
+ObjectSequence::ObjectSequence(EnhancedPhotographyInstance* instance)
+    : task_runner_(instance->CreateSequencedTaskRunner()),
+      running_generation_(0) {
+}
+
+ObjectSequence::~ObjectSequence() {
+}
+
+ObjectSequence::Handler ObjectSequence::Wrap(const Handler& handler) {
+  return base::Bind(&ObjectSequence::RunHandler, task_runner_, handler);
+}
+
+ObjectSequence::Handler ObjectSequence::WrapLatest(const std::string& group,
+                                                   const Handler& handler) {
+  return base::Bind(&ObjectSequence::PostLatestHandler,
+                    base::Unretained(this), group, handler);
+}
+
+ObjectSequence::Handler ObjectSequence::CancelHandler() {
+  return base::Bind(&ObjectSequence::OnCancel, base::Unretained(this));
+}
+
+bool ObjectSequence::IsSuperseded() {
+  DCHECK(task_runner_->RunsTasksOnCurrentThread());
+  DCHECK(!running_group_.empty());
+  return !IsLatest(running_group_, running_generation_);
+}
+
+void ObjectSequence::Flush() {
+  if (task_runner_->RunsTasksOnCurrentThread())
+    return;
+
+  base::WaitableEvent done(false, false);
+  // Posting fails once the worker pool is shut down, which also means that
+  // there is nothing left to wait for.
+  if (task_runner_->PostTask(FROM_HERE,
+                             base::Bind(&base::WaitableEvent::Signal,
+                                        base::Unretained(&done)))) {
+    done.Wait();
+  }
+}
+
+// static
+void ObjectSequence::RunHandler(
+    scoped_refptr<base::SequencedTaskRunner> task_runner,
+    const Handler& handler,
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  int flow_id = g_next_flow_id.GetNext();
+  TRACE_EVENT_FLOW_BEGIN0("realsense", "EnhancedPhotography::Operation",
+                          flow_id);
+  task_runner->PostTask(FROM_HERE,
+                        base::Bind(&ObjectSequence::RunTracedHandler,
+                                   flow_id,
+                                   handler,
+                                   base::Passed(&info)));
+}
+
+// static
+void ObjectSequence::RunTracedHandler(
+    int flow_id,
+    const Handler& handler,
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  TRACE_EVENT_FLOW_END0("realsense", "EnhancedPhotography::Operation",
+                        flow_id);
+  TRACE_EVENT1("realsense", "EnhancedPhotography::Operation",
+               "name", info->name());
+  handler.Run(info.Pass());
+}
+
+void ObjectSequence::PostLatestHandler(
+    const std::string& group,
+    const Handler& handler,
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  int generation;
+  {
+    base::AutoLock lock(lock_);
+    generation = ++generations_[group];
+  }
+  int flow_id = g_next_flow_id.GetNext();
+  TRACE_EVENT_FLOW_BEGIN0("realsense", "EnhancedPhotography::Operation",
+                          flow_id);
+  task_runner_->PostTask(FROM_HERE,
+                         base::Bind(&ObjectSequence::RunLatestHandler,
+                                    base::Unretained(this),
+                                    group,
+                                    generation,
+                                    flow_id,
+                                    handler,
+                                    base::Passed(&info)));
+}
+
+void ObjectSequence::RunLatestHandler(
+    const std::string& group,
+    int generation,
+    int flow_id,
+    const Handler& handler,
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  TRACE_EVENT_FLOW_END0("realsense", "EnhancedPhotography::Operation",
+                        flow_id);
+  TRACE_EVENT2("realsense", "EnhancedPhotography::Operation",
+               "name", info->name(), "group", group);
+  if (!IsLatest(group, generation)) {
+    info->PostResult(CreateDOMException("The request was superseded.",
+                                        ERROR_NAME_ABORTERROR));
+    return;
+  }
+
+  running_group_ = group;
+  running_generation_ = generation;
+  handler.Run(info.Pass());
+  running_group_.clear();
+}
+
+void ObjectSequence::OnCancel(scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  {
+    base::AutoLock lock(lock_);
+    for (std::map<std::string, int>::iterator it = generations_.begin();
+         it != generations_.end(); ++it) {
+      ++it->second;
+    }
+  }
+  info->PostResult(CreateSuccessResult());
+}
+
+bool ObjectSequence::IsLatest(const std::string& group, int generation) {
+  base::AutoLock lock(lock_);
+  return generations_[group] == generation;
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
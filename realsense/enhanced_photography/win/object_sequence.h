@@ -0,0 +1,94 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_OBJECT_SEQUENCE_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_OBJECT_SEQUENCE_H_
+
+#include <map>
+#include <string>
+
+#include "base/callback.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/sequenced_task_runner.h"
+#include "base/synchronization/lock.h"
+#include "xwalk/common/xwalk_extension_function_handler.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+class EnhancedPhotographyInstance;
+
+using xwalk::common::XWalkExtensionFunctionInfo;
+
+// Runs the message handlers of one binding object on its own sequence of the
+// instance worker pool. Messages to the same object keep their order, while
+// messages to different objects run concurrently.
+class ObjectSequence {
+ public:
+  typedef base::Callback<void(scoped_ptr<XWalkExtensionFunctionInfo>)>
+      Handler;
+
+  explicit ObjectSequence(EnhancedPhotographyInstance* instance);
+  ~ObjectSequence();
+
+  // Returns a handler that posts |handler| to this sequence.
+  Handler Wrap(const Handler& handler);
+  // Like Wrap(), for the methods called from pointer and slider handlers:
+  // a message supersedes the messages of the same |group| which are still
+  // waiting in the sequence, they are rejected with an AbortError instead
+  // of running.
+  Handler WrapLatest(const std::string& group, const Handler& handler);
+  // Returns a handler that supersedes the waiting messages of all groups.
+  Handler CancelHandler();
+
+  // Whether a newer message or a cancel() superseded the message being
+  // handled, which must have been wrapped by WrapLatest(). Lets long
+  // handlers skip their remaining work. Must be called on this sequence.
+  bool IsSuperseded();
+
+  // Blocks until the tasks already posted to this sequence have run. The
+  // owner must call it first thing in its destructor, as the pending tasks
+  // use the owner's members.
+  void Flush();
+
+  base::SequencedTaskRunner* task_runner() const {
+    return task_runner_.get();
+  }
+
+ private:
+  static void RunHandler(scoped_refptr<base::SequencedTaskRunner> task_runner,
+                         const Handler& handler,
+                         scoped_ptr<XWalkExtensionFunctionInfo> info);
+  static void RunTracedHandler(int flow_id,
+                               const Handler& handler,
+                               scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void PostLatestHandler(const std::string& group,
+                         const Handler& handler,
+                         scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void RunLatestHandler(const std::string& group,
+                        int generation,
+                        int flow_id,
+                        const Handler& handler,
+                        scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnCancel(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  bool IsLatest(const std::string& group, int generation);
+
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  base::Lock lock_;
+  // Generation of the latest message of each group.
+  std::map<std::string, int> generations_;
+
+  // The message being handled, only used on the sequence.
+  std::string running_group_;
+  int running_generation_;
+
+  DISALLOW_COPY_AND_ASSIGN(ObjectSequence);
+};
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_OBJECT_SEQUENCE_H_
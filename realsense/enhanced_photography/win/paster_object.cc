@@ -5,6 +5,7 @@
 #include "realsense/enhanced_photography/win/paster_object.h"
 
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
 
@@ -14,28 +15,35 @@ namespace enhanced_photography {
 
 PasterObject::PasterObject(EnhancedPhotographyInstance* instance)
     : instance_(instance),
-      binary_message_size_(0) {
+      sequence_(instance),
+      photo_(nullptr),
+      sticker_memory_("Paster", "stickers"),
+      binary_message_size_(0),
+      binary_message_memory_("Paster", "binary_message") {
   handler_.Register("getPlanesMap",
-      base::Bind(&PasterObject::OnGetPlanesMap,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&PasterObject::OnGetPlanesMap,
+                                base::Unretained(this))));
   handler_.Register("setPhoto",
-      base::Bind(&PasterObject::OnSetPhoto,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&PasterObject::OnSetPhoto,
+                                base::Unretained(this))));
   handler_.Register("setSticker",
-      base::Bind(&PasterObject::OnSetSticker,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&PasterObject::OnSetSticker,
+                                base::Unretained(this))));
   handler_.Register("paste",
-      base::Bind(&PasterObject::OnPaste,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&PasterObject::OnPaste,
+                                base::Unretained(this))));
   handler_.Register("previewSticker",
-      base::Bind(&PasterObject::OnPreviewSticker,
-                 base::Unretained(this)));
+      sequence_.WrapLatest("previewSticker",
+                           base::Bind(&PasterObject::OnPreviewSticker,
+                                      base::Unretained(this))));
+  handler_.Register("cancel", sequence_.CancelHandler());
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   paster_ = PXCEnhancedPhoto::Paster::CreateInstance(session_);
 }
 
 PasterObject::~PasterObject() {
+  sequence_.Flush();
   for (std::vector<PXCImage::ImageData>::iterator it =
       sticker_data_set_.begin(); it != sticker_data_set_.end(); ++it) {
     delete (*it).planes[0];
@@ -45,7 +53,7 @@ PasterObject::~PasterObject() {
     paster_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -55,10 +63,18 @@ void PasterObject::OnGetPlanesMap(
   jsapi::depth_photo::Image image;
 
   DCHECK(paster_);
+  ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+  if (!module_photo.valid()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
+  // The map belongs to |paster_|, so the photo stays locked while it is
+  // copied.
   PXCImage* mask = paster_->GetPlanesMap();
   if (!CopyImageToBinaryMessage(mask,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -82,18 +98,22 @@ void PasterObject::OnSetPhoto(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
+  depthPhotoObject->PinPhoto();
+  photo_id_.clear();
+  photo_ = nullptr;
   pxcStatus sts = paster_->SetPhoto(depthPhotoObject->GetPhoto());
   if (sts < PXC_STATUS_NO_ERROR) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
+  photo_id_ = object_id;
+  photo_ = depthPhotoObject->GetPhoto();
 
   info->PostResult(CreateSuccessResult());
 }
@@ -115,6 +135,11 @@ void PasterObject::OnSetSticker(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   }
 
   DCHECK(paster_);
+  ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+  if (!module_photo.valid()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
   const char* data = binary_value->GetBuffer();
   int offset = 0;
   const int* int_array = reinterpret_cast<const int*>(data + offset);
@@ -151,6 +176,9 @@ void PasterObject::OnSetSticker(scoped_ptr<XWalkExtensionFunctionInfo> info) {
 
   PXCImage* sticker = session_->CreateImage(&img_info, &img_data);
   sticker_data_set_.push_back(img_data);
+  // The pixels of the stickers are kept until the object is destroyed.
+  sticker_memory_.SetBuffers(static_cast<int>(sticker_data_set_.size()),
+                             sticker_memory_.bytes() + bufSize);
 
   int_array = reinterpret_cast<const int*>(data + offset);
   int coordinates_x = int_array[0];
@@ -204,7 +232,15 @@ void PasterObject::OnPaste(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   jsapi::depth_photo::Photo photo;
 
   DCHECK(paster_);
-  PXCPhoto* pxcphoto = paster_->Paste();
+  PXCPhoto* pxcphoto;
+  {
+    ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+    if (!module_photo.valid()) {
+      info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+      return;
+    }
+    pxcphoto = paster_->Paste();
+  }
   if (!pxcphoto) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
@@ -219,10 +255,16 @@ void PasterObject::OnPreviewSticker(
   jsapi::depth_photo::Image image;
 
   DCHECK(paster_);
+  ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+  if (!module_photo.valid()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
   PXCImage* mask = paster_->PreviewSticker();
   if (!CopyImageToBinaryMessage(mask,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -11,9 +11,12 @@
 // This file is auto-generated by paster.idl
 #include "paster.h" // NOLINT
 
+#include "realsense/common/memory_accounting.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
 #include "third_party/libpxc/include/pxcimage.h"
+#include "third_party/libpxc/include/pxcphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 
 namespace realsense {
@@ -35,11 +38,18 @@ class PasterObject : public xwalk::common::BindingObject {
   void OnPreviewSticker(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
   PXCSession* session_;
   PXCEnhancedPhoto::Paster* paster_;
+  // The photo passed to setPhoto(), which |paster_| reads under a
+  // ScopedModulePhoto.
+  std::string photo_id_;
+  PXCPhoto* photo_;
   std::vector<PXCImage::ImageData> sticker_data_set_;
+  realsense::common::MemoryTracker sticker_memory_;
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
 };
 
 }  // namespace enhanced_photography
@@ -4,6 +4,8 @@
 
 #include "realsense/enhanced_photography/win/photo_capture_object.h"
 
+#include <math.h>
+
 #include <algorithm>
 #include <string>
 
@@ -11,7 +13,11 @@
 #include "base/guid.h"
 #include "base/logging.h"
 #include "base/strings/sys_string_conversions.h"
+#include "base/time/time.h"
+#include "base/trace_event/trace_event.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/memory_accounting_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
 
@@ -27,6 +33,46 @@ using realsense::jsapi::photo_utils::DepthMapQuality;
     DispatchErrorEvent(e, m); \
     ReleaseResources();
 
+namespace {
+
+// About 250ms of frames at 30fps.
+const size_t kRingSize = 8;
+// The frames considered around the requested moment by the best_depth
+// selection, in milliseconds.
+const double kBestDepthWindow = 100;
+const int kMaxBurstSize = 30;
+
+// Rejects the read waiting in |read|, if any.
+void AbortPendingRead(scoped_ptr<XWalkExtensionFunctionInfo>* read,
+                      const std::string& message) {
+  if (!*read)
+    return;
+  (*read)->PostResult(CreateDOMException(message, ERROR_NAME_ABORTERROR));
+  read->reset();
+}
+
+int GetQualityRank(PXCEnhancedPhoto::PhotoUtils::DepthMapQuality quality) {
+  switch (quality) {
+    case PXCEnhancedPhoto::PhotoUtils::DepthMapQuality::GOOD:
+      return 2;
+    case PXCEnhancedPhoto::PhotoUtils::DepthMapQuality::FAIR:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+PhotoCaptureObject::RingFrame::RingFrame()
+    : color(nullptr),
+      depth(nullptr),
+      has_color(false),
+      timestamp(0),
+      has_quality(false),
+      quality(PXCEnhancedPhoto::PhotoUtils::DepthMapQuality::BAD) {
+}
+
 PhotoCaptureObject::PhotoCaptureObject(
     EnhancedPhotographyInstance* instance)
         : depth_enabled_(false),
@@ -34,11 +80,23 @@ PhotoCaptureObject::PhotoCaptureObject(
           pipeline_thread_("PhotoCaptureThread"),
           message_loop_(base::MessageLoopProxy::current()),
           session_(nullptr),
-          sense_manager_(nullptr),
+          connection_(nullptr),
+          data_desc_(),
           depth_image_(nullptr),
+          depth_image_memory_("PhotoCapture", "depth_image"),
           photo_utils_(nullptr),
           instance_(instance),
-          binary_message_size_(0) {
+          binary_message_size_(0),
+          binary_message_memory_("PhotoCapture", "binary_message"),
+          ring_(kRingSize),
+          ring_memory_("PhotoCapture", "ring_frames"),
+          ring_head_(0),
+          ring_count_(0),
+          clock_offset_(0),
+          has_clock_offset_(false),
+          burst_remaining_(0),
+          preview_enabled_(false),
+          quality_map_enabled_(false) {
   handler_.Register("enableDepthStream",
                     base::Bind(&PhotoCaptureObject::OnEnableDepthStream,
                                base::Unretained(this)));
@@ -51,6 +109,27 @@ PhotoCaptureObject::PhotoCaptureObject(
   handler_.Register("takePhoto",
                     base::Bind(&PhotoCaptureObject::OnTakePhoto,
                                base::Unretained(this)));
+  handler_.Register("takeBurst",
+                    base::Bind(&PhotoCaptureObject::OnTakeBurst,
+                               base::Unretained(this)));
+  handler_.Register("startDepthPreview",
+                    base::Bind(&PhotoCaptureObject::OnStartDepthPreview,
+                               base::Unretained(this)));
+  handler_.Register("stopDepthPreview",
+                    base::Bind(&PhotoCaptureObject::OnStopDepthPreview,
+                               base::Unretained(this)));
+  handler_.Register("readDepthPreview",
+                    base::Bind(&PhotoCaptureObject::OnReadDepthPreview,
+                               base::Unretained(this)));
+  handler_.Register("startDepthQualityMap",
+                    base::Bind(&PhotoCaptureObject::OnStartDepthQualityMap,
+                               base::Unretained(this)));
+  handler_.Register("stopDepthQualityMap",
+                    base::Bind(&PhotoCaptureObject::OnStopDepthQualityMap,
+                               base::Unretained(this)));
+  handler_.Register("getDepthQualityMap",
+                    base::Bind(&PhotoCaptureObject::OnGetDepthQualityMap,
+                               base::Unretained(this)));
 }
 
 PhotoCaptureObject::~PhotoCaptureObject() {
@@ -73,6 +152,38 @@ void PhotoCaptureObject::StopEvent(const std::string& type) {
   }
 }
 
+bool PhotoCaptureObject::CanJoinPipeline(PXCSenseManager* sense_manager) {
+  PXCCapture::Device* capture_device =
+      sense_manager->QueryCaptureManager()->QueryDevice();
+  PXCCapture::Device::StreamProfileSet profile_set = {};
+  if (!capture_device ||
+      PXC_FAILED(capture_device->QueryStreamProfileSet(&profile_set)))
+    return false;
+
+  // The depth image and the ring have the sizes of the picked profile.
+  const PXCImage::ImageInfo& color = profile_set.color.imageInfo;
+  const PXCImage::ImageInfo& depth = profile_set.depth.imageInfo;
+  return color.format && depth.format &&
+      color.width == data_desc_.streams.color.sizeMax.width &&
+      color.height == data_desc_.streams.color.sizeMax.height &&
+      depth.width == data_desc_.streams.depth.sizeMax.width &&
+      depth.height == data_desc_.streams.depth.sizeMax.height;
+}
+
+pxcStatus PhotoCaptureObject::OnConfigurePipeline(
+    PXCSenseManager* sense_manager) {
+  PXCVideoModule::DataDesc data_desc = data_desc_;
+  return sense_manager->EnableStreams(&data_desc);
+}
+
+void PhotoCaptureObject::OnPipelineRestart() {
+  // The connection is released on pipeline_thread_ before it stops.
+  pipeline_thread_.message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&PhotoCaptureObject::OnRestartPipeline,
+                 base::Unretained(this)));
+}
+
 void PhotoCaptureObject::OnEnableDepthStream(
   scoped_ptr<XWalkExtensionFunctionInfo> info) {
   {
@@ -89,7 +200,7 @@ void PhotoCaptureObject::OnEnableDepthStream(
   }
   std::string cameraName = params->camera;
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   if (!session_) {
     DISPATCH_ERROR_AND_CLEAR("Failed to create PXCSession.",
                              ERROR_NAME_NOTFOUNDERROR)
@@ -100,9 +211,12 @@ void PhotoCaptureObject::OnEnableDepthStream(
   templat.group = PXCSession::IMPL_GROUP_SENSOR;
   templat.subgroup = PXCSession::IMPL_SUBGROUP_VIDEO_CAPTURE;
   PXCSession::ImplDesc desc;
-  int module_index = 0;
-  while (PXC_SUCCEEDED(session_->QueryImpl(&templat, module_index, &desc))) {
-    if (PXC_FAILED(session_->CreateImpl<PXCCapture>(&desc, &capture_)))
+  // The capture modules are cached with the shared session, so enabling the
+  // stream again does not load them again.
+  for (int module_index = 0;
+       PXC_SUCCEEDED(session_->QueryImpl(&templat, module_index, &desc));
+       module_index++) {
+    if (PXC_FAILED(CreateSharedImpl<PXCCapture>(session_, &desc, &capture_)))
       continue;
 
     DVLOG(1) << "RSSDK capture module: " << desc.friendlyName;
@@ -121,8 +235,6 @@ void PhotoCaptureObject::OnEnableDepthStream(
     }
     if (capture_device_)
       break;
-    module_index++;
-    capture_->Release();
   }
 
   if (!capture_device_) {
@@ -155,96 +267,38 @@ void PhotoCaptureObject::OnEnableDepthStream(
     << profile_set.color.imageInfo.height << ")"
     << " @" << profile_set.depth.frameRate.max << "fps";
 
-  sense_manager_ = session_->CreateSenseManager();
-  if (!sense_manager_) {
-    DISPATCH_ERROR_AND_CLEAR("Failed to create sense manager.",
-                             ERROR_NAME_NOTFOUNDERROR);
-    return;
-  }
-
-  PXCCaptureManager* capture_manager = sense_manager_->QueryCaptureManager();
-  if (!capture_manager) {
-    DISPATCH_ERROR_AND_CLEAR("Failed to query capture manager.",
-                             ERROR_NAME_NOTFOUNDERROR);
-    return;
-  }
-  capture_manager->FilterByStreamProfiles(&profile_set);
-
-  PXCVideoModule::DataDesc data_desc = {};
-  data_desc.streams.color.frameRate.min =
-      data_desc.streams.color.frameRate.max =
+  // The streams are enabled on the pipeline of the capture service, which
+  // other extensions may use as well, so the profile is requested by its
+  // streams rather than filtered on the device.
+  data_desc_ = PXCVideoModule::DataDesc();
+  data_desc_.streams.color.frameRate.min =
+      data_desc_.streams.color.frameRate.max =
           profile_set.color.frameRate.max;
-  data_desc.streams.color.sizeMin.height =
-      data_desc.streams.color.sizeMax.height =
+  data_desc_.streams.color.sizeMin.height =
+      data_desc_.streams.color.sizeMax.height =
           profile_set.color.imageInfo.height;
-  data_desc.streams.color.sizeMin.width =
-      data_desc.streams.color.sizeMax.width =
+  data_desc_.streams.color.sizeMin.width =
+      data_desc_.streams.color.sizeMax.width =
           profile_set.color.imageInfo.width;
-  data_desc.streams.color.options = profile_set.color.options;
-  data_desc.streams.depth.frameRate.min =
-      data_desc.streams.depth.frameRate.max =
+  data_desc_.streams.color.options = profile_set.color.options;
+  data_desc_.streams.depth.frameRate.min =
+      data_desc_.streams.depth.frameRate.max =
           profile_set.depth.frameRate.max;
-  data_desc.streams.depth.sizeMin.height =
-      data_desc.streams.depth.sizeMax.height =
+  data_desc_.streams.depth.sizeMin.height =
+      data_desc_.streams.depth.sizeMax.height =
           profile_set.depth.imageInfo.height;
-  data_desc.streams.depth.sizeMin.width =
-      data_desc.streams.depth.sizeMax.width =
+  data_desc_.streams.depth.sizeMin.width =
+      data_desc_.streams.depth.sizeMax.width =
           profile_set.depth.imageInfo.width;
-  data_desc.streams.depth.options = profile_set.depth.options;
-
-  if (PXC_FAILED(sense_manager_->EnableStreams(&data_desc))) {
-    DISPATCH_ERROR_AND_CLEAR("Failed to enable depth stream.",
-                             ERROR_NAME_NOTFOUNDERROR);
-    return;
-  }
-
-  if (PXC_FAILED(sense_manager_->Init())) {
-    DISPATCH_ERROR_AND_CLEAR("Failed to init sense manager.",
-                             ERROR_NAME_NOTFOUNDERROR);
-    return;
-  }
-
-  PXCCapture::Device* capture_device = capture_manager->QueryDevice();
-  if (!capture_device) {
-    DISPATCH_ERROR_AND_CLEAR("Failed to query device.",
-                             ERROR_NAME_NOTFOUNDERROR);
-    return;
-  }
-
-  if (PXC_FAILED(capture_device->QueryStreamProfileSet(&profile_set))) {
-    DISPATCH_ERROR_AND_CLEAR(
-        "Failed to query stream profile set after sense manager init.",
-        ERROR_NAME_NOTFOUNDERROR);
-    return;
-  }
-
-  PXCCapture::Device::StreamProfile color = profile_set.color;
-  PXCCapture::Device::StreamProfile depth = profile_set.depth;
-
-  if (!color.imageInfo.format || !depth.imageInfo.format) {
-    DISPATCH_ERROR_AND_CLEAR("Failed to get color and depth stream profile.",
-                             ERROR_NAME_NOTFOUNDERROR);
-    return;
-  }
-
-  DVLOG(1) << "Set color stream profile: "
-      << "format " << color.imageInfo.format
-      << " (" << color.imageInfo.width << "x"
-      << color.imageInfo.height << ")"
-      << " @" << color.frameRate.max << "fps";
-
-  DVLOG(1) << "Set depth stream profile: "
-      << "format " << depth.imageInfo.format
-      << " (" << depth.imageInfo.width << "x"
-      << depth.imageInfo.height << ")"
-      << " @" << depth.frameRate.max << "fps";
+  data_desc_.streams.depth.options = profile_set.depth.options;
 
   PXCImage::ImageInfo image_info;
   memset(&image_info, 0, sizeof(image_info));
-  image_info.width = depth.imageInfo.width;
-  image_info.height = depth.imageInfo.height;
+  image_info.width = profile_set.depth.imageInfo.width;
+  image_info.height = profile_set.depth.imageInfo.height;
   image_info.format = PXCImage::PIXEL_FORMAT_DEPTH;
   depth_image_ = session_->CreateImage(&image_info);
+  depth_image_memory_.Set(GetImageFootprint(depth_image_));
 
   photo_utils_ = PXCEnhancedPhoto::PhotoUtils::CreateInstance(session_);
   if (!photo_utils_) {
@@ -262,10 +316,13 @@ void PhotoCaptureObject::OnEnableDepthStream(
 
   pipeline_thread_.Start();
 
+  // Connecting may wait for the other consumers of the camera to let the
+  // pipeline restart.
   pipeline_thread_.message_loop()->PostTask(
       FROM_HERE,
-      base::Bind(&PhotoCaptureObject::RunPipeline,
-                 base::Unretained(this)));
+      base::Bind(&PhotoCaptureObject::StartPipeline,
+                 base::Unretained(this),
+                 cameraName));
 }
 
 void PhotoCaptureObject::OnDisableDepthStream(
@@ -321,6 +378,73 @@ void PhotoCaptureObject::OnTakePhoto(
                  base::Passed(&info)));
 }
 
+void PhotoCaptureObject::OnTakeBurst(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  {
+    base::AutoLock lock(lock_);
+    if (!depth_enabled_) {
+      info->PostResult(CreateDOMException("The depth stream is not enabled.",
+                                          ERROR_NAME_ABORTERROR));
+      return;
+    }
+  }
+
+  pipeline_thread_.message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&PhotoCaptureObject::DoTakeBurst,
+                 base::Unretained(this),
+                 base::Passed(&info)));
+}
+
+void PhotoCaptureObject::OnStartDepthPreview(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  PostPipelineTask(&PhotoCaptureObject::DoStartDepthPreview, info.Pass());
+}
+
+void PhotoCaptureObject::OnStopDepthPreview(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  PostPipelineTask(&PhotoCaptureObject::DoStopDepthPreview, info.Pass());
+}
+
+void PhotoCaptureObject::OnReadDepthPreview(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  PostPipelineTask(&PhotoCaptureObject::DoReadDepthPreview, info.Pass());
+}
+
+void PhotoCaptureObject::OnStartDepthQualityMap(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  PostPipelineTask(&PhotoCaptureObject::DoStartDepthQualityMap, info.Pass());
+}
+
+void PhotoCaptureObject::OnStopDepthQualityMap(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  PostPipelineTask(&PhotoCaptureObject::DoStopDepthQualityMap, info.Pass());
+}
+
+void PhotoCaptureObject::OnGetDepthQualityMap(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  PostPipelineTask(&PhotoCaptureObject::DoGetDepthQualityMap, info.Pass());
+}
+
+void PhotoCaptureObject::StartPipeline(const std::string& camera_name) {
+  DCHECK_EQ(pipeline_thread_.message_loop(), base::MessageLoop::current());
+
+  pxcStatus status;
+  connection_ = CaptureService::GetInstance()->Connect(
+      camera_name.c_str(), this, &status);
+  if (!connection_) {
+    {
+      base::AutoLock lock(lock_);
+      depth_enabled_ = false;
+    }
+    DISPATCH_ERROR_AND_CLEAR("Failed to init sense manager.",
+                             ERROR_NAME_NOTFOUNDERROR);
+    return;
+  }
+
+  RunPipeline();
+}
+
 void PhotoCaptureObject::RunPipeline() {
   DCHECK_EQ(pipeline_thread_.message_loop(), base::MessageLoop::current());
 
@@ -329,7 +453,22 @@ void PhotoCaptureObject::RunPipeline() {
     if (!depth_enabled_) return;
   }
 
-  if (PXC_FAILED(sense_manager_->AcquireFrame(true))) {
+  TRACE_EVENT0("realsense", "PhotoCaptureObject::RunPipeline");
+  CaptureFrame* capture_frame = nullptr;
+  pxcStatus status;
+  {
+    TRACE_EVENT0("realsense", "AcquireFrame");
+    status = connection_->AcquireFrame(&capture_frame);
+  }
+  if (status == PXC_STATUS_EXEC_ABORTED) {
+    OnRestartPipeline();
+    pipeline_thread_.message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&PhotoCaptureObject::RunPipeline,
+                   base::Unretained(this)));
+    return;
+  }
+  if (PXC_FAILED(status)) {
     {
       base::AutoLock lock(lock_);
       depth_enabled_ = false;
@@ -337,13 +476,21 @@ void PhotoCaptureObject::RunPipeline() {
     DISPATCH_ERROR_AND_CLEAR("Failed to acquire frame.", ERROR_NAME_ABORTERROR);
     return;
   }
+  base::Time acquired = base::Time::Now();
 
-  PXCCapture::Sample *sample = sense_manager_->QuerySample();
+  PXCCapture::Sample *sample = capture_frame->QuerySenseManager()
+      ->QuerySample();
+  RingFrame* frame = StoreFrame(sample, acquired);
   if (sample->depth) {
     depth_image_->CopyImage(sample->depth);
     if (on_depthquality_) {
+      TRACE_EVENT0("realsense", "GetDepthQuality");
       PXCEnhancedPhoto::PhotoUtils::DepthMapQuality quality =
           photo_utils_->GetDepthQuality(sample->depth);
+      if (frame) {
+        frame->has_quality = true;
+        frame->quality = quality;
+      }
       DepthMapQuality depth_quality(DepthMapQuality::DEPTH_MAP_QUALITY_NONE);
       switch (quality) {
         case PXCEnhancedPhoto::PhotoUtils::DepthMapQuality::BAD: {
@@ -367,54 +514,429 @@ void PhotoCaptureObject::RunPipeline() {
     }
   }
 
+  if (frame && !pending_photos_.empty())
+    TakePendingPhotos();
+  if (frame && burst_info_)
+    AddBurstFrame(*frame);
+
+  if (preview_read_ && sample->depth) {
+    scoped_ptr<base::ListValue> result(preview_.Convert(sample->depth));
+    if (result)
+      preview_read_->PostResult(result.Pass());
+    else
+      preview_read_->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    preview_read_.reset();
+  }
+
+  if (quality_map_enabled_ && sample->depth &&
+      quality_map_.Update(sample->depth) && quality_map_read_) {
+    quality_map_read_->PostResult(quality_map_.CreateResult());
+    quality_map_read_.reset();
+  }
+
   // Go fetching the next samples
-  sense_manager_->ReleaseFrame();
+  capture_frame->Release();
   pipeline_thread_.message_loop()->PostTask(
       FROM_HERE,
       base::Bind(&PhotoCaptureObject::RunPipeline,
                  base::Unretained(this)));
 }
 
+void PhotoCaptureObject::OnRestartPipeline() {
+  DCHECK_EQ(pipeline_thread_.message_loop(), base::MessageLoop::current());
+
+  {
+    base::AutoLock lock(lock_);
+    if (!depth_enabled_) return;
+  }
+  if (!connection_->IsRestartPending()) return;
+
+  // Nothing is created from the sense manager of the pipeline, and the
+  // restarted pipeline keeps the picked profile.
+  TRACE_EVENT0("realsense", "PhotoCaptureObject::OnRestartPipeline");
+  if (PXC_FAILED(connection_->WaitForRestart())) {
+    {
+      base::AutoLock lock(lock_);
+      depth_enabled_ = false;
+    }
+    DISPATCH_ERROR_AND_CLEAR("Failed to restart the camera pipeline.",
+                             ERROR_NAME_ABORTERROR);
+  }
+}
+
 void PhotoCaptureObject::DoGetDepthImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (!depth_image_) {
-    info->PostResult(CreateDOMException("Failed to get depth image.",
-                                        ERROR_NAME_ABORTERROR));
+  scoped_ptr<GetDepthImage::Params> params(
+      GetDepthImage::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(
+        CreateDOMException("Malformed parameters for getDepthImage",
+                           ERROR_NAME_INVALIDACCESSERROR));
     return;
   }
+  DepthMessageEncoding encoding =
+      params->encoding == DEPTH_ENCODING_RVL ? DEPTH_MESSAGE_RVL
+                                             : DEPTH_MESSAGE_RAW;
 
-  if (!CopyImageToBinaryMessage(depth_image_,
-                                binary_message_,
-                                &binary_message_size_)) {
+  PXCImage::ImageData depth_data;
+  if (!depth_image_ ||
+      depth_image_->AcquireAccess(PXCImage::ACCESS_READ,
+                                  PXCImage::PIXEL_FORMAT_DEPTH,
+                                  &depth_data) < PXC_STATUS_NO_ERROR) {
     info->PostResult(CreateDOMException("Failed to get depth image.",
                                         ERROR_NAME_ABORTERROR));
     return;
   }
+  PXCImage::ImageInfo depth_info = depth_image_->QueryInfo();
+
+  // depth image message: call_id (i32), width (i32), height (i32),
+  // depth section (see depth_codec.h)
+  const size_t header_size = 3 * sizeof(int);
+  size_t capacity = header_size + GetMaxDepthSectionSize(
+      encoding, depth_info.width, depth_info.height);
+  if (binary_message_size_ < capacity) {
+    binary_message_.reset(new uint8[capacity]);
+    binary_message_size_ = capacity;
+    binary_message_memory_.Set(capacity);
+  }
+  int* header = reinterpret_cast<int*>(binary_message_.get());
+  header[1] = depth_info.width;
+  header[2] = depth_info.height;
+  size_t message_size = header_size + PackDepthSection(
+      encoding, depth_data.planes[0], depth_data.pitches[0],
+      depth_info.width, depth_info.height,
+      binary_message_.get() + header_size);
+  depth_image_->ReleaseAccess(&depth_data);
 
   scoped_ptr<base::ListValue> result(new base::ListValue());
   result->Append(base::BinaryValue::CreateWithCopiedBuffer(
       reinterpret_cast<const char*>(binary_message_.get()),
-      binary_message_size_));
+      message_size));
   info->PostResult(result.Pass());
 }
 
 void PhotoCaptureObject::DoTakePhoto(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (PXC_FAILED(sense_manager_->AcquireFrame(true))) {
-    info->PostResult(CreateDOMException("Failed to acquire frame.",
-                                        ERROR_NAME_ABORTERROR));
+  scoped_ptr<TakePhoto::Params> params(
+      TakePhoto::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
     return;
   }
 
-  PXCCapture::Sample *sample = sense_manager_->QuerySample();
-  PXCPhoto* pxcphoto = session_->CreatePhoto();
-  pxcphoto->ImportFromPreviewSample(sample);
+  // The photo is made from a frame of the ring, which was captured when the
+  // request was made rather than after it reached the pipeline. Right after
+  // enableDepthStream() the request waits for the first frame.
+  if (ring_count_ == 0) {
+    pending_photos_.push_back(info.release());
+    return;
+  }
+
+  double timestamp = FrameAt(ring_count_ - 1).timestamp;
+  FrameSelection selection = FrameSelection::FRAME_SELECTION_CLOSEST;
+  if (params->options) {
+    if (params->options->timestamp)
+      timestamp = *params->options->timestamp;
+    if (params->options->selection != FrameSelection::FRAME_SELECTION_NONE)
+      selection = params->options->selection;
+  }
+  size_t index = selection == FrameSelection::FRAME_SELECTION_BEST_DEPTH ?
+      FindBestDepthFrame(timestamp) : FindClosestFrame(timestamp);
+
+  PXCPhoto* pxcphoto = CreatePhotoFromFrame(FrameAt(index));
+  if (!pxcphoto) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
   jsapi::depth_photo::Photo photo;
   CreateDepthPhotoObject(instance_, pxcphoto, &photo);
-  sense_manager_->ReleaseFrame();
   info->PostResult(TakePhoto::Results::Create(photo, std::string()));
 }
 
+void PhotoCaptureObject::DoTakeBurst(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<TakeBurst::Params> params(
+      TakeBurst::Params::Create(*info->arguments()));
+  if (!params || params->frame_count < 1 ||
+      params->frame_count > kMaxBurstSize) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+  if (burst_info_) {
+    info->PostResult(CreateDOMException("A burst is already in progress.",
+                                        ERROR_NAME_INVALIDSTATEERROR));
+    return;
+  }
+
+  burst_info_ = info.Pass();
+  burst_remaining_ = params->frame_count;
+  if (ring_count_ == 0)
+    return;
+
+  // The burst starts with the frames of the ring from the requested moment,
+  // and goes on with the next frames of the pipeline.
+  size_t index = params->timestamp ?
+      FindClosestFrame(*params->timestamp) : ring_count_ - 1;
+  for (; index < ring_count_ && burst_info_; ++index)
+    AddBurstFrame(FrameAt(index));
+}
+
+void PhotoCaptureObject::DoStartDepthPreview(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<StartDepthPreview::Params> params(
+      StartDepthPreview::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  preview_.Configure(params->options.get());
+  preview_enabled_ = true;
+  info->PostResult(CreateSuccessResult());
+}
+
+void PhotoCaptureObject::DoStopDepthPreview(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  preview_enabled_ = false;
+  AbortPendingRead(&preview_read_, "The depth preview was stopped.");
+  info->PostResult(CreateSuccessResult());
+}
+
+void PhotoCaptureObject::DoReadDepthPreview(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  if (!preview_enabled_) {
+    info->PostResult(CreateDOMException("The depth preview is not started.",
+                                        ERROR_NAME_INVALIDSTATEERROR));
+    return;
+  }
+  // Only the latest read is answered.
+  AbortPendingRead(&preview_read_, "The request was superseded.");
+  preview_read_ = info.Pass();
+}
+
+void PhotoCaptureObject::DoStartDepthQualityMap(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<StartDepthQualityMap::Params> params(
+      StartDepthQualityMap::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  quality_map_.Configure(params->options && params->options->tile_size ?
+      *params->options->tile_size : DepthQualityMap::kDefaultTileSize);
+  quality_map_enabled_ = true;
+  info->PostResult(CreateSuccessResult());
+}
+
+void PhotoCaptureObject::DoStopDepthQualityMap(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  quality_map_enabled_ = false;
+  AbortPendingRead(&quality_map_read_, "The quality map was stopped.");
+  info->PostResult(CreateSuccessResult());
+}
+
+void PhotoCaptureObject::DoGetDepthQualityMap(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  if (!quality_map_enabled_) {
+    info->PostResult(CreateDOMException("The quality map is not started.",
+                                        ERROR_NAME_INVALIDSTATEERROR));
+    return;
+  }
+  if (quality_map_.is_complete()) {
+    info->PostResult(quality_map_.CreateResult());
+    return;
+  }
+  AbortPendingRead(&quality_map_read_, "The request was superseded.");
+  quality_map_read_ = info.Pass();
+}
+
+PhotoCaptureObject::RingFrame* PhotoCaptureObject::StoreFrame(
+    PXCCapture::Sample* sample, base::Time acquired) {
+  // The color stream is optional, a photo can be made of depth alone.
+  if (!sample->depth)
+    return nullptr;
+
+  // The images of the ring are allocated once and reused, so that storing a
+  // frame is only a copy.
+  RingFrame& frame = ring_[ring_head_];
+  if ((sample->color && !frame.color) || !frame.depth) {
+    if (sample->color && !frame.color) {
+      PXCImage::ImageInfo color_info = sample->color->QueryInfo();
+      frame.color = session_->CreateImage(&color_info);
+    }
+    if (!frame.depth) {
+      PXCImage::ImageInfo depth_info = sample->depth->QueryInfo();
+      frame.depth = session_->CreateImage(&depth_info);
+    }
+    UpdateRingMemory();
+  }
+  frame.has_color = false;
+  if (!frame.depth || PXC_FAILED(frame.depth->CopyImage(sample->depth)))
+    return nullptr;
+  if (sample->color) {
+    if (!frame.color || PXC_FAILED(frame.color->CopyImage(sample->color)))
+      return nullptr;
+    frame.has_color = true;
+  }
+  frame.timestamp = GetSampleTime(sample, acquired);
+  frame.has_quality = false;
+
+  ring_head_ = (ring_head_ + 1) % ring_.size();
+  ring_count_ = std::min(ring_count_ + 1, ring_.size());
+  return &frame;
+}
+
+double PhotoCaptureObject::GetSampleTime(PXCCapture::Sample* sample,
+                                         base::Time acquired) {
+  // The frames are selected by the time they were captured, which the copies
+  // and the pipeline delay would skew.
+  PXCImage* image = sample->color ? sample->color : sample->depth;
+  // The time stamps are in 100 ns units.
+  const double time_stamp = image->QueryTimeStamp() / 10000.0;
+  const double offset = acquired.ToJsTime() - time_stamp;
+  if (!has_clock_offset_ || offset < clock_offset_) {
+    clock_offset_ = offset;
+    has_clock_offset_ = true;
+  }
+  return time_stamp + clock_offset_;
+}
+
+PhotoCaptureObject::RingFrame& PhotoCaptureObject::FrameAt(size_t index) {
+  DCHECK_LT(index, ring_count_);
+  return ring_[(ring_head_ + ring_.size() - ring_count_ + index) %
+               ring_.size()];
+}
+
+size_t PhotoCaptureObject::FindClosestFrame(double timestamp) {
+  size_t closest = 0;
+  for (size_t i = 1; i < ring_count_; ++i) {
+    if (fabs(FrameAt(i).timestamp - timestamp) <
+        fabs(FrameAt(closest).timestamp - timestamp))
+      closest = i;
+  }
+  return closest;
+}
+
+size_t PhotoCaptureObject::FindBestDepthFrame(double timestamp) {
+  size_t closest = FindClosestFrame(timestamp);
+  size_t best = closest;
+  int best_rank = -1;
+  for (size_t i = 0; i < ring_count_; ++i) {
+    RingFrame& frame = FrameAt(i);
+    if (i != closest &&
+        fabs(frame.timestamp - timestamp) > kBestDepthWindow)
+      continue;
+    if (!frame.has_quality) {
+      frame.quality = photo_utils_->GetDepthQuality(frame.depth);
+      frame.has_quality = true;
+    }
+    // On a tie the frame closest to |timestamp| wins.
+    int rank = GetQualityRank(frame.quality);
+    if (rank > best_rank ||
+        (rank == best_rank && fabs(frame.timestamp - timestamp) <
+                              fabs(FrameAt(best).timestamp - timestamp))) {
+      best = i;
+      best_rank = rank;
+    }
+  }
+  return best;
+}
+
+PXCPhoto* PhotoCaptureObject::CreatePhotoFromFrame(const RingFrame& frame) {
+  PXCPhoto* pxcphoto = session_->CreatePhoto();
+  if (!pxcphoto)
+    return nullptr;
+  PXCCapture::Sample sample = {};
+  sample.color = frame.has_color ? frame.color : nullptr;
+  sample.depth = frame.depth;
+  if (PXC_FAILED(pxcphoto->ImportFromPreviewSample(&sample))) {
+    pxcphoto->Release();
+    return nullptr;
+  }
+  return pxcphoto;
+}
+
+void PhotoCaptureObject::AddBurstFrame(const RingFrame& frame) {
+  PXCPhoto* pxcphoto = CreatePhotoFromFrame(frame);
+  if (!pxcphoto) {
+    CancelBurst(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  burst_photos_.push_back(pxcphoto);
+  if (--burst_remaining_ > 0)
+    return;
+
+  // The DepthPhotoObjects are only created once the burst is complete, so
+  // that none is left behind by a failed burst.
+  std::vector<linked_ptr<jsapi::depth_photo::Photo>> photos;
+  for (size_t i = 0; i < burst_photos_.size(); ++i) {
+    linked_ptr<jsapi::depth_photo::Photo> photo(
+        new jsapi::depth_photo::Photo);
+    CreateDepthPhotoObject(instance_, burst_photos_[i], photo.get());
+    photos.push_back(photo);
+  }
+  burst_photos_.clear();
+  burst_info_->PostResult(TakeBurst::Results::Create(photos, std::string()));
+  burst_info_.reset();
+}
+
+void PhotoCaptureObject::TakePendingPhotos() {
+  ScopedVector<XWalkExtensionFunctionInfo> requests;
+  requests.swap(pending_photos_);
+  for (size_t i = 0; i < requests.size(); ++i)
+    DoTakePhoto(make_scoped_ptr(requests[i]));
+  requests.weak_clear();
+}
+
+void PhotoCaptureObject::CancelBurst(scoped_ptr<base::ListValue> error) {
+  for (size_t i = 0; i < burst_photos_.size(); ++i)
+    burst_photos_[i]->Release();
+  burst_photos_.clear();
+  if (burst_info_) {
+    burst_info_->PostResult(error.Pass());
+    burst_info_.reset();
+  }
+}
+
+void PhotoCaptureObject::ReleaseRing() {
+  for (size_t i = 0; i < ring_.size(); ++i) {
+    if (ring_[i].color)
+      ring_[i].color->Release();
+    if (ring_[i].depth)
+      ring_[i].depth->Release();
+    ring_[i] = RingFrame();
+  }
+  ring_head_ = 0;
+  ring_count_ = 0;
+  has_clock_offset_ = false;
+  ring_memory_.Reset();
+
+  for (size_t i = 0; i < pending_photos_.size(); ++i) {
+    pending_photos_[i]->PostResult(CreateDOMException(
+        "The depth stream was disabled.", ERROR_NAME_ABORTERROR));
+  }
+  pending_photos_.clear();
+
+  CancelBurst(CreateDOMException("The depth stream was disabled.",
+                                 ERROR_NAME_ABORTERROR));
+}
+
+void PhotoCaptureObject::UpdateRingMemory() {
+  int images = 0;
+  size_t bytes = 0;
+  for (size_t i = 0; i < ring_.size(); ++i) {
+    PXCImage* frame_images[] = { ring_[i].color, ring_[i].depth };
+    for (size_t j = 0; j < arraysize(frame_images); ++j) {
+      if (frame_images[j]) {
+        ++images;
+        bytes += GetImageFootprint(frame_images[j]);
+      }
+    }
+  }
+  ring_memory_.SetBuffers(images, bytes);
+}
+
 void PhotoCaptureObject::StopAndDestroyPipeline(
     scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(pipeline_thread_.message_loop(), base::MessageLoop::current());
@@ -428,33 +950,53 @@ void PhotoCaptureObject::StopAndDestroyPipeline(
 }
 
 void PhotoCaptureObject::ReleaseResources() {
+  ReleaseRing();
+  preview_enabled_ = false;
+  AbortPendingRead(&preview_read_, "The depth stream was disabled.");
+  quality_map_enabled_ = false;
+  AbortPendingRead(&quality_map_read_, "The depth stream was disabled.");
   if (depth_image_) {
     depth_image_->Release();
     depth_image_ = nullptr;
   }
-  if (capture_) {
-    capture_->Release();
-    capture_ = nullptr;
-  }
+  depth_image_memory_.Reset();
+  // |capture_| is owned by the shared session.
+  capture_ = nullptr;
   if (capture_device_) {
     capture_device_->Release();
     capture_device_ = nullptr;
   }
-  if (sense_manager_) {
-    sense_manager_->Close();
-    sense_manager_->Release();
-    sense_manager_ = nullptr;
+  if (connection_) {
+    connection_->Release();
+    connection_ = nullptr;
   }
   if (photo_utils_) {
     photo_utils_->Release();
     photo_utils_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
 
+void PhotoCaptureObject::PostPipelineTask(
+    void (PhotoCaptureObject::*task)(scoped_ptr<XWalkExtensionFunctionInfo>),
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  {
+    base::AutoLock lock(lock_);
+    if (!depth_enabled_) {
+      info->PostResult(CreateDOMException("The depth stream is not enabled.",
+                                          ERROR_NAME_ABORTERROR));
+      return;
+    }
+  }
+
+  pipeline_thread_.message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(task, base::Unretained(this), base::Passed(&info)));
+}
+
 void PhotoCaptureObject::DispatchErrorEvent(
     const std::string& message, ErrorName name) {
   DOMException dom_exception;
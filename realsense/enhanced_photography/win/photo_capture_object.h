@@ -11,9 +11,16 @@
 // This file is auto-generated by photo_capture.idl
 #include "photo_capture.h" // NOLINT
 
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop/message_loop_proxy.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "realsense/common/depth_codec.h"
+#include "realsense/common/memory_accounting.h"
+#include "realsense/common/win/capture_service.h"
+#include "realsense/enhanced_photography/win/depth_preview.h"
+#include "realsense/enhanced_photography/win/depth_quality_map.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
 #include "third_party/libpxc/include/pxcphoto.h"
@@ -29,7 +36,8 @@ using xwalk::common::XWalkExtensionFunctionInfo;
 using namespace jsapi::photo_capture; // NOLINT
 using realsense::jsapi::common::ErrorName;
 
-class PhotoCaptureObject : public xwalk::common::EventTarget {
+class PhotoCaptureObject : public xwalk::common::EventTarget,
+                           public realsense::common::CaptureConsumer {
  public:
   explicit PhotoCaptureObject(EnhancedPhotographyInstance* instance);
   ~PhotoCaptureObject() override;
@@ -38,21 +46,80 @@ class PhotoCaptureObject : public xwalk::common::EventTarget {
   void StartEvent(const std::string& type) override;
   void StopEvent(const std::string& type) override;
 
+  // CaptureConsumer implementation.
+  bool CanJoinPipeline(PXCSenseManager* sense_manager) override;
+  pxcStatus OnConfigurePipeline(PXCSenseManager* sense_manager) override;
+  void OnPipelineRestart() override;
+
  private:
   // Message handlers
   void OnEnableDepthStream(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnDisableDepthStream(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnGetDepthImage(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnTakePhoto(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnTakeBurst(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnStartDepthPreview(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnStopDepthPreview(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnReadDepthPreview(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnStartDepthQualityMap(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnStopDepthQualityMap(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnGetDepthQualityMap(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   // Run on pipeline_thread_
+  void StartPipeline(const std::string& camera_name);
   void RunPipeline();
+  void OnRestartPipeline();
   void StopAndDestroyPipeline(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void DoGetDepthImage(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void DoTakePhoto(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DoTakeBurst(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DoStartDepthPreview(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DoStopDepthPreview(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DoReadDepthPreview(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DoStartDepthQualityMap(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DoStopDepthQualityMap(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DoGetDepthQualityMap(scoped_ptr<XWalkExtensionFunctionInfo> info);
+
+  // A recent frame kept for zero shutter lag capture.
+  struct RingFrame {
+    RingFrame();
+
+    PXCImage* color;
+    PXCImage* depth;
+    // False if the sample had no color image, |color| then holds no frame.
+    bool has_color;
+    // The time stamp of the sample, in milliseconds since the epoch.
+    double timestamp;
+    // The depth quality is computed on demand.
+    bool has_quality;
+    PXCEnhancedPhoto::PhotoUtils::DepthMapQuality quality;
+  };
+
+  // Ring buffer helpers, run on pipeline_thread_
+  // |acquired| is when the pipeline returned |sample|.
+  RingFrame* StoreFrame(PXCCapture::Sample* sample, base::Time acquired);
+  // Maps the time stamp of |sample| to milliseconds since the epoch.
+  double GetSampleTime(PXCCapture::Sample* sample, base::Time acquired);
+  // |index| 0 is the oldest frame of the ring.
+  RingFrame& FrameAt(size_t index);
+  size_t FindClosestFrame(double timestamp);
+  size_t FindBestDepthFrame(double timestamp);
+  PXCPhoto* CreatePhotoFromFrame(const RingFrame& frame);
+  void AddBurstFrame(const RingFrame& frame);
+  // Answers the takePhoto() requests made before the first frame.
+  void TakePendingPhotos();
+  void CancelBurst(scoped_ptr<base::ListValue> error);
+  void ReleaseRing();
+  // Accounts for the images of the ring in |ring_memory_|.
+  void UpdateRingMemory();
 
   // Helpers
+  // Posts |task| to pipeline_thread_, or rejects |info| if the depth stream
+  // is not enabled.
+  void PostPipelineTask(
+      void (PhotoCaptureObject::*task)(scoped_ptr<XWalkExtensionFunctionInfo>),
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
   void DispatchErrorEvent(const std::string& message, ErrorName name);
   void ReleaseResources();
 
@@ -65,17 +132,58 @@ class PhotoCaptureObject : public xwalk::common::EventTarget {
   base::Thread pipeline_thread_;
   scoped_refptr<base::MessageLoopProxy> message_loop_;
 
+  // The images and the photos are created from |session_|. The frames come
+  // from the pipeline of |connection_|, which the camera may share with
+  // other extensions.
   PXCSession* session_;
-  PXCSenseManager* sense_manager_;
+  realsense::common::CaptureConnection* connection_;
+  // The streams of the profile picked by enableDepthStream().
+  PXCVideoModule::DataDesc data_desc_;
   PXCImage* depth_image_;
+  realsense::common::MemoryTracker depth_image_memory_;
   PXCEnhancedPhoto::PhotoUtils* photo_utils_;
   PXCCapture* capture_;
   PXCCapture::Device* capture_device_;
 
   EnhancedPhotographyInstance* instance_;
 
+  // The getDepthImage() message, of |binary_message_size_| bytes of capacity.
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
+
+  // The frame ring and the pending burst are only used on pipeline_thread_.
+  std::vector<RingFrame> ring_;
+  realsense::common::MemoryTracker ring_memory_;
+  // The slot the next frame is stored in.
+  size_t ring_head_;
+  size_t ring_count_;
+  // The offset of the time stamps of the samples to milliseconds since the
+  // epoch. The smallest one seen has the least delivery delay, so it is
+  // kept.
+  double clock_offset_;
+  bool has_clock_offset_;
+
+  // The takePhoto() requests waiting for the first frame.
+  ScopedVector<XWalkExtensionFunctionInfo> pending_photos_;
+
+  scoped_ptr<XWalkExtensionFunctionInfo> burst_info_;
+  std::vector<PXCPhoto*> burst_photos_;
+  int burst_remaining_;
+
+  // The depth preview is only used on pipeline_thread_. Each read is
+  // answered with the next depth frame, so that every frame is sent once,
+  // as soon as it is captured.
+  bool preview_enabled_;
+  DepthPreview preview_;
+  scoped_ptr<XWalkExtensionFunctionInfo> preview_read_;
+
+  // The quality map is only used on pipeline_thread_. It is updated a few
+  // rows of tiles per frame while it is started.
+  bool quality_map_enabled_;
+  DepthQualityMap quality_map_;
+  // Waits for the first complete map.
+  scoped_ptr<XWalkExtensionFunctionInfo> quality_map_read_;
 };
 
 }  // namespace enhanced_photography
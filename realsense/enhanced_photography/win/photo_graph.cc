@@ -0,0 +1,287 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/photo_graph.h"
+
+#include "base/bind.h"
+#include "base/trace_event/trace_event.h"
+#include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
+#include "realsense/enhanced_photography/win/common_utils.h"
+#include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+
+namespace realsense {
+using namespace realsense::common;  // NOLINT
+namespace enhanced_photography {
+
+using jsapi::photo_utils::DepthFillQuality;
+using jsapi::photo_utils::ExecuteGraph;
+using jsapi::photo_utils::PhotoOperation;
+using jsapi::photo_utils::PhotoOperationType;
+
+namespace {
+
+PXCEnhancedPhoto::PhotoUtils::DepthFillQuality ToPXCQuality(
+    DepthFillQuality quality) {
+  if (quality == DepthFillQuality::DEPTH_FILL_QUALITY_HIGH)
+    return PXCEnhancedPhoto::PhotoUtils::DepthFillQuality::HIGH;
+  return PXCEnhancedPhoto::PhotoUtils::DepthFillQuality::LOW;
+}
+
+// Whether |operation| has the parameters its type requires.
+bool HasRequiredParams(const PhotoOperation& operation) {
+  switch (operation.type) {
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_COLOR_RESIZE:
+      return !!operation.width;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_COMMON_FOV:
+      return true;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_DEPTH_REFOCUS:
+      return !!operation.focus;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_DEPTH_RESIZE:
+      return !!operation.width;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_ENHANCE_DEPTH:
+      return operation.quality != DepthFillQuality::DEPTH_FILL_QUALITY_NONE;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_PHOTO_CROP:
+      return !!operation.rect;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_PHOTO_ROTATE:
+      return !!operation.rotation;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+PhotoGraph::Node::Node()
+    : operation(nullptr),
+      input(-1),
+      pending_children(0),
+      is_output(false),
+      result(nullptr) {
+}
+
+PhotoGraph::PhotoGraph(EnhancedPhotographyInstance* instance,
+                       scoped_ptr<ExecuteGraph::Params> params)
+    : instance_(instance),
+      params_(params.Pass()),
+      session_(nullptr),
+      failed_(false) {
+}
+
+PhotoGraph::~PhotoGraph() {
+  if (info_)
+    PostResult();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].result)
+      nodes_[i].result->Release();
+  }
+  if (source_)
+    source_->RemoveSharer();
+  if (session_)
+    ReleaseSharedSession(session_);
+}
+
+bool PhotoGraph::Validate() {
+  const std::vector<linked_ptr<PhotoOperation>>& operations =
+      params_->operations;
+  if (operations.empty())
+    return false;
+
+  nodes_.resize(operations.size());
+  bool has_output = false;
+  for (size_t i = 0; i < operations.size(); ++i) {
+    const PhotoOperation& operation = *operations[i];
+    if (!HasRequiredParams(operation))
+      return false;
+
+    Node& node = nodes_[i];
+    node.operation = &operation;
+    if (operation.input) {
+      // Operations only take the result of an earlier one, which rules out
+      // cycles.
+      node.input = *operation.input;
+      if (node.input < 0 || node.input >= static_cast<int>(i))
+        return false;
+      nodes_[node.input].children.push_back(static_cast<int>(i));
+      ++nodes_[node.input].pending_children;
+    } else {
+      roots_.push_back(static_cast<int>(i));
+    }
+    node.is_output = operation.output && *operation.output;
+    has_output |= node.is_output;
+  }
+  if (!has_output)
+    nodes_.back().is_output = true;
+  return true;
+}
+
+void PhotoGraph::Start(const scoped_refptr<SharedPhoto>& source,
+                       scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  source_ = source;
+  info_ = info.Pass();
+  session_ = AcquireSharedSession();
+  StartChildren(source_->get(), roots_);
+}
+
+void PhotoGraph::StartChildren(PXCPhoto* input,
+                               const std::vector<int>& children) {
+  // The SDK does not document concurrent readers of a photo as safe, so
+  // the first child reads |input| and the others each a copy of it, all
+  // taken before any child starts.
+  std::vector<scoped_refptr<SharedPhoto>> copies(children.size());
+  for (size_t i = 1; i < children.size(); ++i) {
+    PXCPhoto* copy = session_ ? session_->CreatePhoto() : nullptr;
+    if (!copy) {
+      base::AutoLock lock(lock_);
+      failed_ = true;
+      return;
+    }
+    copy->CopyPhoto(input);
+    copies[i] = new SharedPhoto(copy);
+  }
+
+  // The children don't depend on each other, each one gets its own sequence
+  // so that they run in parallel. The tasks keep the graph alive.
+  for (size_t i = 0; i < children.size(); ++i) {
+    instance_->CreateSequencedTaskRunner()->PostTask(
+        FROM_HERE,
+        base::Bind(&PhotoGraph::RunNode, this, children[i], copies[i]));
+  }
+}
+
+void PhotoGraph::RunNode(int index, const scoped_refptr<SharedPhoto>& copy) {
+  TRACE_EVENT1("realsense", "PhotoGraph::RunNode", "node", index);
+  Node& node = nodes_[index];
+  PXCPhoto* input;
+  {
+    base::AutoLock lock(lock_);
+    if (failed_)
+      return;
+    if (copy)
+      input = copy->get();
+    else
+      input = node.input < 0 ? source_->get() : nodes_[node.input].result;
+  }
+
+  // The input is not released until all its children are done, so it is
+  // read without holding |lock_|.
+  PXCPhoto* result = Execute(*node.operation, input);
+
+  std::vector<int> children;
+  {
+    base::AutoLock lock(lock_);
+    if (node.input >= 0) {
+      Node& parent = nodes_[node.input];
+      if (--parent.pending_children == 0 && !parent.is_output) {
+        parent.result->Release();
+        parent.result = nullptr;
+      }
+    }
+    if (!result) {
+      failed_ = true;
+      return;
+    }
+    if (node.children.empty() && !node.is_output) {
+      result->Release();
+      return;
+    }
+    node.result = result;
+    children = node.children;
+  }
+  StartChildren(result, children);
+}
+
+PXCPhoto* PhotoGraph::Execute(const PhotoOperation& operation,
+                              PXCPhoto* input) {
+  if (!session_)
+    return nullptr;
+
+  if (operation.type ==
+      PhotoOperationType::PHOTO_OPERATION_TYPE_DEPTH_REFOCUS) {
+    PXCEnhancedPhoto::DepthRefocus* depth_refocus =
+        PXCEnhancedPhoto::DepthRefocus::CreateInstance(session_);
+    if (!depth_refocus)
+      return nullptr;
+    PXCPhoto* pxcphoto = nullptr;
+    if (depth_refocus->Init(input) >= PXC_STATUS_NO_ERROR) {
+      PXCPointI32 focus;
+      focus.x = operation.focus->x;
+      focus.y = operation.focus->y;
+      if (operation.aperture)
+        pxcphoto = depth_refocus->Apply(focus, *operation.aperture);
+      else
+        pxcphoto = depth_refocus->Apply(focus);
+    }
+    depth_refocus->Release();
+    return pxcphoto;
+  }
+
+  // The operations of the graph run concurrently, each one uses its own
+  // module instance.
+  PXCEnhancedPhoto::PhotoUtils* photo_utils =
+      PXCEnhancedPhoto::PhotoUtils::CreateInstance(session_);
+  if (!photo_utils)
+    return nullptr;
+  PXCPhoto* pxcphoto = nullptr;
+  switch (operation.type) {
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_COLOR_RESIZE:
+      pxcphoto = photo_utils->ColorResize(input, *operation.width);
+      break;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_COMMON_FOV:
+      pxcphoto = photo_utils->CommonFOV(input);
+      break;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_DEPTH_RESIZE:
+      if (operation.quality == DepthFillQuality::DEPTH_FILL_QUALITY_NONE) {
+        pxcphoto = photo_utils->DepthResize(input, *operation.width);
+      } else {
+        pxcphoto = photo_utils->DepthResize(input, *operation.width,
+                                            ToPXCQuality(operation.quality));
+      }
+      break;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_ENHANCE_DEPTH:
+      pxcphoto = photo_utils->EnhanceDepth(input,
+                                           ToPXCQuality(operation.quality));
+      break;
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_PHOTO_CROP: {
+      PXCRectI32 pxcrect;
+      pxcrect.x = operation.rect->x;
+      pxcrect.y = operation.rect->y;
+      pxcrect.w = operation.rect->w;
+      pxcrect.h = operation.rect->h;
+      pxcphoto = photo_utils->PhotoCrop(input, pxcrect);
+      break;
+    }
+    case PhotoOperationType::PHOTO_OPERATION_TYPE_PHOTO_ROTATE:
+      pxcphoto = photo_utils->PhotoRotate(input, *operation.rotation);
+      break;
+    default:
+      break;
+  }
+  photo_utils->Release();
+  return pxcphoto;
+}
+
+void PhotoGraph::PostResult() {
+  // No task is left, so |lock_| is not needed.
+  if (failed_) {
+    info_->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
+  std::vector<linked_ptr<jsapi::depth_photo::Photo>> photos;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (!nodes_[i].is_output)
+      continue;
+    // The DepthPhotoObjects take over the outputs.
+    linked_ptr<jsapi::depth_photo::Photo> photo(
+        new jsapi::depth_photo::Photo);
+    CreateDepthPhotoObject(instance_, nodes_[i].result, photo.get());
+    nodes_[i].result = nullptr;
+    photos.push_back(photo);
+  }
+  info_->PostResult(ExecuteGraph::Results::Create(photos, std::string()));
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
@@ -0,0 +1,91 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_PHOTO_GRAPH_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_PHOTO_GRAPH_H_
+
+// This file is auto-generated by photo_utils.idl
+#include "photo_utils.h" // NOLINT
+
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "realsense/enhanced_photography/win/depth_photo_object.h"
+#include "third_party/libpxc/include/pxcenhancedphoto.h"
+#include "third_party/libpxc/include/pxcphoto.h"
+#include "third_party/libpxc/include/pxcsession.h"
+#include "xwalk/common/xwalk_extension_function_handler.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+class EnhancedPhotographyInstance;
+
+using xwalk::common::XWalkExtensionFunctionInfo;
+
+// Runs the operations of PhotoUtils.executeGraph(). Each operation takes the
+// result of an earlier one or the source photo, so the operations form a tree
+// rooted at the source. An operation runs on its own sequence of the worker
+// pool as soon as its input is ready, so that independent branches run in
+// parallel. The intermediate photos are not registered as DepthPhotoObjects,
+// and are released once the operations using them are done. The result is
+// posted when the last operation drops its reference to the graph.
+class PhotoGraph : public base::RefCountedThreadSafe<PhotoGraph> {
+ public:
+  PhotoGraph(EnhancedPhotographyInstance* instance,
+             scoped_ptr<jsapi::photo_utils::ExecuteGraph::Params> params);
+
+  // Returns false if the operations do not form a valid graph.
+  bool Validate();
+  // Runs the graph on |source|, a snapshot of the source photo taken with
+  // DepthPhotoObject::SnapshotPhoto(), and posts the result to |info|.
+  void Start(const scoped_refptr<SharedPhoto>& source,
+             scoped_ptr<XWalkExtensionFunctionInfo> info);
+
+ private:
+  friend class base::RefCountedThreadSafe<PhotoGraph>;
+
+  struct Node {
+    Node();
+
+    const jsapi::photo_utils::PhotoOperation* operation;
+    // -1 for the source photo.
+    int input;
+    std::vector<int> children;
+    // Children which have not read |result| yet.
+    int pending_children;
+    bool is_output;
+    PXCPhoto* result;
+  };
+
+  ~PhotoGraph();
+
+  // Starts the nodes |children|, which read |input|.
+  void StartChildren(PXCPhoto* input, const std::vector<int>& children);
+  // Runs the node |index| on |copy| if not NULL, on its input otherwise.
+  void RunNode(int index, const scoped_refptr<SharedPhoto>& copy);
+  PXCPhoto* Execute(const jsapi::photo_utils::PhotoOperation& operation,
+                    PXCPhoto* input);
+  void PostResult();
+
+  EnhancedPhotographyInstance* instance_;
+  scoped_ptr<jsapi::photo_utils::ExecuteGraph::Params> params_;
+  scoped_refptr<SharedPhoto> source_;
+  scoped_ptr<XWalkExtensionFunctionInfo> info_;
+  PXCSession* session_;
+
+  base::Lock lock_;
+  std::vector<Node> nodes_;
+  std::vector<int> roots_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(PhotoGraph);
+};
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_PHOTO_GRAPH_H_
@@ -6,9 +6,13 @@
 
 #include <string>
 
+#include "realsense/common/memory_accounting.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
+#include "realsense/enhanced_photography/win/depth_photo_cache.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
+#include "realsense/enhanced_photography/win/photo_graph.h"
 
 namespace realsense {
 using namespace realsense::common;  // NOLINT
@@ -17,44 +21,65 @@ namespace enhanced_photography {
 PhotoUtilsObject::PhotoUtilsObject(EnhancedPhotographyInstance* instance,
                                    bool isRSSDKInstalled)
     : instance_(instance),
+      sequence_(instance),
       isRSSDKInstalled_(isRSSDKInstalled),
       photo_utils_(nullptr),
       session_(nullptr) {
   handler_.Register("colorResize",
-                    base::Bind(&PhotoUtilsObject::OnColorResize,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnColorResize,
+                        base::Unretained(this))));
   handler_.Register("commonFOV",
-                    base::Bind(&PhotoUtilsObject::OnCommonFOV,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnCommonFOV,
+                        base::Unretained(this))));
   handler_.Register("depthResize",
-                    base::Bind(&PhotoUtilsObject::OnDepthResize,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnDepthResize,
+                        base::Unretained(this))));
   handler_.Register("enhanceDepth",
-                    base::Bind(&PhotoUtilsObject::OnEnhanceDepth,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnEnhanceDepth,
+                        base::Unretained(this))));
+  handler_.Register("executeGraph",
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnExecuteGraph,
+                        base::Unretained(this))));
   handler_.Register("getDepthQuality",
-                    base::Bind(&PhotoUtilsObject::OnGetDepthQuality,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnGetDepthQuality,
+                        base::Unretained(this))));
   handler_.Register("photoCrop",
-                    base::Bind(&PhotoUtilsObject::OnPhotoCrop,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnPhotoCrop,
+                        base::Unretained(this))));
   handler_.Register("photoRotate",
-                    base::Bind(&PhotoUtilsObject::OnPhotoRotate,
-                               base::Unretained(this)));
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnPhotoRotate,
+                        base::Unretained(this))));
+  handler_.Register("setPhotoMemoryBudget",
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnSetPhotoMemoryBudget,
+                        base::Unretained(this))));
+  handler_.Register("getMemoryStats",
+                    sequence_.Wrap(base::Bind(
+                        &PhotoUtilsObject::OnGetMemoryStats,
+                        base::Unretained(this))));
 
   if (isRSSDKInstalled) {
-    session_ = PXCSession::CreateInstance();
+    session_ = AcquireSharedSession();
     photo_utils_ = PXCEnhancedPhoto::PhotoUtils::CreateInstance(session_);
   }
 }
 
 PhotoUtilsObject::~PhotoUtilsObject() {
+  sequence_.Flush();
   if (photo_utils_) {
     photo_utils_->Release();
     photo_utils_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -75,9 +100,8 @@ void PhotoUtilsObject::OnColorResize(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -112,9 +136,8 @@ void PhotoUtilsObject::OnCommonFOV(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -147,9 +170,8 @@ void PhotoUtilsObject::OnDepthResize(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -197,9 +219,8 @@ void PhotoUtilsObject::OnEnhanceDepth(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -223,6 +244,43 @@ void PhotoUtilsObject::OnEnhanceDepth(
   info->PostResult(EnhanceDepth::Results::Create(photo, std::string()));
 }
 
+void PhotoUtilsObject::OnExecuteGraph(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  if (!isRSSDKInstalled_) {
+    info->PostResult(CreateDOMException(ERROR_CODE_INIT_FAILED));
+    return;
+  }
+
+  scoped_ptr<ExecuteGraph::Params> params(
+      ExecuteGraph::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  std::string object_id = params->photo.object_id;
+  scoped_refptr<PhotoGraph> graph(new PhotoGraph(instance_, params.Pass()));
+  if (!graph->Validate()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  scoped_refptr<SharedPhoto> source;
+  {
+    ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+    if (depthPhotoObject.get())
+      source = depthPhotoObject->SnapshotPhoto();
+  }
+  if (!source) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
+
+  // The graph runs on the worker pool without holding the photo, so this
+  // sequence is free for the next message.
+  graph->Start(source, info.Pass());
+}
+
 void PhotoUtilsObject::OnGetDepthQuality(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   if (!isRSSDKInstalled_) {
@@ -239,9 +297,8 @@ void PhotoUtilsObject::OnGetDepthQuality(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -281,9 +338,8 @@ void PhotoUtilsObject::OnPhotoCrop(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -322,9 +378,8 @@ void PhotoUtilsObject::OnPhotoRotate(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -343,5 +398,26 @@ void PhotoUtilsObject::OnPhotoRotate(
   info->PostResult(PhotoRotate::Results::Create(photo, std::string()));
 }
 
+void PhotoUtilsObject::OnSetPhotoMemoryBudget(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<SetPhotoMemoryBudget::Params> params(
+      SetPhotoMemoryBudget::Params::Create(*info->arguments()));
+  if (!params || params->budget_in_mb < 0) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  instance_->photo_cache()->SetBudget(
+      static_cast<size_t>(params->budget_in_mb) * 1024 * 1024);
+  info->PostResult(CreateSuccessResult());
+}
+
+void PhotoUtilsObject::OnGetMemoryStats(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  MemoryStats stats;
+  PopulateMemoryStats<MemoryCategoryStats>(&stats);
+  info->PostResult(GetMemoryStats::Results::Create(stats, std::string()));
+}
+
 }  // namespace enhanced_photography
 }  // namespace realsense
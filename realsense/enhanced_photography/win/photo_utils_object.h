@@ -9,6 +9,7 @@
 #include "photo_utils.h" // NOLINT
 
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 #include "third_party/libpxc/include/pxcphoto.h"
@@ -30,11 +31,15 @@ class PhotoUtilsObject : public xwalk::common::BindingObject {
   void OnCommonFOV(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnDepthResize(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnEnhanceDepth(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnExecuteGraph(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnGetDepthQuality(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnPhotoCrop(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnPhotoRotate(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnSetPhotoMemoryBudget(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnGetMemoryStats(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
   PXCSession* session_;
   PXCEnhancedPhoto::PhotoUtils* photo_utils_;
   bool isRSSDKInstalled_;
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
 
@@ -17,31 +18,35 @@ namespace enhanced_photography {
 
 SegmentationObject::SegmentationObject(EnhancedPhotographyInstance* instance)
     : instance_(instance),
-      binary_message_size_(0) {
+      sequence_(instance),
+      photo_(nullptr),
+      binary_message_size_(0),
+      binary_message_memory_("Segmentation", "binary_message") {
   handler_.Register("objectSegment",
-      base::Bind(&SegmentationObject::OnObjectSegment,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&SegmentationObject::OnObjectSegment,
+                                base::Unretained(this))));
   handler_.Register("redo",
-      base::Bind(&SegmentationObject::OnRedo,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&SegmentationObject::OnRedo,
+                                base::Unretained(this))));
   handler_.Register("refineMask",
-      base::Bind(&SegmentationObject::OnRefineMask,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&SegmentationObject::OnRefineMask,
+                                base::Unretained(this))));
   handler_.Register("undo",
-      base::Bind(&SegmentationObject::OnUndo,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&SegmentationObject::OnUndo,
+                                base::Unretained(this))));
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   segmentation_ = PXCEnhancedPhoto::Segmentation::CreateInstance(session_);
 }
 
 SegmentationObject::~SegmentationObject() {
+  sequence_.Flush();
   if (segmentation_) {
     segmentation_->Release();
     segmentation_ = nullptr;
   }
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -74,9 +79,8 @@ void SegmentationObject::OnObjectSegment(
   offset += sizeof(int);
 
   std::string object_id(data + offset, object_id_len);
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
@@ -112,11 +116,16 @@ void SegmentationObject::OnObjectSegment(
 
   PXCImage* bounding_mask = session_->CreateImage(&img_info, &img_data);
 
+  depthPhotoObject->PinPhoto();
   PXCImage* pxc_mask_image = segmentation_->ObjectSegment(
       depthPhotoObject->GetPhoto(), bounding_mask);
+  // Redo(), RefineMask() and Undo() work on this photo.
+  photo_id_ = object_id;
+  photo_ = depthPhotoObject->GetPhoto();
   if (!CopyImageToBinaryMessage(pxc_mask_image,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -136,10 +145,16 @@ void SegmentationObject::OnRedo(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   jsapi::depth_photo::Image image;
 
   DCHECK(segmentation_);
+  ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+  if (!module_photo.valid()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
   PXCImage* pxc_mask_image = segmentation_->Redo();
   if (!CopyImageToBinaryMessage(pxc_mask_image,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -197,11 +212,17 @@ void SegmentationObject::OnRefineMask(
       const uint8_t*>(data + offset);
   bool isForeground = bool_array[0] != 0;
 
+  ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+  if (!module_photo.valid()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
   PXCImage* pxc_mask_image = segmentation_->RefineMask(
       &points[0], static_cast<pxcI32>(points.size()), isForeground);
   if (!CopyImageToBinaryMessage(pxc_mask_image,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -219,10 +240,16 @@ void SegmentationObject::OnUndo(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   jsapi::depth_photo::Image image;
 
   DCHECK(segmentation_);
+  ScopedModulePhoto module_photo(instance_, photo_id_, photo_);
+  if (!module_photo.valid()) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
+    return;
+  }
   PXCImage* pxc_mask_image = segmentation_->Undo();
   if (!CopyImageToBinaryMessage(pxc_mask_image,
                                 binary_message_,
-                                &binary_message_size_)) {
+                                &binary_message_size_,
+                                &binary_message_memory_)) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
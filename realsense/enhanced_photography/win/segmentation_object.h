@@ -8,8 +8,13 @@
 // This file is auto-generated by segmentation.idl
 #include "segmentation.h" // NOLINT
 
+#include <string>
+
+#include "realsense/common/memory_accounting.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
+#include "third_party/libpxc/include/pxcphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 
 namespace realsense {
@@ -30,11 +35,17 @@ class SegmentationObject : public xwalk::common::BindingObject {
   void OnUndo(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
   PXCSession* session_;
   PXCEnhancedPhoto::Segmentation* segmentation_;
+  // The photo of the last objectSegment(), which |segmentation_| reads under
+  // a ScopedModulePhoto.
+  std::string photo_id_;
+  PXCPhoto* photo_;
 
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
 };
 
 }  // namespace enhanced_photography
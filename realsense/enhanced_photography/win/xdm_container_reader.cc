@@ -0,0 +1,260 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/enhanced_photography/win/xdm_container_reader.h"
+
+#include <cstring>
+
+namespace realsense {
+namespace enhanced_photography {
+
+namespace {
+
+// JPEG markers, see ITU T.81 table B.1.
+const uint8 kMarkerPrefix = 0xFF;
+const uint8 kMarkerSOI = 0xD8;
+const uint8 kMarkerEOI = 0xD9;
+const uint8 kMarkerSOS = 0xDA;
+const uint8 kMarkerTEM = 0x01;
+const uint8 kMarkerRST0 = 0xD0;
+const uint8 kMarkerRST7 = 0xD7;
+const uint8 kMarkerAPP1 = 0xE1;
+const uint8 kMarkerSOF0 = 0xC0;
+const uint8 kMarkerSOF15 = 0xCF;
+const uint8 kMarkerDHT = 0xC4;
+const uint8 kMarkerJPG = 0xC8;
+const uint8 kMarkerDAC = 0xCC;
+
+// APP1 signatures, zero terminated, see the XMP specification part 3.
+const char kXMPSignature[] = "http://ns.adobe.com/xap/1.0/";
+const char kExtendedXMPSignature[] = "http://ns.adobe.com/xmp/extension/";
+// GUID (32 bytes), full length (4 bytes) and offset (4 bytes).
+const size_t kExtendedXMPHeaderSize = 40;
+// Upper bound of the extended XMP we are willing to reassemble.
+const uint32 kMaxExtendedXMPSize = 16 * 1024 * 1024;
+
+// Namespace prefix shared by all the XDM 1.0 schemas.
+const char kXDMNamespace[] = "http://ns.xdm.org/photos/1.0/";
+// XDM property and element names. The namespace prefixes bound to them are
+// chosen by the writer, so only the local names are matched.
+const char kRevisionName[] = "Revision";
+const char kCameraName[] = "Camera";
+const char kDepthMapName[] = "DepthMap";
+
+inline uint16 ReadUint16(const uint8* data) {
+  return (data[0] << 8) | data[1];
+}
+
+inline uint32 ReadUint32(const uint8* data) {
+  return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+bool HasSignature(const uint8* data, size_t size, const char* signature,
+                  size_t signature_size) {
+  return size >= signature_size &&
+         memcmp(data, signature, signature_size) == 0;
+}
+
+bool IsSOF(uint8 marker) {
+  return marker >= kMarkerSOF0 && marker <= kMarkerSOF15 &&
+         marker != kMarkerDHT && marker != kMarkerJPG && marker != kMarkerDAC;
+}
+
+bool IsNameEnd(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '>' ||
+         c == '/' || c == '=';
+}
+
+// Whether the qualified name starting at |begin| has |local_name| as local
+// part, e.g. "xdm:Camera" for "Camera".
+bool MatchLocalName(const std::string& xml, size_t begin,
+                    const char* local_name, size_t* end) {
+  size_t name_end = begin;
+  while (name_end < xml.size() && !IsNameEnd(xml[name_end]))
+    ++name_end;
+  size_t colon = xml.rfind(':', name_end);
+  if (colon == std::string::npos || colon < begin)
+    colon = begin;
+  else
+    ++colon;
+  *end = name_end;
+  return xml.compare(colon, name_end - colon, local_name) == 0;
+}
+
+// Counts the start tags of the elements named |local_name|.
+int CountElements(const std::string& xml, const char* local_name) {
+  int count = 0;
+  size_t pos = 0;
+  while ((pos = xml.find('<', pos)) != std::string::npos) {
+    ++pos;
+    if (pos >= xml.size())
+      break;
+    char c = xml[pos];
+    if (c == '/' || c == '?' || c == '!')
+      continue;
+    size_t end;
+    if (MatchLocalName(xml, pos, local_name, &end))
+      ++count;
+    pos = end;
+  }
+  return count;
+}
+
+// Finds the value of the |local_name| property, serialized either as an
+// attribute or as a simple element.
+bool FindProperty(const std::string& xml, const char* local_name,
+                  std::string* value) {
+  const size_t name_size = strlen(local_name);
+  size_t pos = 0;
+  while ((pos = xml.find(local_name, pos)) != std::string::npos) {
+    size_t end = pos + name_size;
+    bool qualified = pos > 0 && xml[pos - 1] == ':';
+    pos = end;
+    if (!qualified || end >= xml.size())
+      continue;
+
+    if (xml[end] == '=' && end + 1 < xml.size() &&
+        (xml[end + 1] == '"' || xml[end + 1] == '\'')) {
+      size_t close = xml.find(xml[end + 1], end + 2);
+      if (close == std::string::npos)
+        return false;
+      *value = xml.substr(end + 2, close - end - 2);
+      return true;
+    }
+
+    size_t open = xml.rfind('<', end);
+    if (xml[end] == '>' && open != std::string::npos &&
+        xml.find_first_of("/ ", open) > end) {
+      size_t close = xml.find('<', end + 1);
+      if (close == std::string::npos)
+        return false;
+      *value = xml.substr(end + 1, close - end - 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+XDMContainerReader::XDMContainerReader()
+    : width_(0),
+      height_(0) {
+}
+
+XDMContainerReader::~XDMContainerReader() {
+}
+
+// static
+bool XDMContainerReader::IsJPEG(const uint8* data, size_t size) {
+  // SOI followed by the prefix of the first segment marker.
+  return size >= 3 && data[0] == kMarkerPrefix && data[1] == kMarkerSOI &&
+         data[2] == kMarkerPrefix;
+}
+
+bool XDMContainerReader::Parse(const uint8* data, size_t size) {
+  xmp_.clear();
+  extended_xmp_.clear();
+  width_ = 0;
+  height_ = 0;
+
+  if (!IsJPEG(data, size))
+    return false;
+
+  size_t offset = 2;
+  while (offset + 2 <= size) {
+    if (data[offset] != kMarkerPrefix)
+      return false;
+    uint8 marker = data[offset + 1];
+    offset += 2;
+
+    // Fill bytes.
+    if (marker == kMarkerPrefix) {
+      --offset;
+      continue;
+    }
+    // Markers without a payload.
+    if (marker == kMarkerTEM ||
+        (marker >= kMarkerRST0 && marker <= kMarkerRST7))
+      continue;
+    if (marker == kMarkerEOI)
+      break;
+
+    if (offset + 2 > size)
+      return false;
+    uint16 length = ReadUint16(data + offset);
+    if (length < 2 || offset + length > size)
+      return false;
+    const uint8* payload = data + offset + 2;
+    size_t payload_size = length - 2;
+
+    if (marker == kMarkerAPP1) {
+      ParseAPP1(payload, payload_size);
+    } else if (IsSOF(marker) && payload_size >= 5) {
+      // Precision (1 byte), height (2 bytes), width (2 bytes).
+      height_ = ReadUint16(payload + 1);
+      width_ = ReadUint16(payload + 3);
+    }
+
+    // All the metadata is before the compressed image data.
+    if (marker == kMarkerSOS)
+      break;
+    offset += length;
+  }
+  return true;
+}
+
+bool XDMContainerReader::IsXDM() const {
+  return xmp_.find(kXDMNamespace) != std::string::npos ||
+         extended_xmp_.find(kXDMNamespace) != std::string::npos;
+}
+
+std::string XDMContainerReader::QueryXDMRevision() const {
+  std::string revision;
+  if (!FindProperty(xmp_, kRevisionName, &revision))
+    FindProperty(extended_xmp_, kRevisionName, &revision);
+  return revision;
+}
+
+int XDMContainerReader::QueryNumberOfCameras() const {
+  return CountElements(xmp_, kCameraName) +
+         CountElements(extended_xmp_, kCameraName);
+}
+
+bool XDMContainerReader::HasDepthMap() const {
+  return CountElements(xmp_, kDepthMapName) > 0 ||
+         CountElements(extended_xmp_, kDepthMapName) > 0;
+}
+
+void XDMContainerReader::ParseAPP1(const uint8* data, size_t size) {
+  if (HasSignature(data, size, kXMPSignature, sizeof(kXMPSignature))) {
+    xmp_.assign(reinterpret_cast<const char*>(data) + sizeof(kXMPSignature),
+                size - sizeof(kXMPSignature));
+    return;
+  }
+
+  if (!HasSignature(data, size, kExtendedXMPSignature,
+                    sizeof(kExtendedXMPSignature)))
+    return;
+  data += sizeof(kExtendedXMPSignature);
+  size -= sizeof(kExtendedXMPSignature);
+  if (size < kExtendedXMPHeaderSize)
+    return;
+
+  uint32 full_length = ReadUint32(data + 32);
+  uint32 chunk_offset = ReadUint32(data + 36);
+  size_t chunk_size = size - kExtendedXMPHeaderSize;
+  if (full_length > kMaxExtendedXMPSize ||
+      chunk_offset > full_length ||
+      chunk_size > full_length - chunk_offset)
+    return;
+
+  if (extended_xmp_.size() != full_length)
+    extended_xmp_.resize(full_length);
+  memcpy(&extended_xmp_[chunk_offset], data + kExtendedXMPHeaderSize,
+         chunk_size);
+}
+
+}  // namespace enhanced_photography
+}  // namespace realsense
@@ -0,0 +1,63 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_XDM_CONTAINER_READER_H_
+#define REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_XDM_CONTAINER_READER_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace realsense {
+namespace enhanced_photography {
+
+// Reads the header segments of an XDM JPEG container from memory. Parsing
+// stops at the start of the compressed image data, so it costs the size of
+// the metadata rather than the size of the photo.
+class XDMContainerReader {
+ public:
+  XDMContainerReader();
+  ~XDMContainerReader();
+
+  // Whether |data| starts with a JPEG signature. Buffers failing this check
+  // are not XDM photos, the others may still be rejected by the SDK.
+  static bool IsJPEG(const uint8* data, size_t size);
+
+  // Returns false if |data| is not a well formed JPEG header.
+  bool Parse(const uint8* data, size_t size);
+
+  // Whether the XMP metadata declares the XDM namespaces.
+  bool IsXDM() const;
+
+  // Metadata answered from the XMP packets, matching what PXCPhoto returns
+  // once the whole photo is loaded.
+  std::string QueryXDMRevision() const;
+  int QueryNumberOfCameras() const;
+  bool HasDepthMap() const;
+
+  // The standard XMP packet (APP1 segment).
+  const std::string& xmp() const { return xmp_; }
+  // The extended XMP packet reassembled from its APP1 chunks, in which XDM
+  // stores the camera and depth metadata that don't fit in 64 KB.
+  const std::string& extended_xmp() const { return extended_xmp_; }
+
+  // Dimensions of the container image, from its SOF segment.
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+ private:
+  void ParseAPP1(const uint8* data, size_t size);
+
+  std::string xmp_;
+  std::string extended_xmp_;
+  int width_;
+  int height_;
+
+  DISALLOW_COPY_AND_ASSIGN(XDMContainerReader);
+};
+
+}  // namespace enhanced_photography
+}  // namespace realsense
+
+#endif  // REALSENSE_ENHANCED_PHOTOGRAPHY_WIN_XDM_CONTAINER_READER_H_
@@ -4,42 +4,114 @@
 
 #include "realsense/enhanced_photography/win/xdm_utils_object.h"
 
-#include "base/files/file.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
-#include "base/files/scoped_temp_dir.h"
+#include "base/memory/linked_ptr.h"
+#include "base/memory/ref_counted.h"
+#include "base/sys_info.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/shared_session.h"
 #include "realsense/enhanced_photography/win/common_utils.h"
 #include "realsense/enhanced_photography/win/depth_photo_object.h"
+#include "realsense/enhanced_photography/win/xdm_container_reader.h"
 
 namespace realsense {
 using namespace realsense::common;  // NOLINT
 namespace enhanced_photography {
 
+namespace {
+
+void ProbeBuffer(const uint8* data, size_t size, XDMInfo* info) {
+  XDMContainerReader reader;
+  info->is_xdm = reader.Parse(data, size) && reader.IsXDM();
+  info->width = reader.width();
+  info->height = reader.height();
+  if (info->is_xdm) {
+    info->revision = reader.QueryXDMRevision();
+    info->number_of_cameras = reader.QueryNumberOfCameras();
+    info->has_depth = reader.HasDepthMap();
+  } else {
+    info->number_of_cameras = 0;
+    info->has_depth = false;
+  }
+}
+
+// The files of one probeXDMBatch call, probed by several tasks running on
+// their own sequences. The result is posted once the last task is done and
+// drops its reference.
+class ProbeBatch : public base::RefCountedThreadSafe<ProbeBatch> {
+ public:
+  explicit ProbeBatch(scoped_ptr<XWalkExtensionFunctionInfo> info)
+      : info_(info.Pass()) {
+  }
+
+  void AddFile(const uint8* data, size_t size) {
+    files_.push_back(std::make_pair(data, size));
+    infos_.push_back(linked_ptr<XDMInfo>(new XDMInfo));
+  }
+
+  size_t size() const { return files_.size(); }
+
+  // Probes the files |first|, |first| + |stride|, ... Each file is written
+  // by a single task.
+  void Probe(size_t first, size_t stride) {
+    for (size_t i = first; i < files_.size(); i += stride)
+      ProbeBuffer(files_[i].first, files_[i].second, infos_[i].get());
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<ProbeBatch>;
+
+  ~ProbeBatch() {
+    info_->PostResult(ProbeXDMBatch::Results::Create(infos_, std::string()));
+  }
+
+  // Owns the arguments |files_| point into.
+  scoped_ptr<XWalkExtensionFunctionInfo> info_;
+  std::vector<std::pair<const uint8*, size_t> > files_;
+  std::vector<linked_ptr<XDMInfo> > infos_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProbeBatch);
+};
+
+}  // namespace
+
 XDMUtilsObject::XDMUtilsObject(EnhancedPhotographyInstance* instance,
                                bool isRSSDKInstalled)
       : instance_(instance),
+        sequence_(instance),
         isRSSDKInstalled_(isRSSDKInstalled),
-        session_(nullptr),
-        binary_message_size_(0) {
+        session_(nullptr) {
   handler_.Register("isXDM",
-      base::Bind(&XDMUtilsObject::OnIsXDM,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&XDMUtilsObject::OnIsXDM,
+                                base::Unretained(this))));
   handler_.Register("loadXDM",
-      base::Bind(&XDMUtilsObject::OnLoadXDM,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&XDMUtilsObject::OnLoadXDM,
+                                base::Unretained(this))));
   handler_.Register("saveXDM",
-      base::Bind(&XDMUtilsObject::OnSaveXDM,
-                 base::Unretained(this)));
+      sequence_.Wrap(base::Bind(&XDMUtilsObject::OnSaveXDM,
+                                base::Unretained(this))));
+  handler_.Register("probeXDM",
+      sequence_.Wrap(base::Bind(&XDMUtilsObject::OnProbeXDM,
+                                base::Unretained(this))));
+  handler_.Register("probeXDMBatch",
+      sequence_.Wrap(base::Bind(&XDMUtilsObject::OnProbeXDMBatch,
+                                base::Unretained(this))));
 
   if (isRSSDKInstalled) {
-    session_ = PXCSession::CreateInstance();
+    session_ = AcquireSharedSession();
   }
 }
 
 XDMUtilsObject::~XDMUtilsObject() {
+  sequence_.Flush();
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = nullptr;
   }
 }
@@ -53,24 +125,35 @@ void XDMUtilsObject::OnIsXDM(
 
   base::BinaryValue* binary_value = nullptr;
   GetBinaryValueFromArgs(info->arguments(), &binary_value);
-  if (!binary_value)
+  if (!binary_value) {
     info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
 
-  base::ScopedTempDir tmp_dir;
-  tmp_dir.CreateUniqueTempDir();
-  base::FilePath tmp_file = tmp_dir.path().Append(
-      FILE_PATH_LITERAL("tmp_img.jpg"));
+  // The header parser is stricter than the SDK, only trust it to turn down
+  // buffers that are not JPEG at all.
+  if (!XDMContainerReader::IsJPEG(
+          reinterpret_cast<const uint8*>(binary_value->GetBuffer()),
+          binary_value->GetSize())) {
+    info->PostResult(IsXDM::Results::Create(false, std::string()));
+    return;
+  }
 
-  CreateFileWithBinaryValue(*binary_value, &tmp_file);
+  base::FilePath tmp_file;
+  if (!WriteTempFile(*binary_value, &tmp_file)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
 
-  wchar_t* wfile = const_cast<wchar_t*>(tmp_file.value().c_str());
   PXCPhoto* pxcphoto = session_->CreatePhoto();
-  if (pxcphoto->IsXDM(wfile)) {
-    info->PostResult(IsXDM::Results::Create(true, std::string()));
-  } else {
-    info->PostResult(IsXDM::Results::Create(false, std::string()));
+  if (!pxcphoto) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
   }
+  wchar_t* wfile = const_cast<wchar_t*>(tmp_file.value().c_str());
+  bool is_xdm = pxcphoto->IsXDM(wfile) != 0;
   pxcphoto->Release();
+  info->PostResult(IsXDM::Results::Create(is_xdm, std::string()));
 }
 
 void XDMUtilsObject::OnLoadXDM(
@@ -82,19 +165,34 @@ void XDMUtilsObject::OnLoadXDM(
 
   base::BinaryValue* binary_value = nullptr;
   GetBinaryValueFromArgs(info->arguments(), &binary_value);
-  if (!binary_value)
+  if (!binary_value) {
     info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
 
-  base::ScopedTempDir tmp_dir;
-  tmp_dir.CreateUniqueTempDir();
-  base::FilePath tmp_file = tmp_dir.path().Append(
-      FILE_PATH_LITERAL("tmp_img.jpg"));
+  // Reject buffers that are not JPEG before touching the disk, the SDK
+  // decides about the others.
+  if (!XDMContainerReader::IsJPEG(
+          reinterpret_cast<const uint8*>(binary_value->GetBuffer()),
+          binary_value->GetSize())) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
 
-  CreateFileWithBinaryValue(*binary_value, &tmp_file);
+  base::FilePath tmp_file;
+  if (!WriteTempFile(*binary_value, &tmp_file)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
 
-  wchar_t* wfile = const_cast<wchar_t*>(tmp_file.value().c_str());
   PXCPhoto* pxcphoto = session_->CreatePhoto();
+  if (!pxcphoto) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+  wchar_t* wfile = const_cast<wchar_t*>(tmp_file.value().c_str());
   if (pxcphoto->LoadXDM(wfile) < PXC_STATUS_NO_ERROR) {
+    pxcphoto->Release();
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
@@ -118,48 +216,123 @@ void XDMUtilsObject::OnSaveXDM(
   }
 
   std::string object_id = params->photo.object_id;
-  DepthPhotoObject* depthPhotoObject = static_cast<DepthPhotoObject*>(
-      instance_->GetBindingObjectById(object_id));
-  if (!depthPhotoObject || !depthPhotoObject->GetPhoto()) {
+  ScopedDepthPhoto depthPhotoObject(instance_, object_id);
+  if (!depthPhotoObject.get() || !depthPhotoObject->GetPhoto()) {
     info->PostResult(CreateDOMException(ERROR_CODE_PHOTO_INVALID));
     return;
   }
 
-  base::ScopedTempDir tmp_dir;
-  tmp_dir.CreateUniqueTempDir();
-  base::FilePath tmp_file = tmp_dir.path().Append(
-      FILE_PATH_LITERAL("tmp_img.jpg"));
+  base::FilePath tmp_file;
+  if (!GetTempFilePath(&tmp_file)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
   wchar_t* wfile = const_cast<wchar_t*>(tmp_file.value().c_str());
   if (depthPhotoObject->GetPhoto()->SaveXDM(wfile) < PXC_STATUS_NO_ERROR) {
     info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
     return;
   }
 
-  base::File file(tmp_file, base::File::FLAG_OPEN | base::File::FLAG_READ);
-  int64 file_length = file.GetLength();
-  binary_message_size_ = file_length + sizeof(int);
-  binary_message_.reset(new uint8[binary_message_size_]);
-  // the first sizeof(int) bytes will be used for callback id.
-  char* data = reinterpret_cast<char*>(binary_message_.get() + 1 * sizeof(int));
-  file.Read(0, data, file_length);
-  file.Close();
+  int64 file_length = 0;
+  if (!base::GetFileSize(tmp_file, &file_length) || file_length <= 0 ||
+      file_length > kint32max - static_cast<int64>(sizeof(int))) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
+
+  // Read the file straight into the result buffer, the first sizeof(int)
+  // bytes will be used for callback id.
+  size_t buffer_size = static_cast<size_t>(file_length) + sizeof(int);
+  scoped_ptr<char[]> buffer(new char[buffer_size]);
+  int length = static_cast<int>(file_length);
+  if (base::ReadFile(tmp_file, buffer.get() + sizeof(int), length) !=
+      length) {
+    info->PostResult(CreateDOMException(ERROR_CODE_EXEC_FAILED));
+    return;
+  }
 
   scoped_ptr<base::ListValue> result(new base::ListValue());
-  result->Append(base::BinaryValue::CreateWithCopiedBuffer(
-      reinterpret_cast<const char*>(binary_message_.get()),
-      binary_message_size_));
+  result->Append(new base::BinaryValue(buffer.Pass(), buffer_size));
   info->PostResult(result.Pass());
 }
 
-void XDMUtilsObject::CreateFileWithBinaryValue(
-    const base::BinaryValue& value, base::FilePath* file_path) {
-  const char* data = value.GetBuffer();
+void XDMUtilsObject::OnProbeXDM(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  base::BinaryValue* binary_value = nullptr;
+  GetBinaryValueFromArgs(info->arguments(), &binary_value);
+  if (!binary_value) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  XDMInfo xdm_info;
+  ProbeBuffer(reinterpret_cast<const uint8*>(binary_value->GetBuffer()),
+              binary_value->GetSize(), &xdm_info);
+  info->PostResult(ProbeXDM::Results::Create(xdm_info, std::string()));
+}
+
+void XDMUtilsObject::OnProbeXDMBatch(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  base::BinaryValue* binary_value = nullptr;
+  GetBinaryValueFromArgs(info->arguments(), &binary_value);
+  if (!binary_value || binary_value->GetSize() < sizeof(int)) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  // Layout: count, then the size of each file, then the files.
+  const uint8* data =
+      reinterpret_cast<const uint8*>(binary_value->GetBuffer());
+  size_t size = binary_value->GetSize();
+  const int* int_array = reinterpret_cast<const int*>(data);
+  int count = int_array[0];
+  if (count < 0 ||
+      static_cast<size_t>(count) > size / sizeof(int) - 1) {
+    info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+    return;
+  }
+
+  size_t files_offset = (count + 1) * sizeof(int);
+  size_t offset = files_offset;
+  for (int i = 0; i < count; ++i) {
+    int file_size = int_array[i + 1];
+    if (file_size < 0 || static_cast<size_t>(file_size) > size - offset) {
+      info->PostResult(CreateDOMException(ERROR_CODE_PARAM_UNSUPPORTED));
+      return;
+    }
+    offset += file_size;
+  }
+
+  scoped_refptr<ProbeBatch> batch(new ProbeBatch(info.Pass()));
+  offset = files_offset;
+  for (int i = 0; i < count; ++i) {
+    batch->AddFile(data + offset, int_array[i + 1]);
+    offset += int_array[i + 1];
+  }
+
+  // One task per processor, the first one runs on this sequence.
+  size_t tasks = std::min(batch->size(),
+      static_cast<size_t>(base::SysInfo::NumberOfProcessors()));
+  for (size_t i = 1; i < tasks; ++i) {
+    instance_->CreateSequencedTaskRunner()->PostTask(
+        FROM_HERE, base::Bind(&ProbeBatch::Probe, batch, i, tasks));
+  }
+  if (tasks > 0)
+    batch->Probe(0, tasks);
+}
+
+bool XDMUtilsObject::GetTempFilePath(base::FilePath* file_path) {
+  if (!temp_dir_.IsValid() && !temp_dir_.CreateUniqueTempDir())
+    return false;
+  *file_path = temp_dir_.path().Append(FILE_PATH_LITERAL("tmp_img.jpg"));
+  return true;
+}
 
-  base::File file(*file_path,
-                  base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
-  file.created();
-  file.Write(0, data, static_cast<int>(value.GetSize()));
-  file.Close();
+bool XDMUtilsObject::WriteTempFile(const base::BinaryValue& binary_value,
+                                   base::FilePath* file_path) {
+  int size = static_cast<int>(binary_value.GetSize());
+  return GetTempFilePath(file_path) &&
+         base::WriteFile(*file_path, binary_value.GetBuffer(), size) == size;
 }
 
 }  // namespace enhanced_photography
@@ -11,7 +11,10 @@
 #include <string>
 
 #include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/values.h"
 #include "realsense/enhanced_photography/win/enhanced_photography_instance.h"
+#include "realsense/enhanced_photography/win/object_sequence.h"
 #include "third_party/libpxc/include/pxcenhancedphoto.h"
 #include "third_party/libpxc/include/pxcsession.h"
 #include "third_party/libpxc/include/pxcphoto.h"
@@ -32,15 +35,21 @@ class XDMUtilsObject : public xwalk::common::BindingObject {
   void OnIsXDM(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnLoadXDM(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnSaveXDM(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnProbeXDM(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnProbeXDMBatch(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
-  void CreateFileWithBinaryValue(const base::BinaryValue& value,
-                                 base::FilePath* file_path);
+  // The SDK only loads and saves XDM photos by file name, so those calls go
+  // through a file in |temp_dir_|, which is kept for the object lifetime.
+  bool GetTempFilePath(base::FilePath* file_path);
+  // Writes |binary_value| to the temp file and returns its path.
+  bool WriteTempFile(const base::BinaryValue& binary_value,
+                     base::FilePath* file_path);
 
   bool isRSSDKInstalled_;
   EnhancedPhotographyInstance* instance_;
+  ObjectSequence sequence_;
   PXCSession* session_;
-  scoped_ptr<uint8[]> binary_message_;
-  size_t binary_message_size_;
+  base::ScopedTempDir temp_dir_;
 };
 
 }  // namespace enhanced_photography
@@ -58,7 +58,8 @@ var FaceModule = function(previewStream, object_id) {
   function wrapProcessedSampleReturns(data) {
     // ProcessedSample layout:
     // color format (int32), width (int32), height (int32), data (int8 buffer),
-    // depth format (int32), width (int32), height (int32), data (int16 buffer),
+    // depth format (int32), width (int32), height (int32),
+    // depth section (see depth_codec_api.js),
     // number of faces (int32),
     // detection data available (int32),
     // landmark data available (int32),
@@ -107,9 +108,10 @@ var FaceModule = function(previewStream, object_id) {
     var depth_height = int32_array[2];
     // depth data
     var offset = offset + 3 * 4; // 3 int32(4 bytes)
-    var depth_data =
-        new Uint16Array(data, offset, depth_width * depth_height);
-    offset = offset + depth_width * depth_height * 2;
+    var depth_section = depthCodec.readDepthSection(
+        data, offset, depth_width, depth_height);
+    var depth_data = depth_section.data;
+    offset = offset + depth_section.byteLength;
 
     var face_array = [];
     int32_array = new Int32Array(data, offset, 4);
@@ -219,6 +221,8 @@ var FaceModule = function(previewStream, object_id) {
   this._addMethodWithPromise('stop', null, null, wrapErrorReturns);
   this._addMethodWithPromise('getProcessedSample', null, wrapProcessedSampleReturns,
                              wrapErrorReturns);
+  this._addMethodWithPromise('setStreamQuality', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('getMemoryStats', null, null, wrapErrorReturns);
 
   var FaceErrorEvent = function(type, data) {
     // Follow https://developer.mozilla.org/en-US/docs/Web/API/ErrorEvent
@@ -242,7 +246,15 @@ var FaceModule = function(previewStream, object_id) {
   };
   this._addEvent('alert', AlertEvent);
 
-  this._addEvent('processedsample');
+  // Once the page called setStreamQuality(), the processedsample events
+  // carry an ID and are acknowledged as they arrive, for the extension to
+  // pace them to the page.
+  var ProcessedSampleEvent = function(type, data) {
+    if (data && data.frameEventId)
+      that._postMessage('ackFrameEvent', [data.frameEventId]);
+    this.type = type;
+  };
+  this._addEvent('processedsample', ProcessedSampleEvent);
   this._addEvent('ready');
   this._addEvent('ended');
 
@@ -17,6 +17,8 @@ xwalk::common::Extension* CreateExtension() {
 
 // This will be generated from common_api.js
 extern const char kSource_common_api[];
+// This will be generated from depth_codec_api.js.
+extern const char kSource_depth_codec_api[];
 // This will be generated from face_api.js.
 extern const char kSource_face_api[];
 
@@ -26,6 +28,7 @@ namespace face {
 FaceExtension::FaceExtension() {
   SetExtensionName("realsense.Face");
   std::string jsapi(kSource_common_api);
+  jsapi += kSource_depth_codec_api;
   jsapi += kSource_face_api;
   SetJavaScriptAPI(jsapi.c_str());
 }
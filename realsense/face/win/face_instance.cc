@@ -19,7 +19,9 @@ using namespace xwalk::common; // NOLINT
 using realsense::jsapi::face_module::FaceModuleConstructor::Params;
 
 FaceInstance::FaceInstance()
-    : handler_(this),
+    : trace_recording_("face"),
+      memory_report_("face"),
+      handler_(this),
       store_(&handler_),
       ft_ext_thread_("FTExtensionThread") {
   ft_ext_thread_.Start();
@@ -52,6 +54,7 @@ void FaceInstance::HandleMessage(const char* msg) {
 
 void FaceInstance::OnHandleMessage(scoped_ptr<base::Value> msg) {
   DCHECK_EQ(ft_ext_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "FaceInstance::OnHandleMessage");
   handler_.HandleMessage(msg.Pass());
 }
 
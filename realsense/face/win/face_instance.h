@@ -7,6 +7,8 @@
 
 #include "base/threading/thread.h"
 #include "base/values.h"
+#include "realsense/common/memory_accounting.h"
+#include "realsense/common/trace_recorder.h"
 #include "xwalk/common/extension.h"
 #include "xwalk/common/binding_object_store.h"
 #include "xwalk/common/xwalk_extension_function_handler.h"
@@ -30,6 +32,12 @@ class FaceInstance : public Instance {
   void OnFaceModuleConstructor(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
 
+  // Declared first so that the trace is written once the threads below are
+  // stopped.
+  realsense::common::ScopedTraceRecording trace_recording_;
+  // Declared before the objects so that it reports the buffers they leave.
+  realsense::common::ScopedMemoryReport memory_report_;
+
   xwalk::common::XWalkExtensionFunctionHandler handler_;
   xwalk::common::BindingObjectStore store_;
   base::Thread ft_ext_thread_;
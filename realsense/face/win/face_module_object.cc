@@ -9,8 +9,13 @@
 
 #include "base/bind.h"
 #include "base/logging.h"
-#include "base/strings/sys_string_conversions.h"
+#include "base/time/time.h"
+#include "base/trace_event/trace_event.h"
+#include "realsense/common/binary_packing.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/frame_recorder_utils.h"
+#include "realsense/common/win/memory_accounting_utils.h"
+#include "realsense/common/win/shared_session.h"
 
 namespace {
 
@@ -264,6 +269,12 @@ void RetrieveConfig(
       new bool(config->QueryRecognition()->properties.isEnabled != 0));
 }
 
+pxcStatus CopyConfig(PXCFaceConfiguration* from, PXCFaceConfiguration* to) {
+  JSFaceConfigurationData config_data;
+  RetrieveConfig(from, &config_data);
+  return ApplyChangesConfig(to, config_data);
+}
+
 }  // namespace
 
 namespace realsense {
@@ -282,11 +293,20 @@ FaceModuleObject::FaceModuleObject()
       message_loop_(base::MessageLoopProxy::current()),
       session_(NULL),
       sense_manager_(NULL),
+      connection_(NULL),
+      tracking_mode_(
+          PXCFaceConfiguration::TrackingModeType::FACE_MODE_COLOR_PLUS_DEPTH),
       face_output_(NULL),
       face_config_(NULL),
       latest_color_image_(NULL),
       latest_depth_image_(NULL),
-      binary_message_size_(0) {
+      color_image_memory_("FaceModule", "latest_color_image"),
+      depth_image_memory_("FaceModule", "latest_depth_image"),
+      binary_message_size_(0),
+      binary_message_memory_("FaceModule", "binary_message"),
+      frame_id_(0),
+      sample_id_(0),
+      processed_sample_flow_("Face::ProcessedSample") {
   handler_.Register("setCamera",
                     base::Bind(&FaceModuleObject::OnSetCamera,
                                base::Unretained(this)));
@@ -299,6 +319,15 @@ FaceModuleObject::FaceModuleObject()
   handler_.Register("getProcessedSample",
                     base::Bind(&FaceModuleObject::OnGetProcessedSample,
                                base::Unretained(this)));
+  handler_.Register("setStreamQuality",
+                    base::Bind(&FaceModuleObject::OnSetStreamQuality,
+                               base::Unretained(this)));
+  handler_.Register("ackFrameEvent",
+                    base::Bind(&FaceModuleObject::OnAckFrameEvent,
+                               base::Unretained(this)));
+  handler_.Register("getMemoryStats",
+                    base::Bind(&FaceModuleObject::OnGetMemoryStats,
+                               base::Unretained(this)));
   handler_.Register("set",
                     base::Bind(&FaceModuleObject::OnSetConf,
                                base::Unretained(this)));
@@ -335,6 +364,8 @@ void FaceModuleObject::StartEvent(const std::string& type) {
 void FaceModuleObject::StopEvent(const std::string& type) {
   if (type == std::string("processedsample")) {
     on_processedsample_ = false;
+    // The events in flight are not acknowledged anymore.
+    stream_quality_.Reset();
   } else if (type == std::string("error")) {
     on_error_ = false;
   } else if (type == std::string("alert")) {
@@ -354,6 +385,36 @@ void FaceModuleObject::OnFiredAlert(const PXCFaceData::AlertData *alert) {
   DispatchEvent("alert", data.Pass());
 }
 
+bool FaceModuleObject::CanJoinPipeline(PXCSenseManager* sense_manager) {
+  return sense_manager->QueryFace() != NULL;
+}
+
+pxcStatus FaceModuleObject::OnConfigurePipeline(
+    PXCSenseManager* sense_manager) {
+  // Another face object of the camera may have enabled the module already.
+  if (!sense_manager->QueryFace()) {
+    pxcStatus status = sense_manager->EnableFace();
+    if (status < PXC_STATUS_NO_ERROR)
+      return status;
+  }
+  PXCFaceConfiguration* config =
+      sense_manager->QueryFace()->CreateActiveConfiguration();
+  if (!config)
+    return PXC_STATUS_ALLOC_FAILED;
+  config->SetTrackingMode(tracking_mode_);
+  pxcStatus status = config->ApplyChanges();
+  config->Release();
+  return status;
+}
+
+void FaceModuleObject::OnPipelineRestart() {
+  // The connection is released on face_module_thread_ before it stops.
+  face_module_thread_.message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&FaceModuleObject::OnRestartPipeline,
+                 base::Unretained(this)));
+}
+
 void FaceModuleObject::OnSetCamera(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK(!face_module_thread_.IsRunning());
@@ -441,6 +502,47 @@ void FaceModuleObject::OnGetProcessedSample(
                  base::Passed(&info)));
 }
 
+void FaceModuleObject::OnSetStreamQuality(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<SetStreamQuality::Params> params(
+      SetStreamQuality::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException("Invalid parameters",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+
+  static_assert(STREAM_QUALITY_FULL == 1 &&
+                    STREAM_QUALITY_MINIMAL ==
+                        StreamQualityController::QUALITY_MINIMAL + 1,
+                "StreamQuality lists the qualities of the controller");
+  if (!stream_quality_.SetBoundsFromOptions(
+          params->options.lowest_quality,
+          params->options.max_latency.get())) {
+    info->PostResult(CreateDOMException("Invalid maxLatency",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+  info->PostResult(CreateSuccessResult());
+}
+
+void FaceModuleObject::OnAckFrameEvent(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<AckFrameEvent::Params> params(
+      AckFrameEvent::Params::Create(*info->arguments()));
+  if (!params)
+    return;
+  stream_quality_.OnFrameEventAcknowledged(params->event_id,
+                                           base::TimeTicks::Now());
+}
+
+void FaceModuleObject::OnGetMemoryStats(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  MemoryStats stats;
+  PopulateMemoryStats<MemoryCategoryStats>(&stats);
+  info->PostResult(GetMemoryStats::Results::Create(stats));
+}
+
 void FaceModuleObject::OnSetConf(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   // Pipeline is not running, do it on current thread.
@@ -567,46 +669,13 @@ void FaceModuleObject::OnStartPipeline(
   DCHECK_EQ(face_module_thread_.message_loop(), base::MessageLoop::current());
   DCHECK(state_ == IDLE);
 
-  // Filter the camera.
-  // TODO(leonhsl): Seems base::SysUTF8ToWide() can't work well for now,
-  // otherwise we can simply call CaptureManager's FilterByDeviceInfo() instead.
-  PXCSession::ImplDesc templat = {};
-  templat.group = PXCSession::IMPL_GROUP_SENSOR;
-  templat.subgroup = PXCSession::IMPL_SUBGROUP_VIDEO_CAPTURE;
-  PXCSession::ImplDesc desc;
-  PXCCapture* capture;
-  int module_index = 0;
-  bool found = false;
-  while (session_->QueryImpl(&templat, module_index, &desc)
-      >= PXC_STATUS_NO_ERROR) {
-    if (session_->CreateImpl<PXCCapture>(&desc, &capture) < PXC_STATUS_NO_ERROR)
-      continue;
-
-    DLOG(INFO) << "RSSDK capture module: " << desc.friendlyName;
-
-    for (int i = 0; i < capture->QueryDeviceNum(); i++) {
-      PXCCapture::DeviceInfo device_info;
-      if ((capture->QueryDeviceInfo(i, &device_info)) < PXC_STATUS_NO_ERROR)
-        break;
-
-      if (camera_name_ == base::SysWideToUTF8(device_info.name)) {
-        found = true;
-        sense_manager_->QueryCaptureManager()->FilterByDeviceInfo(&device_info);
-        DLOG(INFO) << "Found capture device: "
-          << base::SysWideToUTF8(device_info.name) << " "
-          << base::SysWideToUTF8(device_info.did);
-        break;
-      }
-    }
-    capture->Release();
-    if (found)
-      break;
-    module_index++;
-  }
-
-  // Init sense manager.
-  pxcStatus status = sense_manager_->Init();
-  if (status < PXC_STATUS_NO_ERROR) {
+  // The pipeline of the camera is shared with the other extensions, and
+  // restarted if it does not run the face module yet.
+  tracking_mode_ = face_config_->GetTrackingMode();
+  pxcStatus status;
+  connection_ = CaptureService::GetInstance()->Connect(
+      camera_name_.c_str(), this, &status);
+  if (!connection_) {
     DLOG(ERROR) << "Failed to init sense manager: " << status;
     info->PostResult(
         CreateDOMException("Failed to init sense manager",
@@ -616,29 +685,13 @@ void FaceModuleObject::OnStartPipeline(
     return;
   }
 
-  if (face_config_->GetTrackingMode() ==
-      PXCFaceConfiguration::TrackingModeType::FACE_MODE_COLOR_PLUS_DEPTH) {
-    DLOG(INFO) << "Face color_depth tracking mode, set for DS4 device";
-    // Quote from C++ SDK FaceTracking sample application.
-    PXCCapture::DeviceInfo device_info;
-    sense_manager_->QueryCaptureManager()->QueryDevice()
-        ->QueryDeviceInfo(&device_info);
-
-    if (device_info.model == PXCCapture::DEVICE_MODEL_DS4) {
-      sense_manager_->QueryCaptureManager()->QueryDevice()
-          ->SetDSLeftRightExposure(26);
-      sense_manager_->QueryCaptureManager()->QueryDevice()
-          ->SetDepthConfidenceThreshold(0);
-    }
-  }
-
-  face_config_->SubscribeAlert(this);
-  face_config_->ApplyChanges();
-
-  // Create face module output.
-  face_output_ = sense_manager_->QueryFace()->CreateOutput();
-  if (!face_output_) {
-    DLOG(ERROR) << "Failed to create face output";
+  // Move the configuration set before start() to the face module of the
+  // pipeline.
+  PXCFaceConfiguration* config = face_config_;
+  face_config_ = NULL;
+  bool created = CreatePipelineOutputs(config);
+  config->Release();
+  if (!created) {
     info->PostResult(
         CreateDOMException("Failed to create face output",
                            ERROR_NAME_ABORTERROR));
@@ -647,11 +700,9 @@ void FaceModuleObject::OnStartPipeline(
     return;
   }
 
-  // We create color/depth images according current stream profiles.
-  CreateProcessedSampleImages();
-
   DLOG(INFO) << "Start, State transit from IDLE to TRACKING";
   state_ = TRACKING;
+  recorder_ = FrameRecorder::CreateFromEnvironment("face");
 
   face_module_thread_.message_loop()->PostTask(
       FROM_HERE,
@@ -665,7 +716,22 @@ void FaceModuleObject::OnRunPipeline() {
   DCHECK_EQ(face_module_thread_.message_loop(), base::MessageLoop::current());
   if (state_ != TRACKING) return;
 
-  pxcStatus status = sense_manager_->AcquireFrame(true);
+  TRACE_EVENT1("realsense", "FaceModuleObject::OnRunPipeline",
+               "frame", frame_id_ + 1);
+  CaptureFrame* frame = NULL;
+  pxcStatus status;
+  {
+    TRACE_EVENT0("realsense", "AcquireFrame");
+    status = connection_->AcquireFrame(&frame);
+  }
+  if (status == PXC_STATUS_EXEC_ABORTED) {
+    OnRestartPipeline();
+    face_module_thread_.message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&FaceModuleObject::OnRunPipeline,
+                   base::Unretained(this)));
+    return;
+  }
   if (status < PXC_STATUS_NO_ERROR) {
     DLOG(ERROR) << "AcquiredFrame failed: " << status;
     if (on_error_) {
@@ -677,16 +743,36 @@ void FaceModuleObject::OnRunPipeline() {
     StopFaceModuleThread();
     return;
   }
+  ++frame_id_;
 
-  face_output_->Update();
-  PXCCapture::Sample* face_sample = sense_manager_->QueryFaceSample();
+  {
+    TRACE_EVENT0("realsense", "PXCFaceData::Update");
+    face_output_->Update();
+  }
+  PXCCapture::Sample* face_sample = frame->QuerySenseManager()
+      ->QueryFaceSample();
+  if (face_sample && recorder_)
+    RecordFrame(face_sample);
   if (face_sample) {
-    if (on_processedsample_) {
+    // The samples skipped while the page lags are not copied.
+    int event_id = 0;
+    if (on_processedsample_ &&
+        stream_quality_.OnFrame(base::TimeTicks::Now(), &event_id)) {
       latest_color_image_->CopyImage(face_sample->color);
       if (latest_depth_image_ && face_sample->depth) {
         latest_depth_image_->CopyImage(face_sample->depth);
       }
-      DispatchEvent("processedsample");
+      // The flow ends when the page pulls the sample, or skips it.
+      ++sample_id_;
+      processed_sample_flow_.Begin(sample_id_);
+      // Paced events carry the ID the page acknowledges them with.
+      scoped_ptr<base::ListValue> data(new base::ListValue);
+      if (event_id) {
+        scoped_ptr<base::DictionaryValue> event(new base::DictionaryValue);
+        event->SetInteger("frameEventId", event_id);
+        data->Append(event.release());
+      }
+      DispatchEvent("processedsample", data.Pass());
     }
   } else {
     // face_sample is NULL means face module is paused
@@ -694,7 +780,7 @@ void FaceModuleObject::OnRunPipeline() {
     DLOG(ERROR) << "QueryFaceSample() returned NULL";
   }
 
-  sense_manager_->ReleaseFrame();
+  frame->Release();
 
   face_module_thread_.message_loop()->PostTask(
       FROM_HERE,
@@ -702,6 +788,67 @@ void FaceModuleObject::OnRunPipeline() {
                  base::Unretained(this)));
 }
 
+void FaceModuleObject::RecordFrame(PXCCapture::Sample* face_sample) {
+  TRACE_EVENT0("realsense", "FaceModuleObject::RecordFrame");
+  FrameRecorder::Frame* recorded_frame = recorder_->BeginFrame();
+  if (!recorded_frame)
+    return;
+
+  if (face_sample->color)
+    AddImageChunk(recorded_frame, FRAME_CHUNK_COLOR, face_sample->color);
+  if (face_sample->depth)
+    AddImageChunk(recorded_frame, FRAME_CHUNK_DEPTH, face_sample->depth);
+
+  // The size of the landmarks first, then the landmarks.
+  const int num_of_faces = face_output_->QueryNumberOfDetectedFaces();
+  size_t size = sizeof(int);
+  for (int i = 0; i < num_of_faces; ++i) {
+    const PXCFaceData::LandmarksData* landmarks =
+        face_output_->QueryFaceByIndex(i)->QueryLandmarks();
+    size += 2 * sizeof(int);
+    if (landmarks)
+      size += landmarks->QueryNumPoints() * kLandmarkPointSize;
+  }
+
+  uint8* output = recorded_frame->AddChunk(
+      FRAME_CHUNK_FACE_LANDMARKS, FRAME_CHUNK_FORMAT_DATA, 0, 0, 0, 0, size);
+  int* int_array = reinterpret_cast<int*>(output);
+  int_array[0] = num_of_faces;
+  output += sizeof(int);
+  for (int i = 0; i < num_of_faces; ++i) {
+    PXCFaceData::Face* face = face_output_->QueryFaceByIndex(i);
+    const PXCFaceData::LandmarksData* landmarks = face->QueryLandmarks();
+    const int num_of_points = landmarks ? landmarks->QueryNumPoints() : 0;
+    int_array = reinterpret_cast<int*>(output);
+    int_array[0] = face->QueryUserID();
+    int_array[1] = num_of_points;
+    output += 2 * sizeof(int);
+
+    PXCFaceData::LandmarkPoint landmark_point;
+    for (int j = 0; j < num_of_points; ++j) {
+      landmarks->QueryPoint(j, &landmark_point);
+      output = PackLandmarkPoint(landmark_point, output);
+    }
+  }
+
+  recorder_->EndFrame(recorded_frame);
+}
+
+void FaceModuleObject::OnRestartPipeline() {
+  DCHECK_EQ(face_module_thread_.message_loop(), base::MessageLoop::current());
+  if (state_ != TRACKING || !connection_->IsRestartPending()) return;
+
+  if (!RestartPipeline()) {
+    if (on_error_) {
+      DispatchErrorEvent("Failed to restart the camera pipeline. Stop.",
+                         ERROR_NAME_ABORTERROR);
+    }
+
+    ReleasePipelineResources();
+    StopFaceModuleThread();
+  }
+}
+
 void FaceModuleObject::OnStopPipeline(
     scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(face_module_thread_.message_loop(), base::MessageLoop::current());
@@ -716,6 +863,9 @@ void FaceModuleObject::OnStopPipeline(
 void FaceModuleObject::OnGetProcessedSampleOnPipeline(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(face_module_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT1("realsense", "FaceModuleObject::OnGetProcessedSampleOnPipeline",
+               "sample", sample_id_);
+  processed_sample_flow_.End();
 
   bool fail = false;
 
@@ -742,15 +892,24 @@ void FaceModuleObject::OnGetProcessedSampleOnPipeline(
   if (params->get_depth) {
     get_depth = *(params->get_depth.get());
   }
+  DepthMessageEncoding depth_encoding =
+      params->depth_encoding == DEPTH_ENCODING_RVL ? DEPTH_MESSAGE_RVL
+                                                   : DEPTH_MESSAGE_RAW;
+  // While the page lags the color image, a preview, is halved, then left
+  // out.
+  if (stream_quality_.ShouldSkipOptionalOutputs())
+    get_color = false;
+  bool halve_color = stream_quality_.ShouldDownscalePreview();
 
   PXCImage* color = latest_color_image_;
   PXCImage* depth = latest_depth_image_;
 
   const size_t post_data_size =
-      CalculateBinaryMessageSize(get_color, get_depth);
+      CalculateBinaryMessageSize(get_color, get_depth, depth_encoding);
   if (binary_message_size_ < post_data_size) {
     binary_message_.reset(new uint8[post_data_size]);
     binary_message_size_ = post_data_size;
+    binary_message_memory_.Set(post_data_size);
   }
 
   size_t offset = 0;
@@ -758,9 +917,15 @@ void FaceModuleObject::OnGetProcessedSampleOnPipeline(
   // Fill ProcessedSample::color image.
   if (get_color && color) {
     PXCImage::ImageInfo color_info = color->QueryInfo();
+    int color_width = color_info.width;
+    int color_height = color_info.height;
+    if (halve_color) {
+      color_width /= 2;
+      color_height /= 2;
+    }
     int_array[1] = 1;  // 1 for PixelFormat::PIXEL_FORMAT_RGB32
-    int_array[2] = color_info.width;
-    int_array[3] = color_info.height;
+    int_array[2] = color_width;
+    int_array[3] = color_height;
     offset += 4 * sizeof(int);
     PXCImage::ImageData color_data;
     pxcStatus status = color->AcquireAccess(
@@ -768,18 +933,14 @@ void FaceModuleObject::OnGetProcessedSampleOnPipeline(
     uint8_t* uint8_array =
         reinterpret_cast<uint8_t*>(binary_message_.get() + offset);
     if (status >= PXC_STATUS_NO_ERROR) {
-      int k = 0;
-      uint8_t* rgb32 = reinterpret_cast<uint8_t*>(color_data.planes[0]);
-      for (int y = 0; y < color_info.height; ++y) {
-        for (int x = 0; x < color_info.width; ++x) {
-          int i = (x + color_info.width * y) * 4;
-          uint8_array[k++] = rgb32[i + 2];
-          uint8_array[k++] = rgb32[i + 1];
-          uint8_array[k++] = rgb32[i];
-          uint8_array[k++] = rgb32[i + 3];
-        }
+      if (halve_color) {
+        HalveBGRAToRGBA(color_data.planes[0], color_data.pitches[0],
+                        color_info.width, color_info.height, uint8_array);
+      } else {
+        SwizzleBGRAToRGBA(color_data.planes[0], color_data.pitches[0],
+                          color_info.width, color_info.height, uint8_array);
       }
-      offset += color_info.width * color_info.height * 4;
+      offset += color_width * color_height * 4;
       color->ReleaseAccess(&color_data);
     } else {
       fail = true;
@@ -805,19 +966,11 @@ void FaceModuleObject::OnGetProcessedSampleOnPipeline(
       PXCImage::ImageData depth_data;
       pxcStatus status = depth->AcquireAccess(
           PXCImage::ACCESS_READ, PXCImage::PIXEL_FORMAT_DEPTH, &depth_data);
-      uint16_t* uint16_array = reinterpret_cast<uint16_t*>(
-          binary_message_.get() + offset);
       if (status >= PXC_STATUS_NO_ERROR) {
-        int k = 0;
-        for (int y = 0; y < depth_info.height; ++y) {
-          for (int x = 0; x < depth_info.width; ++x) {
-            uint16_t* depth16 =
-                reinterpret_cast<uint16_t*>(
-                    depth_data.planes[0] + depth_data.pitches[0] * y);
-            uint16_array[k++] = depth16[x];
-          }
-        }
-        offset += depth_info.width * depth_info.height * 2;
+        offset += PackDepthSection(depth_encoding, depth_data.planes[0],
+                                   depth_data.pitches[0], depth_info.width,
+                                   depth_info.height,
+                                   binary_message_.get() + offset);
         depth->ReleaseAccess(&depth_data);
       } else {
         fail = true;
@@ -829,6 +982,8 @@ void FaceModuleObject::OnGetProcessedSampleOnPipeline(
       int_array[1] = 0;
       int_array[2] = 0;
       offset += 3 * sizeof(int);
+      offset += PackDepthSection(DEPTH_MESSAGE_RAW, nullptr, 0, 0, 0,
+                                 binary_message_.get() + offset);
     }
   }
 
@@ -903,23 +1058,11 @@ void FaceModuleObject::OnGetProcessedSampleOnPipeline(
 
           PXCFaceData::LandmarkPoint landmark_point;
           for (int j = 0; j < num_of_points; j++) {
-            int_array = reinterpret_cast<int*>(binary_message_.get() + offset);
             landmarkData->QueryPoint(j, &landmark_point);
 
             DCHECK(landmark_point.source.index == j);
-            int_array[0] = landmark_point.source.alias;
-            int_array[1] = landmark_point.confidenceImage;
-            int_array[2] = landmark_point.confidenceWorld;
-            offset += 3 * sizeof(int);
-
-            float* float_array =
-                reinterpret_cast<float*>(binary_message_.get() + offset);
-            float_array[0] = landmark_point.world.x;
-            float_array[1] = landmark_point.world.y;
-            float_array[2] = landmark_point.world.z;
-            float_array[3] = landmark_point.image.x;
-            float_array[4] = landmark_point.image.y;
-            offset += 5 * sizeof(float);
+            PackLandmarkPoint(landmark_point, binary_message_.get() + offset);
+            offset += kLandmarkPointSize;
           }
         } else {
           // No landmark data for this face.
@@ -1141,7 +1284,7 @@ bool FaceModuleObject::Init() {
 
   // Create session.
   if (!session_) {
-    session_ = PXCSession::CreateInstance();
+    session_ = AcquireSharedSession();
     if (!session_) {
       DLOG(ERROR) << "Failed to create session";
       return false;
@@ -1157,7 +1300,7 @@ bool FaceModuleObject::Init() {
     }
   }
 
-  // Enable face module in sense manager.
+  // Enable face module in sense manager, to configure it before start().
   sense_manager_->EnableFace();
   PXCFaceModule* face_module = sense_manager_->QueryFace();
   if (!face_module) {
@@ -1197,19 +1340,60 @@ void FaceModuleObject::Destroy() {
   }
 
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = NULL;
   }
   DLOG(INFO) << "Destroy, State transit from " << state_ << " to NOT_READY";
   state_ = NOT_READY;
 }
 
+bool FaceModuleObject::CreatePipelineOutputs(PXCFaceConfiguration* config) {
+  PXCSenseManager* sense_manager = connection_->QuerySenseManager();
+  face_config_ = sense_manager->QueryFace()->CreateActiveConfiguration();
+  if (!face_config_) {
+    DLOG(ERROR) << "Failed to create FaceConfiguration";
+    return false;
+  }
+  CopyConfig(config, face_config_);
+
+  if (face_config_->GetTrackingMode() ==
+      PXCFaceConfiguration::TrackingModeType::FACE_MODE_COLOR_PLUS_DEPTH) {
+    DLOG(INFO) << "Face color_depth tracking mode, set for DS4 device";
+    // Quote from C++ SDK FaceTracking sample application.
+    PXCCapture::DeviceInfo device_info;
+    sense_manager->QueryCaptureManager()->QueryDevice()
+        ->QueryDeviceInfo(&device_info);
+
+    if (device_info.model == PXCCapture::DEVICE_MODEL_DS4) {
+      sense_manager->QueryCaptureManager()->QueryDevice()
+          ->SetDSLeftRightExposure(26);
+      sense_manager->QueryCaptureManager()->QueryDevice()
+          ->SetDepthConfidenceThreshold(0);
+    }
+  }
+
+  face_config_->SubscribeAlert(this);
+  face_config_->ApplyChanges();
+
+  // Create face module output.
+  face_output_ = sense_manager->QueryFace()->CreateOutput();
+  if (!face_output_) {
+    DLOG(ERROR) << "Failed to create face output";
+    return false;
+  }
+
+  // We create color/depth images according current stream profiles.
+  CreateProcessedSampleImages();
+  return true;
+}
+
 void FaceModuleObject::CreateProcessedSampleImages() {
   DCHECK(!latest_color_image_);
   DCHECK(!latest_depth_image_);
 
+  PXCSenseManager* sense_manager = connection_->QuerySenseManager();
   PXCCapture::Device::StreamProfileSet profiles = {};
-  sense_manager_->QueryCaptureManager()->QueryDevice()
+  sense_manager->QueryCaptureManager()->QueryDevice()
       ->QueryStreamProfileSet(&profiles);
 
   // color image.
@@ -1223,7 +1407,7 @@ void FaceModuleObject::CreateProcessedSampleImages() {
           << PXCImage::PixelFormatToString(profiles.color.imageInfo.format);
       PXCImage::ImageInfo image_info = profiles.color.imageInfo;
       image_info.format = PXCImage::PIXEL_FORMAT_RGB32;
-      latest_color_image_ = sense_manager_->QuerySession()
+      latest_color_image_ = sense_manager->QuerySession()
           ->CreateImage(&image_info);
     } else {
       DLOG(ERROR) << "Device color stream format is not RGB32: "
@@ -1243,7 +1427,7 @@ void FaceModuleObject::CreateProcessedSampleImages() {
           << PXCImage::PixelFormatToString(profiles.depth.imageInfo.format);
       PXCImage::ImageInfo image_info = profiles.depth.imageInfo;
       image_info.format = PXCImage::PIXEL_FORMAT_DEPTH;
-      latest_depth_image_ = sense_manager_->QuerySession()
+      latest_depth_image_ = sense_manager->QuerySession()
           ->CreateImage(&image_info);
     } else {
       DLOG(ERROR) << "Device depth stream format is not DEPTH: "
@@ -1252,14 +1436,34 @@ void FaceModuleObject::CreateProcessedSampleImages() {
   } else {
     DLOG(ERROR) << "Device depth stream format undefined";
   }
+  color_image_memory_.Set(GetImageFootprint(latest_color_image_));
+  depth_image_memory_.Set(GetImageFootprint(latest_depth_image_));
 }
 
-void FaceModuleObject::ReleasePipelineResources() {
-  DCHECK_EQ(face_module_thread_.message_loop(), base::MessageLoop::current());
-
-  binary_message_.reset();
-  binary_message_size_ = 0;
+bool FaceModuleObject::RestartPipeline() {
+  TRACE_EVENT0("realsense", "FaceModuleObject::RestartPipeline");
+  // Keep the configuration of the page in the face module of the object,
+  // which the restart does not touch.
+  PXCFaceConfiguration* config =
+      sense_manager_->QueryFace()->CreateActiveConfiguration();
+  if (!config) {
+    DLOG(ERROR) << "Failed to create FaceConfiguration";
+    return false;
+  }
+  CopyConfig(face_config_, config);
+  tracking_mode_ = config->GetTrackingMode();
+
+  ReleasePipelineOutputs();
+  pxcStatus status = connection_->WaitForRestart();
+  if (status < PXC_STATUS_NO_ERROR)
+    DLOG(ERROR) << "Failed to restart the pipeline: " << status;
+  bool created =
+      status >= PXC_STATUS_NO_ERROR && CreatePipelineOutputs(config);
+  config->Release();
+  return created;
+}
 
+void FaceModuleObject::ReleasePipelineOutputs() {
   if (latest_color_image_) {
     latest_color_image_->Release();
     latest_color_image_ = NULL;
@@ -1268,6 +1472,8 @@ void FaceModuleObject::ReleasePipelineResources() {
     latest_depth_image_->Release();
     latest_depth_image_ = NULL;
   }
+  color_image_memory_.Reset();
+  depth_image_memory_.Reset();
   if (face_output_) {
     face_output_->Release();
     face_output_ = NULL;
@@ -1277,8 +1483,23 @@ void FaceModuleObject::ReleasePipelineResources() {
     face_config_->Release();
     face_config_ = NULL;
   }
+}
+
+void FaceModuleObject::ReleasePipelineResources() {
+  DCHECK_EQ(face_module_thread_.message_loop(), base::MessageLoop::current());
 
-  sense_manager_->Close();
+  binary_message_.reset();
+  binary_message_size_ = 0;
+  binary_message_memory_.Reset();
+  // Writes the frames still queued and closes the file.
+  recorder_.reset();
+  processed_sample_flow_.End();
+
+  ReleasePipelineOutputs();
+  if (connection_) {
+    connection_->Release();
+    connection_ = NULL;
+  }
 
   DLOG(INFO) << "Release pipeline, State transit from "
       << state_ << " to NOT_READY";
@@ -1318,7 +1539,7 @@ void FaceModuleObject::OnStopFaceModuleThread() {
 //                                               image point x, y (float32),
 //                    recognition data: recognition ID (int32),
 size_t FaceModuleObject::CalculateBinaryMessageSize(
-    bool get_color, bool get_depth) {
+    bool get_color, bool get_depth, DepthMessageEncoding depth_encoding) {
   const int image_header_size = 3 * sizeof(int);  // format, width, height
 
   int color_image_size = 0;
@@ -1327,10 +1548,13 @@ size_t FaceModuleObject::CalculateBinaryMessageSize(
     color_image_size = color_info.width * color_info.height * 4;
   }
 
-  int depth_image_size = 0;
+  // The depth section is sent empty without a depth image.
+  size_t depth_section_size =
+      GetMaxDepthSectionSize(DEPTH_MESSAGE_RAW, 0, 0);
   if (get_depth && latest_depth_image_) {
     PXCImage::ImageInfo depth_info = latest_depth_image_->QueryInfo();
-    depth_image_size = depth_info.width * depth_info.height * 2;
+    depth_section_size = GetMaxDepthSectionSize(
+        depth_encoding, depth_info.width, depth_info.height);
   }
 
   const int num_of_faces = face_output_->QueryNumberOfDetectedFaces();
@@ -1346,8 +1570,7 @@ size_t FaceModuleObject::CalculateBinaryMessageSize(
     // size for "number of landmark points"
     landmark_size += sizeof(int);
     // size for "one landmark point data"
-    const int landmark_point_size = 3 * sizeof(int) + 5 * sizeof(float);
-    landmark_size += face_config_->landmarks.numLandmarks * landmark_point_size;
+    landmark_size += face_config_->landmarks.numLandmarks * kLandmarkPointSize;
 
     one_face_size += landmark_size;
   }
@@ -1356,13 +1579,13 @@ size_t FaceModuleObject::CalculateBinaryMessageSize(
     one_face_size += sizeof(int);
   }
 
-  const int message_size =
+  const size_t message_size =
       // call_id
       sizeof(int)
       // color image
       + image_header_size + color_image_size
       // depth image
-      + image_header_size + depth_image_size
+      + image_header_size + depth_section_size
       // faces
       + 4 * sizeof(int) + num_of_faces * one_face_size;
   return message_size;
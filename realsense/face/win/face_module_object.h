@@ -9,6 +9,12 @@
 
 #include "base/message_loop/message_loop_proxy.h"
 #include "base/threading/thread.h"
+#include "realsense/common/depth_codec.h"
+#include "realsense/common/frame_recorder.h"
+#include "realsense/common/memory_accounting.h"
+#include "realsense/common/stream_quality.h"
+#include "realsense/common/trace_recorder.h"
+#include "realsense/common/win/capture_service.h"
 #include "third_party/libpxc/include/pxcfaceconfiguration.h"
 #include "third_party/libpxc/include/pxcfacedata.h"
 #include "third_party/libpxc/include/pxcimage.h"
@@ -23,7 +29,8 @@ using realsense::jsapi::common::ErrorName;
 
 class FaceModuleObject
     : public xwalk::common::EventTarget,
-      public PXCFaceConfiguration::AlertHandler {
+      public PXCFaceConfiguration::AlertHandler,
+      public realsense::common::CaptureConsumer {
  public:
   FaceModuleObject();
   ~FaceModuleObject() override;
@@ -35,6 +42,11 @@ class FaceModuleObject
   // PXCFaceConfiguration::AlertHandler implementation.
   void OnFiredAlert(const PXCFaceData::AlertData *alert) override;
 
+  // CaptureConsumer implementation.
+  bool CanJoinPipeline(PXCSenseManager* sense_manager) override;
+  pxcStatus OnConfigurePipeline(PXCSenseManager* sense_manager) override;
+  void OnPipelineRestart() override;
+
  private:
   void OnSetCamera(
       scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
@@ -44,6 +56,12 @@ class FaceModuleObject
       scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
   void OnGetProcessedSample(
       scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  void OnSetStreamQuality(
+      scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  void OnAckFrameEvent(
+      scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  void OnGetMemoryStats(
+      scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
   void OnSetConf(
       scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
   void OnGetDefaultsConf(
@@ -69,6 +87,7 @@ class FaceModuleObject
   void OnUnregisterUserByIDOnPipeline(
       int userId,
       scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+  void OnRestartPipeline();
 
   // Run on face_ext_thread_ or face_module_thread_
   void DoSetConf(
@@ -83,7 +102,12 @@ class FaceModuleObject
   void Destroy();
 
   // Run on face_module_thread_
+  bool CreatePipelineOutputs(PXCFaceConfiguration* config);
   void CreateProcessedSampleImages();
+  bool RestartPipeline();
+  // Records the images and the landmarks of the frame, when recording.
+  void RecordFrame(PXCCapture::Sample* face_sample);
+  void ReleasePipelineOutputs();
   void ReleasePipelineResources();
 
   // Run on face_module_thread_
@@ -91,7 +115,9 @@ class FaceModuleObject
   // Run on face extension thread
   void OnStopFaceModuleThread();
 
-  size_t CalculateBinaryMessageSize(bool get_color, bool get_depth);
+  size_t CalculateBinaryMessageSize(
+      bool get_color, bool get_depth,
+      realsense::common::DepthMessageEncoding depth_encoding);
   void DispatchErrorEvent(const std::string& message, ErrorName name);
 
   enum State {
@@ -104,21 +130,45 @@ class FaceModuleObject
   bool on_processedsample_;
   bool on_error_;
   bool on_alert_;
+  // Paces the processedsample events and the sample images to the page.
+  realsense::common::StreamQualityController stream_quality_;
 
   base::Thread face_module_thread_;
   scoped_refptr<base::MessageLoopProxy> message_loop_;
 
+  // The face module of |sense_manager_| holds the configuration set before
+  // start(). The sense manager is never initialized: the frames come from the
+  // pipeline of |connection_|, which the camera may share with other
+  // extensions.
   PXCSession* session_;
   PXCSenseManager* sense_manager_;
+  realsense::common::CaptureConnection* connection_;
+  // The tracking mode selects the streams of the pipeline. Written on
+  // face_module_thread_ before the pipeline is configured.
+  PXCFaceConfiguration::TrackingModeType tracking_mode_;
   PXCFaceData* face_output_;
   PXCFaceConfiguration* face_config_;
 
   PXCImage* latest_color_image_;
   PXCImage* latest_depth_image_;
+  realsense::common::MemoryTracker color_image_memory_;
+  realsense::common::MemoryTracker depth_image_memory_;
 
   std::string camera_name_;
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
+
+  // Records the frames of the pipeline while REALSENSE_RECORD_DIR is set.
+  scoped_ptr<realsense::common::FrameRecorder> recorder_;
+
+  // Counts the frames of the pipeline.
+  int64 frame_id_;
+  // Counts the samples announced by "processedsample", which skip frames
+  // while the page lags, to match them to the getProcessedSample() calls in
+  // traces.
+  int64 sample_id_;
+  realsense::common::FrameFlow processed_sample_flow_;
 };
 
 }  // namespace face
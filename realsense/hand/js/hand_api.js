@@ -30,6 +30,17 @@ var HandModule = function(objectId) {
     return {format: format, width: width, height: height, data: buffer};
   }
 
+  function wrapDepthImageReturns(data) {
+    const bytesPerInt32 = 4;
+    var headerByteOffset = 4 * bytesPerInt32;
+    var int32View = new Int32Array(data, 0, 4);
+    // int32View[0] is the callback id, int32View[1] the depth pixel format.
+    var width = int32View[2];
+    var height = int32View[3];
+    var depth = depthCodec.readDepthSection(data, headerByteOffset, width, height);
+    return {format: 'depth', width: width, height: height, data: depth.data};
+  }
+
   var handModuleObject = this;
   function wrapHandsReturns(hands) {
     var handObjectArray = [];
@@ -48,7 +59,11 @@ var HandModule = function(objectId) {
   this._addMethodWithPromise('start', null, null, wrapErrorReturns);
   this._addMethodWithPromise('stop', null, null, wrapErrorReturns);
   this._addMethodWithPromise('track', null, wrapHandsReturns, wrapErrorReturns);
-  this._addMethodWithPromise('getDepthImage', null, wrapImageReturns, wrapErrorReturns);
+  this._addMethodWithPromise('getDepthImage', null, wrapDepthImageReturns, wrapErrorReturns);
+  this._addMethodWithPromise('trackGestures', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('registerGestureTemplate', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('unregisterGestureTemplate', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('getMemoryStats', null, null, wrapErrorReturns);
 
   this._addMethodWithPromise('_getSegmentationImageById', null, wrapImageReturns, wrapErrorReturns);
   this._addMethodWithPromise('_getContoursById', null, null, wrapErrorReturns);
@@ -0,0 +1,390 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "realsense/hand/win/gesture_recognizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "base/logging.h"
+
+namespace realsense {
+namespace hand {
+
+namespace {
+
+// About 3 seconds of history at 30 fps.
+const size_t kHistoryCapacity = 90;
+
+// Distances are in meters, as the world coordinates of the SDK.
+const float kPinchBeginDistance = 0.025f;
+const float kPinchEndDistance = 0.04f;
+
+const int kGrabBeginOpenness = 25;
+const int kGrabEndOpenness = 50;
+
+const int kPointExtendedFoldedness = 80;
+const int kPointFoldedFoldedness = 30;
+
+const double kSwipeWindowMs = 400;
+const double kSwipeCooldownMs = 600;
+const float kSwipeMinDistance = 0.15f;
+// The dominant axis must be this many times longer than the other one.
+const float kSwipeDominance = 2.0f;
+
+// Trajectories are resampled to this many points before DTW.
+const size_t kTemplatePoints = 32;
+// Trajectories that move less than this are considered still.
+const float kTemplateMinExtent = 0.02f;
+
+typedef GestureRecognizer::Vector3 Vector3;
+
+inline float Distance(const Vector3& a, const Vector3& b) {
+  float dx = a.x - b.x;
+  float dy = a.y - b.y;
+  float dz = a.z - b.z;
+  return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+inline Vector3 Lerp(const Vector3& a, const Vector3& b, float t) {
+  return Vector3(a.x + (b.x - a.x) * t,
+                 a.y + (b.y - a.y) * t,
+                 a.z + (b.z - a.z) * t);
+}
+
+// Resamples |points| to |count| points evenly spaced along the path.
+std::vector<Vector3> Resample(const std::vector<Vector3>& points,
+                              size_t count) {
+  std::vector<Vector3> result;
+  result.reserve(count);
+
+  float length = 0;
+  for (size_t i = 1; i < points.size(); ++i)
+    length += Distance(points[i - 1], points[i]);
+
+  if (points.size() < 2 || length == 0) {
+    result.assign(count, points.empty() ? Vector3() : points[0]);
+    return result;
+  }
+
+  const float step = length / (count - 1);
+  float accumulated = 0;
+  size_t i = 1;
+  result.push_back(points[0]);
+  for (size_t k = 1; k < count - 1; ++k) {
+    float target = step * k;
+    float segment = Distance(points[i - 1], points[i]);
+    while (i < points.size() - 1 && accumulated + segment < target) {
+      accumulated += segment;
+      ++i;
+      segment = Distance(points[i - 1], points[i]);
+    }
+    float t = segment > 0 ? (target - accumulated) / segment : 0;
+    result.push_back(Lerp(points[i - 1], points[i], std::min(t, 1.0f)));
+  }
+  result.push_back(points.back());
+  return result;
+}
+
+// Translates the trajectory to its centroid and scales its largest extent to
+// 1, so that templates match regardless of where and how big they are drawn.
+bool Normalize(std::vector<Vector3>* points) {
+  if (points->empty())
+    return false;
+
+  Vector3 min_point = points->front();
+  Vector3 max_point = points->front();
+  Vector3 centroid;
+  for (size_t i = 0; i < points->size(); ++i) {
+    const Vector3& p = (*points)[i];
+    min_point.x = std::min(min_point.x, p.x);
+    min_point.y = std::min(min_point.y, p.y);
+    min_point.z = std::min(min_point.z, p.z);
+    max_point.x = std::max(max_point.x, p.x);
+    max_point.y = std::max(max_point.y, p.y);
+    max_point.z = std::max(max_point.z, p.z);
+    centroid.x += p.x;
+    centroid.y += p.y;
+    centroid.z += p.z;
+  }
+  float extent = std::max(max_point.x - min_point.x,
+                          std::max(max_point.y - min_point.y,
+                                   max_point.z - min_point.z));
+  if (extent < kTemplateMinExtent)
+    return false;
+
+  float n = static_cast<float>(points->size());
+  centroid.x /= n;
+  centroid.y /= n;
+  centroid.z /= n;
+  for (size_t i = 0; i < points->size(); ++i) {
+    Vector3& p = (*points)[i];
+    p.x = (p.x - centroid.x) / extent;
+    p.y = (p.y - centroid.y) / extent;
+    p.z = (p.z - centroid.z) / extent;
+  }
+  return true;
+}
+
+// Returns the DTW cost between |a| and |b| divided by the path length.
+double DynamicTimeWarping(const std::vector<Vector3>& a,
+                          const std::vector<Vector3>& b) {
+  const size_t n = a.size();
+  const size_t m = b.size();
+  const double kInfinity = std::numeric_limits<double>::infinity();
+  // Only two rows of the cost matrix are needed at a time.
+  std::vector<double> previous(m + 1, kInfinity);
+  std::vector<double> current(m + 1, kInfinity);
+  previous[0] = 0;
+  for (size_t i = 1; i <= n; ++i) {
+    current[0] = kInfinity;
+    for (size_t j = 1; j <= m; ++j) {
+      double cost = Distance(a[i - 1], b[j - 1]);
+      current[j] = cost + std::min(previous[j],
+                                   std::min(current[j - 1], previous[j - 1]));
+    }
+    previous.swap(current);
+  }
+  return previous[m] / (n + m);
+}
+
+GestureRecognizer::Gesture MakeGesture(
+    const std::string& name, int hand_id,
+    GestureRecognizer::GestureState state,
+    const GestureRecognizer::HandFrame& frame) {
+  GestureRecognizer::Gesture gesture;
+  gesture.name = name;
+  gesture.hand_id = hand_id;
+  gesture.state = state;
+  gesture.time_stamp = frame.time_stamp;
+  gesture.position = frame.palm;
+  gesture.score = 1.0;
+  return gesture;
+}
+
+}  // namespace
+
+GestureRecognizer::History::History()
+    : frames_(kHistoryCapacity),
+      head_(0),
+      size_(0) {
+}
+
+void GestureRecognizer::History::Push(const HandFrame& frame) {
+  frames_[head_] = frame;
+  head_ = (head_ + 1) % frames_.size();
+  if (size_ < frames_.size())
+    ++size_;
+}
+
+void GestureRecognizer::History::Clear() {
+  head_ = 0;
+  size_ = 0;
+}
+
+const GestureRecognizer::HandFrame& GestureRecognizer::History::at(
+    size_t i) const {
+  DCHECK_LT(i, size_);
+  return frames_[(head_ + frames_.size() - size_ + i) % frames_.size()];
+}
+
+GestureRecognizer::GestureRecognizer()
+    : enabled_(false) {
+}
+
+GestureRecognizer::~GestureRecognizer() {
+}
+
+bool GestureRecognizer::RegisterTemplate(const std::string& name,
+                                         const std::vector<Vector3>& points,
+                                         double threshold) {
+  if (name.empty() || points.size() < 2 || points.size() > kHistoryCapacity ||
+      threshold <= 0)
+    return false;
+
+  std::vector<Vector3> normalized(points);
+  if (!Normalize(&normalized))
+    return false;
+
+  Template& entry = templates_[name];
+  entry.points = Resample(normalized, kTemplatePoints);
+  entry.frame_count = points.size();
+  entry.threshold = threshold;
+  return true;
+}
+
+bool GestureRecognizer::UnregisterTemplate(const std::string& name) {
+  return templates_.erase(name) > 0;
+}
+
+void GestureRecognizer::Update(int hand_id, const HandFrame& frame,
+                               std::vector<Gesture>* gestures) {
+  HandState& state = hands_[hand_id];
+  state.history.Push(frame);
+
+  DetectPoses(hand_id, &state, gestures);
+  DetectSwipe(hand_id, &state, gestures);
+  MatchTemplates(hand_id, &state, gestures);
+}
+
+void GestureRecognizer::RemoveLostHands(const std::vector<int>& live_hand_ids,
+                                        double time_stamp,
+                                        std::vector<Gesture>* gestures) {
+  std::map<int, HandState>::iterator it = hands_.begin();
+  while (it != hands_.end()) {
+    if (std::find(live_hand_ids.begin(), live_hand_ids.end(), it->first) !=
+        live_hand_ids.end()) {
+      ++it;
+      continue;
+    }
+    HandState& state = it->second;
+    if (state.history.size() > 0) {
+      HandFrame last = state.history.latest();
+      last.time_stamp = time_stamp;
+      if (state.pinching)
+        gestures->push_back(
+            MakeGesture("pinch", it->first, GESTURE_STATE_END, last));
+      if (state.grabbing)
+        gestures->push_back(
+            MakeGesture("grab", it->first, GESTURE_STATE_END, last));
+      if (state.pointing)
+        gestures->push_back(
+            MakeGesture("point", it->first, GESTURE_STATE_END, last));
+    }
+    hands_.erase(it++);
+  }
+}
+
+void GestureRecognizer::Reset() {
+  hands_.clear();
+}
+
+void GestureRecognizer::DetectPoses(int hand_id, HandState* state,
+                                    std::vector<Gesture>* gestures) {
+  const HandFrame& frame = state->history.latest();
+
+  // Pinch, with hysteresis to avoid flickering around the threshold.
+  float pinch_distance = Distance(frame.thumb_tip, frame.index_tip);
+  if (!state->pinching && pinch_distance < kPinchBeginDistance) {
+    state->pinching = true;
+    gestures->push_back(
+        MakeGesture("pinch", hand_id, GESTURE_STATE_BEGIN, frame));
+  } else if (state->pinching && pinch_distance > kPinchEndDistance) {
+    state->pinching = false;
+    gestures->push_back(
+        MakeGesture("pinch", hand_id, GESTURE_STATE_END, frame));
+  }
+
+  // Grab.
+  if (!state->grabbing && frame.openness < kGrabBeginOpenness) {
+    state->grabbing = true;
+    gestures->push_back(
+        MakeGesture("grab", hand_id, GESTURE_STATE_BEGIN, frame));
+  } else if (state->grabbing && frame.openness > kGrabEndOpenness) {
+    state->grabbing = false;
+    gestures->push_back(
+        MakeGesture("grab", hand_id, GESTURE_STATE_END, frame));
+  }
+
+  // Point: index extended while middle, ring and pinky are folded.
+  bool pointing =
+      frame.foldedness[FINGER_INDEX] >= kPointExtendedFoldedness &&
+      frame.foldedness[FINGER_MIDDLE] <= kPointFoldedFoldedness &&
+      frame.foldedness[FINGER_RING] <= kPointFoldedFoldedness &&
+      frame.foldedness[FINGER_PINKY] <= kPointFoldedFoldedness;
+  if (pointing != state->pointing) {
+    state->pointing = pointing;
+    Gesture gesture = MakeGesture(
+        "point", hand_id,
+        pointing ? GESTURE_STATE_BEGIN : GESTURE_STATE_END, frame);
+    gesture.position = frame.index_tip;
+    gestures->push_back(gesture);
+  }
+}
+
+void GestureRecognizer::DetectSwipe(int hand_id, HandState* state,
+                                    std::vector<Gesture>* gestures) {
+  const History& history = state->history;
+  const HandFrame& latest = history.latest();
+  if (latest.time_stamp - state->last_swipe_time < kSwipeCooldownMs)
+    return;
+
+  // Find the oldest frame within the swipe window.
+  size_t first = history.size() - 1;
+  while (first > 0 &&
+         latest.time_stamp - history.at(first - 1).time_stamp <=
+             kSwipeWindowMs) {
+    --first;
+  }
+  if (first == history.size() - 1)
+    return;
+
+  const Vector3& from = history.at(first).palm;
+  float dx = latest.palm.x - from.x;
+  float dy = latest.palm.y - from.y;
+  float abs_dx = std::abs(dx);
+  float abs_dy = std::abs(dy);
+
+  const char* name = NULL;
+  if (abs_dx >= kSwipeMinDistance && abs_dx >= abs_dy * kSwipeDominance)
+    name = dx > 0 ? "swipe-right" : "swipe-left";
+  else if (abs_dy >= kSwipeMinDistance && abs_dy >= abs_dx * kSwipeDominance)
+    name = dy > 0 ? "swipe-up" : "swipe-down";
+  if (!name)
+    return;
+
+  state->last_swipe_time = latest.time_stamp;
+  gestures->push_back(
+      MakeGesture(name, hand_id, GESTURE_STATE_INSTANT, latest));
+}
+
+void GestureRecognizer::MatchTemplates(int hand_id, HandState* state,
+                                       std::vector<Gesture>* gestures) {
+  if (templates_.empty())
+    return;
+
+  const History& history = state->history;
+  const Template* best = NULL;
+  std::string best_name;
+  double best_cost = 0;
+  for (std::map<std::string, Template>::const_iterator it = templates_.begin();
+       it != templates_.end(); ++it) {
+    const Template& entry = it->second;
+    if (history.size() < entry.frame_count)
+      continue;
+
+    std::vector<Vector3> candidate;
+    candidate.reserve(entry.frame_count);
+    for (size_t i = history.size() - entry.frame_count;
+         i < history.size(); ++i) {
+      candidate.push_back(history.at(i).palm);
+    }
+    if (!Normalize(&candidate))
+      continue;
+
+    double cost = DynamicTimeWarping(
+        Resample(candidate, kTemplatePoints), entry.points);
+    if (cost <= entry.threshold && (!best || cost < best_cost)) {
+      best = &entry;
+      best_name = it->first;
+      best_cost = cost;
+    }
+  }
+  if (!best)
+    return;
+
+  Gesture gesture = MakeGesture(best_name, hand_id, GESTURE_STATE_INSTANT,
+                                history.latest());
+  gesture.score = 1.0 - best_cost / best->threshold;
+  gestures->push_back(gesture);
+
+  // Start over so the same motion doesn't match on the following frames.
+  HandFrame latest = history.latest();
+  state->history.Clear();
+  state->history.Push(latest);
+}
+
+}  // namespace hand
+}  // namespace realsense
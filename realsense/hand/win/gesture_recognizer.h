@@ -0,0 +1,139 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_HAND_WIN_GESTURE_RECOGNIZER_H_
+#define REALSENSE_HAND_WIN_GESTURE_RECOGNIZER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace realsense {
+namespace hand {
+
+// Rule and template based gesture recognition running on the native hand
+// tracking results, so gesture-only apps never need the full skeleton.
+class GestureRecognizer {
+ public:
+  struct Vector3 {
+    Vector3() : x(0), y(0), z(0) {}
+    Vector3(float x, float y, float z) : x(x), y(y), z(z) {}
+    float x;
+    float y;
+    float z;
+  };
+
+  enum Finger {
+    FINGER_THUMB,
+    FINGER_INDEX,
+    FINGER_MIDDLE,
+    FINGER_RING,
+    FINGER_PINKY,
+    NUMBER_OF_FINGERS,
+  };
+
+  // Subset of one tracked hand that the recognizer consumes per frame.
+  struct HandFrame {
+    double time_stamp;  // In milliseconds.
+    Vector3 palm;  // Mass center in world coordinates (meters).
+    Vector3 thumb_tip;
+    Vector3 index_tip;
+    int openness;  // 0 (closed) .. 100 (open).
+    int foldedness[NUMBER_OF_FINGERS];  // 0 (folded) .. 100 (extended).
+  };
+
+  enum GestureState {
+    GESTURE_STATE_BEGIN,
+    GESTURE_STATE_END,
+    GESTURE_STATE_INSTANT,
+  };
+
+  struct Gesture {
+    std::string name;
+    int hand_id;
+    GestureState state;
+    double time_stamp;
+    Vector3 position;
+    // 1.0 for rule based gestures, 1 - normalized DTW cost for templates.
+    double score;
+  };
+
+  GestureRecognizer();
+  ~GestureRecognizer();
+
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+  bool enabled() const { return enabled_; }
+
+  // |points| is a palm trajectory sampled at the tracking frame rate.
+  // |threshold| is the maximal normalized DTW cost accepted as a match.
+  bool RegisterTemplate(const std::string& name,
+                        const std::vector<Vector3>& points,
+                        double threshold);
+  bool UnregisterTemplate(const std::string& name);
+
+  // Feeds one frame of hand |hand_id| and appends recognized gestures.
+  void Update(int hand_id, const HandFrame& frame,
+              std::vector<Gesture>* gestures);
+  // Drops the history of hands that are not in |live_hand_ids|, and emits
+  // the end of gestures they were holding.
+  void RemoveLostHands(const std::vector<int>& live_hand_ids,
+                       double time_stamp,
+                       std::vector<Gesture>* gestures);
+  void Reset();
+
+ private:
+  // Fixed capacity history of the recent frames of one hand.
+  class History {
+   public:
+    History();
+
+    void Push(const HandFrame& frame);
+    void Clear();
+    size_t size() const { return size_; }
+    // 0 is the oldest frame, size() - 1 the latest.
+    const HandFrame& at(size_t i) const;
+    const HandFrame& latest() const { return at(size_ - 1); }
+
+   private:
+    std::vector<HandFrame> frames_;
+    size_t head_;
+    size_t size_;
+  };
+
+  struct HandState {
+    HandState() : pinching(false), grabbing(false), pointing(false),
+                  last_swipe_time(0) {}
+    History history;
+    bool pinching;
+    bool grabbing;
+    bool pointing;
+    double last_swipe_time;
+  };
+
+  struct Template {
+    std::vector<Vector3> points;  // Normalized and resampled.
+    size_t frame_count;  // Length of the original trajectory.
+    double threshold;
+  };
+
+  void DetectPoses(int hand_id, HandState* state,
+                   std::vector<Gesture>* gestures);
+  void DetectSwipe(int hand_id, HandState* state,
+                   std::vector<Gesture>* gestures);
+  void MatchTemplates(int hand_id, HandState* state,
+                      std::vector<Gesture>* gestures);
+
+  bool enabled_;
+  std::map<int, HandState> hands_;
+  std::map<std::string, Template> templates_;
+
+  DISALLOW_COPY_AND_ASSIGN(GestureRecognizer);
+};
+
+}  // namespace hand
+}  // namespace realsense
+
+#endif  // REALSENSE_HAND_WIN_GESTURE_RECOGNIZER_H_
@@ -17,6 +17,8 @@ xwalk::common::Extension* CreateExtension() {
 
 // This will be generated from common_api.js
 extern const char kSource_common_api[];
+// This will be generated from depth_codec_api.js.
+extern const char kSource_depth_codec_api[];
 // This will be generated from hand_api.js.
 extern const char kSource_hand_api[];
 
@@ -26,6 +28,7 @@ namespace hand {
 HandExtension::HandExtension() {
   SetExtensionName("realsense.Hand");
   std::string jsapi(kSource_common_api);
+  jsapi += kSource_depth_codec_api;
   jsapi += kSource_hand_api;
   SetJavaScriptAPI(jsapi.c_str());
 }
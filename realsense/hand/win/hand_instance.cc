@@ -19,7 +19,9 @@ using namespace xwalk::common; // NOLINT
 using realsense::jsapi::hand_module::HandModuleConstructor::Params;
 
 HandInstance::HandInstance()
-    : handler_(this),
+    : trace_recording_("hand"),
+      memory_report_("hand"),
+      handler_(this),
       store_(&handler_),
       hand_ext_thread_("HandExtensionThread") {
   hand_ext_thread_.Start();
@@ -52,6 +54,7 @@ void HandInstance::HandleMessage(const char* msg) {
 
 void HandInstance::OnHandleMessage(scoped_ptr<base::Value> msg) {
   DCHECK_EQ(hand_ext_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "HandInstance::OnHandleMessage");
   handler_.HandleMessage(msg.Pass());
 }
 
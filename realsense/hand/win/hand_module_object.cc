@@ -7,13 +7,19 @@
 // This file is auto-generated by hand_module.idl
 #include "hand_module.h" // NOLINT
 
+#include <string.h>
+
 #include <vector>
 
 #include "base/bind.h"
 #include "base/logging.h"
 #include "base/strings/sys_string_conversions.h"
 #include "base/time/time.h"
+#include "base/trace_event/trace_event.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/frame_recorder_utils.h"
+#include "realsense/common/win/memory_accounting_utils.h"
+#include "realsense/hand/win/joint_population.h"
 
 namespace realsense {
 namespace hand {
@@ -23,76 +29,28 @@ namespace hand {
 
 #define MESSAGE_TO_METHOD(message, method) \
   handler_.Register( \
-      message, base::Bind(&method, base::Unretained(this)));
+      message, base::Bind(&HandModuleObject::PostToHandModuleThread, \
+                          base::Unretained(this), \
+                          base::Bind(&method, base::Unretained(this))));
 
 using namespace realsense::common;  // NOLINT
 using namespace realsense::jsapi::hand_module;  // NOLINT
 using namespace xwalk::common;  // NOLINT
 
-inline void PopulatePoint2D(
-    Point2D* js_point_2d, const PXCPointF32& pxc_point_2d) {
-  js_point_2d->x = pxc_point_2d.x;
-  js_point_2d->y = pxc_point_2d.y;
-}
-
-inline void PopulatePoint3D(
-    Point3D* js_point_3d, const PXCPoint3DF32& pxc_point_3d) {
-  js_point_3d->x = pxc_point_3d.x;
-  js_point_3d->y = pxc_point_3d.y;
-  js_point_3d->z = pxc_point_3d.z;
-}
-
-inline void PopulatePoint4D(
-    Point4D* js_point_4d, const PXCPoint4DF32& pxc_point_4d) {
-  js_point_4d->x = pxc_point_4d.x;
-  js_point_4d->y = pxc_point_4d.y;
-  js_point_4d->z = pxc_point_4d.z;
-  js_point_4d->w = pxc_point_4d.w;
-}
-
-inline void PopulateJointData(
-    JointData* js_joint_data, const PXCHandData::JointData& pxc_joint_data) {
-  js_joint_data->confidence = pxc_joint_data.confidence;
-  PopulatePoint3D(&js_joint_data->position_world,
-                  pxc_joint_data.positionWorld);
-  PopulatePoint3D(&js_joint_data->position_image,
-                  pxc_joint_data.positionImage);
-  PopulatePoint4D(&js_joint_data->local_rotation, pxc_joint_data.localRotation);
-  PopulatePoint4D(&js_joint_data->global_orientation,
-                  pxc_joint_data.globalOrientation);
-  PopulatePoint3D(&js_joint_data->speed, pxc_joint_data.speed);
-}
-
-#define POPULATE_FINGER_JOINTS(Type, type, FINGER, finger) \
-  pxc_hand->Query##Type##Joint(PXCHandData::JOINT_##FINGER##_BASE, \
-                               pxc_joint_data); \
-  PopulateJointData(&js_hand->##type##_joints.##finger##.base, \
-                    pxc_joint_data); \
-  pxc_hand->Query##Type##Joint(PXCHandData::JOINT_##FINGER##_JT1, \
-                               pxc_joint_data); \
-  PopulateJointData(&js_hand->##type##_joints.##finger##.joint1, \
-                    pxc_joint_data); \
-  pxc_hand->Query##Type##Joint(PXCHandData::JOINT_##FINGER##_JT2, \
-                               pxc_joint_data); \
-  PopulateJointData(&js_hand->##type##_joints.##finger##.joint2, \
-                    pxc_joint_data);\
-  pxc_hand->Query##Type##Joint(PXCHandData::JOINT_##FINGER##_TIP, \
-                               pxc_joint_data); \
-  PopulateJointData(&js_hand->##type##_joints.##finger##.tip, pxc_joint_data);
-
+// Queries the joints in the order of PXCHandData::JointType.
 #define POPULATE_HAND_JOINTS(Type, type) { \
-  PXCHandData::JointData pxc_joint_data; \
-  pxc_hand->Query##Type##Joint(PXCHandData::JOINT_WRIST, pxc_joint_data); \
-  PopulateJointData(&js_hand->##type##_joints.wrist, pxc_joint_data); \
-  pxc_hand->Query##Type##Joint(PXCHandData::JOINT_CENTER, pxc_joint_data); \
-  PopulateJointData(&js_hand->##type##_joints.center, pxc_joint_data); \
-  POPULATE_FINGER_JOINTS(Type, type, THUMB, thumb); \
-  POPULATE_FINGER_JOINTS(Type, type, INDEX, index); \
-  POPULATE_FINGER_JOINTS(Type, type, MIDDLE, middle); \
-  POPULATE_FINGER_JOINTS(Type, type, RING, ring); \
-  POPULATE_FINGER_JOINTS(Type, type, PINKY, pinky); \
+  PXCHandData::JointData pxc_joints[kNumberOfJoints]; \
+  for (int j = 0; j < kNumberOfJoints; ++j) { \
+    pxc_hand->Query##Type##Joint(static_cast<PXCHandData::JointType>(j), \
+                                 pxc_joints[j]); \
+  } \
+  PopulateJoints(&js_hand->type##_joints, pxc_joints); \
 }
 
+// Upper bound of gestures queued by track() between two trackGestures().
+const size_t kMaxPendingGestures = 64;
+const double kDefaultGestureTemplateThreshold = 0.1;
+
 #define COVERT_ENUM(TYPE) \
   case PXCHandData::##TYPE : return TYPE;
 
@@ -171,19 +129,84 @@ inline TrackingStatus ConvertTrackingStatus(
   }
 }
 
+inline GestureRecognizer::Vector3 ToVector3(const PXCPoint3DF32& point) {
+  return GestureRecognizer::Vector3(point.x, point.y, point.z);
+}
+
+inline GestureState ConvertGestureState(
+    GestureRecognizer::GestureState state) {
+  switch (state) {
+    case GestureRecognizer::GESTURE_STATE_BEGIN: return GESTURE_STATE_BEGIN;
+    case GestureRecognizer::GESTURE_STATE_END: return GESTURE_STATE_END;
+    case GestureRecognizer::GESTURE_STATE_INSTANT:
+      return GESTURE_STATE_INSTANT;
+    default: return GESTURE_STATE_NONE;
+  }
+}
+
+bool PopulateHandFrame(GestureRecognizer::HandFrame* frame,
+                       PXCHandData::IHand* pxc_hand,
+                       double time_stamp) {
+  // Pinch and point need the finger tips.
+  if (!pxc_hand->HasTrackedJoints())
+    return false;
+
+  frame->time_stamp = time_stamp;
+  frame->palm = ToVector3(pxc_hand->QueryMassCenterWorld());
+
+  PXCHandData::JointData pxc_joint_data;
+  pxc_hand->QueryTrackedJoint(PXCHandData::JOINT_THUMB_TIP, pxc_joint_data);
+  frame->thumb_tip = ToVector3(pxc_joint_data.positionWorld);
+  pxc_hand->QueryTrackedJoint(PXCHandData::JOINT_INDEX_TIP, pxc_joint_data);
+  frame->index_tip = ToVector3(pxc_joint_data.positionWorld);
+
+  frame->openness = pxc_hand->QueryOpenness();
+
+  const PXCHandData::FingerType kFingers[] = {
+    PXCHandData::FINGER_THUMB,
+    PXCHandData::FINGER_INDEX,
+    PXCHandData::FINGER_MIDDLE,
+    PXCHandData::FINGER_RING,
+    PXCHandData::FINGER_PINKY,
+  };
+  for (int i = 0; i < GestureRecognizer::NUMBER_OF_FINGERS; ++i) {
+    PXCHandData::FingerData pxc_finger_data;
+    pxc_hand->QueryFingerData(kFingers[i], pxc_finger_data);
+    frame->foldedness[i] = pxc_finger_data.foldedness;
+  }
+  return true;
+}
+
 HandModuleObject::HandModuleObject()
     : state_(UNINITIALIZED),
-      message_loop_(base::MessageLoopProxy::current()),
-      pxc_sense_manager_(NULL),
+      hand_module_thread_("HandModuleThread"),
+      connection_(NULL),
+      frame_(NULL),
       pxc_hand_data_(NULL),
       pxc_depth_image_(NULL),
+      depth_image_memory_("HandModule", "depth_image"),
       pxc_hand_config_(NULL),
-      binary_message_size_(0) {
+      frame_id_(0),
+      frame_flow_("Hand::Frame"),
+      binary_message_size_(0),
+      binary_message_memory_("HandModule", "binary_message"),
+      depth_message_capacity_(0),
+      depth_message_memory_("HandModule", "depth_message"),
+      last_frame_number_(0) {
+  hand_module_thread_.Start();
+  task_runner_ = hand_module_thread_.task_runner();
+
   MESSAGE_TO_METHOD("init", HandModuleObject::OnInit);
   MESSAGE_TO_METHOD("start", HandModuleObject::OnStart);
   MESSAGE_TO_METHOD("stop", HandModuleObject::OnStop);
   MESSAGE_TO_METHOD("track", HandModuleObject::OnTrack);
   MESSAGE_TO_METHOD("getDepthImage", HandModuleObject::OnGetDepthImage);
+  MESSAGE_TO_METHOD("trackGestures", HandModuleObject::OnTrackGestures);
+  MESSAGE_TO_METHOD("registerGestureTemplate",
+                    HandModuleObject::OnRegisterGestureTemplate);
+  MESSAGE_TO_METHOD("unregisterGestureTemplate",
+                    HandModuleObject::OnUnregisterGestureTemplate);
+  MESSAGE_TO_METHOD("getMemoryStats", HandModuleObject::OnGetMemoryStats);
   MESSAGE_TO_METHOD("_getSegmentationImageById",
                     HandModuleObject::OnGetSegmentationImageById);
   MESSAGE_TO_METHOD("_getContoursById",
@@ -191,9 +214,36 @@ HandModuleObject::HandModuleObject()
 }
 
 HandModuleObject::~HandModuleObject() {
+  // Runs the messages still queued. The thread no longer uses the object
+  // afterwards.
+  hand_module_thread_.Stop();
   ReleaseResources();
 }
 
+void HandModuleObject::PostToHandModuleThread(
+    const Handler& handler, scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  task_runner_->PostTask(FROM_HERE, base::Bind(handler, base::Passed(&info)));
+}
+
+bool HandModuleObject::CanJoinPipeline(PXCSenseManager* sense_manager) {
+  return sense_manager->QueryHand() != NULL;
+}
+
+pxcStatus HandModuleObject::OnConfigurePipeline(
+    PXCSenseManager* sense_manager) {
+  // Another hand object may have enabled the module already.
+  if (sense_manager->QueryHand())
+    return PXC_STATUS_NO_ERROR;
+  return sense_manager->EnableHand();
+}
+
+void HandModuleObject::OnPipelineRestart() {
+  task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&HandModuleObject::OnRestartPipeline,
+                 base::Unretained(this)));
+}
+
 void HandModuleObject::OnInit(
      scoped_ptr<XWalkExtensionFunctionInfo> info) {
   if (state_ != UNINITIALIZED) {
@@ -203,23 +253,8 @@ void HandModuleObject::OnInit(
     return;
   }
 
-  pxc_sense_manager_ = PXCSenseManager::CreateInstance();
-  if (!pxc_sense_manager_) {
-    info->PostResult(
-        CreateDOMException("Failed to create sense manager.",
-                           ERROR_NAME_NOTFOUNDERROR));
-    ReleaseResources();
-    return;
-  }
-
-  if (!EnableAndConfigureHandModule()) {
-    info->PostResult(
-        CreateDOMException("Failed to enable hand module.",
-                           ERROR_NAME_ABORTERROR));
-    ReleaseResources();
-    return;
-  }
-
+  // The hand module is enabled on the pipeline of the capture service by
+  // start().
   state_ = INITIALIZED;
   DLOG(INFO) << "State: UNINITIALIZED to INITIALIZED";
 
@@ -237,46 +272,32 @@ void HandModuleObject::OnStart(
     return;
   }
 
-  if (PXC_FAILED(pxc_sense_manager_->Init())) {
+  // The pipeline of the camera is shared with the other extensions, and
+  // restarted if it does not run the hand module yet.
+  pxcStatus status;
+  connection_ = CaptureService::GetInstance()->Connect("", this, &status);
+  if (!connection_) {
     info->PostResult(
         CreateDOMException("Failed to init sense manager",
                            ERROR_NAME_ABORTERROR));
     return;
   }
 
-  CHECK(!pxc_hand_data_);
-  pxc_hand_data_ = pxc_sense_manager_->QueryHand()->CreateOutput();
-  if (!pxc_hand_data_) {
+  if (!CreatePipelineOutputs()) {
     info->PostResult(
         CreateDOMException("Failed to create hand data.",
                            ERROR_NAME_ABORTERROR));
+    ReleasePipelineOutputs();
+    connection_->Release();
+    connection_ = NULL;
     return;
   }
 
-  PXCCapture::Device* pxc_capture_device =
-      pxc_sense_manager_->QueryCaptureManager()->QueryDevice();
-  if (!pxc_capture_device) {
-    info->PostResult(
-        CreateDOMException("Failed to query capture device.",
-                           ERROR_NAME_ABORTERROR));
-    return;
-  }
-
-  PXCCapture::Device::StreamProfileSet profiles = {};
-  if (PXC_FAILED(pxc_capture_device->QueryStreamProfileSet(&profiles))) {
-    info->PostResult(
-        CreateDOMException("Failed to query working profile.",
-                           ERROR_NAME_ABORTERROR));
-    return;
-  }
-
-  PXCImage::ImageInfo pxc_image_info = profiles.depth.imageInfo;
-  CHECK(pxc_image_info.format == PXCImage::PIXEL_FORMAT_DEPTH);
-  pxc_depth_image_ = pxc_sense_manager_->QuerySession()->CreateImage(
-      &pxc_image_info);
-
+  PXCImage::ImageInfo pxc_image_info = pxc_depth_image_->QueryInfo();
   state_ = STREAMING;
   DLOG(INFO) << "State: from INITIALIZED to STREAMING.";
+  recorder_ = FrameRecorder::CreateFromEnvironment("hand");
+  last_frame_number_ = 0;
 
   ImageSize js_image_size;
   js_image_size.width = pxc_image_info.width;
@@ -293,27 +314,21 @@ void HandModuleObject::OnStop(
     return;
   }
 
-  pxc_sense_manager_->Close();
+  gesture_recognizer_.Reset();
+  pending_gestures_.clear();
 
   binary_message_.reset();
   binary_message_size_ = 0;
+  binary_message_memory_.Reset();
+  depth_message_.reset();
+  depth_message_capacity_ = 0;
+  depth_message_memory_.Reset();
+  recorder_.reset();
+  frame_flow_.End();
 
-  if (pxc_depth_image_) {
-    pxc_depth_image_->Release();
-    pxc_depth_image_ = NULL;
-  }
-  if (pxc_hand_data_) {
-    pxc_hand_data_->Release();
-    pxc_hand_data_ = NULL;
-  }
-
-  if (!EnableAndConfigureHandModule()) {
-    info->PostResult(
-        CreateDOMException("Failed to enable hand module.",
-                           ERROR_NAME_ABORTERROR));
-    ReleaseResources();
-    return;
-  }
+  ReleasePipelineOutputs();
+  connection_->Release();
+  connection_ = NULL;
 
   state_ = INITIALIZED;
   DLOG(INFO) << "State: from STREAMING to INITIALIZED.";
@@ -323,6 +338,7 @@ void HandModuleObject::OnStop(
 
 void HandModuleObject::OnTrack(
   scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  TRACE_EVENT0("realsense", "HandModuleObject::OnTrack");
   if (state_ != STREAMING) {
     info->PostResult(
         CreateDOMException("Not streaming.",
@@ -330,33 +346,11 @@ void HandModuleObject::OnTrack(
     return;
   }
 
-  if (PXC_FAILED(pxc_sense_manager_->AcquireFrame(true))) {
-    info->PostResult(
-        CreateDOMException("Fail to acquire frame.",
-                           ERROR_NAME_ABORTERROR));
-    return;
-  }
-
-  PXCCapture::Sample *processed_sample =
-      pxc_sense_manager_->QueryHandSample();
-  if (processed_sample) {
-    if (processed_sample->depth) {
-      pxc_depth_image_->CopyImage(processed_sample->depth);
-    }
-    sample_processed_time_stamp_ = base::Time::Now().ToJsTime();
-  } else {
-    info->PostResult(
-        CreateDOMException("Fail to query hand sample.",
-                           ERROR_NAME_ABORTERROR));
+  if (!AcquireFrameAndUpdateHandData(info.get()))
     return;
-  }
 
-  if (PXC_FAILED(pxc_hand_data_->Update())) {
-    info->PostResult(
-        CreateDOMException("Fail to update hand data.",
-                           ERROR_NAME_ABORTERROR));
-    return;
-  }
+  if (gesture_recognizer_.enabled())
+    RecognizeGestures();
 
   std::vector<linked_ptr<Hand> > hands;
 
@@ -398,18 +392,39 @@ void HandModuleObject::OnTrack(
 
   info->PostResult(Track::Results::Create(hands));
 
-  pxc_sense_manager_->ReleaseFrame();
+  ReleaseFrame();
+}
+
+void HandModuleObject::OnRestartPipeline() {
+  if (state_ != STREAMING || !connection_->IsRestartPending())
+    return;
+  RestartPipeline();
 }
 
 void HandModuleObject::OnGetDepthImage(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  TRACE_EVENT1("realsense", "HandModuleObject::OnGetDepthImage",
+               "frame", frame_id_);
+  frame_flow_.End();
   if (!pxc_depth_image_) {
     info->PostResult(CreateDOMException("No sample data.",
                                         ERROR_NAME_NOTFOUNDERROR));
     return;
   }
 
-  if (!MakeBinaryMessageForImage<uint16>(pxc_depth_image_)) {
+  scoped_ptr<GetDepthImage::Params> params(
+      GetDepthImage::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException("Malformed parameters",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+
+  size_t message_size = MakeDepthMessage(
+      pxc_depth_image_,
+      params->encoding == DEPTH_ENCODING_RVL ? DEPTH_MESSAGE_RVL
+                                             : DEPTH_MESSAGE_RAW);
+  if (!message_size) {
     info->PostResult(CreateDOMException("Failed to copy image data.",
                                         ERROR_NAME_ABORTERROR));
     return;
@@ -417,13 +432,107 @@ void HandModuleObject::OnGetDepthImage(
 
   scoped_ptr<base::ListValue> result(new base::ListValue());
   result->Append(base::BinaryValue::CreateWithCopiedBuffer(
-      reinterpret_cast<const char*>(binary_message_.get()),
-      binary_message_size_));
+      reinterpret_cast<const char*>(depth_message_.get()), message_size));
   info->PostResult(result.Pass());
 }
 
+void HandModuleObject::OnTrackGestures(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  TRACE_EVENT0("realsense", "HandModuleObject::OnTrackGestures");
+  if (state_ != STREAMING) {
+    info->PostResult(
+        CreateDOMException("Not streaming.",
+                           ERROR_NAME_INVALIDSTATEERROR));
+    return;
+  }
+
+  // From now on track() feeds the recognizer as well, so that the gesture
+  // history has no holes when both methods are used.
+  gesture_recognizer_.set_enabled(true);
+
+  if (!AcquireFrameAndUpdateHandData(info.get()))
+    return;
+
+  RecognizeGestures();
+  ReleaseFrame();
+
+  std::vector<linked_ptr<Gesture> > gestures;
+  for (size_t i = 0; i < pending_gestures_.size(); ++i) {
+    const GestureRecognizer::Gesture& gesture = pending_gestures_[i];
+    linked_ptr<Gesture> js_gesture(new Gesture);
+    js_gesture->name = gesture.name;
+    js_gesture->hand_id = gesture.hand_id;
+    js_gesture->state = ConvertGestureState(gesture.state);
+    js_gesture->time_stamp = gesture.time_stamp;
+    js_gesture->position.x = gesture.position.x;
+    js_gesture->position.y = gesture.position.y;
+    js_gesture->position.z = gesture.position.z;
+    js_gesture->score = gesture.score;
+    gestures.push_back(js_gesture);
+  }
+  pending_gestures_.clear();
+
+  info->PostResult(TrackGestures::Results::Create(gestures));
+}
+
+void HandModuleObject::OnRegisterGestureTemplate(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<RegisterGestureTemplate::Params> params(
+      RegisterGestureTemplate::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException("The parameter is not supported.",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+
+  std::vector<GestureRecognizer::Vector3> points;
+  for (size_t i = 0; i < params->points.size(); ++i) {
+    const Point3D& point = *params->points[i];
+    points.push_back(GestureRecognizer::Vector3(point.x, point.y, point.z));
+  }
+
+  double threshold = params->threshold ?
+      *params->threshold : kDefaultGestureTemplateThreshold;
+  if (!gesture_recognizer_.RegisterTemplate(params->name, points, threshold)) {
+    info->PostResult(CreateDOMException("Invalid gesture template.",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+
+  info->PostResult(CreateSuccessResult());
+}
+
+void HandModuleObject::OnUnregisterGestureTemplate(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<UnregisterGestureTemplate::Params> params(
+      UnregisterGestureTemplate::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException("The parameter is not supported.",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+
+  if (!gesture_recognizer_.UnregisterTemplate(params->name)) {
+    info->PostResult(CreateDOMException("No such gesture template.",
+                                        ERROR_NAME_NOTFOUNDERROR));
+    return;
+  }
+
+  info->PostResult(CreateSuccessResult());
+}
+
+void HandModuleObject::OnGetMemoryStats(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  MemoryStats stats;
+  PopulateMemoryStats<MemoryCategoryStats>(&stats);
+  info->PostResult(GetMemoryStats::Results::Create(stats));
+}
+
 void HandModuleObject::OnGetSegmentationImageById(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  TRACE_EVENT1("realsense", "HandModuleObject::OnGetSegmentationImageById",
+               "frame", frame_id_);
+  frame_flow_.End();
   scoped_ptr<GetSegmentationImageById::Params> params(
       GetSegmentationImageById::Params::Create(*info->arguments()));
   if (!params) {
@@ -468,6 +577,9 @@ void HandModuleObject::OnGetSegmentationImageById(
 
 void HandModuleObject::OnGetContoursById(
       scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  TRACE_EVENT1("realsense", "HandModuleObject::OnGetContoursById",
+               "frame", frame_id_);
+  frame_flow_.End();
   scoped_ptr<GetContoursById::Params> params(
       GetContoursById::Params::Create(*info->arguments()));
   if (!params) {
@@ -520,6 +632,7 @@ void HandModuleObject::OnGetContoursById(
 template <typename T>
 bool HandModuleObject::MakeBinaryMessageForImage(PXCImage* image) {
   // TODO(huningxin): move this helper to common utils.
+  TRACE_EVENT0("realsense", "HandModuleObject::MakeBinaryMessageForImage");
   const int call_id_size = sizeof(int);
   const int image_header_size = 3 * sizeof(int);  // format, width, height
 
@@ -533,6 +646,7 @@ bool HandModuleObject::MakeBinaryMessageForImage(PXCImage* image) {
   if (binary_message_size_ < binary_message_size) {
     binary_message_.reset(new uint8[binary_message_size]);
     binary_message_size_ = binary_message_size;
+    binary_message_memory_.Set(binary_message_size);
   }
 
   int offset = call_id_size;
@@ -565,13 +679,188 @@ bool HandModuleObject::MakeBinaryMessageForImage(PXCImage* image) {
   return true;
 }
 
-bool HandModuleObject::EnableAndConfigureHandModule() {
-  if (PXC_FAILED(pxc_sense_manager_->EnableHand())) return false;
+size_t HandModuleObject::MakeDepthMessage(PXCImage* image,
+                                          DepthMessageEncoding encoding) {
+  TRACE_EVENT0("realsense", "HandModuleObject::MakeDepthMessage");
+  // call_id, format, width, height
+  const size_t header_size = 4 * sizeof(int);
 
-  PXCHandModule* pxc_hand_module = pxc_sense_manager_->QueryHand();
-  if (!pxc_hand_module) return false;
+  PXCImage::ImageInfo image_info = image->QueryInfo();
+  size_t capacity = header_size + GetMaxDepthSectionSize(
+      encoding, image_info.width, image_info.height);
+  if (depth_message_capacity_ < capacity) {
+    depth_message_.reset(new uint8[capacity]);
+    depth_message_capacity_ = capacity;
+    depth_message_memory_.Set(capacity);
+  }
+
+  PXCImage::ImageData image_data;
+  if (PXC_FAILED(image->AcquireAccess(
+        PXCImage::ACCESS_READ, PXCImage::PIXEL_FORMAT_DEPTH, &image_data))) {
+    return 0;
+  }
+
+  int* int_view = reinterpret_cast<int*>(depth_message_.get());
+  int_view[1] = PXCImage::PIXEL_FORMAT_DEPTH;
+  int_view[2] = image_info.width;
+  int_view[3] = image_info.height;
+  size_t section_size = PackDepthSection(
+      encoding, image_data.planes[0], image_data.pitches[0],
+      image_info.width, image_info.height,
+      depth_message_.get() + header_size);
+
+  image->ReleaseAccess(&image_data);
+  return header_size + section_size;
+}
+
+bool HandModuleObject::AcquireFrameAndUpdateHandData(
+    XWalkExtensionFunctionInfo* info) {
+  pxcStatus status;
+  {
+    TRACE_EVENT0("realsense", "AcquireFrame");
+    status = connection_->AcquireFrame(&frame_);
+    // Another extension restarted the pipeline of the camera.
+    while (status == PXC_STATUS_EXEC_ABORTED && RestartPipeline())
+      status = connection_->AcquireFrame(&frame_);
+  }
+  if (PXC_FAILED(status)) {
+    info->PostResult(
+        CreateDOMException("Fail to acquire frame.",
+                           ERROR_NAME_ABORTERROR));
+    return false;
+  }
+
+  PXCCapture::Sample *processed_sample =
+      frame_->QuerySenseManager()->QueryHandSample();
+  if (processed_sample) {
+    if (processed_sample->depth) {
+      pxc_depth_image_->CopyImage(processed_sample->depth);
+    }
+    sample_processed_time_stamp_ = base::Time::Now().ToJsTime();
+    // The flow ends when the page reads the images of the frame, if it does.
+    ++frame_id_;
+    frame_flow_.Begin(frame_id_);
+  } else {
+    info->PostResult(
+        CreateDOMException("Fail to query hand sample.",
+                           ERROR_NAME_ABORTERROR));
+    ReleaseFrame();
+    return false;
+  }
 
-  if (pxc_hand_config_) pxc_hand_config_->Release();
+  {
+    TRACE_EVENT0("realsense", "PXCHandData::Update");
+    status = pxc_hand_data_->Update();
+  }
+  if (PXC_FAILED(status)) {
+    info->PostResult(
+        CreateDOMException("Fail to update hand data.",
+                           ERROR_NAME_ABORTERROR));
+    ReleaseFrame();
+    return false;
+  }
+
+  if (recorder_) {
+    // Only the frames the page asks for are acquired, so the others are
+    // counted as dropped.
+    int frame_number = frame_->QueryFrameNumber();
+    if (last_frame_number_ && frame_number > last_frame_number_ + 1)
+      recorder_->SkipFrames(frame_number - last_frame_number_ - 1);
+    last_frame_number_ = frame_number;
+    RecordFrame(processed_sample);
+  }
+  return true;
+}
+
+void HandModuleObject::ReleaseFrame() {
+  frame_->Release();
+  frame_ = NULL;
+}
+
+void HandModuleObject::RecognizeGestures() {
+  TRACE_EVENT0("realsense", "HandModuleObject::RecognizeGestures");
+  std::vector<GestureRecognizer::Gesture> gestures;
+  std::vector<int> live_hand_ids;
+
+  int number_of_hands = pxc_hand_data_->QueryNumberOfHands();
+  for (int i = 0; i < number_of_hands; ++i) {
+    PXCHandData::IHand* pxc_hand = NULL;
+    if (PXC_FAILED(pxc_hand_data_->QueryHandData(
+        PXCHandData::AccessOrderType::ACCESS_ORDER_BY_TIME,
+        i, pxc_hand))) {
+      continue;
+    }
+
+    GestureRecognizer::HandFrame frame;
+    if (!PopulateHandFrame(&frame, pxc_hand, sample_processed_time_stamp_))
+      continue;
+
+    int hand_id = pxc_hand->QueryUniqueId();
+    live_hand_ids.push_back(hand_id);
+    gesture_recognizer_.Update(hand_id, frame, &gestures);
+  }
+  gesture_recognizer_.RemoveLostHands(
+      live_hand_ids, sample_processed_time_stamp_, &gestures);
+
+  pending_gestures_.insert(pending_gestures_.end(),
+                           gestures.begin(), gestures.end());
+  // Drop the oldest gestures if the app stopped calling trackGestures().
+  if (pending_gestures_.size() > kMaxPendingGestures) {
+    pending_gestures_.erase(
+        pending_gestures_.begin(),
+        pending_gestures_.end() - kMaxPendingGestures);
+  }
+}
+
+void HandModuleObject::RecordFrame(PXCCapture::Sample* sample) {
+  TRACE_EVENT0("realsense", "HandModuleObject::RecordFrame");
+  FrameRecorder::Frame* recorded_frame = recorder_->BeginFrame();
+  if (!recorded_frame)
+    return;
+
+  if (sample->depth)
+    AddImageChunk(recorded_frame, FRAME_CHUNK_DEPTH, sample->depth);
+
+  static_assert(kFrameJointCount == kNumberOfJoints, "joints of a hand");
+  const size_t hand_size =
+      2 * sizeof(int) + kFrameJointCount * kFrameJointSize;
+  const int number_of_hands = pxc_hand_data_->QueryNumberOfHands();
+  const size_t size = sizeof(int) + number_of_hands * hand_size;
+  uint8* hands = recorded_frame->AddChunk(
+      FRAME_CHUNK_HAND_JOINTS, FRAME_CHUNK_FORMAT_DATA, 0, 0, 0, 0, size);
+  // The hands which fail to query leave zeros at the end of the chunk.
+  memset(hands, 0, size);
+  uint8* output = hands + sizeof(int);
+  int recorded_hands = 0;
+  for (int i = 0; i < number_of_hands; ++i) {
+    PXCHandData::IHand* pxc_hand = NULL;
+    if (PXC_FAILED(pxc_hand_data_->QueryHandData(
+        PXCHandData::AccessOrderType::ACCESS_ORDER_BY_TIME,
+        i, pxc_hand))) {
+      continue;
+    }
+
+    int* int_array = reinterpret_cast<int*>(output);
+    int_array[0] = pxc_hand->QueryUniqueId();
+    int_array[1] = pxc_hand->QueryBodySide();
+    output += 2 * sizeof(int);
+    PXCHandData::JointData pxc_joint = {};
+    for (int j = 0; j < kFrameJointCount; ++j) {
+      pxc_hand->QueryTrackedJoint(static_cast<PXCHandData::JointType>(j),
+                                  pxc_joint);
+      output = PackFrameJoint(pxc_joint, output);
+    }
+    ++recorded_hands;
+  }
+  *reinterpret_cast<int*>(hands) = recorded_hands;
+
+  recorder_->EndFrame(recorded_frame);
+}
+
+bool HandModuleObject::CreatePipelineOutputs() {
+  PXCSenseManager* pxc_sense_manager = connection_->QuerySenseManager();
+  PXCHandModule* pxc_hand_module = pxc_sense_manager->QueryHand();
+  if (!pxc_hand_module) return false;
 
   pxc_hand_config_ =
       pxc_hand_module->CreateActiveConfiguration();
@@ -582,17 +871,50 @@ bool HandModuleObject::EnableAndConfigureHandModule() {
   pxc_hand_config_->EnableSegmentationImage(true);
   pxc_hand_config_->EnableStabilizer(true);
   pxc_hand_config_->ApplyChanges();
-  return true;
+
+  pxc_hand_data_ = pxc_hand_module->CreateOutput();
+  if (!pxc_hand_data_) return false;
+
+  PXCCapture::Device* pxc_capture_device =
+      pxc_sense_manager->QueryCaptureManager()->QueryDevice();
+  if (!pxc_capture_device) return false;
+
+  PXCCapture::Device::StreamProfileSet profiles = {};
+  if (PXC_FAILED(pxc_capture_device->QueryStreamProfileSet(&profiles)))
+    return false;
+
+  PXCImage::ImageInfo pxc_image_info = profiles.depth.imageInfo;
+  CHECK(pxc_image_info.format == PXCImage::PIXEL_FORMAT_DEPTH);
+  pxc_depth_image_ = pxc_sense_manager->QuerySession()->CreateImage(
+      &pxc_image_info);
+  depth_image_memory_.Set(GetImageFootprint(pxc_depth_image_));
+  return pxc_depth_image_ != NULL;
 }
 
-void HandModuleObject::ReleaseResources() {
-  binary_message_.reset();
-  binary_message_size_ = 0;
+bool HandModuleObject::RestartPipeline() {
+  TRACE_EVENT0("realsense", "HandModuleObject::RestartPipeline");
+  ReleasePipelineOutputs();
+  pxcStatus status = connection_->WaitForRestart();
+  if (PXC_SUCCEEDED(status) && CreatePipelineOutputs())
+    return true;
+
+  DLOG(ERROR) << "Failed to restart the pipeline: " << status;
+  gesture_recognizer_.Reset();
+  pending_gestures_.clear();
+  ReleasePipelineOutputs();
+  connection_->Release();
+  connection_ = NULL;
+  state_ = INITIALIZED;
+  DLOG(INFO) << "State: from STREAMING to INITIALIZED.";
+  return false;
+}
 
+void HandModuleObject::ReleasePipelineOutputs() {
   if (pxc_depth_image_) {
     pxc_depth_image_->Release();
     pxc_depth_image_ = NULL;
   }
+  depth_image_memory_.Reset();
   if (pxc_hand_config_) {
     pxc_hand_config_->Release();
     pxc_hand_config_ = NULL;
@@ -601,10 +923,22 @@ void HandModuleObject::ReleaseResources() {
     pxc_hand_data_->Release();
     pxc_hand_data_ = NULL;
   }
-  if (pxc_sense_manager_) {
-    pxc_sense_manager_->Close();
-    pxc_sense_manager_->Release();
-    pxc_sense_manager_ = NULL;
+}
+
+void HandModuleObject::ReleaseResources() {
+  binary_message_.reset();
+  binary_message_size_ = 0;
+  binary_message_memory_.Reset();
+  depth_message_.reset();
+  depth_message_capacity_ = 0;
+  depth_message_memory_.Reset();
+  recorder_.reset();
+  frame_flow_.End();
+
+  ReleasePipelineOutputs();
+  if (connection_) {
+    connection_->Release();
+    connection_ = NULL;
   }
 }
 
@@ -6,9 +6,16 @@
 #define REALSENSE_HAND_WIN_HAND_MODULE_OBJECT_H_
 
 #include <string>
+#include <vector>
 
-#include "base/message_loop/message_loop_proxy.h"
+#include "base/single_thread_task_runner.h"
 #include "base/threading/thread.h"
+#include "realsense/common/depth_codec.h"
+#include "realsense/common/frame_recorder.h"
+#include "realsense/common/memory_accounting.h"
+#include "realsense/common/trace_recorder.h"
+#include "realsense/common/win/capture_service.h"
+#include "realsense/hand/win/gesture_recognizer.h"
 #include "third_party/libpxc/include/pxchandconfiguration.h"
 #include "third_party/libpxc/include/pxchanddata.h"
 #include "third_party/libpxc/include/pxchandmodule.h"
@@ -23,11 +30,17 @@ namespace hand {
 using xwalk::common::XWalkExtensionFunctionInfo;
 
 class HandModuleObject
-    : public xwalk::common::BindingObject {
+    : public xwalk::common::BindingObject,
+      public realsense::common::CaptureConsumer {
  public:
   HandModuleObject();
   ~HandModuleObject() override;
 
+  // CaptureConsumer implementation.
+  bool CanJoinPipeline(PXCSenseManager* sense_manager) override;
+  pxcStatus OnConfigurePipeline(PXCSenseManager* sense_manager) override;
+  void OnPipelineRestart() override;
+
  private:
   // Message handlers.
   void OnInit(
@@ -40,14 +53,49 @@ class HandModuleObject
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnGetDepthImage(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnTrackGestures(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnRegisterGestureTemplate(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnUnregisterGestureTemplate(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnGetMemoryStats(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnGetSegmentationImageById(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnGetContoursById(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
 
+  void OnRestartPipeline();
+
+  typedef base::Callback<void(scoped_ptr<XWalkExtensionFunctionInfo>)>
+      Handler;
+  // Runs |handler| on |hand_module_thread_|.
+  void PostToHandModuleThread(const Handler& handler,
+                              scoped_ptr<XWalkExtensionFunctionInfo> info);
+
   // Helpers.
+  // Acquires a frame and updates the hand data. On failure the error is
+  // posted to |info| and no frame is held.
+  bool AcquireFrameAndUpdateHandData(XWalkExtensionFunctionInfo* info);
+  void ReleaseFrame();
+  // Feeds the current hand data to |gesture_recognizer_| and queues the
+  // recognized gestures into |pending_gestures_|.
+  void RecognizeGestures();
+  // Records the depth and the joints of the frame, when recording.
+  void RecordFrame(PXCCapture::Sample* sample);
   template <typename T> bool MakeBinaryMessageForImage(PXCImage* image);
-  bool EnableAndConfigureHandModule();
+  // Fills |depth_message_| with the format, width and height (i32) of
+  // |image| and its depth section. Returns the size of the message, or 0.
+  size_t MakeDepthMessage(PXCImage* image,
+                          realsense::common::DepthMessageEncoding encoding);
+  // Creates the hand data and the depth image from the sense manager of the
+  // pipeline.
+  bool CreatePipelineOutputs();
+  // Recreates the outputs once the pipeline restarted for another consumer.
+  // On failure streaming stops.
+  bool RestartPipeline();
+  void ReleasePipelineOutputs();
   void ReleaseResources();
 
  private:
@@ -64,17 +112,48 @@ class HandModuleObject
   };
   State state_;
 
-  scoped_refptr<base::MessageLoopProxy> message_loop_;
+  // The messages are handled on a thread of the object rather than on the
+  // thread of the instance: a restart of the pipeline waits in
+  // WaitForRestart() until every hand object released its outputs, which
+  // the other objects could not do while a shared thread is blocked.
+  base::Thread hand_module_thread_;
+  // Stays valid once the thread is stopped, for the capture thread.
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner_;
 
-  PXCSenseManager* pxc_sense_manager_;
+  // The pipeline of the camera, which other extensions may share.
+  realsense::common::CaptureConnection* connection_;
+  // The frame held between AcquireFrameAndUpdateHandData() and
+  // ReleaseFrame().
+  realsense::common::CaptureFrame* frame_;
   PXCHandData* pxc_hand_data_;
   PXCImage* pxc_depth_image_;
+  realsense::common::MemoryTracker depth_image_memory_;
   PXCHandConfiguration* pxc_hand_config_;
 
   double sample_processed_time_stamp_;
+  // Counts the frames acquired by track() and trackGestures(), to match them
+  // to the requests reading their images in traces.
+  int64 frame_id_;
+  realsense::common::FrameFlow frame_flow_;
+
+  GestureRecognizer gesture_recognizer_;
+  // Gestures recognized by track() that are not yet returned by
+  // trackGestures().
+  std::vector<GestureRecognizer::Gesture> pending_gestures_;
 
   scoped_ptr<uint8[]> binary_message_;
   size_t binary_message_size_;
+  realsense::common::MemoryTracker binary_message_memory_;
+  // Kept apart from |binary_message_|, its size depends on the coding.
+  scoped_ptr<uint8[]> depth_message_;
+  size_t depth_message_capacity_;
+  realsense::common::MemoryTracker depth_message_memory_;
+
+  // Records the frames acquired while REALSENSE_RECORD_DIR is set. The
+  // frames of the pipeline between two acquired ones are counted as dropped.
+  scoped_ptr<realsense::common::FrameRecorder> recorder_;
+  // The number of the last acquired frame in the pipeline, or 0.
+  int last_frame_number_;
 };
 
 }  // namespace hand
@@ -0,0 +1,85 @@
+// Copyright (c) 2016 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef REALSENSE_HAND_WIN_JOINT_POPULATION_H_
+#define REALSENSE_HAND_WIN_JOINT_POPULATION_H_
+
+// This file is auto-generated by hand_module.idl
+#include "hand_module.h" // NOLINT
+
+// Fills the hand dictionaries from the joints of the SDK. The source types are
+// template parameters with the fields of PXCPointF32, PXCPoint3DF32,
+// PXCPoint4DF32 and PXCHandData::JointData, so that this builds without the
+// SDK for benchmarks/bench_kernels.
+namespace realsense {
+namespace hand {
+
+// Number of joints of a hand, in the order of PXCHandData::JointType.
+const int kNumberOfJoints = 22;
+
+template <typename Point>
+inline void PopulatePoint2D(jsapi::hand_module::Point2D* js_point_2d,
+                            const Point& pxc_point_2d) {
+  js_point_2d->x = pxc_point_2d.x;
+  js_point_2d->y = pxc_point_2d.y;
+}
+
+template <typename Point>
+inline void PopulatePoint3D(jsapi::hand_module::Point3D* js_point_3d,
+                            const Point& pxc_point_3d) {
+  js_point_3d->x = pxc_point_3d.x;
+  js_point_3d->y = pxc_point_3d.y;
+  js_point_3d->z = pxc_point_3d.z;
+}
+
+template <typename Point>
+inline void PopulatePoint4D(jsapi::hand_module::Point4D* js_point_4d,
+                            const Point& pxc_point_4d) {
+  js_point_4d->x = pxc_point_4d.x;
+  js_point_4d->y = pxc_point_4d.y;
+  js_point_4d->z = pxc_point_4d.z;
+  js_point_4d->w = pxc_point_4d.w;
+}
+
+template <typename JointData>
+inline void PopulateJointData(jsapi::hand_module::JointData* js_joint_data,
+                              const JointData& pxc_joint_data) {
+  js_joint_data->confidence = pxc_joint_data.confidence;
+  PopulatePoint3D(&js_joint_data->position_world,
+                  pxc_joint_data.positionWorld);
+  PopulatePoint3D(&js_joint_data->position_image,
+                  pxc_joint_data.positionImage);
+  PopulatePoint4D(&js_joint_data->local_rotation, pxc_joint_data.localRotation);
+  PopulatePoint4D(&js_joint_data->global_orientation,
+                  pxc_joint_data.globalOrientation);
+  PopulatePoint3D(&js_joint_data->speed, pxc_joint_data.speed);
+}
+
+template <typename JointData>
+inline void PopulateFingerJoints(jsapi::hand_module::FingerJoints* js_finger,
+                                 const JointData* pxc_joints) {
+  PopulateJointData(&js_finger->base, pxc_joints[0]);
+  PopulateJointData(&js_finger->joint1, pxc_joints[1]);
+  PopulateJointData(&js_finger->joint2, pxc_joints[2]);
+  PopulateJointData(&js_finger->tip, pxc_joints[3]);
+}
+
+// |pxc_joints| holds kNumberOfJoints joints: the wrist, the center, then the
+// base, the two joints and the tip of each finger from the thumb.
+template <typename JointData>
+void PopulateJoints(jsapi::hand_module::Joints* js_joints,
+                    const JointData* pxc_joints) {
+  PopulateJointData(&js_joints->wrist, pxc_joints[0]);
+  PopulateJointData(&js_joints->center, pxc_joints[1]);
+  PopulateFingerJoints(&js_joints->thumb, pxc_joints + 2);
+  PopulateFingerJoints(&js_joints->index, pxc_joints + 6);
+  PopulateFingerJoints(&js_joints->middle, pxc_joints + 10);
+  PopulateFingerJoints(&js_joints->ring, pxc_joints + 14);
+  PopulateFingerJoints(&js_joints->pinky, pxc_joints + 18);
+}
+
+}  // namespace hand
+}  // namespace realsense
+
+#endif  // REALSENSE_HAND_WIN_JOINT_POPULATION_H_
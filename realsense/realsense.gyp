@@ -7,6 +7,9 @@
     {
       'target_name': 'realsense',
       'type': 'none',
+      'dependencies': [
+        'common/common.gyp:*',
+      ],
       'conditions': [
         ['OS=="win"', {
           'dependencies': [
@@ -23,9 +23,10 @@ var ScenePerception = function(objectId) {
     var headerOffset = 5 * BYTES_PER_INT;
     var cByteLength = cWidth * cHeight * BYTES_OF_RGBA;
     var color = new Uint8Array(data, headerOffset, cByteLength);
-    var depth = new Uint16Array(data, headerOffset + cByteLength, dWidth * dHeight);
+    var depth = depthCodec.readDepthSection(data, headerOffset + cByteLength,
+                                            dWidth, dHeight);
     return {color: {width: cWidth, height: cHeight, data: color},
-      depth: {width: dWidth, height: dHeight, data: depth}};
+      depth: {width: dWidth, height: dHeight, data: depth.data}};
   };
 
   function wrapVolumePreviewReturn(data) {
@@ -186,6 +187,7 @@ var ScenePerception = function(objectId) {
   this._addMethodWithPromise('setMeshingUpdateConfigs', null, null, wrapErrorReturns);
   this._addMethodWithPromise('configureSurfaceVoxelsData', null, null, wrapErrorReturns);
   this._addMethodWithPromise('setMeshingRegion', null, null, wrapErrorReturns);
+  this._addMethodWithPromise('setStreamQuality', null, null, wrapErrorReturns);
 
   this._addMethodWithPromise('getSample', null, wrapSampleReturns, wrapErrorReturns);
   this._addMethodWithPromise('getVolumePreview', null, wrapGetVolumePreviewReturn,
@@ -201,6 +203,7 @@ var ScenePerception = function(objectId) {
   this._addMethodWithPromise('getMeshingResolution', null, null, wrapErrorReturns);
   this._addMethodWithPromise('getMeshData', null, wrapMeshDataReturn, wrapErrorReturns);
   this._addMethodWithPromise('getSurfaceVoxels', null, wrapVoxelsReturn, wrapErrorReturns);
+  this._addMethodWithPromise('getMemoryStats', null, null, wrapErrorReturns);
 
   this._addMethodWithPromise('saveMesh', null, wrapMeshFileReturn, wrapErrorReturns);
   this._addMethodWithPromise('clearMeshingRegion', null, null, wrapErrorReturns);
@@ -215,9 +218,35 @@ var ScenePerception = function(objectId) {
     }
   };
 
+  // Once the page called setStreamQuality(), the frame events carry an ID
+  // and are acknowledged as they arrive, for the extension to pace them to
+  // the page.
+  var that = this;
+  var CheckingEvent = function(type, data) {
+    if (data && data.frameEventId)
+      that._postMessage('ackFrameEvent', [data.frameEventId]);
+    this.type = type;
+
+    if (data) {
+      this.quality = data.quality;
+    }
+  };
+
+  var SampleProcessedEvent = function(type, data) {
+    if (data && data.frameEventId)
+      that._postMessage('ackFrameEvent', [data.frameEventId]);
+    this.type = type;
+
+    if (data) {
+      this.quality = data.quality;
+      this.accuracy = data.accuracy;
+      this.cameraPose = data.cameraPose;
+    }
+  };
+
   this._addEvent('error', SPErrorEvent);
-  this._addEvent('checking');
-  this._addEvent('sampleprocessed');
+  this._addEvent('checking', CheckingEvent);
+  this._addEvent('sampleprocessed', SampleProcessedEvent);
   this._addEvent('meshupdated');
 };
 
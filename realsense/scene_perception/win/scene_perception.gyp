@@ -9,6 +9,7 @@
       'type': 'loadable_module',
       'dependencies':[
         '<(DEPTH)/base/base.gyp:base',
+        '../../common/win/capture_service.gyp:capture_service',
         '<(DEPTH)/extensions/third_party/libpxc/libpxc.gyp:libpxc',
         '<(DEPTH)/xwalk/common/common.gyp:common',
       ],
@@ -25,6 +26,20 @@
       },
       'sources': [
         'scene_perception.idl',
+        '../../common/binary_packing.cc',
+        '../../common/binary_packing.h',
+        '../../common/depth_codec.cc',
+        '../../common/depth_codec.h',
+        '../../common/depth_codec_api.js',
+        '../../common/frame_file.h',
+        '../../common/frame_recorder.cc',
+        '../../common/frame_recorder.h',
+        '../../common/memory_accounting.cc',
+        '../../common/memory_accounting.h',
+        '../../common/stream_quality.cc',
+        '../../common/stream_quality.h',
+        '../../common/trace_recorder.cc',
+        '../../common/trace_recorder.h',
         '../js/scene_perception_api.js',
         'scene_perception_extension.cc',
         'scene_perception_extension.h',
@@ -16,6 +16,8 @@ xwalk::common::Extension* CreateExtension() {
 
 // This will be generated from common_api.js
 extern const char kSource_common_api[];
+// This will be generated from depth_codec_api.js.
+extern const char kSource_depth_codec_api[];
 // This will be generated from scene_perception_api.js.
 extern const char kSource_scene_perception_api[];
 
@@ -25,6 +27,7 @@ namespace scene_perception {
 ScenePerceptionExtension::ScenePerceptionExtension() {
   SetExtensionName("realsense.ScenePerception");
   std::string jsapi(kSource_common_api);
+  jsapi += kSource_depth_codec_api;
   jsapi += kSource_scene_perception_api;
   SetJavaScriptAPI(jsapi.c_str());
 }
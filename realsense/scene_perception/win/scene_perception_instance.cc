@@ -20,7 +20,9 @@ using namespace xwalk::common; // NOLINT
 using realsense::jsapi::scene_perception::ScenePerceptionConstructor::Params;
 
 ScenePerceptionInstance::ScenePerceptionInstance()
-    : handler_(this),
+    : trace_recording_("scene_perception"),
+      memory_report_("scene_perception"),
+      handler_(this),
       store_(&handler_),
       sp_ext_thread_("SPExtensionThread") {
   sp_ext_thread_.Start();
@@ -57,6 +59,7 @@ void ScenePerceptionInstance::HandleMessage(const char* msg) {
 
 void ScenePerceptionInstance::OnHandleMessage(scoped_ptr<base::Value> msg) {
   DCHECK_EQ(sp_ext_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "ScenePerceptionInstance::OnHandleMessage");
   handler_.HandleMessage(msg.Pass());
 }
 
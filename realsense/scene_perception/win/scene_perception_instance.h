@@ -6,6 +6,8 @@
 #define REALSENSE_SCENE_PERCEPTION_SCENE_PERCEPTION_INSTANCE_H_
 
 #include "base/threading/thread.h"
+#include "realsense/common/memory_accounting.h"
+#include "realsense/common/trace_recorder.h"
 #include "xwalk/common/extension.h"
 #include "xwalk/common/binding_object_store.h"
 #include "xwalk/common/xwalk_extension_function_handler.h"
@@ -27,6 +29,12 @@ class ScenePerceptionInstance : public xwalk::common::Instance {
   void OnScenePerceptionConstructor(
       scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
 
+  // Declared first so that the trace is written once the threads below are
+  // stopped.
+  realsense::common::ScopedTraceRecording trace_recording_;
+  // Declared before the objects so that it reports the buffers they leave.
+  realsense::common::ScopedMemoryReport memory_report_;
+
   xwalk::common::XWalkExtensionFunctionHandler handler_;
   xwalk::common::BindingObjectStore store_;
   base::Thread sp_ext_thread_;
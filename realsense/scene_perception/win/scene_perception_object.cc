@@ -4,13 +4,20 @@
 
 #include "realsense/scene_perception/win/scene_perception_object.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/files/file.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/logging.h"
+#include "base/trace_event/trace_event.h"
+#include "realsense/common/binary_packing.h"
 #include "realsense/common/win/common_utils.h"
+#include "realsense/common/win/frame_recorder_utils.h"
+#include "realsense/common/win/memory_accounting_utils.h"
+#include "realsense/common/win/shared_session.h"
 
 namespace {
 using namespace realsense::common; // NOLINT
@@ -30,7 +37,28 @@ bool isValidFramerate(float fr) {
   return (fr == 30 || fr == 60);
 }
 
-bool copyImageRGB32(PXCImage* color, uint8_t* uint8_array) {
+// Estimated size of the buffers the SDK allocates for |data|: the block
+// meshes, the vertices (x, y, z, confidence) with their RGB colors, and the
+// faces.
+size_t getBlockMeshingDataFootprint(PXCBlockMeshingData* data,
+                                    bool use_color) {
+  if (!data)
+    return 0;
+  return data->QueryMaxNumberOfBlockMeshes() *
+             sizeof(PXCBlockMeshingData::PXCBlockMesh) +
+         data->QueryMaxNumberOfVertices() *
+             (4 * sizeof(float) + (use_color ? 3 : 0)) +
+         data->QueryMaxNumberOfFaces() * 3 * sizeof(int);
+}
+
+// Estimated size of the centers and the RGB colors of |voxel_count| surface
+// voxels.
+size_t getSurfaceVoxelsFootprint(int voxel_count, bool use_color) {
+  return std::max(voxel_count, 0) * (3 * sizeof(float) + (use_color ? 3 : 0));
+}
+
+// Copies |color| as RGBA, at half its width and height if |halve|.
+bool copyImageRGB32(PXCImage* color, bool halve, uint8_t* uint8_array) {
   if (!(color && uint8_array)) {
     DLOG(ERROR) << "Null image or buffer.";
     return false;
@@ -43,16 +71,12 @@ bool copyImageRGB32(PXCImage* color, uint8_t* uint8_array) {
     DLOG(ERROR) << "Failed to access color image.";
     return false;
   }
-  int k = 0;
-  for (int y = 0; y < info.height; ++y) {
-    for (int x = 0; x < info.width; ++x) {
-      uint8_t* rgb32 = reinterpret_cast<uint8_t*>(color_data.planes[0]);
-      int i = (x + info.width * y) * 4;
-      uint8_array[k++] = rgb32[i + 2];
-      uint8_array[k++] = rgb32[i + 1];
-      uint8_array[k++] = rgb32[i];
-      uint8_array[k++] = rgb32[i + 3];
-    }
+  if (halve) {
+    HalveBGRAToRGBA(color_data.planes[0], color_data.pitches[0],
+                    info.width, info.height, uint8_array);
+  } else {
+    SwizzleBGRAToRGBA(color_data.planes[0], color_data.pitches[0],
+                      info.width, info.height, uint8_array);
   }
   color->ReleaseAccess(&color_data);
   return true;
@@ -90,16 +114,25 @@ ScenePerceptionObject::ScenePerceptionObject() :
     meshupdated_event_on_(false),
     sampleprocessed_event_on_(false),
     doing_meshing_updating_(false),
+    waiting_for_meshing_(false),
     sensemanager_thread_("SceneManagerThread"),
     meshing_thread_("MeshingThread"),
     message_loop_(base::MessageLoopProxy::current()),
     session_(NULL),
-    sense_manager_(NULL),
+    connection_(NULL),
     scene_perception_(NULL),
     block_meshing_data_(NULL),
+    block_meshing_data_memory_("ScenePerception", "block_meshing_data"),
     surface_voxels_data_(NULL),
+    surface_voxels_data_memory_("ScenePerception", "surface_voxels_data"),
     latest_color_image_(NULL),
-    latest_depth_image_(NULL) {
+    latest_depth_image_(NULL),
+    color_image_memory_("ScenePerception", "latest_color_image"),
+    depth_image_memory_("ScenePerception", "latest_depth_image"),
+    sample_message_size_(0),
+    sample_message_memory_("ScenePerception", "sample_message"),
+    frame_id_(0),
+    sample_flow_("ScenePerception::Sample") {
   last_meshing_time_ = base::TimeTicks::Now();
 
   // Size and framte rate for depth and color images.
@@ -114,6 +147,12 @@ ScenePerceptionObject::ScenePerceptionObject() :
   max_block_mesh_ = max_faces_ = max_vertices_ = -1;
   b_use_color_ = true;
 
+  // The module defaults, unless init() sets them.
+  has_coordinate_system_ = false;
+  has_voxel_resolution_ = false;
+  has_initial_pose_ = false;
+  has_meshing_thresholds_ = false;
+
   // Default meshing update info configurations.
   meshing_update_info_.countOfBlockMeshesRequired = true;
   meshing_update_info_.blockMeshesRequired = true;
@@ -168,6 +207,15 @@ ScenePerceptionObject::ScenePerceptionObject() :
   handler_.Register("setMeshingRegion",
                     base::Bind(&ScenePerceptionObject::OnSetMeshingRegion,
                                base::Unretained(this)));
+  handler_.Register("setStreamQuality",
+                    base::Bind(&ScenePerceptionObject::OnSetStreamQuality,
+                               base::Unretained(this)));
+  handler_.Register("ackFrameEvent",
+                    base::Bind(&ScenePerceptionObject::OnAckFrameEvent,
+                               base::Unretained(this)));
+  handler_.Register("getMemoryStats",
+                    base::Bind(&ScenePerceptionObject::OnGetMemoryStats,
+                               base::Unretained(this)));
 
   // Data and configurations getting APIs.
   handler_.Register("getSample",
@@ -227,10 +275,79 @@ ScenePerceptionObject::~ScenePerceptionObject() {
   }
 
   sample_message_.reset();
+  sample_message_size_ = 0;
+  sample_message_memory_.Reset();
 }
 
-void ScenePerceptionObject::ReleaseResources() {
+bool ScenePerceptionObject::CanJoinPipeline(PXCSenseManager* sense_manager) {
+  // The module holds the volume of one object, and its settings are only
+  // applied before the pipeline is initialized.
+  return false;
+}
+
+pxcStatus ScenePerceptionObject::OnConfigurePipeline(
+    PXCSenseManager* sense_manager) {
+  if (has_coordinate_system_)
+    sense_manager->QuerySession()->SetCoordinateSystem(coordinate_system_);
+
+  sense_manager->EnableStream(PXCCapture::STREAM_TYPE_COLOR,
+                              color_image_width_, color_image_height_,
+                              color_capture_framerate_);
+  sense_manager->EnableStream(PXCCapture::STREAM_TYPE_DEPTH,
+                              depth_image_width_, depth_image_height_,
+                              depth_capture_framerate_);
+
+  pxcStatus status = sense_manager->EnableScenePerception();
+  if (status != PXC_STATUS_NO_ERROR)
+    return status;
+  PXCScenePerception* scene_perception =
+      sense_manager->QueryScenePerception();
+  if (scene_perception == NULL)
+    return PXC_STATUS_ITEM_UNAVAILABLE;
+
+  if (has_voxel_resolution_)
+    scene_perception->SetVoxelResolution(voxel_resolution_);
+  // TODO(Donna): check SetInitialCameraPose is valid before 'Init'.
+  if (has_initial_pose_ &&
+      PXC_STATUS_NO_ERROR != scene_perception->SetInitialPose(initial_pose_)) {
+    triggerError("Failed to apply parameter [initialCameraPose].");
+  }
+  // TODO(Donna): check SetMeshingThresholds is valid before 'Init'.
+  if (has_meshing_thresholds_ &&
+      PXC_STATUS_NO_ERROR != scene_perception->SetMeshingThresholds(
+          meshing_threshold_max_, meshing_threshold_avg_)) {
+    triggerError("Failed to apply [meshingThresholds].");
+  }
+
+  sense_manager->PauseScenePerception(true);
+  scene_perception->EnableSceneReconstruction(true);
+  return PXC_STATUS_NO_ERROR;
+}
+
+void ScenePerceptionObject::OnPipelineRestart() {
+  // The connection is released on sensemanager_thread_ before it stops.
+  sensemanager_thread_.message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&ScenePerceptionObject::OnRestartPipeline,
+                 base::Unretained(this)));
+}
+
+bool ScenePerceptionObject::CreatePipelineOutputs() {
+  PXCSenseManager* sense_manager = connection_->QuerySenseManager();
+  scene_perception_ = sense_manager->QueryScenePerception();
+  if (scene_perception_ == NULL)
+    return false;
+  scene_perception_->GetInternalCameraIntrinsics(&sp_intrinsics_);
+  if (state_ == STARTED)
+    sense_manager->PauseScenePerception(false);
+  return true;
+}
+
+bool ScenePerceptionObject::RestartPipeline() {
   DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "ScenePerceptionObject::RestartPipeline");
+  ReleasePipelineOutputs();
+  // The streams of the new pipeline may have other sizes.
   if (latest_color_image_) {
     latest_color_image_->Release();
     latest_color_image_ = NULL;
@@ -239,24 +356,60 @@ void ScenePerceptionObject::ReleaseResources() {
     latest_depth_image_->Release();
     latest_depth_image_ = NULL;
   }
+  color_image_memory_.Reset();
+  depth_image_memory_.Reset();
+  sample_message_.reset();
+  sample_message_size_ = 0;
+  sample_message_memory_.Reset();
+
+  pxcStatus status = connection_->WaitForRestart();
+  if (status < PXC_STATUS_NO_ERROR) {
+    DLOG(ERROR) << "Failed to restart the pipeline: " << status;
+    return false;
+  }
+  return CreatePipelineOutputs();
+}
+
+void ScenePerceptionObject::ReleasePipelineOutputs() {
   if (block_meshing_data_) {
     block_meshing_data_->Release();
     block_meshing_data_ = NULL;
   }
+  block_meshing_data_memory_.Reset();
 
   if (surface_voxels_data_) {
     surface_voxels_data_->Release();
     surface_voxels_data_ = NULL;
   }
+  surface_voxels_data_memory_.Reset();
+
+  scene_perception_ = NULL;
+}
 
-  if (sense_manager_) {
-    sense_manager_->Close();
-    sense_manager_->Release();
-    sense_manager_ = NULL;
+void ScenePerceptionObject::ReleaseResources() {
+  DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  // Writes the frames still queued and closes the file.
+  recorder_.reset();
+  sample_flow_.End();
+  if (latest_color_image_) {
+    latest_color_image_->Release();
+    latest_color_image_ = NULL;
+  }
+  if (latest_depth_image_) {
+    latest_depth_image_->Release();
+    latest_depth_image_ = NULL;
+  }
+  color_image_memory_.Reset();
+  depth_image_memory_.Reset();
+
+  ReleasePipelineOutputs();
+  if (connection_) {
+    connection_->Release();
+    connection_ = NULL;
   }
 
   if (session_) {
-    session_->Release();
+    ReleaseSharedSession(session_);
     session_ = NULL;
   }
 }
@@ -292,6 +445,9 @@ void ScenePerceptionObject::StopEvent(const std::string& type) {
   } else if (type == std::string("sampleprocessed")) {
     sampleprocessed_event_on_ = false;
   }
+  // The events in flight are not acknowledged anymore.
+  if (!checking_event_on_ && !sampleprocessed_event_on_)
+    stream_quality_.Reset();
 }
 
 void ScenePerceptionObject::triggerError(const std::string message) {
@@ -332,7 +488,7 @@ void ScenePerceptionObject::OnCreateAndStartPipeline(
     return;
   }
 
-  session_ = PXCSession::CreateInstance();
+  session_ = AcquireSharedSession();
   if (!session_) {
     info->PostResult(CreateDOMException("Failed to create session.",
                                         ERROR_NAME_NOTFOUNDERROR));
@@ -340,14 +496,6 @@ void ScenePerceptionObject::OnCreateAndStartPipeline(
     StopSceneManagerThread();
     return;
   }
-  sense_manager_ = session_->CreateSenseManager();
-  if (!sense_manager_) {
-    info->PostResult(CreateDOMException("Failed to create sense manager.",
-                                        ERROR_NAME_ABORTERROR));
-    ReleaseResources();
-    StopSceneManagerThread();
-    return;
-  }
 
   scoped_ptr<Init::Params> params(Init::Params::Create(*info->arguments()));
   if (params && params->config) {
@@ -355,47 +503,28 @@ void ScenePerceptionObject::OnCreateAndStartPipeline(
     applyInitialConfigs(params->config.get());
   }
 
-  sense_manager_->EnableStream(PXCCapture::STREAM_TYPE_COLOR,
-                               color_image_width_, color_image_height_,
-                               color_capture_framerate_);
-  sense_manager_->EnableStream(PXCCapture::STREAM_TYPE_DEPTH,
-                               depth_image_width_, depth_image_height_,
-                               depth_capture_framerate_);
-
-  pxcStatus status = sense_manager_->EnableScenePerception();
-  if (status != PXC_STATUS_NO_ERROR) {
-    info->PostResult(
-        CreateDOMException("Failed to enable scene perception module.",
-                           ERROR_NAME_ABORTERROR));
-    ReleaseResources();
-    StopSceneManagerThread();
-    return;
-  }
-
-  scene_perception_ = sense_manager_->QueryScenePerception();
-  if (scene_perception_ == NULL) {
-    info->PostResult(CreateDOMException("Failed to query scene perception.",
+  // The pipeline of the camera is shared with the other extensions, and
+  // restarted to enable the module with the configuration above.
+  pxcStatus status;
+  connection_ = CaptureService::GetInstance()->Connect("", this, &status);
+  if (!connection_) {
+    info->PostResult(CreateDOMException("Failed to initialize pipeline.",
                                         ERROR_NAME_ABORTERROR));
     ReleaseResources();
     StopSceneManagerThread();
     return;
   }
 
-  sense_manager_->PauseScenePerception(true);
-  scene_perception_->EnableSceneReconstruction(true);
-
-  /** Init the pipeline **/
-  status = sense_manager_->Init();
-  if (status != PXC_STATUS_NO_ERROR) {
-    info->PostResult(CreateDOMException("Failed to initialize pipeline.",
+  if (!CreatePipelineOutputs()) {
+    info->PostResult(CreateDOMException("Failed to query scene perception.",
                                         ERROR_NAME_ABORTERROR));
     ReleaseResources();
     StopSceneManagerThread();
     return;
   }
-  scene_perception_->GetInternalCameraIntrinsics(&sp_intrinsics_);
 
   state_ = INITIALIZED;
+  recorder_ = FrameRecorder::CreateFromEnvironment("scene_perception");
 
   sensemanager_thread_.message_loop()->PostTask(
       FROM_HERE,
@@ -407,51 +536,52 @@ void ScenePerceptionObject::OnCreateAndStartPipeline(
 
 void ScenePerceptionObject::applyInitialConfigs(
     InitialConfiguration* jsConfig) {
+  has_coordinate_system_ = false;
+  has_voxel_resolution_ = false;
+  has_initial_pose_ = false;
+  has_meshing_thresholds_ = false;
+
   if (jsConfig->use_open_cv_coordinate_system) {
     bool useOPENCV = *(jsConfig->use_open_cv_coordinate_system.get());
-    PXCSession::CoordinateSystem c = useOPENCV ?
+    coordinate_system_ = useOPENCV ?
         PXCSession::COORDINATE_SYSTEM_REAR_OPENCV
       : PXCSession::COORDINATE_SYSTEM_REAR_DEFAULT;
-    session_->SetCoordinateSystem(c);
+    has_coordinate_system_ = true;
   }
   if (jsConfig->voxel_resolution) {
+    has_voxel_resolution_ = true;
     switch (jsConfig->voxel_resolution) {
       case VOXEL_RESOLUTION_LOW:
-        scene_perception_->SetVoxelResolution(
-          PXCScenePerception::VoxelResolution::LOW_RESOLUTION);
+        voxel_resolution_ =
+          PXCScenePerception::VoxelResolution::LOW_RESOLUTION;
         break;
       case VOXEL_RESOLUTION_MED:
-        scene_perception_->SetVoxelResolution(
-          PXCScenePerception::VoxelResolution::MED_RESOLUTION);
+        voxel_resolution_ =
+          PXCScenePerception::VoxelResolution::MED_RESOLUTION;
         break;
       case VOXEL_RESOLUTION_HIGH:
-        scene_perception_->SetVoxelResolution(
-          PXCScenePerception::VoxelResolution::HIGH_RESOLUTION);
+        voxel_resolution_ =
+          PXCScenePerception::VoxelResolution::HIGH_RESOLUTION;
         break;
       default:
+        has_voxel_resolution_ = false;
         triggerError("Invalid parameter [voxelResolution].");
     }
   }
   if (jsConfig->initial_camera_pose) {
-    // TODO(Donna): check SetInitialCameraPose is valid before 'Init'.
-    float pose[12];
     std::vector<double> jsPose = *(jsConfig->initial_camera_pose.get());
     for (int i = 0; i < 12; i++) {
-      pose[i] = static_cast<float>(jsPose[i]);
-    }
-    if (PXC_STATUS_NO_ERROR != scene_perception_->SetInitialPose(pose)) {
-      triggerError("Failed to apply parameter [initialCameraPose].");
+      initial_pose_[i] = static_cast<float>(jsPose[i]);
     }
+    has_initial_pose_ = true;
   }
   if (jsConfig->meshing_thresholds) {
     MeshingThresholds* jsThresholds = jsConfig->meshing_thresholds.get();
 
     if (isValidThresholds(jsThresholds)) {
-      // TODO(Donna): check SetMeshingThresholds is valid before 'Init'.
-      if (PXC_STATUS_NO_ERROR != scene_perception_->SetMeshingThresholds(
-            jsThresholds->max, jsThresholds->avg)) {
-        triggerError("Failed to apply [meshingThresholds].");
-      }
+      meshing_threshold_max_ = static_cast<float>(jsThresholds->max);
+      meshing_threshold_avg_ = static_cast<float>(jsThresholds->avg);
+      has_meshing_thresholds_ = true;
     } else {
       triggerError("Invalid parameter [meshingThresholds].");
     }
@@ -480,7 +610,27 @@ void ScenePerceptionObject::OnRunPipeline() {
   if (state_ == IDLE)
     return;
 
-  pxcStatus status = sense_manager_->AcquireFrame(true);
+  TRACE_EVENT1("realsense", "ScenePerceptionObject::OnRunPipeline",
+               "frame", frame_id_ + 1);
+  CaptureFrame* frame = NULL;
+  pxcStatus status;
+  {
+    TRACE_EVENT0("realsense", "AcquireFrame");
+    status = connection_->AcquireFrame(&frame);
+  }
+  if (status == PXC_STATUS_EXEC_ABORTED) {
+    // A running meshing update still uses the module.
+    if (doing_meshing_updating_) {
+      waiting_for_meshing_ = true;
+      return;
+    }
+    OnRestartPipeline();
+    sensemanager_thread_.message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&ScenePerceptionObject::OnRunPipeline,
+                   base::Unretained(this)));
+    return;
+  }
   if (status < PXC_STATUS_NO_ERROR) {
     triggerError("Failed to process next frame.");
 
@@ -489,17 +639,19 @@ void ScenePerceptionObject::OnRunPipeline() {
     return;
   }
 
-  PXCCapture::Sample *sample = sense_manager_->QueryScenePerceptionSample();
+  PXCSenseManager* sense_manager = frame->QuerySenseManager();
+  PXCCapture::Sample *sample = sense_manager->QueryScenePerceptionSample();
   if (!sample) {
     // If the SP module is paused, the sample will be NULL.
     // Query the raw color/depth images to support live preview and
     // calculation of scene quality
-    sample = sense_manager_->QuerySample();
+    sample = sense_manager->QuerySample();
   }
 
   if (!sample || !sample->color || !sample->depth) {
     triggerError("Failed to query sample.");
 
+    frame->Release();
     ReleaseResources();
     state_ = IDLE;
     return;
@@ -524,20 +676,43 @@ void ScenePerceptionObject::OnRunPipeline() {
     image_info.format = PXCImage::PIXEL_FORMAT_DEPTH;
     latest_depth_image_ = session_->CreateImage(&image_info);
   }
+  color_image_memory_.Set(GetImageFootprint(latest_color_image_));
+  depth_image_memory_.Set(GetImageFootprint(latest_depth_image_));
 
   // Copy the images.
-  latest_color_image_->CopyImage(sample->color);
-  latest_depth_image_->CopyImage(sample->depth);
+  {
+    TRACE_EVENT0("realsense", "CopyImage");
+    latest_color_image_->CopyImage(sample->color);
+    latest_depth_image_->CopyImage(sample->depth);
+  }
+  ++frame_id_;
+
+  // The frame events skipped while the page lags skip the quality check too.
+  bool frame_event_on = (state_ == INITIALIZED && checking_event_on_) ||
+                        (state_ == STARTED && sampleprocessed_event_on_);
+  // Paced events carry the ID the page acknowledges them with.
+  int event_id = 0;
+  bool dispatch_frame_event =
+      frame_event_on &&
+      stream_quality_.OnFrame(base::TimeTicks::Now(), &event_id);
+  if (dispatch_frame_event)
+    sample_flow_.Begin(frame_id_);
 
   // Get the depth quality.
   float quality = 0.0;
-  quality = scene_perception_->CheckSceneQuality(sample);
+  if (dispatch_frame_event) {
+    TRACE_EVENT0("realsense", "CheckSceneQuality");
+    quality = scene_perception_->CheckSceneQuality(sample);
+  }
 
-  if ((state_ == INITIALIZED) && checking_event_on_) {
+  if ((state_ == INITIALIZED) && checking_event_on_ && dispatch_frame_event) {
     CheckingEvent event;
     event.quality = quality;
+    scoped_ptr<base::DictionaryValue> value = event.ToValue();
+    if (event_id)
+      value->SetInteger("frameEventId", event_id);
     scoped_ptr<base::ListValue> eventData(new base::ListValue);
-    eventData->Append(event.ToValue().release());
+    eventData->Append(value.release());
 
     DispatchEvent("checking", eventData.Pass());
   }
@@ -548,15 +723,18 @@ void ScenePerceptionObject::OnRunPipeline() {
     float pose[12];
     scene_perception_->GetCameraPose(pose);
 
-    if (sampleprocessed_event_on_) {
+    if (sampleprocessed_event_on_ && dispatch_frame_event) {
       SampleProcessedEvent event;
       event.quality = quality;
       event.accuracy = toJsAccuracy(accuracy);
       for (int i = 0; i < 12; ++i) {
         event.camera_pose.push_back(pose[i]);
       }
+      scoped_ptr<base::DictionaryValue> value = event.ToValue();
+      if (event_id)
+        value->SetInteger("frameEventId", event_id);
       scoped_ptr<base::ListValue> eventData(new base::ListValue);
-      eventData->Append(event.ToValue().release());
+      eventData->Append(value.release());
 
       DispatchEvent("sampleprocessed", eventData.Pass());
     }
@@ -568,7 +746,9 @@ void ScenePerceptionObject::OnRunPipeline() {
     }
   }
 
-  sense_manager_->ReleaseFrame();
+  if (recorder_)
+    RecordFrame(sample);
+  frame->Release();
 
   sensemanager_thread_.message_loop()->PostTask(
       FROM_HERE,
@@ -576,6 +756,40 @@ void ScenePerceptionObject::OnRunPipeline() {
                  base::Unretained(this)));
 }
 
+void ScenePerceptionObject::RecordFrame(PXCCapture::Sample* sample) {
+  TRACE_EVENT0("realsense", "ScenePerceptionObject::RecordFrame");
+  FrameRecorder::Frame* recorded_frame = recorder_->BeginFrame();
+  if (!recorded_frame)
+    return;
+
+  AddImageChunk(recorded_frame, FRAME_CHUNK_COLOR, sample->color);
+  AddImageChunk(recorded_frame, FRAME_CHUNK_DEPTH, sample->depth);
+  // The camera is only tracked once started.
+  if (state_ == STARTED) {
+    float pose[12];
+    scene_perception_->GetCameraPose(pose);
+    recorded_frame->AddData(FRAME_CHUNK_CAMERA_POSE, pose, sizeof(pose));
+  }
+
+  recorder_->EndFrame(recorded_frame);
+}
+
+void ScenePerceptionObject::OnRestartPipeline() {
+  DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  // A running meshing update still uses the module, OnMeshingResult()
+  // restarts the pipeline then.
+  if (state_ == IDLE || doing_meshing_updating_ ||
+      !connection_->IsRestartPending())
+    return;
+
+  if (!RestartPipeline()) {
+    triggerError("Failed to restart the camera pipeline.");
+
+    ReleaseResources();
+    state_ = IDLE;
+  }
+}
+
 void ScenePerceptionObject::OnDestroy(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   if (!sensemanager_thread_.IsRunning()) {
@@ -657,7 +871,7 @@ void ScenePerceptionObject::DoPauseScenePerception(
       return;
     }
     state_ = STARTED;
-    sense_manager_->PauseScenePerception(pause);
+    connection_->QuerySenseManager()->PauseScenePerception(pause);
     info->PostResult(CreateSuccessResult());
   } else {
     if (state_ != STARTED) {
@@ -666,7 +880,7 @@ void ScenePerceptionObject::DoPauseScenePerception(
       return;
     }
     state_ = INITIALIZED;
-    sense_manager_->PauseScenePerception(pause);
+    connection_->QuerySenseManager()->PauseScenePerception(pause);
     info->PostResult(CreateSuccessResult());
   }
 }
@@ -815,6 +1029,7 @@ void ScenePerceptionObject::OnGetVertices(
 void ScenePerceptionObject::DoGetVerticesOrNormals(bool isGettingVertices,
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "ScenePerceptionObject::DoGetVerticesOrNormals");
 
   if (scene_perception_ == NULL) {
     info->PostResult(CreateDOMException("Wrong state.",
@@ -892,6 +1107,8 @@ void ScenePerceptionObject::DoGetMeshData(
     // initialize the meshing_data buffer
     block_meshing_data_ = scene_perception_->CreatePXCBlockMeshingData(
         max_block_mesh_, max_vertices_, max_faces_, b_use_color_);
+    block_meshing_data_memory_.Set(
+        getBlockMeshingDataFootprint(block_meshing_data_, b_use_color_));
   }
   if (doing_meshing_updating_
       || !(scene_perception_->IsReconstructionUpdated())
@@ -903,6 +1120,8 @@ void ScenePerceptionObject::DoGetMeshData(
   } else {
     doing_meshing_updating_ = true;
     DLOG(INFO) << "Request meshing";
+    // Only one meshing update runs at a time, so |this| identifies it.
+    TRACE_EVENT_ASYNC_BEGIN0("realsense", "ScenePerception::Meshing", this);
     // Start the meshing thread if needed.
     if (!meshing_thread_.IsRunning()) {
       meshing_thread_.Start();
@@ -918,9 +1137,15 @@ void ScenePerceptionObject::DoGetMeshData(
 void ScenePerceptionObject::DoMeshingUpdateOnMeshingThread(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(meshing_thread_.message_loop(), base::MessageLoop::current());
-  pxcStatus status = scene_perception_->DoMeshingUpdate(block_meshing_data_,
-                                                        b_fill_holes_,
-                                                        &meshing_update_info_);
+  TRACE_EVENT0("realsense",
+               "ScenePerceptionObject::DoMeshingUpdateOnMeshingThread");
+  pxcStatus status;
+  {
+    TRACE_EVENT0("realsense", "DoMeshingUpdate");
+    status = scene_perception_->DoMeshingUpdate(block_meshing_data_,
+                                                b_fill_holes_,
+                                                &meshing_update_info_);
+  }
   // Failed to get mesh updates.
   if (status != PXC_STATUS_NO_ERROR) {
     sensemanager_thread_.message_loop()->PostTask(
@@ -938,68 +1163,18 @@ void ScenePerceptionObject::DoMeshingUpdateOnMeshingThread(
   int num_of_faces = block_meshing_data_->QueryNumberOfFaces();
   int num_of_blockmeshes = block_meshing_data_->QueryNumberOfBlockMeshes();
 
-  const int header_byte_length = 4 * sizeof(int);
-  const int blockmesh_int_length = 5;
-  const int blockmesh_byte_length = blockmesh_int_length * sizeof(int);
-  const int vertices_byte_length = num_of_vertices * 4 * sizeof(float);
-  const int faces_byte_length = num_of_faces * 3 * sizeof(unsigned int);
-  const int colors_byte_length = num_of_vertices * 3 * sizeof(unsigned char);
-
   size_t meshing_data_message_size =
-      header_byte_length
-      + num_of_blockmeshes * blockmesh_byte_length
-      + vertices_byte_length
-      + faces_byte_length
-      + colors_byte_length;
-
-  scoped_ptr<uint8[]> meshing_data_message(
-      new uint8[meshing_data_message_size]);
-  int* int_array = reinterpret_cast<int*>(meshing_data_message.get());
-  int_array[1] = num_of_blockmeshes;
-  int_array[2] = num_of_vertices;
-  int_array[3] = num_of_faces;
-
-  PXCBlockMeshingData::PXCBlockMesh *block_mesh_data =
-      block_meshing_data_->QueryBlockMeshes();
-  char* block_meshes_offset =
-      reinterpret_cast<char*>(meshing_data_message.get()) +
-      header_byte_length;
-  int* block_meshes_array = reinterpret_cast<int*>(block_meshes_offset);
-  for (int i = 0; i < num_of_blockmeshes; ++i, ++block_mesh_data) {
-    block_meshes_array[i * blockmesh_int_length] = block_mesh_data->meshId;
-    block_meshes_array[i * blockmesh_int_length + 1] =
-        block_mesh_data->vertexStartIndex;
-    block_meshes_array[i * blockmesh_int_length + 2] =
-        block_mesh_data->numVertices;
-    block_meshes_array[i * blockmesh_int_length + 3] =
-        block_mesh_data->faceStartIndex;
-    block_meshes_array[i * blockmesh_int_length + 4] =
-        block_mesh_data->numFaces;
-
-    if ((block_mesh_data->numVertices > 0) && (block_mesh_data->numFaces > 0)) {
-      // Set face indices relative to vertex buffer
-      for (int j = 0; j < block_mesh_data->numFaces * 3; j++) {
-        faces[block_mesh_data->faceStartIndex + j] -=
-            block_mesh_data->vertexStartIndex / 4;
-      }
-    }
-  }
-
-  char* vertices_offset = block_meshes_offset
-      + num_of_blockmeshes * blockmesh_byte_length;
-  memcpy(vertices_offset, reinterpret_cast<char*>(vertices),
-         vertices_byte_length);
-
-  char* faces_offset = vertices_offset + vertices_byte_length;
-  memcpy(faces_offset, reinterpret_cast<char*>(faces), faces_byte_length);
-
-  char* colors_offset = faces_offset + faces_byte_length;
-  memcpy(colors_offset, reinterpret_cast<char*>(colors), colors_byte_length);
-
+      GetMeshMessageSize(num_of_blockmeshes, num_of_vertices, num_of_faces);
+  scoped_ptr<char[]> meshing_data_message(
+      new char[meshing_data_message_size]);
+  PackMeshMessage(block_meshing_data_->QueryBlockMeshes(), num_of_blockmeshes,
+                  vertices, num_of_vertices, faces, num_of_faces, colors,
+                  reinterpret_cast<uint8*>(meshing_data_message.get()));
+
+  // The message is large, the result takes it over instead of copying it.
   scoped_ptr<base::ListValue> result(new base::ListValue());
-  result->Append(base::BinaryValue::CreateWithCopiedBuffer(
-        reinterpret_cast<const char*>(meshing_data_message.get()),
-        meshing_data_message_size));
+  result->Append(new base::BinaryValue(meshing_data_message.Pass(),
+                                       meshing_data_message_size));
   info->PostResult(result.Pass());
 
   // Notice the scenemanager thread that mesh data updating done.
@@ -1014,6 +1189,16 @@ void ScenePerceptionObject::OnMeshingResult() {
 
   last_meshing_time_ = base::TimeTicks::Now();
   doing_meshing_updating_ = false;
+  TRACE_EVENT_ASYNC_END0("realsense", "ScenePerception::Meshing", this);
+
+  if (waiting_for_meshing_) {
+    waiting_for_meshing_ = false;
+    OnRestartPipeline();
+    sensemanager_thread_.message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&ScenePerceptionObject::OnRunPipeline,
+                   base::Unretained(this)));
+  }
 }
 
 /** ---------------- Implementation for setters --------------**/
@@ -1225,6 +1410,9 @@ void ScenePerceptionObject::DoConfigureSurfaceVoxelsData(
   surface_voxels_data_ =
     scene_perception_->CreatePXCSurfaceVoxelsData(
         params->config.voxel_count, params->config.use_color);
+  surface_voxels_data_memory_.Set(surface_voxels_data_ ?
+      getSurfaceVoxelsFootprint(params->config.voxel_count,
+                                params->config.use_color) : 0);
   if (surface_voxels_data_) {
     info->PostResult(CreateSuccessResult());
   } else {
@@ -1269,6 +1457,48 @@ void ScenePerceptionObject::OnSetMeshingRegion(
   info->PostResult(CreateSuccessResult());
 }
 
+void ScenePerceptionObject::OnSetStreamQuality(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<SetStreamQuality::Params> params(
+      SetStreamQuality::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(
+        CreateDOMException("Malformed parameters for setStreamQuality.",
+                           ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+
+  static_assert(STREAM_QUALITY_FULL == 1 &&
+                    STREAM_QUALITY_MINIMAL ==
+                        StreamQualityController::QUALITY_MINIMAL + 1,
+                "StreamQuality lists the qualities of the controller");
+  if (!stream_quality_.SetBoundsFromOptions(
+          params->options.lowest_quality,
+          params->options.max_latency.get())) {
+    info->PostResult(CreateDOMException("Invalid parameter [maxLatency].",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+  info->PostResult(CreateSuccessResult());
+}
+
+void ScenePerceptionObject::OnAckFrameEvent(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<AckFrameEvent::Params> params(
+      AckFrameEvent::Params::Create(*info->arguments()));
+  if (!params)
+    return;
+  stream_quality_.OnFrameEventAcknowledged(params->event_id,
+                                           base::TimeTicks::Now());
+}
+
+void ScenePerceptionObject::OnGetMemoryStats(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  MemoryStats stats;
+  PopulateMemoryStats<MemoryCategoryStats>(&stats);
+  info->PostResult(GetMemoryStats::Results::Create(stats, std::string()));
+}
+
 /** ---------------- Implementation for getters --------------**/
 void ScenePerceptionObject::OnGetSample(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
@@ -1289,62 +1519,89 @@ void ScenePerceptionObject::OnGetSample(
 void ScenePerceptionObject::DoCopySample(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT1("realsense", "ScenePerceptionObject::DoCopySample",
+               "frame", frame_id_);
+  sample_flow_.End();
   if (!(latest_color_image_ && latest_depth_image_)) {
     info->PostResult(CreateDOMException("No valiable sample.",
                                         ERROR_NAME_ABORTERROR));
     return;
   }
 
+  scoped_ptr<GetSample::Params> params(
+      GetSample::Params::Create(*info->arguments()));
+  if (!params) {
+    info->PostResult(CreateDOMException("Malformed parameters for getSample",
+                                        ERROR_NAME_INVALIDACCESSERROR));
+    return;
+  }
+  DepthMessageEncoding depth_encoding =
+      params->depth_encoding == DEPTH_ENCODING_RVL ? DEPTH_MESSAGE_RVL
+                                                   : DEPTH_MESSAGE_RAW;
+
   PXCImage* color = latest_color_image_;
   PXCImage* depth = latest_depth_image_;
 
   PXCImage::ImageInfo color_info = color->QueryInfo();
   PXCImage::ImageInfo depth_info = depth->QueryInfo();
 
+  // While the page lags the color image, a preview, is halved, then left
+  // out as 0x0.
+  bool skip_color = stream_quality_.ShouldSkipOptionalOutputs();
+  bool halve_color = !skip_color && stream_quality_.ShouldDownscalePreview();
+  int color_width = color_info.width;
+  int color_height = color_info.height;
+  if (skip_color) {
+    color_width = color_height = 0;
+  } else if (halve_color) {
+    color_width /= 2;
+    color_height /= 2;
+  }
+
   // sample message: call_id (i32),
   // color_width (i32), color_height (i32),
   // depth_width (i32), depth_height (i32),
-  // color (int8 buffer), depth (int16 buffer)
-  int cDataOffset = 4 * 5;
-  int dDataOffset = cDataOffset + color_info.width * color_info.height * 4;
-  if (!sample_message_) {
-    sample_message_size_ = dDataOffset
-      + depth_info.width * depth_info.height * 2;
+  // color (int8 buffer), depth section (see depth_codec.h)
+  size_t cDataOffset = 4 * 5;
+  size_t dDataOffset = cDataOffset + color_width * color_height * 4;
+  size_t message_capacity = dDataOffset + GetMaxDepthSectionSize(
+      depth_encoding, depth_info.width, depth_info.height);
+  if (sample_message_size_ < message_capacity) {
+    sample_message_size_ = message_capacity;
     sample_message_.reset(
         new uint8[sample_message_size_]);
+    sample_message_memory_.Set(sample_message_size_);
   }
   int* int_array = reinterpret_cast<int*>(sample_message_.get());
-  int_array[1] = color_info.width;
-  int_array[2] = color_info.height;
+  int_array[1] = color_width;
+  int_array[2] = color_height;
   int_array[3] = depth_info.width;
   int_array[4] = depth_info.height;
 
-  copyImageRGB32(color,
-         reinterpret_cast<uint8_t*>(
-         sample_message_.get() + cDataOffset));
+  if (!skip_color) {
+    copyImageRGB32(color, halve_color,
+           reinterpret_cast<uint8_t*>(
+           sample_message_.get() + cDataOffset));
+  }
 
   PXCImage::ImageData depth_data;
   pxcStatus status = depth->AcquireAccess(
       PXCImage::ACCESS_READ, PXCImage::PIXEL_FORMAT_DEPTH, &depth_data);
-  uint16_t* uint16_array = reinterpret_cast<uint16_t*>(
-      sample_message_.get() + dDataOffset);
-  if (status >= PXC_STATUS_NO_ERROR) {
-    int k = 0;
-    for (int y = 0; y < depth_info.height; ++y) {
-      for (int x = 0; x < depth_info.width; ++x) {
-        uint16_t* depth16 =
-          reinterpret_cast<uint16_t*>(
-              depth_data.planes[0] + depth_data.pitches[0] * y);
-        uint16_array[k++] = depth16[x];
-      }
-    }
-    depth->ReleaseAccess(&depth_data);
+  if (status < PXC_STATUS_NO_ERROR) {
+    info->PostResult(CreateDOMException("Failed to access depth image.",
+                                        ERROR_NAME_ABORTERROR));
+    return;
   }
+  size_t message_size = dDataOffset + PackDepthSection(
+      depth_encoding, depth_data.planes[0], depth_data.pitches[0],
+      depth_info.width, depth_info.height,
+      sample_message_.get() + dDataOffset);
+  depth->ReleaseAccess(&depth_data);
 
   scoped_ptr<base::ListValue> result(new base::ListValue());
   result->Append(base::BinaryValue::CreateWithCopiedBuffer(
         reinterpret_cast<const char*>(sample_message_.get()),
-        sample_message_size_));
+        message_size));
   info->PostResult(result.Pass());
 }
 
@@ -1365,6 +1622,7 @@ void ScenePerceptionObject::OnGetVolumePreview(
 void ScenePerceptionObject::DoGetVolumePreview(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "ScenePerceptionObject::DoGetVolumePreview");
   scoped_ptr<GetVolumePreview::Params> params(
       GetVolumePreview::Params::Create(*info->arguments()));
   if (!params) {
@@ -1419,6 +1677,7 @@ void ScenePerceptionObject::DoGetVolumePreview(
 void ScenePerceptionObject::DoQueryVolumePreview(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "ScenePerceptionObject::DoQueryVolumePreview");
 
   scoped_ptr<QueryVolumePreview::Params> params(
       QueryVolumePreview::Params::Create(*info->arguments()));
@@ -1457,7 +1716,7 @@ void ScenePerceptionObject::DoQueryVolumePreview(
   int_array[1] = imageInfo.width;
   int_array[2] = imageInfo.height;
 
-  copyImageRGB32(volume_preview,
+  copyImageRGB32(volume_preview, false,
          reinterpret_cast<uint8_t*>(
          volume_preview_message.get() + dataOffset));
 
@@ -1665,6 +1924,7 @@ void ScenePerceptionObject::OnGetSurfaceVoxels(
 void ScenePerceptionObject::DoGetSurfaceVoxels(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "ScenePerceptionObject::DoGetSurfaceVoxels");
 
   SurfaceVoxelsData data;
 
@@ -1731,6 +1991,11 @@ void ScenePerceptionObject::DoGetSurfaceVoxels(
   uint8_t* voxelsColor = reinterpret_cast<uint8_t*>(
                          surface_voxels_data_->QuerySurfaceVoxelsColor());
   int hasColorData = voxelsColor ? 1 : 0;
+  // The size of voxels data created with the default count is only known
+  // from the voxels it holds.
+  surface_voxels_data_memory_.Set(std::max(
+      surface_voxels_data_memory_.bytes(),
+      getSurfaceVoxelsFootprint(numberOfVoxels, hasColorData != 0)));
 
   int voxelsDataOffset = 4 * sizeof(int);
   int colorOffset = voxelsDataOffset + numberOfVoxels * 3 * sizeof(float);
@@ -1793,6 +2058,7 @@ void ScenePerceptionObject::OnSaveMesh(
 void ScenePerceptionObject::DoSaveMesh(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   DCHECK_EQ(sensemanager_thread_.message_loop(), base::MessageLoop::current());
+  TRACE_EVENT0("realsense", "ScenePerceptionObject::DoSaveMesh");
 
   std::vector<char> buffer;
   PXCScenePerception::SaveMeshInfo mInfo;
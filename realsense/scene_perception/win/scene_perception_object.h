@@ -14,6 +14,12 @@
 #include "base/message_loop/message_loop_proxy.h"
 #include "base/time/time.h"
 #include "base/threading/thread.h"
+#include "realsense/common/depth_codec.h"
+#include "realsense/common/frame_recorder.h"
+#include "realsense/common/memory_accounting.h"
+#include "realsense/common/stream_quality.h"
+#include "realsense/common/trace_recorder.h"
+#include "realsense/common/win/capture_service.h"
 #include "third_party/libpxc/include/pxcsceneperception.h"
 #include "third_party/libpxc/include/pxcsensemanager.h"
 #include "xwalk/common/event_target.h"
@@ -24,7 +30,8 @@ namespace scene_perception {
 using namespace realsense::jsapi::scene_perception; // NOLINT
 using xwalk::common::XWalkExtensionFunctionInfo; // NOLINT
 
-class ScenePerceptionObject : public xwalk::common::EventTarget {
+class ScenePerceptionObject : public xwalk::common::EventTarget,
+                              public realsense::common::CaptureConsumer {
  public:
   ScenePerceptionObject();
   ~ScenePerceptionObject() override;
@@ -33,6 +40,11 @@ class ScenePerceptionObject : public xwalk::common::EventTarget {
   void StartEvent(const std::string& type) override;
   void StopEvent(const std::string& type) override;
 
+  // CaptureConsumer implementation.
+  bool CanJoinPipeline(PXCSenseManager* sense_manager) override;
+  pxcStatus OnConfigurePipeline(PXCSenseManager* sense_manager) override;
+  void OnPipelineRestart() override;
+
  private:
   // Controllers.
   void OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info);
@@ -58,6 +70,12 @@ class ScenePerceptionObject : public xwalk::common::EventTarget {
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnSetMeshingRegion(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnSetStreamQuality(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnAckFrameEvent(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnGetMemoryStats(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   // Data and configurations getting APIs.
   void OnGetSample(
@@ -99,6 +117,7 @@ class ScenePerceptionObject : public xwalk::common::EventTarget {
   void OnStopAndDestroyPipeline(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnRunPipeline();
+  void OnRestartPipeline();
   void OnResetScenePerception(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
 
@@ -131,7 +150,15 @@ class ScenePerceptionObject : public xwalk::common::EventTarget {
   void DoGetMeshingResolution(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnMeshingResult();
+  // Queries the module from the sense manager of the pipeline.
+  bool CreatePipelineOutputs();
+  // Recreates the module objects once the pipeline restarted for another
+  // consumer. The volume of the module starts over.
+  bool RestartPipeline();
+  void ReleasePipelineOutputs();
   void ReleaseResources();
+  // Records the images and the camera pose of the frame, when recording.
+  void RecordFrame(PXCCapture::Sample* sample);
   void DoGetVolumePreview(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void DoQueryVolumePreview(
@@ -193,8 +220,14 @@ class ScenePerceptionObject : public xwalk::common::EventTarget {
   bool checking_event_on_;
   bool sampleprocessed_event_on_;
   bool meshupdated_event_on_;
+  // Paces the checking and sampleprocessed events, the frame events, and the
+  // sample images to the page.
+  realsense::common::StreamQualityController stream_quality_;
 
   bool doing_meshing_updating_;
+  // The pipeline waits for the running meshing update to restart, and
+  // OnMeshingResult() resumes the frames.
+  bool waiting_for_meshing_;
   base::Thread sensemanager_thread_;
   base::Thread meshing_thread_;
   scoped_refptr<base::MessageLoopProxy> message_loop_;
@@ -210,6 +243,16 @@ class ScenePerceptionObject : public xwalk::common::EventTarget {
   int max_faces_;
   int max_vertices_;
   bool b_use_color_;
+  // Applied to the module each time the pipeline is configured.
+  bool has_coordinate_system_;
+  PXCSession::CoordinateSystem coordinate_system_;
+  bool has_voxel_resolution_;
+  PXCScenePerception::VoxelResolution voxel_resolution_;
+  bool has_initial_pose_;
+  float initial_pose_[12];
+  bool has_meshing_thresholds_;
+  float meshing_threshold_max_;
+  float meshing_threshold_avg_;
 
   // Configurations for surface voxels data.
   int voxel_count_;
@@ -217,23 +260,40 @@ class ScenePerceptionObject : public xwalk::common::EventTarget {
 
   base::TimeTicks last_meshing_time_;
 
+  // Only creates the sample images. The frames come from the pipeline of
+  // |connection_|, which the camera may share with other extensions.
   PXCSession* session_;
-  PXCSenseManager* sense_manager_;
+  realsense::common::CaptureConnection* connection_;
   PXCScenePerception* scene_perception_;
   PXCScenePerception::ScenePerceptionIntrinsics sp_intrinsics_;
 
   PXCBlockMeshingData* block_meshing_data_;
+  realsense::common::MemoryTracker block_meshing_data_memory_;
   // All actions on surface_voxels_data_
   // should be taken on sensemanager_thread_;
   PXCSurfaceVoxelsData* surface_voxels_data_;
+  realsense::common::MemoryTracker surface_voxels_data_memory_;
   PXCScenePerception::MeshingUpdateInfo  meshing_update_info_;
   pxcBool b_fill_holes_;
 
   PXCImage* latest_color_image_;
   PXCImage* latest_depth_image_;
+  realsense::common::MemoryTracker color_image_memory_;
+  realsense::common::MemoryTracker depth_image_memory_;
 
   scoped_ptr<uint8[]> sample_message_;
+  // The capacity of |sample_message_|.
   size_t sample_message_size_;
+  realsense::common::MemoryTracker sample_message_memory_;
+
+  // Counts the frames copied to |latest_color_image_| and
+  // |latest_depth_image_|, to match the samples to the frames in traces.
+  int64 frame_id_;
+  // From the "checking" or "sampleprocessed" event of a frame to getSample().
+  realsense::common::FrameFlow sample_flow_;
+
+  // Records the frames of the pipeline while REALSENSE_RECORD_DIR is set.
+  scoped_ptr<realsense::common::FrameRecorder> recorder_;
 };
 
 }  // namespace scene_perception
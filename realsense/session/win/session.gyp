@@ -9,6 +9,7 @@
       'type': 'loadable_module',
       'dependencies':[
         '<(DEPTH)/base/base.gyp:base',
+        '../../common/win/capture_service.gyp:capture_service',
         '<(DEPTH)/extensions/third_party/libpxc/libpxc.gyp:libpxc',
         '<(DEPTH)/xwalk/common/common.gyp:common',
       ],
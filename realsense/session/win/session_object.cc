@@ -7,7 +7,7 @@
 // This file is auto-generated by sesssion.idl
 #include "session.h" // NOLINT
 
-#include "third_party/libpxc/include/pxcsession.h"
+#include "realsense/common/win/shared_session.h"
 
 namespace realsense {
 namespace session {
@@ -15,13 +15,14 @@ namespace session {
 using namespace realsense::jsapi::session; // NOLINT
 using namespace xwalk::common; // NOLINT
 
-SessionObject::SessionObject() {
+SessionObject::SessionObject() : session_(nullptr) {
   handler_.Register("getVersion",
                     base::Bind(&SessionObject::OnGetVersion,
                                base::Unretained(this)));
 }
 
 SessionObject::~SessionObject() {
+  realsense::common::ReleaseSharedSession(session_);
 }
 
 void SessionObject::StartEvent(const std::string& type) {
@@ -34,9 +35,14 @@ void SessionObject::StopEvent(const std::string& type) {
 
 void SessionObject::OnGetVersion(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  PXCSession* session = PXCSession::CreateInstance();
-  PXCSession::ImplVersion ver = session->QueryVersion();
-  session->Release();
+  if (!session_)
+    session_ = realsense::common::AcquireSharedSession();
+  if (!session_) {
+    info->PostResult(GetVersion::Results::Create(
+        Version(), "Failed to create PXCSession."));
+    return;
+  }
+  PXCSession::ImplVersion ver = session_->QueryVersion();
   std::ostringstream major, minor;
   major << ver.major;
   minor << ver.minor;
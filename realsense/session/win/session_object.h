@@ -6,6 +6,7 @@
 #define REALSENSE_SESSION_SESSION_OBJECT_H_
 
 #include <string>
+#include "third_party/libpxc/include/pxcsession.h"
 #include "xwalk/common/event_target.h"
 
 namespace realsense {
@@ -23,6 +24,10 @@ class SessionObject : public xwalk::common::EventTarget {
  private:
   void OnGetVersion(
       scoped_ptr<xwalk::common::XWalkExtensionFunctionInfo> info);
+
+  // A reference to the session shared by the extensions, taken by the first
+  // getVersion() call.
+  PXCSession* session_;
 };
 
 }  // namespace session